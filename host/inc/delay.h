@@ -0,0 +1,16 @@
+/*
+ * delay.h
+ *
+ * Host stand-in, the delays advance the virtual clock of sim.c.
+ *
+ */
+
+#ifndef __DELAY_H
+#define __DELAY_H
+#include "sys.h"
+
+void delay_init(u8 SYSCLK);
+void delay_ms(u16 nms);
+void delay_us(u32 nus);
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * oledfont.h
+ *
+ * Host stand-in for the board font tables: every glyph is a box one
+ * column narrower and one row shorter than the cell, enough to see the
+ * layout in the rendered PGM.
+ *
+ */
+
+#ifndef __OLEDFONT_H
+#define __OLEDFONT_H
+
+// 6 x 12, 2 bytes per column, top pixel in the MSB
+static const unsigned char asc2_1206[95][12] = {
+	[0 ... 94] = {0XFF, 0XE0, 0X80, 0X20, 0X80, 0X20, 0X80, 0X20, 0XFF, 0XE0, 0X00, 0X00},
+};
+
+// 8 x 16
+static const unsigned char asc2_1608[95][16] = {
+	[0 ... 94] = {0XFF, 0XFE, 0X80, 0X02, 0X80, 0X02, 0X80, 0X02, 0X80, 0X02, 0X80, 0X02, 0XFF, 0XFE, 0X00, 0X00},
+};
+
+// 12 x 24, 3 bytes per column
+static const unsigned char asc2_2412[95][36] = {
+	[0 ... 94] = {0XFF, 0XFF, 0XFE, 0X80, 0X00, 0X02, 0X80, 0X00, 0X02, 0X80, 0X00, 0X02,
+				  0X80, 0X00, 0X02, 0X80, 0X00, 0X02, 0X80, 0X00, 0X02, 0X80, 0X00, 0X02,
+				  0X80, 0X00, 0X02, 0X80, 0X00, 0X02, 0XFF, 0XFF, 0XFE, 0X00, 0X00, 0X00},
+};
+
+#endif
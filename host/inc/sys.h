@@ -0,0 +1,535 @@
+/*
+ * sys.h
+ *
+ * Host stand-in for the board sys.h and the parts of the STM32F4 HAL and
+ * CMSIS the drivers use. Register accesses go through sim.c: GPIO and DWT
+ * accesses advance the virtual clock and hand every pin change to the
+ * hardware models in order.
+ *
+ */
+
+#ifndef __SYS_H
+#define __SYS_H
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t u32;
+typedef uint16_t u16;
+typedef uint8_t u8;
+
+////////////////////////////////////////////////////
+//CORE
+
+extern uint32_t SystemCoreClock;
+
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type *Sim_DWT(void);
+extern CoreDebug_Type Sim_CoreDebug;
+
+#define DWT         (Sim_DWT()) //each read of CYCCNT advances the clock
+#define CoreDebug   (&Sim_CoreDebug)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+    return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+    *addr = value;
+    return 0;
+}
+
+#define __CLREX()
+#define __DMB()     __sync_synchronize()
+
+////////////////////////////////////////////////////
+//GPIO
+//IDR, ODR and BSRR expand to a call that first applies the previous write
+//of any port, so the models see every write in order even when two
+//writes hit the same register back to back. The struct is 0x400 bytes
+//like the port blocks, GPIOx - GPIOA_BASE gives the port number.
+
+typedef struct
+{
+    volatile uint32_t MODER;
+    volatile uint32_t OTYPER;
+    volatile uint32_t OSPEEDR;
+    volatile uint32_t PUPDR;
+    volatile uint32_t IDR_[1];
+    volatile uint32_t ODR_[1];
+    volatile uint32_t BSRR_[1];
+    volatile uint32_t LCKR;
+    volatile uint32_t AFR[2];
+    uint32_t bit_slot; //value written through the bit-band alias
+    uint32_t pad[245];
+} GPIO_TypeDef;
+
+#define SIM_GPIO_PORTS  11 //GPIOA ~ GPIOK
+extern GPIO_TypeDef Sim_GPIO[SIM_GPIO_PORTS];
+
+uint32_t Sim_GPIO_Access(void);
+volatile uint32_t *Sim_GPIO_Bit(GPIO_TypeDef *port, uint8_t n);
+uint32_t Sim_GPIO_Read(GPIO_TypeDef *port, uint8_t n);
+
+#define IDR     IDR_[Sim_GPIO_Access()]
+#define ODR     ODR_[Sim_GPIO_Access()]
+#define BSRR    BSRR_[Sim_GPIO_Access()]
+
+#define GPIOA   (&Sim_GPIO[0])
+#define GPIOB   (&Sim_GPIO[1])
+#define GPIOC   (&Sim_GPIO[2])
+#define GPIOD   (&Sim_GPIO[3])
+#define GPIOE   (&Sim_GPIO[4])
+#define GPIOF   (&Sim_GPIO[5])
+#define GPIOG   (&Sim_GPIO[6])
+#define GPIOH   (&Sim_GPIO[7])
+#define GPIOI   (&Sim_GPIO[8])
+#define GPIOJ   (&Sim_GPIO[9])
+#define GPIOK   (&Sim_GPIO[10])
+#define GPIOA_BASE  ((uint32_t)(uintptr_t)GPIOA)
+
+//bit-band aliases
+#define PAout(n)    (*Sim_GPIO_Bit(GPIOA, n))
+#define PAin(n)     Sim_GPIO_Read(GPIOA, n)
+#define PBout(n)    (*Sim_GPIO_Bit(GPIOB, n))
+#define PBin(n)     Sim_GPIO_Read(GPIOB, n)
+#define PCout(n)    (*Sim_GPIO_Bit(GPIOC, n))
+#define PCin(n)     Sim_GPIO_Read(GPIOC, n)
+#define PDout(n)    (*Sim_GPIO_Bit(GPIOD, n))
+#define PDin(n)     Sim_GPIO_Read(GPIOD, n)
+#define PEout(n)    (*Sim_GPIO_Bit(GPIOE, n))
+#define PEin(n)     Sim_GPIO_Read(GPIOE, n)
+#define PFout(n)    (*Sim_GPIO_Bit(GPIOF, n))
+#define PFin(n)     Sim_GPIO_Read(GPIOF, n)
+#define PGout(n)    (*Sim_GPIO_Bit(GPIOG, n))
+#define PGin(n)     Sim_GPIO_Read(GPIOG, n)
+#define PHout(n)    (*Sim_GPIO_Bit(GPIOH, n))
+#define PHin(n)     Sim_GPIO_Read(GPIOH, n)
+#define PIout(n)    (*Sim_GPIO_Bit(GPIOI, n))
+#define PIin(n)     Sim_GPIO_Read(GPIOI, n)
+
+//GPIO_Set of the board sys.c
+#define PIN0    (1 << 0)
+#define PIN1    (1 << 1)
+#define PIN2    (1 << 2)
+#define PIN3    (1 << 3)
+#define PIN4    (1 << 4)
+#define PIN5    (1 << 5)
+#define PIN6    (1 << 6)
+#define PIN7    (1 << 7)
+#define PIN8    (1 << 8)
+#define PIN9    (1 << 9)
+#define PIN10   (1 << 10)
+#define PIN11   (1 << 11)
+#define PIN12   (1 << 12)
+#define PIN13   (1 << 13)
+#define PIN14   (1 << 14)
+#define PIN15   (1 << 15)
+
+#define GPIO_MODE_IN        0
+#define GPIO_MODE_OUT       1
+#define GPIO_MODE_AF        2
+#define GPIO_MODE_AIN       3
+#define GPIO_OTYPE_PP       0
+#define GPIO_OTYPE_OD       1
+#define GPIO_SPEED_2M       0
+#define GPIO_SPEED_25M      1
+#define GPIO_SPEED_50M      2
+#define GPIO_SPEED_100M     3
+#define GPIO_PUPD_NONE      0
+#define GPIO_PUPD_PU        1
+#define GPIO_PUPD_PD        2
+
+void GPIO_Set(GPIO_TypeDef *GPIOx, u32 BITx, u32 MODE, u32 OTYPE, u32 OSPEED, u32 PUPD);
+
+////////////////////////////////////////////////////
+//RCC
+
+typedef struct
+{
+    volatile uint32_t AHB1ENR;
+    volatile uint32_t APB2ENR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef Sim_RCC;
+#define RCC (&Sim_RCC)
+
+#define __HAL_RCC_GPIOB_CLK_ENABLE()
+#define __HAL_RCC_GPIOF_CLK_ENABLE()
+#define __HAL_RCC_GPIOH_CLK_ENABLE()
+#define __HAL_RCC_SPI5_CLK_ENABLE()
+#define __HAL_RCC_I2C2_CLK_ENABLE()
+#define __HAL_RCC_DMA1_CLK_ENABLE()
+#define __HAL_RCC_DMA2_CLK_ENABLE()
+#define __HAL_RCC_QSPI_CLK_ENABLE()
+
+////////////////////////////////////////////////////
+//HAL
+
+typedef enum
+{
+    HAL_OK = 0,
+    HAL_ERROR = 1,
+    HAL_BUSY = 2,
+    HAL_TIMEOUT = 3
+} HAL_StatusTypeDef;
+
+#define assert_param(expr)  ((void)0)
+#define POSITION_VAL(v)     ((uint32_t)__builtin_ctz(v))
+#define SET_BIT(REG, BIT)   ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+
+uint32_t HAL_GetTick(void);
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_0  0X0001
+#define GPIO_PIN_1  0X0002
+#define GPIO_PIN_2  0X0004
+#define GPIO_PIN_3  0X0008
+#define GPIO_PIN_4  0X0010
+#define GPIO_PIN_5  0X0020
+#define GPIO_PIN_6  0X0040
+#define GPIO_PIN_7  0X0080
+#define GPIO_PIN_8  0X0100
+#define GPIO_PIN_9  0X0200
+#define GPIO_PIN_10 0X0400
+#define GPIO_PIN_11 0X0800
+#define GPIO_PIN_12 0X1000
+#define GPIO_PIN_13 0X2000
+#define GPIO_PIN_14 0X4000
+#define GPIO_PIN_15 0X8000
+
+#define GPIO_MODE_INPUT     0X00
+#define GPIO_MODE_OUTPUT_PP 0X01
+#define GPIO_MODE_OUTPUT_OD 0X11
+#define GPIO_MODE_AF_PP     0X02
+#define GPIO_MODE_AF_OD     0X12
+#define GPIO_NOPULL         0X00
+#define GPIO_PULLUP         0X01
+#define GPIO_SPEED_LOW      0X00
+#define GPIO_SPEED_MEDIUM   0X01
+#define GPIO_SPEED_FAST     0X02
+#define GPIO_SPEED_HIGH     0X03
+#define GPIO_AF4_I2C2       0X04
+#define GPIO_AF5_SPI5       0X05
+#define GPIO_AF9_QUADSPI    0X09
+#define GPIO_AF10_QUADSPI   0X0A
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+
+typedef enum
+{
+    DMA1_Stream2_IRQn = 13,
+    I2C2_EV_IRQn = 33,
+    I2C2_ER_IRQn = 34,
+    DMA1_Stream7_IRQn = 47,
+    DMA2_Stream3_IRQn = 59,
+    DMA2_Stream4_IRQn = 60
+} IRQn_Type;
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+//DMA
+typedef struct
+{
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+    uint32_t FIFOMode;
+} DMA_InitTypeDef;
+
+typedef struct
+{
+    void *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+} DMA_HandleTypeDef;
+
+#define DMA1_Stream2            ((void *)0X12)
+#define DMA1_Stream7            ((void *)0X17)
+#define DMA2_Stream3            ((void *)3)
+#define DMA2_Stream4            ((void *)4)
+#define DMA_CHANNEL_2           0X04000000
+#define DMA_CHANNEL_7           0X0E000000
+#define DMA_PERIPH_TO_MEMORY    0X00
+#define DMA_MEMORY_TO_PERIPH    0X40
+#define DMA_PINC_DISABLE        0X00
+#define DMA_MINC_ENABLE         0X400
+#define DMA_PDATAALIGN_BYTE     0X00
+#define DMA_MDATAALIGN_BYTE     0X00
+#define DMA_NORMAL              0X00
+#define DMA_PRIORITY_MEDIUM     0X10000
+#define DMA_PRIORITY_HIGH       0X20000
+#define DMA_FIFOMODE_DISABLE    0X00
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+#define __HAL_LINKDMA(h, field, dma) \
+    do                               \
+    {                                \
+        (h)->field = &(dma);         \
+        (dma).Parent = (h);          \
+    } while (0)
+
+//SPI
+typedef struct
+{
+    volatile uint32_t CR1;
+} SPI_TypeDef;
+
+typedef struct
+{
+    uint32_t Mode;
+    uint32_t Direction;
+    uint32_t DataSize;
+    uint32_t CLKPolarity;
+    uint32_t CLKPhase;
+    uint32_t NSS;
+    uint32_t BaudRatePrescaler;
+    uint32_t FirstBit;
+    uint32_t TIMode;
+    uint32_t CRCCalculation;
+    uint32_t CRCPolynomial;
+} SPI_InitTypeDef;
+
+typedef enum
+{
+    HAL_SPI_STATE_RESET = 0,
+    HAL_SPI_STATE_READY = 1,
+    HAL_SPI_STATE_BUSY = 2
+} HAL_SPI_StateTypeDef;
+
+typedef struct
+{
+    SPI_TypeDef *Instance;
+    SPI_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    volatile HAL_SPI_StateTypeDef State;
+    volatile uint32_t ErrorCode;
+} SPI_HandleTypeDef;
+
+extern SPI_TypeDef Sim_SPI5;
+#define SPI5    (&Sim_SPI5)
+
+#define SPI_MODE_MASTER             0X0104
+#define SPI_DIRECTION_2LINES        0X0000
+#define SPI_DATASIZE_8BIT           0X0000
+#define SPI_POLARITY_HIGH           0X0002
+#define SPI_PHASE_2EDGE             0X0001
+#define SPI_NSS_SOFT                0X0200
+#define SPI_BAUDRATEPRESCALER_2     0X0000
+#define SPI_BAUDRATEPRESCALER_4     0X0008
+#define SPI_BAUDRATEPRESCALER_8     0X0010
+#define SPI_BAUDRATEPRESCALER_16    0X0018
+#define SPI_BAUDRATEPRESCALER_32    0X0020
+#define SPI_BAUDRATEPRESCALER_64    0X0028
+#define SPI_BAUDRATEPRESCALER_128   0X0030
+#define SPI_BAUDRATEPRESCALER_256   0X0038
+#define SPI_FIRSTBIT_MSB            0X0000
+#define SPI_TIMODE_DISABLE          0X0000
+#define SPI_CRCCALCULATION_DISABLE  0X0000
+#define HAL_SPI_ERROR_NONE          0X0000
+#define IS_SPI_BAUDRATE_PRESCALER(p) (((p) & ~0X38U) == 0)
+
+#define __HAL_SPI_ENABLE(h)     ((h)->Instance->CR1 |= 0X0040)
+#define __HAL_SPI_DISABLE(h)    ((h)->Instance->CR1 &= ~0X0040U)
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi);
+void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi);
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi);
+
+//QUADSPI, the models give both transports to every build
+#define HAL_QSPI_MODULE_ENABLED
+
+typedef struct
+{
+    uint32_t ClockPrescaler;
+    uint32_t FifoThreshold;
+    uint32_t SampleShifting;
+    uint32_t FlashSize;
+    uint32_t ChipSelectHighTime;
+    uint32_t ClockMode;
+    uint32_t FlashID;
+    uint32_t DualFlash;
+} QSPI_InitTypeDef;
+
+typedef struct
+{
+    void *Instance;
+    QSPI_InitTypeDef Init;
+} QSPI_HandleTypeDef;
+
+//line counts are the values of the mode constants
+typedef struct
+{
+    uint32_t Instruction;
+    uint32_t Address;
+    uint32_t AlternateBytes;
+    uint32_t AddressSize;
+    uint32_t AlternateBytesSize;
+    uint32_t DummyCycles;
+    uint32_t InstructionMode;
+    uint32_t AddressMode;
+    uint32_t AlternateByteMode;
+    uint32_t DataMode;
+    uint32_t NbData;
+    uint32_t DdrMode;
+    uint32_t DdrHoldHalfCycle;
+    uint32_t SIOOMode;
+} QSPI_CommandTypeDef;
+
+typedef struct
+{
+    uint32_t TimeOutPeriod;
+    uint32_t TimeOutActivation;
+} QSPI_MemoryMappedTypeDef;
+
+#define QUADSPI                         ((void *)0XA0001000)
+#define QSPI_SAMPLE_SHIFTING_HALFCYCLE  0X10
+#define QSPI_CS_HIGH_TIME_5_CYCLE       0X400
+#define QSPI_CLOCK_MODE_0               0X00
+#define QSPI_FLASH_ID_1                 0X00
+#define QSPI_DUALFLASH_DISABLE          0X00
+#define QSPI_INSTRUCTION_NONE           0
+#define QSPI_INSTRUCTION_1_LINE         1
+#define QSPI_ADDRESS_NONE               0
+#define QSPI_ADDRESS_1_LINE             1
+#define QSPI_ADDRESS_2_LINES            2
+#define QSPI_ADDRESS_4_LINES            4
+#define QSPI_ADDRESS_24_BITS            3
+#define QSPI_ADDRESS_32_BITS            4
+#define QSPI_ALTERNATE_BYTES_NONE       0
+#define QSPI_ALTERNATE_BYTES_1_LINE     1
+#define QSPI_ALTERNATE_BYTES_2_LINES    2
+#define QSPI_ALTERNATE_BYTES_4_LINES    4
+#define QSPI_ALTERNATE_BYTES_8_BITS     1
+#define QSPI_DATA_NONE                  0
+#define QSPI_DATA_1_LINE                1
+#define QSPI_DATA_2_LINES               2
+#define QSPI_DATA_4_LINES               4
+#define QSPI_DDR_MODE_DISABLE           0
+#define QSPI_DDR_HHC_ANALOG_DELAY       0
+#define QSPI_SIOO_INST_EVERY_CMD        0
+#define QSPI_SIOO_INST_ONLY_FIRST_CMD   1
+#define QSPI_TIMEOUT_COUNTER_DISABLE    0
+
+HAL_StatusTypeDef HAL_QSPI_Init(QSPI_HandleTypeDef *hqspi);
+void HAL_QSPI_MspInit(QSPI_HandleTypeDef *hqspi);
+HAL_StatusTypeDef HAL_QSPI_Command(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, uint32_t Timeout);
+HAL_StatusTypeDef HAL_QSPI_Receive(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout);
+HAL_StatusTypeDef HAL_QSPI_Transmit(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout);
+HAL_StatusTypeDef HAL_QSPI_MemoryMapped(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, QSPI_MemoryMappedTypeDef *cfg);
+HAL_StatusTypeDef HAL_QSPI_Abort(QSPI_HandleTypeDef *hqspi);
+
+//I2C2, the controller clocks the bus through PH4/PH5 (see hal.c)
+typedef struct
+{
+    volatile uint32_t CR1;
+} I2C_TypeDef;
+
+typedef struct
+{
+    uint32_t ClockSpeed;
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum
+{
+    HAL_I2C_STATE_RESET = 0X00,
+    HAL_I2C_STATE_READY = 0X20,
+    HAL_I2C_STATE_BUSY = 0X24
+} HAL_I2C_StateTypeDef;
+
+typedef struct
+{
+    I2C_TypeDef *Instance;
+    I2C_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    volatile HAL_I2C_StateTypeDef State;
+    volatile uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+extern I2C_TypeDef Sim_I2C2;
+#define I2C2    (&Sim_I2C2) //a CR1 write takes effect at the next hardware access
+
+#define I2C_CR1_STOP                0X0200
+#define I2C_DUTYCYCLE_2             0X0000
+#define I2C_ADDRESSINGMODE_7BIT     0X4000
+#define I2C_DUALADDRESS_DISABLE     0X0000
+#define I2C_GENERALCALL_DISABLE     0X0000
+#define I2C_NOSTRETCH_DISABLE       0X0000
+#define I2C_MEMADD_SIZE_8BIT        0X0001
+#define I2C_MEMADD_SIZE_16BIT       0X0010
+#define I2C_FIRST_FRAME             0X0001
+#define I2C_NEXT_FRAME              0X0004
+#define I2C_FIRST_AND_LAST_FRAME    0X0008
+#define I2C_LAST_FRAME              0X0020
+#define HAL_I2C_ERROR_NONE          0X0000
+#define HAL_I2C_ERROR_AF            0X0004
+#define HAL_I2C_ERROR_TIMEOUT       0X0020
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions);
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * usart.h
+ *
+ * Host stand-in, printf goes to stdout.
+ *
+ */
+
+#ifndef __USART_H
+#define __USART_H
+#include "sys.h"
+#include <stdio.h>
+
+#endif
@@ -0,0 +1,811 @@
+#define _GNU_SOURCE
+#include "hal.h"
+#include "delay.h"
+#include "w25q_model.h"
+#include <pthread.h>
+
+Sim_HAL_Stats SIM_HAL_STATS;
+QSPI_CommandTypeDef SIM_QSPI_LAST;
+SPI_TypeDef Sim_SPI5;
+
+static QSPI_CommandTypeDef Sim_QSPI_Cmd; // command waiting for its data phase
+static uint8_t Sim_QSPI_Pending;
+static uint8_t Sim_QSPI_Map;
+
+////////////////////////////////////////////////////
+//GPIO, delays
+
+/**
+ * @brief set the mode bits of pins, mode: 0 input, 1 output, 2 AF, 3 analog
+ *
+ */
+static void Sim_GPIO_Mode(GPIO_TypeDef *port, uint32_t pins, uint32_t mode)
+{
+	uint8_t n;
+	Sim_Advance(SIM_GPIO_CYCLES);
+	for (n = 0; n < 16; n++)
+	{
+		if (pins & (1UL << n))
+		{
+			port->MODER = (port->MODER & ~(3UL << (n * 2))) | ((mode & 3) << (n * 2));
+		}
+	}
+}
+
+void GPIO_Set(GPIO_TypeDef *GPIOx, u32 BITx, u32 MODE, u32 OTYPE, u32 OSPEED, u32 PUPD)
+{
+	uint8_t n;
+	(void)OTYPE;
+	(void)OSPEED;
+	Sim_GPIO_Mode(GPIOx, BITx, MODE);
+	for (n = 0; n < 16; n++)
+	{
+		if (BITx & (1UL << n))
+		{
+			GPIOx->PUPDR = (GPIOx->PUPDR & ~(3UL << (n * 2))) | ((PUPD & 3) << (n * 2));
+		}
+	}
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	uint8_t n;
+	Sim_GPIO_Mode(GPIOx, GPIO_Init->Pin, GPIO_Init->Mode);
+	for (n = 0; n < 16; n++)
+	{
+		if (GPIO_Init->Pin & (1UL << n))
+		{
+			GPIOx->PUPDR = (GPIOx->PUPDR & ~(3UL << (n * 2))) | ((GPIO_Init->Pull & 3) << (n * 2));
+		}
+	}
+}
+
+uint32_t HAL_GetTick(void)
+{
+	Sim_Advance(SIM_TICK_CYCLES);
+	return (uint32_t)(Sim_Time / (SystemCoreClock / 1000));
+}
+
+void delay_init(u8 SYSCLK)
+{
+	(void)SYSCLK;
+}
+
+void delay_us(u32 nus)
+{
+	Sim_Advance((uint64_t)nus * (SystemCoreClock / 1000000));
+}
+
+void delay_ms(u16 nms)
+{
+	Sim_Advance((uint64_t)nms * (SystemCoreClock / 1000));
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	(void)IRQn;
+	(void)PreemptPriority;
+	(void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	(void)IRQn;
+}
+
+////////////////////////////////////////////////////
+//DMA
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	(void)hdma;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+	(void)hdma;
+	return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+	(void)hdma;
+}
+
+/**
+ * @brief 1: p is on the stack of the simulation thread
+ * The bounds are looked up once, pthread_getattr_np reads /proc for the
+ * main thread.
+ *
+ */
+static uint8_t Sim_On_Stack(const void *p)
+{
+	static void *base;
+	static size_t size;
+	pthread_attr_t attr;
+	if (size == 0)
+	{
+		if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		{
+			return 0;
+		}
+		pthread_attr_getstack(&attr, &base, &size);
+		pthread_attr_destroy(&attr);
+	}
+	return (const uint8_t *)p >= (const uint8_t *)base && (const uint8_t *)p < (const uint8_t *)base + size;
+}
+
+////////////////////////////////////////////////////
+//SPI5, the flash is the only device
+
+/**
+ * @brief core cycles per byte: SCK = APB2 / 2^(BR+1), 2 core cycles per
+ * APB2 cycle
+ *
+ */
+static uint32_t Sim_SPI_Byte_Cycles(SPI_HandleTypeDef *hspi)
+{
+	return 8 * 2 * (2UL << ((hspi->Instance->CR1 >> 3) & 7));
+}
+
+/**
+ * @brief clock a block through the flash model, tx and rx may be the same
+ *
+ */
+static void Sim_SPI_Xfer(SPI_HandleTypeDef *hspi, const uint8_t *tx, uint8_t *rx, uint16_t size)
+{
+	uint16_t i;
+	uint8_t b;
+	uint32_t cycles = Sim_SPI_Byte_Cycles(hspi);
+	Sim_Sync();
+	for (i = 0; i < size; i++)
+	{
+		b = Sim_Flash_Xfer(tx ? tx[i] : 0XFF);
+		if (rx)
+		{
+			rx[i] = b;
+		}
+		Sim_Time += cycles;
+	}
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+	HAL_SPI_MspInit(hspi);
+	hspi->Instance->CR1 = hspi->Init.BaudRatePrescaler;
+	hspi->State = HAL_SPI_STATE_READY;
+	hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	SIM_HAL_STATS.spi_polled++;
+	Sim_SPI_Xfer(hspi, pData, NULL, Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	SIM_HAL_STATS.spi_polled++;
+	Sim_SPI_Xfer(hspi, pData, pData, Size); // master full duplex: the buffer is sent
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	SIM_HAL_STATS.spi_polled++;
+	Sim_SPI_Xfer(hspi, pTxData, pRxData, Size);
+	return HAL_OK;
+}
+
+/**
+ * @brief a DMA transfer, done by the time the call returns
+ *
+ */
+static HAL_StatusTypeDef Sim_SPI_DMA(SPI_HandleTypeDef *hspi, const uint8_t *tx, uint8_t *rx, uint16_t Size)
+{
+	Sim_Advance(SIM_HAL_DMA_CYCLES);
+	SIM_HAL_STATS.spi_dma++;
+	if ((tx && Sim_On_Stack(tx)) || (rx && Sim_On_Stack(rx)))
+	{
+		SIM_HAL_STATS.dma_stack++;
+	}
+	Sim_SPI_Xfer(hspi, tx, rx, Size);
+	hspi->State = HAL_SPI_STATE_READY;
+	hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	return Sim_SPI_DMA(hspi, pData, NULL, Size);
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	return Sim_SPI_DMA(hspi, pData, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size)
+{
+	return Sim_SPI_DMA(hspi, pTxData, pRxData, Size);
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	hspi->State = HAL_SPI_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef *hspi)
+{
+	Sim_Advance(SIM_DWT_CYCLES);
+	return hspi->State;
+}
+
+////////////////////////////////////////////////////
+//QUADSPI, NCS is driven by the controller for each command
+
+uint8_t Sim_QSPI_Mapped(void)
+{
+	return Sim_QSPI_Map;
+}
+
+/**
+ * @brief select the flash and clock instruction, address, mode byte and
+ * dummy cycles of a command, the mode constants are line counts
+ *
+ */
+static void Sim_QSPI_Header(const QSPI_CommandTypeDef *cmd)
+{
+	uint8_t lines = cmd->AddressMode ? cmd->AddressMode : 1;
+	uint32_t i, clocks = cmd->DummyCycles;
+	Sim_Sync();
+	Sim_Flash_Set_Lines(cmd->AddressMode, cmd->DataMode);
+	Sim_Flash_Select(0);
+	if (cmd->InstructionMode != QSPI_INSTRUCTION_NONE)
+	{
+		Sim_Flash_Xfer(cmd->Instruction);
+		clocks += 8;
+	}
+	if (cmd->AddressMode != QSPI_ADDRESS_NONE)
+	{
+		for (i = cmd->AddressSize; i > 0; i--)
+		{
+			Sim_Flash_Xfer((uint8_t)(cmd->Address >> ((i - 1) * 8)));
+			clocks += 8 / cmd->AddressMode;
+		}
+	}
+	if (cmd->AlternateByteMode != QSPI_ALTERNATE_BYTES_NONE)
+	{
+		Sim_Flash_Xfer((uint8_t)cmd->AlternateBytes);
+		clocks += 8 / cmd->AlternateByteMode;
+	}
+	for (i = 0; i < cmd->DummyCycles * lines / 8; i++)
+	{
+		Sim_Flash_Xfer(0XFF);
+	}
+	Sim_Time += (uint64_t)clocks * SIM_QSPI_CLK_CYCLES;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Init(QSPI_HandleTypeDef *hqspi)
+{
+	HAL_QSPI_MspInit(hqspi);
+	Sim_QSPI_Map = 0;
+	Sim_QSPI_Pending = 0;
+	Sim_Flash_Window(0);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Command(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, uint32_t Timeout)
+{
+	(void)hqspi;
+	(void)Timeout;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	SIM_HAL_STATS.qspi_cmds++;
+	if (Sim_QSPI_Map)
+	{
+		SIM_HAL_STATS.qspi_errors++;
+		return HAL_BUSY;
+	}
+	SIM_QSPI_LAST = *cmd;
+	if (!Sim_Flash_QE() && ((GPIOF->PUPDR >> 12) & 0XF) != 0X5)
+	{
+		SIM_HAL_STATS.qspi_floating++; // PF6/PF7 pull-ups
+	}
+	Sim_QSPI_Header(cmd);
+	if (cmd->DataMode == QSPI_DATA_NONE)
+	{
+		Sim_Flash_Select(1);
+		Sim_QSPI_Pending = 0;
+	}
+	else
+	{
+		Sim_QSPI_Cmd = *cmd;
+		Sim_QSPI_Pending = 1;
+	}
+	return HAL_OK;
+}
+
+/**
+ * @brief data phase of the pending command, rx: receive, tx: transmit
+ *
+ */
+static HAL_StatusTypeDef Sim_QSPI_Data(const uint8_t *tx, uint8_t *rx)
+{
+	uint32_t i;
+	if (!Sim_QSPI_Pending)
+	{
+		return HAL_ERROR;
+	}
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	for (i = 0; i < Sim_QSPI_Cmd.NbData; i++)
+	{
+		if (rx)
+		{
+			rx[i] = Sim_Flash_Xfer(0XFF);
+		}
+		else
+		{
+			Sim_Flash_Xfer(tx[i]);
+		}
+	}
+	Sim_Time += (uint64_t)Sim_QSPI_Cmd.NbData * 8 / Sim_QSPI_Cmd.DataMode * SIM_QSPI_CLK_CYCLES;
+	Sim_Flash_Select(1);
+	Sim_QSPI_Pending = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Receive(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout)
+{
+	(void)hqspi;
+	(void)Timeout;
+	return Sim_QSPI_Data(NULL, pData);
+}
+
+HAL_StatusTypeDef HAL_QSPI_Transmit(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout)
+{
+	(void)hqspi;
+	(void)Timeout;
+	return Sim_QSPI_Data(pData, NULL);
+}
+
+/**
+ * @brief memory-mapped mode, the window of the flash model becomes
+ * readable
+ * With continuous read mode (M5-4 = 10) the first access is clocked
+ * through the model so that the chip enters the mode.
+ *
+ */
+HAL_StatusTypeDef HAL_QSPI_MemoryMapped(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, QSPI_MemoryMappedTypeDef *cfg)
+{
+	QSPI_CommandTypeDef first;
+	(void)hqspi;
+	(void)cfg;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	if (Sim_QSPI_Map)
+	{
+		SIM_HAL_STATS.qspi_errors++;
+		return HAL_BUSY;
+	}
+	SIM_HAL_STATS.qspi_maps++;
+	if (Sim_Flash_Busy())
+	{
+		SIM_HAL_STATS.qspi_busy_maps++;
+	}
+	if (cmd->AlternateByteMode != QSPI_ALTERNATE_BYTES_NONE && (cmd->AlternateBytes & 0X30) == 0X20)
+	{
+		if (cmd->SIOOMode != QSPI_SIOO_INST_ONLY_FIRST_CMD)
+		{
+			SIM_HAL_STATS.qspi_errors++; // the instruction would be read as an address
+		}
+		first = *cmd;
+		first.Address = 0;
+		Sim_QSPI_Header(&first);
+		Sim_Flash_Xfer(0XFF);
+		Sim_Flash_Select(1);
+	}
+	Sim_QSPI_Map = 1;
+	Sim_Flash_Window(1);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Abort(QSPI_HandleTypeDef *hqspi)
+{
+	(void)hqspi;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	if (Sim_QSPI_Pending)
+	{
+		Sim_Flash_Select(1);
+		Sim_QSPI_Pending = 0;
+	}
+	Sim_QSPI_Map = 0;
+	Sim_Flash_Window(0);
+	return HAL_OK;
+}
+
+////////////////////////////////////////////////////
+//I2C2 on PH4 (SCL) and PH5 (SDA)
+
+#define SIM_I2C2_SCL GPIO_PIN_4
+#define SIM_I2C2_SDA GPIO_PIN_5
+#define SIM_I2C2_STRETCH 25 //ms SCL may be held low, I2C_TIMEOUT_BUSY_FLAG of the HAL
+
+// bus owned between sequential frames
+#define SIM_I2C2_FREE 0
+#define SIM_I2C2_HELD_TX 1 // after a transmit frame
+#define SIM_I2C2_HELD_RX 2 // after a receive frame, its last byte acked
+
+I2C_TypeDef Sim_I2C2;
+
+static uint32_t Sim_I2C2_Low, Sim_I2C2_High; // SCL low and high, core cycles
+static uint8_t Sim_I2C2_Held;
+static uint8_t Sim_I2C2_Timeout; // SCL held low past SIM_I2C2_STRETCH
+
+/**
+ * @brief drive a line, a register write
+ *
+ */
+static void Sim_I2C2_Line(uint16_t pin, uint8_t level)
+{
+	Sim_GPIO_AF(GPIOH, pin, level);
+	Sim_Advance(SIM_GPIO_CYCLES);
+}
+
+/**
+ * @brief release SCL and wait while a device stretches it
+ *
+ */
+static void Sim_I2C2_SCL_High(void)
+{
+	uint64_t start = Sim_Time;
+	Sim_I2C2_Line(SIM_I2C2_SCL, 1);
+	while (!Sim_GPIO_Read(GPIOH, 4))
+	{
+		if (Sim_Time - start > (uint64_t)SIM_I2C2_STRETCH * (SystemCoreClock / 1000))
+		{
+			Sim_I2C2_Timeout = 1;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief one SCL clock, SCL is low before and after
+ *
+ * @param
+ * sda: level to send, 1 to receive
+ *
+ * @return SDA sampled while SCL is high
+ *
+ */
+static uint8_t Sim_I2C2_Clock(uint8_t sda)
+{
+	uint8_t bit;
+	Sim_I2C2_Line(SIM_I2C2_SDA, sda);
+	Sim_Advance(Sim_I2C2_Low);
+	Sim_I2C2_SCL_High();
+	bit = (uint8_t)Sim_GPIO_Read(GPIOH, 5);
+	Sim_Advance(Sim_I2C2_High);
+	Sim_I2C2_Line(SIM_I2C2_SCL, 0);
+	return bit;
+}
+
+/**
+ * @brief start, or repeated start while the bus is held
+ *
+ */
+static void Sim_I2C2_Start(void)
+{
+	if (Sim_I2C2_Held != SIM_I2C2_FREE)
+	{
+		Sim_I2C2_Line(SIM_I2C2_SDA, 1);
+		Sim_Advance(Sim_I2C2_Low);
+		Sim_I2C2_SCL_High();
+	}
+	Sim_Advance(Sim_I2C2_High);
+	Sim_I2C2_Line(SIM_I2C2_SDA, 0);
+	Sim_Advance(Sim_I2C2_High);
+	Sim_I2C2_Line(SIM_I2C2_SCL, 0);
+	Sim_I2C2_Held = SIM_I2C2_HELD_TX;
+}
+
+static void Sim_I2C2_Stop(void)
+{
+	Sim_I2C2_Line(SIM_I2C2_SDA, 0);
+	Sim_Advance(Sim_I2C2_Low);
+	Sim_I2C2_SCL_High();
+	Sim_Advance(Sim_I2C2_High);
+	Sim_I2C2_Line(SIM_I2C2_SDA, 1);
+	Sim_Advance(Sim_I2C2_Low); // tBUF
+	Sim_I2C2_Held = SIM_I2C2_FREE;
+}
+
+/**
+ * @brief send a byte
+ *
+ * @return 1: acked
+ *
+ */
+static uint8_t Sim_I2C2_Send(uint8_t data)
+{
+	uint8_t i;
+	for (i = 0; i < 8; i++)
+	{
+		Sim_I2C2_Clock((data >> (7 - i)) & 1);
+	}
+	return !Sim_I2C2_Clock(1);
+}
+
+static uint8_t Sim_I2C2_Recv(uint8_t ack)
+{
+	uint8_t i, data = 0;
+	for (i = 0; i < 8; i++)
+	{
+		data = (uint8_t)((data << 1) | Sim_I2C2_Clock(1));
+	}
+	Sim_I2C2_Clock(!ack);
+	Sim_I2C2_Line(SIM_I2C2_SDA, 1);
+	return data;
+}
+
+/**
+ * @brief a STOP request in CR1 while the bus is held: the byte the device
+ * has begun to send after the last ack is read and nACKed first
+ *
+ */
+static void Sim_I2C2_Apply(void)
+{
+	if (!(Sim_I2C2.CR1 & I2C_CR1_STOP))
+	{
+		return;
+	}
+	Sim_I2C2.CR1 &= ~I2C_CR1_STOP;
+	if (Sim_I2C2_Held == SIM_I2C2_HELD_RX)
+	{
+		Sim_I2C2_Recv(0);
+	}
+	if (Sim_I2C2_Held != SIM_I2C2_FREE)
+	{
+		Sim_I2C2_Stop();
+	}
+}
+
+/**
+ * @brief end a transfer, a NACK sends a stop as the HAL error handler does
+ *
+ */
+static void Sim_I2C2_Done(I2C_HandleTypeDef *hi2c, uint8_t acked)
+{
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	if (Sim_I2C2_Timeout)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+		Sim_I2C2_Held = SIM_I2C2_FREE; // the bus is left as it is
+	}
+	else if (!acked)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		Sim_I2C2_Stop();
+	}
+	hi2c->State = HAL_I2C_STATE_READY;
+}
+
+/**
+ * @brief a transfer is started, the interrupt or DMA setup is charged
+ *
+ */
+static void Sim_I2C2_Begin(uint8_t dma)
+{
+	Sim_Advance(dma ? SIM_HAL_DMA_CYCLES : SIM_HAL_CALL_CYCLES); // applies a pending STOP
+	SIM_HAL_STATS.i2c_xfers++;
+	SIM_HAL_STATS.i2c_dma += dma;
+	Sim_I2C2_Timeout = 0;
+}
+
+/**
+ * @brief one frame of a transfer
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * read: 1: receive, 0: transmit
+ * pData: the data or read buffer
+ * Size: the length of data
+ * opt: I2C_FIRST_FRAME, I2C_NEXT_FRAME, I2C_FIRST_AND_LAST_FRAME or
+ *      I2C_LAST_FRAME, a start and the address are sent for a first frame
+ *      or when the direction changes, the last byte read is nACKed and a
+ *      stop sent for a last frame
+ *
+ * @return 1: every byte sent was acked
+ *
+ */
+static uint8_t Sim_I2C2_Frame(uint8_t addr, uint8_t read, uint8_t *pData, uint16_t Size, uint32_t opt)
+{
+	uint16_t i;
+	uint8_t acked = 1, held = read ? SIM_I2C2_HELD_RX : SIM_I2C2_HELD_TX;
+	uint8_t last = opt == I2C_LAST_FRAME || opt == I2C_FIRST_AND_LAST_FRAME;
+	if (opt == I2C_FIRST_FRAME || opt == I2C_FIRST_AND_LAST_FRAME || Sim_I2C2_Held != held)
+	{
+		Sim_I2C2_Start();
+		acked = Sim_I2C2_Send((addr & 0XFE) | read);
+	}
+	for (i = 0; i < Size && acked && !Sim_I2C2_Timeout; i++)
+	{
+		if (read)
+		{
+			pData[i] = Sim_I2C2_Recv(i + 1 < Size || !last);
+		}
+		else
+		{
+			acked = Sim_I2C2_Send(pData[i]);
+		}
+	}
+	Sim_I2C2_Held = held;
+	if (acked && !Sim_I2C2_Timeout && last)
+	{
+		Sim_I2C2_Stop();
+	}
+	return acked;
+}
+
+static HAL_StatusTypeDef Sim_I2C2_Xfer(I2C_HandleTypeDef *hi2c, uint8_t addr, uint8_t read, uint8_t *pData, uint16_t Size,
+									   uint32_t opt, uint8_t dma)
+{
+	Sim_I2C2_Begin(dma);
+	Sim_I2C2_Done(hi2c, Sim_I2C2_Frame(addr, read, pData, Size, opt));
+	return HAL_OK;
+}
+
+/**
+ * @brief register access: start, address and register address, then the
+ * data or a repeated start and the read
+ *
+ */
+static HAL_StatusTypeDef Sim_I2C2_Mem(I2C_HandleTypeDef *hi2c, uint8_t addr, uint16_t reg, uint16_t regsize, uint8_t read,
+									  uint8_t *pData, uint16_t Size, uint8_t dma)
+{
+	uint8_t acked;
+	Sim_I2C2_Begin(dma);
+	Sim_I2C2_Start();
+	acked = Sim_I2C2_Send(addr & 0XFE);
+	if (acked && regsize == I2C_MEMADD_SIZE_16BIT)
+	{
+		acked = Sim_I2C2_Send((uint8_t)(reg >> 8));
+	}
+	if (acked)
+	{
+		acked = Sim_I2C2_Send((uint8_t)reg);
+	}
+	if (acked && !Sim_I2C2_Timeout)
+	{
+		acked = Sim_I2C2_Frame(addr, read, pData, Size, read ? I2C_FIRST_AND_LAST_FRAME : I2C_LAST_FRAME);
+	}
+	Sim_I2C2_Done(hi2c, acked);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+	uint64_t period = SIM_CYCLES(1000000000ULL / hi2c->Init.ClockSpeed);
+	if (hi2c->State == HAL_I2C_STATE_RESET)
+	{
+		HAL_I2C_MspInit(hi2c);
+	}
+	// Standard-mode 1:1, Fast-mode tLOW/tHIGH = 2 (I2C_DUTYCYCLE_2)
+	Sim_I2C2_High = (uint32_t)(hi2c->Init.ClockSpeed <= 100000 ? period / 2 : period / 3);
+	Sim_I2C2_Low = (uint32_t)period - Sim_I2C2_High;
+	Sim_I2C2_Held = SIM_I2C2_FREE;
+	Sim_I2C2.CR1 = 0;
+	Sim_Add_Peripheral(Sim_I2C2_Apply);
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+	Sim_GPIO_AF(GPIOH, SIM_I2C2_SCL | SIM_I2C2_SDA, 1);
+	Sim_I2C2_Held = SIM_I2C2_FREE;
+	hi2c->State = HAL_I2C_STATE_RESET;
+	return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c)
+{
+	Sim_Advance(SIM_DWT_CYCLES);
+	return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->ErrorCode;
+}
+
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout)
+{
+	uint8_t acked = 0;
+	(void)Timeout;
+	Sim_Advance(SIM_HAL_CALL_CYCLES);
+	SIM_HAL_STATS.i2c_probes++;
+	while (Trials-- && !acked)
+	{
+		Sim_I2C2_Start();
+		acked = Sim_I2C2_Send((uint8_t)DevAddress & 0XFE);
+		Sim_I2C2_Stop();
+	}
+	hi2c->State = HAL_I2C_STATE_READY;
+	return acked ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 0, pData, Size, I2C_FIRST_AND_LAST_FRAME, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 1, pData, Size, I2C_FIRST_AND_LAST_FRAME, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 0, pData, Size, I2C_FIRST_AND_LAST_FRAME, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 1, pData, Size, I2C_FIRST_AND_LAST_FRAME, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Mem(hi2c, (uint8_t)DevAddress, MemAddress, MemAddSize, 0, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Mem(hi2c, (uint8_t)DevAddress, MemAddress, MemAddSize, 1, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Mem(hi2c, (uint8_t)DevAddress, MemAddress, MemAddSize, 0, pData, Size, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return Sim_I2C2_Mem(hi2c, (uint8_t)DevAddress, MemAddress, MemAddSize, 1, pData, Size, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 0, pData, Size, XferOptions, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 0, pData, Size, XferOptions, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t XferOptions)
+{
+	return Sim_I2C2_Xfer(hi2c, (uint8_t)DevAddress, 1, pData, Size, XferOptions, 0);
+}
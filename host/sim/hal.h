@@ -0,0 +1,52 @@
+/*
+ * hal.h
+ *
+ */
+
+#ifndef __HAL_H_
+#define __HAL_H_
+#include "sim.h"
+
+/**
+ * HAL and board functions of the host build
+ *
+ * SPI5 and QUADSPI transfers go to the flash model byte by byte and take
+ * their time on the bus clock: SPI5 SCK is APB2 (90MHz) / prescaler,
+ * QUADSPI runs at 60MHz (AHB / 3). DMA transfers complete at once and are
+ * charged a fixed setup cost.
+ *
+ * The I2C2 controller clocks PH4 (SCL) and PH5 (SDA) in alternate function
+ * mode with the SCL low/high times of its ClockSpeed, so the I2C model
+ * decodes and checks it like the bit-banged bus. Its _IT and _DMA
+ * transfers are also done by the time the call returns.
+ *
+ */
+#define SIM_HAL_CALL_CYCLES 60  //a polled HAL transfer call
+#define SIM_HAL_DMA_CYCLES  250 //DMA stream setup and the completion interrupt
+#define SIM_QSPI_CLK_CYCLES 3   //core cycles per QUADSPI clock
+
+typedef struct _Sim_HAL_Stats
+{
+    uint32_t spi_polled; //polled SPI5 transfers
+    uint32_t spi_dma;    //DMA SPI5 transfers
+    uint32_t dma_stack;  //DMA buffers on the stack, which may sit in CCM RAM out of DMA reach
+    uint32_t qspi_cmds;  //QUADSPI commands
+    uint32_t qspi_maps;  //memory-mapped mode entered
+    uint32_t qspi_busy_maps; //entered while the flash was BUSY
+    uint32_t qspi_errors;    //commands refused by the controller in memory-mapped mode
+    uint32_t qspi_floating;  //commands with QE clear and no pull-ups on IO2 (/WP) and IO3 (/HOLD)
+    uint32_t i2c_xfers;  //I2C2 transfers, sequential frames included
+    uint32_t i2c_dma;    //of them with DMA
+    uint32_t i2c_probes; //HAL_I2C_IsDeviceReady calls
+} Sim_HAL_Stats;
+
+extern Sim_HAL_Stats SIM_HAL_STATS;
+extern QSPI_CommandTypeDef SIM_QSPI_LAST; //the last QUADSPI command, for checks by the tests
+
+/**
+ * @brief 1: QUADSPI is in memory-mapped mode
+ *
+ */
+uint8_t Sim_QSPI_Mapped(void);
+
+#endif
@@ -0,0 +1,482 @@
+#include "i2c_model.h"
+#include "stdio.h"
+#include "string.h"
+
+/**
+ * I2C minimum timings in ns (UM10204 table 10), kept apart from the
+ * driver's own table on purpose
+ *
+ */
+static const Sim_I2C_Timing SIM_I2C_SPEC[3] = {
+	{4700, 4000, 4700, 4000, 4000, 4700, 250}, // Standard-mode
+	{1300, 600, 600, 600, 600, 1300, 100},	   // Fast-mode
+	{500, 260, 260, 260, 260, 500, 50},		   // Fast-mode Plus
+};
+
+static const char *const SIM_I2C_NAMES[7] = {"tLOW", "tHIGH", "tSU;STA", "tHD;STA", "tSU;STO", "tBUF", "tSU;DAT"};
+
+// bus states
+enum
+{
+	SIM_I2C_IDLE,	// after a stop
+	SIM_I2C_ADDR,	// address byte after a start
+	SIM_I2C_WRITE,	// master sends
+	SIM_I2C_READ,	// slave sends
+	SIM_I2C_IGNORE, // not addressed, wait for a start or stop
+};
+
+Sim_I2C_Bus SIM_I2C_BUS;
+
+static Sim_I2C_Bus *Sim_I2C_Buses[SIM_I2C_BUS_NUM];
+static uint8_t Sim_I2C_BusNum;
+static uint8_t Sim_I2C_Added; // hook attached to the simulation
+
+/**
+ * @brief check a measured time against the spec minimum
+ *
+ * @param
+ * param: index into Sim_I2C_Timing
+ * cycles: measured time
+ *
+ */
+static void Sim_I2C_Check(Sim_I2C_Bus *b, uint8_t param, int64_t cycles)
+{
+	uint32_t ns = (uint32_t)SIM_NS(cycles);
+	uint32_t min = ((const uint32_t *)&SIM_I2C_SPEC[b->speed])[param];
+	uint32_t *seen = &((uint32_t *)&b->min)[param];
+	if (ns < *seen)
+	{
+		*seen = ns;
+	}
+	if (ns < min && b->stats.violations++ < 8)
+	{
+		printf("i2c: %s %u ns < %u ns at %llu ns\r\n", SIM_I2C_NAMES[param], ns, min,
+			   (unsigned long long)SIM_NS(Sim_Time));
+	}
+}
+
+/**
+ * @brief hold SCL low after an acknowledge bit if the device stretches
+ *
+ */
+static void Sim_I2C_Stretch(Sim_I2C_Bus *b)
+{
+	if (b->cur && b->cur->stretch_ns)
+	{
+		b->hold = 1;
+		b->hold_until = Sim_Time + SIM_CYCLES(b->cur->stretch_ns);
+	}
+}
+
+static void Sim_I2C_On_Start(Sim_I2C_Bus *b)
+{
+	if (b->state != SIM_I2C_IDLE)
+	{
+		b->stats.restarts++;
+		Sim_I2C_Check(b, 2, b->rise >= 0 ? (int64_t)Sim_Time - b->rise : 0);
+	}
+	else if (b->stop >= 0)
+	{
+		Sim_I2C_Check(b, 5, (int64_t)Sim_Time - b->stop);
+	}
+	b->stats.starts++;
+	b->start = Sim_Time;
+	b->start_high = 1;
+	b->state = SIM_I2C_ADDR;
+	b->bit = 0;
+	b->shift = 0;
+	b->drive_sda = 0;
+	b->cur = NULL;
+}
+
+static void Sim_I2C_On_Stop(Sim_I2C_Bus *b)
+{
+	if (b->state == SIM_I2C_IDLE)
+	{
+		return;
+	}
+	Sim_I2C_Check(b, 4, (int64_t)Sim_Time - b->rise);
+	b->stats.stops++;
+	if (b->cur)
+	{
+		if (b->cur->written && b->cur->busy_ns)
+		{
+			b->cur->busy_until = Sim_Time + SIM_CYCLES(b->cur->busy_ns);
+		}
+		if (b->cur->stop)
+		{
+			b->cur->stop(b->cur);
+		}
+	}
+	b->state = SIM_I2C_IDLE;
+	b->cur = NULL;
+	b->drive_sda = 0;
+	b->stop = Sim_Time;
+	b->fall = -1;
+}
+
+static void Sim_I2C_On_Rise(Sim_I2C_Bus *b)
+{
+	if (b->state != SIM_I2C_IDLE && b->fall >= 0)
+	{
+		Sim_I2C_Check(b, 0, (int64_t)Sim_Time - b->fall);
+		if (b->sda_change > b->fall)
+		{
+			Sim_I2C_Check(b, 6, (int64_t)Sim_Time - b->sda_change);
+		}
+	}
+	b->rise = Sim_Time;
+	b->start_high = 0;
+	if ((b->state == SIM_I2C_ADDR || b->state == SIM_I2C_WRITE) && b->bit < 8)
+	{
+		b->shift = (b->shift << 1) | b->sda;
+	}
+	else if (b->state == SIM_I2C_READ && b->bit == 8)
+	{
+		b->master_ack = !b->sda;
+	}
+}
+
+/**
+ * @brief the address or data byte sent by the master is complete
+ *
+ */
+static void Sim_I2C_Byte_Received(Sim_I2C_Bus *b)
+{
+	uint8_t i;
+	b->ack = 0;
+	if (b->state == SIM_I2C_ADDR)
+	{
+		for (i = 0; i < b->ndevs; i++)
+		{
+			if ((b->devs[i]->addr & 0XFE) == (b->shift & 0XFE))
+			{
+				b->cur = b->devs[i];
+				break;
+			}
+		}
+		if (b->cur && Sim_Time >= b->cur->busy_until)
+		{
+			b->reading = b->shift & 1;
+			b->cur->written = 0;
+			b->cur->start(b->cur, b->reading);
+			b->ack = 1;
+		}
+		else
+		{
+			b->cur = NULL;
+		}
+	}
+	else
+	{
+		b->ack = b->cur->write(b->cur, b->shift);
+		b->cur->written = 1;
+		b->stats.bytes += b->ack;
+	}
+	if (!b->ack)
+	{
+		b->stats.nacks++;
+	}
+	b->drive_sda = b->ack;
+}
+
+/**
+ * @brief load the next byte to send and drive its MSB
+ *
+ */
+static void Sim_I2C_Load(Sim_I2C_Bus *b)
+{
+	b->tx = b->cur->read(b->cur);
+	b->stats.bytes++;
+	b->drive_sda = !(b->tx & 0X80);
+}
+
+static void Sim_I2C_On_Fall(Sim_I2C_Bus *b)
+{
+	uint8_t start = b->start_high;
+	if (b->state != SIM_I2C_IDLE && b->rise >= 0)
+	{
+		if (start)
+		{
+			Sim_I2C_Check(b, 3, (int64_t)Sim_Time - b->start);
+		}
+		else
+		{
+			Sim_I2C_Check(b, 1, (int64_t)Sim_Time - b->rise);
+		}
+	}
+	b->fall = Sim_Time;
+	b->start_high = 0;
+	// the fall that ends a start is not the end of a bit
+	if (start || b->state == SIM_I2C_IDLE || b->state == SIM_I2C_IGNORE)
+	{
+		return;
+	}
+	b->bit++;
+	if (b->state == SIM_I2C_READ)
+	{
+		if (b->bit < 8)
+		{
+			b->drive_sda = !((b->tx >> (7 - b->bit)) & 1);
+		}
+		else if (b->bit == 8)
+		{
+			b->drive_sda = 0; // acknowledge bit of the master
+		}
+		else
+		{
+			b->bit = 0;
+			if (b->master_ack)
+			{
+				Sim_I2C_Load(b);
+			}
+			else
+			{
+				b->drive_sda = 0;
+				b->state = SIM_I2C_IGNORE;
+			}
+			Sim_I2C_Stretch(b);
+		}
+		return;
+	}
+	if (b->bit == 8)
+	{
+		Sim_I2C_Byte_Received(b);
+	}
+	else if (b->bit == 9)
+	{
+		b->drive_sda = 0;
+		b->bit = 0;
+		b->shift = 0;
+		if (!b->ack)
+		{
+			b->state = SIM_I2C_IGNORE;
+			return;
+		}
+		if (b->state == SIM_I2C_ADDR)
+		{
+			b->state = b->reading ? SIM_I2C_READ : SIM_I2C_WRITE;
+			if (b->reading)
+			{
+				Sim_I2C_Load(b);
+			}
+		}
+		Sim_I2C_Stretch(b);
+	}
+}
+
+/**
+ * @brief record an edge
+ *
+ */
+static void Sim_I2C_Record(Sim_I2C_Bus *b)
+{
+	Sim_I2C_Edge *e = &b->trace[b->edges++ % SIM_I2C_TRACE_SIZE];
+	e->time = Sim_Time;
+	e->scl = b->scl;
+	e->sda = b->sda;
+}
+
+static void Sim_I2C_Bus_Sync(Sim_I2C_Bus *b)
+{
+	uint8_t scl, sda;
+	if (b->hold && Sim_Time >= b->hold_until)
+	{
+		b->hold = 0;
+	}
+	scl = Sim_GPIO_Drive(b->port, b->scl_pin) && !b->hold;
+	sda = Sim_GPIO_Drive(b->port, b->sda_pin) && !b->drive_sda;
+	if (sda != b->sda)
+	{
+		b->sda = sda;
+		Sim_I2C_Record(b);
+		if (b->scl)
+		{
+			if (sda)
+			{
+				Sim_I2C_On_Stop(b);
+			}
+			else
+			{
+				Sim_I2C_On_Start(b);
+			}
+		}
+		else
+		{
+			b->sda_change = Sim_Time;
+		}
+	}
+	if (scl != b->scl)
+	{
+		b->scl = scl;
+		Sim_I2C_Record(b);
+		if (scl)
+		{
+			Sim_I2C_On_Rise(b);
+		}
+		else
+		{
+			Sim_I2C_On_Fall(b);
+		}
+	}
+	Sim_GPIO_Pull(b->port, b->sda_pin, b->drive_sda);
+	Sim_GPIO_Pull(b->port, b->scl_pin, b->hold);
+}
+
+static void Sim_I2C_Sync(void)
+{
+	uint8_t i;
+	for (i = 0; i < Sim_I2C_BusNum; i++)
+	{
+		Sim_I2C_Bus_Sync(Sim_I2C_Buses[i]);
+	}
+}
+
+/**
+ * @brief power-up: bus released, devices not addressed
+ *
+ */
+static void Sim_I2C_Bus_Reset(Sim_I2C_Bus *b)
+{
+	b->scl = 1;
+	b->sda = 1;
+	b->drive_sda = 0;
+	b->hold = 0;
+	b->state = SIM_I2C_IDLE;
+	b->cur = NULL;
+	b->fall = b->rise = b->start = b->stop = b->sda_change = -1;
+}
+
+static void Sim_I2C_Reset(void)
+{
+	uint8_t i;
+	for (i = 0; i < Sim_I2C_BusNum; i++)
+	{
+		Sim_I2C_Bus_Reset(Sim_I2C_Buses[i]);
+	}
+}
+
+void Sim_I2C_Bus_Set_Speed(Sim_I2C_Bus *bus, uint8_t speed)
+{
+	bus->speed = speed > SIM_I2C_FAST_PLUS ? SIM_I2C_STANDARD : speed;
+	memset(&bus->stats, 0, sizeof(bus->stats));
+	memset(&bus->min, 0XFF, sizeof(bus->min));
+}
+
+void Sim_I2C_Bus_Init(Sim_I2C_Bus *bus, GPIO_TypeDef *port, uint16_t scl, uint16_t sda, uint8_t speed)
+{
+	uint8_t i;
+	bus->port = port;
+	bus->scl_pin = scl;
+	bus->sda_pin = sda;
+	bus->ndevs = 0;
+	bus->edges = 0;
+	Sim_I2C_Bus_Set_Speed(bus, speed);
+	Sim_I2C_Bus_Reset(bus);
+	for (i = 0; i < Sim_I2C_BusNum && Sim_I2C_Buses[i] != bus; i++)
+	{
+	}
+	if (i == Sim_I2C_BusNum && Sim_I2C_BusNum < SIM_I2C_BUS_NUM)
+	{
+		Sim_I2C_Buses[Sim_I2C_BusNum++] = bus;
+	}
+	if (!Sim_I2C_Added)
+	{
+		Sim_Add_Device(Sim_I2C_Sync, Sim_I2C_Reset);
+		Sim_I2C_Added = 1;
+	}
+}
+
+void Sim_I2C_Bus_Attach(Sim_I2C_Bus *bus, Sim_I2C_Device *dev)
+{
+	if (bus->ndevs < SIM_I2C_DEVICE_NUM)
+	{
+		dev->busy_until = 0;
+		bus->devs[bus->ndevs++] = dev;
+	}
+}
+
+uint8_t Sim_I2C_Bus_Save_Trace(Sim_I2C_Bus *bus, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	uint32_t i = bus->edges > SIM_I2C_TRACE_SIZE ? bus->edges - SIM_I2C_TRACE_SIZE : 0;
+	if (f == NULL)
+	{
+		return 1;
+	}
+	for (; i < bus->edges; i++)
+	{
+		const Sim_I2C_Edge *e = &bus->trace[i % SIM_I2C_TRACE_SIZE];
+		fprintf(f, "%llu %u %u\n", (unsigned long long)SIM_NS(e->time), e->scl, e->sda);
+	}
+	return fclose(f) == 0 ? 0 : 1;
+}
+
+void Sim_I2C_Init(GPIO_TypeDef *port, uint16_t scl, uint16_t sda, uint8_t speed)
+{
+	Sim_I2C_Bus_Init(&SIM_I2C_BUS, port, scl, sda, speed);
+}
+
+void Sim_I2C_Set_Speed(uint8_t speed)
+{
+	Sim_I2C_Bus_Set_Speed(&SIM_I2C_BUS, speed);
+}
+
+void Sim_I2C_Attach(Sim_I2C_Device *dev)
+{
+	Sim_I2C_Bus_Attach(&SIM_I2C_BUS, dev);
+}
+
+uint8_t Sim_I2C_Save_Trace(const char *path)
+{
+	return Sim_I2C_Bus_Save_Trace(&SIM_I2C_BUS, path);
+}
+
+////////////////////////////////////////////////////
+//register memory
+
+static void Sim_I2C_Mem_Start(Sim_I2C_Device *dev, uint8_t read)
+{
+	Sim_I2C_Mem *m = (Sim_I2C_Mem *)dev;
+	if (!read)
+	{
+		m->nreg = 0;
+	}
+}
+
+static uint8_t Sim_I2C_Mem_Write(Sim_I2C_Device *dev, uint8_t data)
+{
+	Sim_I2C_Mem *m = (Sim_I2C_Mem *)dev;
+	uint16_t mask = m->regsize == 1 ? 0XFF : 0XFFFF;
+	if (m->nreg < m->regsize)
+	{
+		m->ptr = (uint16_t)((m->nreg ? m->ptr << 8 : 0) | data);
+		m->nreg++;
+	}
+	else
+	{
+		m->mem[m->ptr] = data;
+		m->ptr = (m->ptr + 1) & mask;
+	}
+	return 1;
+}
+
+static uint8_t Sim_I2C_Mem_Read(Sim_I2C_Device *dev)
+{
+	Sim_I2C_Mem *m = (Sim_I2C_Mem *)dev;
+	uint16_t mask = m->regsize == 1 ? 0XFF : 0XFFFF;
+	uint8_t data = m->mem[m->ptr];
+	m->ptr = (m->ptr + 1) & mask;
+	return data;
+}
+
+void Sim_I2C_Mem_Init(Sim_I2C_Mem *mem, uint8_t addr, uint8_t regsize)
+{
+	memset(mem, 0, sizeof(*mem) - sizeof(mem->mem));
+	memset(mem->mem, 0XFF, sizeof(mem->mem));
+	mem->dev.addr = addr;
+	mem->dev.start = Sim_I2C_Mem_Start;
+	mem->dev.write = Sim_I2C_Mem_Write;
+	mem->dev.read = Sim_I2C_Mem_Read;
+	mem->regsize = regsize;
+}
@@ -0,0 +1,183 @@
+/*
+ * i2c_model.h
+ *
+ */
+
+#ifndef __I2C_MODEL_H_
+#define __I2C_MODEL_H_
+#include "sim.h"
+
+/**
+ * Bit-level I2C bus with slave devices, on two open drain GPIO lines
+ *
+ * Every SCL/SDA edge is recorded with its time. START and STOP are
+ * detected from SDA edges while SCL is high, bits are sampled on the SCL
+ * rising edge and the slaves drive SDA (ACK, read data) after the falling
+ * edge, as the real parts do. Each edge is checked against the UM10204
+ * minimums of the bus speed set with Sim_I2C_Set_Speed: tLOW, tHIGH,
+ * tSU;STA, tHD;STA, tSU;STO, tBUF and tSU;DAT. Violations are printed and
+ * counted, the shortest time seen for each parameter is kept in
+ * SIM_I2C_MIN.
+ *
+ * A device can stretch the clock after each acknowledge bit and NACK its
+ * address for a while after a write, like an EEPROM in its write cycle.
+ *
+ * Each Sim_I2C_Bus is a separate bus on its own pins. The Sim_I2C_*
+ * functions without a bus use SIM_I2C_BUS.
+ *
+ */
+#define SIM_I2C_STANDARD    0 //100 kHz
+#define SIM_I2C_FAST        1 //400 kHz
+#define SIM_I2C_FAST_PLUS   2 //1 MHz
+#define SIM_I2C_TRACE_SIZE  65536 //recorded edges, older ones are overwritten
+#define SIM_I2C_DEVICE_NUM  8
+#define SIM_I2C_BUS_NUM     4
+
+typedef struct _Sim_I2C_Timing
+{
+    uint32_t low;    //tLOW
+    uint32_t high;   //tHIGH
+    uint32_t su_sta; //tSU;STA
+    uint32_t hd_sta; //tHD;STA
+    uint32_t su_sto; //tSU;STO
+    uint32_t buf;    //tBUF
+    uint32_t su_dat; //tSU;DAT
+} Sim_I2C_Timing;
+
+typedef struct _Sim_I2C_Stats
+{
+    uint32_t starts;     //including repeated starts
+    uint32_t restarts;   //repeated starts
+    uint32_t stops;
+    uint32_t bytes;      //data bytes acknowledged or read
+    uint32_t nacks;      //address or data bytes not acknowledged
+    uint32_t violations; //timings below the minimum
+} Sim_I2C_Stats;
+
+typedef struct _Sim_I2C_Edge
+{
+    uint64_t time; //core clock cycles
+    uint8_t scl;
+    uint8_t sda;
+} Sim_I2C_Edge;
+
+typedef struct _Sim_I2C_Device Sim_I2C_Device;
+
+struct _Sim_I2C_Device
+{
+    uint8_t addr;        //8 bit write address
+    uint32_t stretch_ns; //SCL held low after each acknowledge bit, 0: none
+    uint32_t busy_ns;    //address NACKed after a write, 0: never
+    void (*start)(Sim_I2C_Device *dev, uint8_t read); //addressed
+    uint8_t (*write)(Sim_I2C_Device *dev, uint8_t data); //return 1: ACK
+    uint8_t (*read)(Sim_I2C_Device *dev);
+    void (*stop)(Sim_I2C_Device *dev); //may be NULL
+    uint64_t busy_until; //Sim_Time, set by the model
+    uint8_t written;     //data written since the address
+};
+
+/**
+ * A register memory: the first regsize bytes of a write set the register
+ * pointer, the following bytes are stored, reads return bytes from the
+ * pointer on. With regsize 1 the pointer wraps at 256.
+ */
+typedef struct _Sim_I2C_Mem
+{
+    Sim_I2C_Device dev;
+    uint8_t regsize; //1 or 2
+    uint8_t nreg;    //register address bytes received
+    uint16_t ptr;
+    uint8_t mem[65536];
+} Sim_I2C_Mem;
+
+/**
+ * A bus on two pins, the statistics, minimums and edges are public, the
+ * rest is the state of the model
+ *
+ */
+typedef struct _Sim_I2C_Bus
+{
+    Sim_I2C_Stats stats;
+    Sim_I2C_Timing min; //shortest measured times in ns
+    Sim_I2C_Edge trace[SIM_I2C_TRACE_SIZE];
+    uint32_t edges;     //edges recorded
+
+    GPIO_TypeDef *port;
+    uint16_t scl_pin, sda_pin;
+    uint8_t speed;
+    Sim_I2C_Device *devs[SIM_I2C_DEVICE_NUM];
+    uint8_t ndevs;
+    uint8_t scl, sda;    //bus levels
+    uint8_t drive_sda;   //a slave pulls SDA low
+    uint8_t hold;        //a slave holds SCL low
+    uint64_t hold_until;
+    uint8_t state;
+    uint8_t bit;         //falling SCL edges in the current byte
+    uint8_t shift;
+    uint8_t tx;
+    uint8_t ack;         //the slave acknowledged the last byte
+    uint8_t master_ack;  //the master acknowledged the last read byte
+    uint8_t reading;
+    uint8_t start_high;  //a start happened in this SCL high phase
+    Sim_I2C_Device *cur;
+    int64_t fall, rise, start, stop, sda_change; //-1: none
+} Sim_I2C_Bus;
+
+extern Sim_I2C_Bus SIM_I2C_BUS; //the bus of Sim_I2C_Init
+#define SIM_I2C_STATS   (SIM_I2C_BUS.stats)
+#define SIM_I2C_MIN     (SIM_I2C_BUS.min)
+
+/**
+ * @brief attach a bus to two pins, the devices are removed
+ *
+ * @param
+ * bus: the bus, at most SIM_I2C_BUS_NUM of them
+ * port: GPIO port of both lines
+ * scl, sda: pins, e.g. GPIO_PIN_4, GPIO_PIN_5
+ * speed: SIM_I2C_STANDARD, SIM_I2C_FAST or SIM_I2C_FAST_PLUS
+ *
+ */
+void Sim_I2C_Bus_Init(Sim_I2C_Bus *bus, GPIO_TypeDef *port, uint16_t scl, uint16_t sda, uint8_t speed);
+
+/**
+ * @brief set the speed mode whose minimums are checked, the statistics
+ * and measured minimums are cleared
+ *
+ */
+void Sim_I2C_Bus_Set_Speed(Sim_I2C_Bus *bus, uint8_t speed);
+
+/**
+ * @brief add a device to a bus
+ *
+ */
+void Sim_I2C_Bus_Attach(Sim_I2C_Bus *bus, Sim_I2C_Device *dev);
+
+/**
+ * @brief write the recorded edges of a bus as "ns scl sda" lines
+ *
+ * @return 0: success, 1: the file could not be written
+ *
+ */
+uint8_t Sim_I2C_Bus_Save_Trace(Sim_I2C_Bus *bus, const char *path);
+
+/**
+ * @brief the same on SIM_I2C_BUS
+ *
+ */
+void Sim_I2C_Init(GPIO_TypeDef *port, uint16_t scl, uint16_t sda, uint8_t speed);
+void Sim_I2C_Set_Speed(uint8_t speed);
+void Sim_I2C_Attach(Sim_I2C_Device *dev);
+uint8_t Sim_I2C_Save_Trace(const char *path);
+
+/**
+ * @brief initialization a register memory, erased to 0XFF
+ *
+ * @param
+ * mem: the memory
+ * addr: 8 bit write address
+ * regsize: 1 or 2 bytes register address
+ *
+ */
+void Sim_I2C_Mem_Init(Sim_I2C_Mem *mem, uint8_t addr, uint8_t regsize);
+
+#endif
@@ -0,0 +1,256 @@
+#include "sim.h"
+#include "string.h"
+
+#define SIM_DEVICE_NUM 8
+#define SIM_PERIPHERAL_NUM 4
+
+uint32_t SystemCoreClock = SIM_CORE_CLOCK;
+uint64_t Sim_Time;
+GPIO_TypeDef Sim_GPIO[SIM_GPIO_PORTS];
+RCC_TypeDef Sim_RCC;
+CoreDebug_Type Sim_CoreDebug;
+
+static DWT_Type Sim_DWT_Regs;
+static uint16_t Sim_Pulled[SIM_GPIO_PORTS]; // lines held low by the models
+static uint16_t Sim_AF_Level[SIM_GPIO_PORTS]; // levels driven by peripherals
+static GPIO_TypeDef *Sim_BitPort;			// pending bit-band write
+static uint8_t Sim_BitPin;
+static uint8_t Sim_InSync;
+static uint8_t Sim_PullChanged; // a model changed Sim_Pulled during the hooks
+static Sim_Hook Sim_Syncs[SIM_DEVICE_NUM];
+static Sim_Hook Sim_Resets[SIM_DEVICE_NUM];
+static uint8_t Sim_Devices;
+static Sim_Hook Sim_Applies[SIM_PERIPHERAL_NUM];
+static uint8_t Sim_Peripherals;
+
+/**
+ * @brief GPIO registers at reset: inputs, ODR 0
+ *
+ */
+static void Sim_GPIO_Reset(void)
+{
+	memset(Sim_GPIO, 0, sizeof(Sim_GPIO));
+	memset(Sim_Pulled, 0, sizeof(Sim_Pulled));
+	memset(Sim_AF_Level, 0XFF, sizeof(Sim_AF_Level));
+	Sim_BitPort = NULL;
+	Sim_InSync = 0;
+}
+
+/**
+ * @brief the pins of a port in a mode
+ *
+ * @param
+ * moder: MODER of the port
+ * mode: 0 input, 1 output, 2 AF, 3 analog
+ *
+ * @return pin mask
+ *
+ */
+static uint32_t Sim_GPIO_Pins(uint32_t moder, uint32_t mode)
+{
+	uint32_t m = ~(moder ^ (mode * 0X55555555)); // 11 where the field equals mode
+	// the even bits packed into 16 bits
+	m = m & (m >> 1) & 0X55555555;
+	m = (m | (m >> 1)) & 0X33333333;
+	m = (m | (m >> 2)) & 0X0F0F0F0F;
+	m = (m | (m >> 4)) & 0X00FF00FF;
+	m = (m | (m >> 8)) & 0X0000FFFF;
+	return m;
+}
+
+/**
+ * @brief input level of every pin: the driven level of outputs and
+ * alternate function pins, the pull-up otherwise, low while a model
+ * pulls it
+ *
+ */
+static void Sim_GPIO_Update_IDR(void)
+{
+	uint8_t i;
+	uint32_t out, af, level;
+	for (i = 0; i < SIM_GPIO_PORTS; i++)
+	{
+		out = Sim_GPIO_Pins(Sim_GPIO[i].MODER, 1);
+		af = Sim_GPIO_Pins(Sim_GPIO[i].MODER, 2);
+		level = (Sim_GPIO[i].ODR_[0] & out) | (Sim_AF_Level[i] & af) | (~(out | af) & 0XFFFF);
+		Sim_GPIO[i].IDR_[0] = level & ~(uint32_t)Sim_Pulled[i];
+	}
+}
+
+void Sim_Init(void)
+{
+	Sim_Time = 0;
+	Sim_Devices = 0;
+	Sim_Peripherals = 0;
+	Sim_GPIO_Reset();
+	Sim_GPIO_Update_IDR();
+	memset(&Sim_DWT_Regs, 0, sizeof(Sim_DWT_Regs));
+}
+
+void Sim_Sync(void)
+{
+	uint8_t i;
+	uint32_t bsrr;
+	if (Sim_InSync)
+	{
+		return;
+	}
+	for (i = 0; i < Sim_Peripherals; i++)
+	{
+		Sim_Applies[i]();
+	}
+	Sim_InSync = 1;
+	for (i = 0; i < SIM_GPIO_PORTS; i++)
+	{
+		bsrr = Sim_GPIO[i].BSRR_[0];
+		if (bsrr)
+		{
+			// set wins over reset
+			Sim_GPIO[i].ODR_[0] = (Sim_GPIO[i].ODR_[0] & ~(bsrr >> 16)) | (bsrr & 0XFFFF);
+			Sim_GPIO[i].BSRR_[0] = 0;
+		}
+	}
+	if (Sim_BitPort)
+	{
+		if (Sim_BitPort->bit_slot & 1)
+		{
+			Sim_BitPort->ODR_[0] |= 1UL << Sim_BitPin;
+		}
+		else
+		{
+			Sim_BitPort->ODR_[0] &= ~(1UL << Sim_BitPin);
+		}
+		Sim_BitPort = NULL;
+	}
+	Sim_GPIO_Update_IDR();
+	Sim_PullChanged = 0;
+	for (i = 0; i < Sim_Devices; i++)
+	{
+		Sim_Syncs[i]();
+	}
+	if (Sim_PullChanged)
+	{
+		Sim_GPIO_Update_IDR();
+	}
+	Sim_InSync = 0;
+}
+
+void Sim_Advance(uint64_t cycles)
+{
+	Sim_Sync();
+	Sim_Time += cycles;
+}
+
+void Sim_Add_Device(Sim_Hook sync, Sim_Hook reset)
+{
+	if (Sim_Devices < SIM_DEVICE_NUM)
+	{
+		Sim_Syncs[Sim_Devices] = sync;
+		Sim_Resets[Sim_Devices] = reset;
+		Sim_Devices++;
+	}
+}
+
+void Sim_Add_Peripheral(Sim_Hook apply)
+{
+	uint8_t i;
+	for (i = 0; i < Sim_Peripherals; i++)
+	{
+		if (Sim_Applies[i] == apply)
+		{
+			return;
+		}
+	}
+	if (Sim_Peripherals < SIM_PERIPHERAL_NUM)
+	{
+		Sim_Applies[Sim_Peripherals++] = apply;
+	}
+}
+
+uint8_t Sim_GPIO_Drive(GPIO_TypeDef *port, uint16_t pin)
+{
+	uint8_t n = __builtin_ctz(pin);
+	switch ((port->MODER >> (n * 2)) & 3)
+	{
+	case 1:
+		return (port->ODR_[0] & pin) != 0;
+	case 2:
+		return (Sim_AF_Level[port - Sim_GPIO] & pin) != 0;
+	default:
+		return 1;
+	}
+}
+
+void Sim_GPIO_AF(GPIO_TypeDef *port, uint16_t pins, uint8_t level)
+{
+	uint8_t i = port - Sim_GPIO;
+	Sim_AF_Level[i] = level ? Sim_AF_Level[i] | pins : Sim_AF_Level[i] & ~pins;
+}
+
+void Sim_GPIO_Pull(GPIO_TypeDef *port, uint16_t pin, uint8_t low)
+{
+	uint8_t i = port - Sim_GPIO;
+	uint16_t pulled = low ? Sim_Pulled[i] | pin : Sim_Pulled[i] & ~pin;
+	if (pulled != Sim_Pulled[i])
+	{
+		Sim_Pulled[i] = pulled;
+		Sim_PullChanged = 1;
+	}
+}
+
+void Sim_Power_Cycle(void)
+{
+	uint8_t i;
+	Sim_GPIO_Reset();
+	for (i = 0; i < Sim_Devices; i++)
+	{
+		if (Sim_Resets[i])
+		{
+			Sim_Resets[i]();
+		}
+	}
+	Sim_GPIO_Update_IDR();
+}
+
+/**
+ * @brief register access of IDR, ODR and BSRR (see sys.h)
+ *
+ * @return index 0 of the register array
+ *
+ */
+uint32_t Sim_GPIO_Access(void)
+{
+	Sim_Advance(SIM_GPIO_CYCLES);
+	return 0;
+}
+
+/**
+ * @brief bit-band alias of an output bit, the write is applied at the
+ * next access
+ *
+ */
+volatile uint32_t *Sim_GPIO_Bit(GPIO_TypeDef *port, uint8_t n)
+{
+	Sim_Advance(SIM_GPIO_CYCLES);
+	port->bit_slot = (port->ODR_[0] >> n) & 1;
+	Sim_BitPort = port;
+	Sim_BitPin = n;
+	return &port->bit_slot;
+}
+
+/**
+ * @brief bit-band alias of an input bit
+ *
+ */
+uint32_t Sim_GPIO_Read(GPIO_TypeDef *port, uint8_t n)
+{
+	Sim_Advance(SIM_GPIO_CYCLES);
+	return (port->IDR_[0] >> n) & 1;
+}
+
+DWT_Type *Sim_DWT(void)
+{
+	Sim_Advance(SIM_DWT_CYCLES);
+	Sim_DWT_Regs.CYCCNT = (uint32_t)Sim_Time;
+	return &Sim_DWT_Regs;
+}
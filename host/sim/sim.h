@@ -0,0 +1,112 @@
+/*
+ * sim.h
+ *
+ */
+
+#ifndef __SIM_H_
+#define __SIM_H_
+#include "sys.h"
+
+/**
+ * Virtual time and GPIO of the host build
+ *
+ * Time is counted in core clock cycles and only moves when the code
+ * touches the hardware: a GPIO register access, a read of DWT->CYCCNT,
+ * HAL_GetTick, delay_us/delay_ms and the bus transfers of the HAL shims.
+ * Busy waits on the cycle counter therefore take as long as they would on
+ * the chip, and flash erase or program times are measured, not slept.
+ *
+ * A write to a GPIO register is applied when the next hardware access
+ * starts, then every model hook is called, so the models see the pin
+ * changes in program order with their time stamps.
+ *
+ */
+#define SIM_CORE_CLOCK  180000000 //SystemCoreClock
+#define SIM_GPIO_CYCLES 2         //a GPIO register access
+#define SIM_DWT_CYCLES  4         //a read of the cycle counter in a polling loop
+#define SIM_TICK_CYCLES 4         //a HAL_GetTick call
+
+#define SIM_NS(cycles) ((uint64_t)(cycles) * 1000 / (SystemCoreClock / 1000000))
+#define SIM_CYCLES(ns) (((uint64_t)(ns) * (SystemCoreClock / 1000000) + 999) / 1000)
+
+extern uint64_t Sim_Time; //core clock cycles since Sim_Init
+
+typedef void (*Sim_Hook)(void);
+
+/**
+ * @brief reset time, GPIO and the models
+ *
+ */
+void Sim_Init(void);
+
+/**
+ * @brief apply the pending GPIO write and let the models react
+ *
+ */
+void Sim_Sync(void);
+
+/**
+ * @brief let time pass
+ *
+ * @param
+ * cycles: core clock cycles
+ *
+ */
+void Sim_Advance(uint64_t cycles);
+
+/**
+ * @brief attach a model
+ *
+ * @param
+ * sync: called after every GPIO access, reads the pins and Sim_Time
+ * reset: called by Sim_Power_Cycle, may be NULL
+ *
+ */
+void Sim_Add_Device(Sim_Hook sync, Sim_Hook reset);
+
+/**
+ * @brief attach a peripheral whose register writes take effect at the
+ * next hardware access, like a GPIO write
+ *
+ * @param
+ * apply: called before the models are synced, may let time pass
+ *
+ */
+void Sim_Add_Peripheral(Sim_Hook apply);
+
+/**
+ * @brief level the MCU drives on a pin: ODR for outputs, the peripheral
+ * for alternate function pins, 1 otherwise (pull-up)
+ *
+ */
+uint8_t Sim_GPIO_Drive(GPIO_TypeDef *port, uint16_t pin);
+
+/**
+ * @brief a peripheral drives alternate function pins, open drain: 1
+ * releases them
+ *
+ * @param
+ * port, pins: the pins
+ * level: 0 or 1
+ *
+ */
+void Sim_GPIO_AF(GPIO_TypeDef *port, uint16_t pins, uint8_t level);
+
+/**
+ * @brief a device pulls an open drain line low or releases it
+ *
+ * @param
+ * port, pin: the line
+ * low: 1: pull low, 0: release
+ *
+ */
+void Sim_GPIO_Pull(GPIO_TypeDef *port, uint16_t pin, uint8_t low);
+
+/**
+ * @brief power loss and reset: GPIO back to reset state, every model
+ * reset, time keeps running
+ *
+ */
+void Sim_Power_Cycle(void);
+
+#endif
@@ -0,0 +1,471 @@
+#include "ssd1306_model.h"
+#include "i2c_model.h"
+#include "stdio.h"
+#include "string.h"
+
+uint8_t SIM_SSD1306_RAM[8][128];
+uint16_t SIM_SSD1306_WRITES[8][128];
+Sim_SSD1306_Stats SIM_SSD1306_STATS;
+Sim_SSD1306_Timing SIM_SSD1306_MIN;
+
+static const Sim_SSD1306_Timing SIM_SSD1306_SPEC[2] = {{300, 60, 60, 40}, {100, 20, 20, 15}}; // 8080, SPI
+
+static uint8_t Sim_SSD1306_Bus;
+static uint8_t Sim_SSD1306_Added;
+
+// controller registers
+static uint8_t Sim_SSD1306_Mode; // 0: horizontal, 1: vertical, 2: page addressing
+static uint8_t Sim_SSD1306_Col, Sim_SSD1306_Page;
+static uint8_t Sim_SSD1306_ColStart, Sim_SSD1306_ColEnd;
+static uint8_t Sim_SSD1306_PageStart, Sim_SSD1306_PageEnd;
+static uint8_t Sim_SSD1306_Remap;	  // A1: column 127 drives SEG0
+static uint8_t Sim_SSD1306_ScanRev;	  // C8: COM63 to COM0
+static uint8_t Sim_SSD1306_StartLine; // 40h~7Fh
+static uint8_t Sim_SSD1306_Inverse;	  // A7
+static uint8_t Sim_SSD1306_AllOn;	  // A5
+static uint8_t Sim_SSD1306_On;		  // AF
+
+// command parser
+static uint8_t Sim_SSD1306_Cmd[8];
+static uint8_t Sim_SSD1306_CmdLen, Sim_SSD1306_CmdNeed;
+
+// pins
+static uint8_t Sim_SSD1306_RST, Sim_SSD1306_WR, Sim_SSD1306_SCLK, Sim_SSD1306_CS;
+static uint8_t Sim_SSD1306_Bus8;   // data bus level
+static uint8_t Sim_SSD1306_Shift;  // SPI shift register
+static uint8_t Sim_SSD1306_Bits;   // SPI bits received
+static int64_t Sim_SSD1306_WrFall, Sim_SSD1306_WrRise, Sim_SSD1306_DataChange; // -1: none, SCLK on SPI
+static uint8_t Sim_SSD1306_SDIN;
+static uint8_t Sim_SSD1306_InData; // display data received in this CS cycle or IIC message
+
+// IIC front end
+static Sim_I2C_Device Sim_SSD1306_IIC;
+static uint8_t Sim_SSD1306_Control; // next byte is a control byte
+static uint8_t Sim_SSD1306_Co, Sim_SSD1306_DC;
+
+/**
+ * @brief reset state of the registers, the display RAM keeps its content
+ *
+ */
+static void Sim_SSD1306_Reset(void)
+{
+	Sim_SSD1306_Mode = 2;
+	Sim_SSD1306_Col = Sim_SSD1306_Page = 0;
+	Sim_SSD1306_ColStart = 0;
+	Sim_SSD1306_ColEnd = 127;
+	Sim_SSD1306_PageStart = 0;
+	Sim_SSD1306_PageEnd = 7;
+	Sim_SSD1306_Remap = Sim_SSD1306_ScanRev = Sim_SSD1306_StartLine = 0;
+	Sim_SSD1306_Inverse = Sim_SSD1306_AllOn = Sim_SSD1306_On = 0;
+	Sim_SSD1306_CmdLen = Sim_SSD1306_CmdNeed = 0;
+}
+
+/**
+ * @brief parameter bytes of a command
+ *
+ */
+static uint8_t Sim_SSD1306_Args(uint8_t cmd)
+{
+	switch (cmd)
+	{
+	case 0X81: // contrast
+	case 0X8D: // charge pump
+	case 0X20: // addressing mode
+	case 0XA8: // multiplex ratio
+	case 0XD3: // display offset
+	case 0XD5: // clock divide
+	case 0XD9: // pre-charge
+	case 0XDA: // COM pins
+	case 0XDB: // VCOMH
+		return 1;
+	case 0X21: // column address
+	case 0X22: // page address
+	case 0XA3: // vertical scroll area
+		return 2;
+	case 0X29:
+	case 0X2A:
+		return 5;
+	case 0X26:
+	case 0X27:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief execute a complete command
+ *
+ */
+static void Sim_SSD1306_Execute(const uint8_t *c)
+{
+	if (c[0] < 0X10)
+	{
+		Sim_SSD1306_ColStart = (Sim_SSD1306_ColStart & 0XF0) | c[0];
+		Sim_SSD1306_Col = Sim_SSD1306_ColStart;
+	}
+	else if (c[0] < 0X20)
+	{
+		Sim_SSD1306_ColStart = (Sim_SSD1306_ColStart & 0X0F) | ((c[0] & 0X07) << 4);
+		Sim_SSD1306_Col = Sim_SSD1306_ColStart;
+	}
+	else if (c[0] == 0X20)
+	{
+		Sim_SSD1306_Mode = c[1] & 3;
+	}
+	else if (c[0] == 0X21)
+	{
+		Sim_SSD1306_ColStart = Sim_SSD1306_Col = c[1] & 0X7F;
+		Sim_SSD1306_ColEnd = c[2] & 0X7F;
+	}
+	else if (c[0] == 0X22)
+	{
+		Sim_SSD1306_PageStart = Sim_SSD1306_Page = c[1] & 7;
+		Sim_SSD1306_PageEnd = c[2] & 7;
+	}
+	else if (c[0] >= 0X40 && c[0] <= 0X7F)
+	{
+		Sim_SSD1306_StartLine = c[0] & 0X3F;
+	}
+	else if (c[0] == 0XA0 || c[0] == 0XA1)
+	{
+		Sim_SSD1306_Remap = c[0] & 1;
+	}
+	else if (c[0] == 0XA4 || c[0] == 0XA5)
+	{
+		Sim_SSD1306_AllOn = c[0] & 1;
+	}
+	else if (c[0] == 0XA6 || c[0] == 0XA7)
+	{
+		Sim_SSD1306_Inverse = c[0] & 1;
+	}
+	else if (c[0] == 0XAE || c[0] == 0XAF)
+	{
+		Sim_SSD1306_On = c[0] & 1;
+	}
+	else if (c[0] >= 0XB0 && c[0] <= 0XB7)
+	{
+		Sim_SSD1306_Page = c[0] & 7;
+	}
+	else if (c[0] == 0XC0 || c[0] == 0XC8)
+	{
+		Sim_SSD1306_ScanRev = c[0] == 0XC8;
+	}
+}
+
+/**
+ * @brief a byte received by the controller
+ *
+ * @param
+ * dc: 0: command, 1: display data
+ * data: the byte
+ *
+ */
+static void Sim_SSD1306_Byte(uint8_t dc, uint8_t data)
+{
+	if (!dc)
+	{
+		SIM_SSD1306_STATS.commands++;
+		if (Sim_SSD1306_CmdLen == 0)
+		{
+			Sim_SSD1306_CmdNeed = 1 + Sim_SSD1306_Args(data);
+		}
+		Sim_SSD1306_Cmd[Sim_SSD1306_CmdLen++] = data;
+		if (Sim_SSD1306_CmdLen == Sim_SSD1306_CmdNeed)
+		{
+			Sim_SSD1306_Execute(Sim_SSD1306_Cmd);
+			Sim_SSD1306_CmdLen = 0;
+		}
+		return;
+	}
+	SIM_SSD1306_STATS.data++;
+	if (!Sim_SSD1306_InData)
+	{
+		Sim_SSD1306_InData = 1;
+		SIM_SSD1306_STATS.bursts++;
+	}
+	SIM_SSD1306_RAM[Sim_SSD1306_Page][Sim_SSD1306_Col] = data;
+	SIM_SSD1306_WRITES[Sim_SSD1306_Page][Sim_SSD1306_Col]++;
+	if (Sim_SSD1306_Mode == 2)
+	{
+		Sim_SSD1306_Col = Sim_SSD1306_Col >= 127 ? Sim_SSD1306_ColStart : Sim_SSD1306_Col + 1;
+	}
+	else if (Sim_SSD1306_Mode == 0)
+	{
+		if (Sim_SSD1306_Col++ >= Sim_SSD1306_ColEnd)
+		{
+			Sim_SSD1306_Col = Sim_SSD1306_ColStart;
+			Sim_SSD1306_Page = Sim_SSD1306_Page >= Sim_SSD1306_PageEnd ? Sim_SSD1306_PageStart : Sim_SSD1306_Page + 1;
+		}
+	}
+	else
+	{
+		if (Sim_SSD1306_Page++ >= Sim_SSD1306_PageEnd)
+		{
+			Sim_SSD1306_Page = Sim_SSD1306_PageStart;
+			Sim_SSD1306_Col = Sim_SSD1306_Col >= Sim_SSD1306_ColEnd ? Sim_SSD1306_ColStart : Sim_SSD1306_Col + 1;
+		}
+	}
+}
+
+/**
+ * @brief check an 8080 or SPI time against its minimum
+ *
+ */
+static void Sim_SSD1306_Check(uint8_t param, int64_t cycles)
+{
+	static const char *const names[2][4] = {{"tCYCLE", "tPWLW", "tPWHW", "tDSW"}, {"tCYCLE", "tCLKL", "tCLKH", "tDSW"}};
+	uint8_t spi = Sim_SSD1306_Bus == SIM_SSD1306_SPI;
+	uint32_t ns = (uint32_t)SIM_NS(cycles);
+	uint32_t min = ((const uint32_t *)&SIM_SSD1306_SPEC[spi])[param];
+	uint32_t *seen = &((uint32_t *)&SIM_SSD1306_MIN)[param];
+	if (ns < *seen)
+	{
+		*seen = ns;
+	}
+	if (ns < min && SIM_SSD1306_STATS.violations++ < 8)
+	{
+		printf("ssd1306: %s %u ns < %u ns at %llu ns\r\n", names[spi][param], ns, min,
+			   (unsigned long long)SIM_NS(Sim_Time));
+	}
+}
+
+/**
+ * @brief data bus of the 8080 interface
+ *
+ */
+static uint8_t Sim_SSD1306_Data_Bus(void)
+{
+	uint8_t d = 0, i;
+	for (i = 0; i < 4; i++)
+	{
+		d |= Sim_GPIO_Drive(GPIOC, GPIO_PIN_6 << i) << i;
+	}
+	d |= Sim_GPIO_Drive(GPIOC, GPIO_PIN_11) << 4;
+	d |= Sim_GPIO_Drive(GPIOD, GPIO_PIN_3) << 5;
+	d |= Sim_GPIO_Drive(GPIOB, GPIO_PIN_8) << 6;
+	d |= Sim_GPIO_Drive(GPIOB, GPIO_PIN_9) << 7;
+	return d;
+}
+
+static void Sim_SSD1306_Sync_8080(void)
+{
+	uint8_t wr = Sim_GPIO_Drive(GPIOH, GPIO_PIN_8);
+	uint8_t d = Sim_SSD1306_Data_Bus();
+	if (d != Sim_SSD1306_Bus8)
+	{
+		Sim_SSD1306_Bus8 = d;
+		Sim_SSD1306_DataChange = Sim_Time;
+	}
+	if (wr == Sim_SSD1306_WR)
+	{
+		return;
+	}
+	Sim_SSD1306_WR = wr;
+	if (Sim_SSD1306_CS)
+	{
+		return; // not selected
+	}
+	if (!wr)
+	{
+		if (Sim_SSD1306_WrRise >= 0)
+		{
+			Sim_SSD1306_Check(2, (int64_t)Sim_Time - Sim_SSD1306_WrRise);
+		}
+		Sim_SSD1306_WrFall = Sim_Time;
+		return;
+	}
+	if (Sim_SSD1306_WrFall >= 0)
+	{
+		Sim_SSD1306_Check(1, (int64_t)Sim_Time - Sim_SSD1306_WrFall);
+	}
+	if (Sim_SSD1306_WrRise >= 0)
+	{
+		Sim_SSD1306_Check(0, (int64_t)Sim_Time - Sim_SSD1306_WrRise);
+	}
+	if (Sim_SSD1306_DataChange >= 0)
+	{
+		Sim_SSD1306_Check(3, (int64_t)Sim_Time - Sim_SSD1306_DataChange);
+	}
+	Sim_SSD1306_WrRise = Sim_Time;
+	Sim_SSD1306_Byte(Sim_GPIO_Drive(GPIOB, GPIO_PIN_4), d);
+}
+
+static void Sim_SSD1306_Sync_SPI(void)
+{
+	uint8_t sclk = Sim_GPIO_Drive(GPIOC, GPIO_PIN_6);
+	uint8_t sdin = Sim_GPIO_Drive(GPIOC, GPIO_PIN_7);
+	if (sdin != Sim_SSD1306_SDIN)
+	{
+		Sim_SSD1306_SDIN = sdin;
+		Sim_SSD1306_DataChange = Sim_Time;
+	}
+	if (Sim_SSD1306_CS)
+	{
+		Sim_SSD1306_Bits = 0;
+	}
+	if (sclk == Sim_SSD1306_SCLK)
+	{
+		return;
+	}
+	Sim_SSD1306_SCLK = sclk;
+	if (Sim_SSD1306_CS)
+	{
+		return;
+	}
+	if (!sclk)
+	{
+		if (Sim_SSD1306_WrRise >= 0)
+		{
+			Sim_SSD1306_Check(2, (int64_t)Sim_Time - Sim_SSD1306_WrRise);
+		}
+		Sim_SSD1306_WrFall = Sim_Time;
+		return;
+	}
+	if (Sim_SSD1306_WrFall >= 0)
+	{
+		Sim_SSD1306_Check(1, (int64_t)Sim_Time - Sim_SSD1306_WrFall);
+	}
+	if (Sim_SSD1306_WrRise >= 0)
+	{
+		Sim_SSD1306_Check(0, (int64_t)Sim_Time - Sim_SSD1306_WrRise);
+	}
+	if (Sim_SSD1306_DataChange >= 0)
+	{
+		Sim_SSD1306_Check(3, (int64_t)Sim_Time - Sim_SSD1306_DataChange);
+	}
+	Sim_SSD1306_WrRise = Sim_Time;
+	Sim_SSD1306_Shift = (Sim_SSD1306_Shift << 1) | Sim_GPIO_Drive(GPIOC, GPIO_PIN_7);
+	if (++Sim_SSD1306_Bits == 8)
+	{
+		Sim_SSD1306_Bits = 0;
+		Sim_SSD1306_Byte(Sim_GPIO_Drive(GPIOB, GPIO_PIN_4), Sim_SSD1306_Shift);
+	}
+}
+
+static void Sim_SSD1306_Sync(void)
+{
+	uint8_t rst = Sim_GPIO_Drive(GPIOA, GPIO_PIN_15);
+	if (rst != Sim_SSD1306_RST)
+	{
+		Sim_SSD1306_RST = rst;
+		if (!rst)
+		{
+			Sim_SSD1306_Reset();
+		}
+	}
+	if (!rst || Sim_SSD1306_Bus == SIM_SSD1306_IIC)
+	{
+		return;
+	}
+	Sim_SSD1306_CS = Sim_GPIO_Drive(GPIOB, GPIO_PIN_7);
+	if (Sim_SSD1306_CS)
+	{
+		Sim_SSD1306_WrRise = Sim_SSD1306_WrFall = -1; // checked inside a transaction
+		Sim_SSD1306_InData = 0;
+	}
+	if (Sim_SSD1306_Bus == SIM_SSD1306_8080)
+	{
+		Sim_SSD1306_Sync_8080();
+	}
+	else
+	{
+		Sim_SSD1306_Sync_SPI();
+	}
+}
+
+static void Sim_SSD1306_IIC_Start(Sim_I2C_Device *dev, uint8_t read)
+{
+	(void)dev;
+	(void)read;
+	Sim_SSD1306_Control = 1;
+	Sim_SSD1306_InData = 0;
+}
+
+/**
+ * @brief IIC byte: a control byte (Co, D/C#) or a data/command byte
+ *
+ */
+static uint8_t Sim_SSD1306_IIC_Write(Sim_I2C_Device *dev, uint8_t data)
+{
+	(void)dev;
+	if (Sim_SSD1306_Control)
+	{
+		Sim_SSD1306_Co = data >> 7;
+		Sim_SSD1306_DC = (data >> 6) & 1;
+		Sim_SSD1306_Control = 0;
+		return 1;
+	}
+	Sim_SSD1306_Byte(Sim_SSD1306_DC, data);
+	Sim_SSD1306_Control = Sim_SSD1306_Co;
+	return 1;
+}
+
+static uint8_t Sim_SSD1306_IIC_Read(Sim_I2C_Device *dev)
+{
+	(void)dev;
+	return 0X00; // status: display on, not busy
+}
+
+void Sim_SSD1306_Init(uint8_t bus)
+{
+	Sim_SSD1306_Bus = bus;
+	memset(&SIM_SSD1306_STATS, 0, sizeof(SIM_SSD1306_STATS));
+	memset(SIM_SSD1306_WRITES, 0, sizeof(SIM_SSD1306_WRITES));
+	memset(&SIM_SSD1306_MIN, 0XFF, sizeof(SIM_SSD1306_MIN));
+	Sim_SSD1306_RST = Sim_SSD1306_WR = Sim_SSD1306_SCLK = Sim_SSD1306_CS = 1;
+	Sim_SSD1306_Bits = Sim_SSD1306_SDIN = Sim_SSD1306_InData = 0;
+	Sim_SSD1306_WrFall = Sim_SSD1306_WrRise = Sim_SSD1306_DataChange = -1;
+	Sim_SSD1306_Reset();
+	if (bus == SIM_SSD1306_IIC)
+	{
+		memset(&Sim_SSD1306_IIC, 0, sizeof(Sim_SSD1306_IIC));
+		Sim_SSD1306_IIC.addr = SIM_SSD1306_ADDR;
+		Sim_SSD1306_IIC.start = Sim_SSD1306_IIC_Start;
+		Sim_SSD1306_IIC.write = Sim_SSD1306_IIC_Write;
+		Sim_SSD1306_IIC.read = Sim_SSD1306_IIC_Read;
+		Sim_I2C_Attach(&Sim_SSD1306_IIC);
+	}
+	if (!Sim_SSD1306_Added)
+	{
+		Sim_Add_Device(Sim_SSD1306_Sync, Sim_SSD1306_Reset);
+		Sim_SSD1306_Added = 1;
+	}
+}
+
+uint8_t Sim_SSD1306_Pixel(uint8_t x, uint8_t y)
+{
+	uint8_t col = Sim_SSD1306_Remap ? 127 - x : x;
+	uint8_t com = Sim_SSD1306_ScanRev ? 63 - y : y;
+	uint8_t line = (com + Sim_SSD1306_StartLine) & 63;
+	uint8_t bit = (SIM_SSD1306_RAM[line / 8][col] >> (line % 8)) & 1;
+	if (!Sim_SSD1306_On)
+	{
+		return 0;
+	}
+	if (Sim_SSD1306_AllOn)
+	{
+		return 1;
+	}
+	return bit ^ Sim_SSD1306_Inverse;
+}
+
+uint8_t Sim_SSD1306_Save_PGM(const char *path)
+{
+	uint8_t x, y, row[128];
+	FILE *f = fopen(path, "wb");
+	if (f == NULL)
+	{
+		return 1;
+	}
+	fprintf(f, "P5\n128 64\n255\n");
+	for (y = 0; y < 64; y++)
+	{
+		for (x = 0; x < 128; x++)
+		{
+			row[x] = Sim_SSD1306_Pixel(x, y) ? 0XFF : 0X00;
+		}
+		fwrite(row, 1, sizeof(row), f);
+	}
+	return fclose(f) == 0 ? 0 : 1;
+}
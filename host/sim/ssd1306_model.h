@@ -0,0 +1,79 @@
+/*
+ * ssd1306_model.h
+ *
+ */
+
+#ifndef __SSD1306_MODEL_H_
+#define __SSD1306_MODEL_H_
+#include "sim.h"
+
+/**
+ * SSD1306 128x64 controller on the ALIENTEK OLED module pins
+ *
+ * 8080: D[3:0]-->PC[9:6], D4-->PC11, D5-->PD3, D[7:6]-->PB[9:8],
+ *       WR: PH8, CS: PB7, DC: PB4, RD: PB3, RST: PA15
+ * SPI:  SCLK: PC6, SDIN: PC7, CS: PB7, DC: PB4
+ * IIC:  device 0X78 on the bus of i2c_model.c
+ *
+ * The command parser follows the datasheet for the addressing modes,
+ * column/page windows, segment remap, COM scan direction, start line,
+ * inverse and display on/off. The 8080 front end latches on the rising
+ * edge of WR and checks tCYCLE, tPWLW, tPWHW and tDSW, the SPI front end
+ * samples SDIN on the rising edge of SCLK, DC with the 8th bit, and
+ * checks tCYCLE, tCLKL, tCLKH and tDSW of SCLK. The display
+ * RAM can be compared with the driver's frame buffer or rendered as the
+ * glass shows it into a PGM image.
+ *
+ */
+#define SIM_SSD1306_8080    0
+#define SIM_SSD1306_SPI     1
+#define SIM_SSD1306_IIC     2
+#define SIM_SSD1306_ADDR    0X78 //IIC address, SA0 = 0
+
+typedef struct _Sim_SSD1306_Timing
+{
+    uint32_t cycle; //tCYCLE, WR (SCLK) rise to rise, min 300 (100) ns
+    uint32_t low;   //tPWLW (tCLKL), min 60 (20) ns
+    uint32_t high;  //tPWHW (tCLKH), min 60 (20) ns
+    uint32_t setup; //tDSW, data setup before the WR (SCLK) rise, min 40 (15) ns
+} Sim_SSD1306_Timing;
+
+typedef struct _Sim_SSD1306_Stats
+{
+    uint32_t commands;   //command bytes
+    uint32_t data;       //display RAM bytes written
+    uint32_t bursts;     //CS low periods or IIC messages carrying display data
+    uint32_t violations; //8080 or SPI timings below the minimum
+} Sim_SSD1306_Stats;
+
+extern uint8_t SIM_SSD1306_RAM[8][128]; //GDDRAM, [page][column]
+extern uint16_t SIM_SSD1306_WRITES[8][128]; //writes of each GDDRAM byte, for checks by the tests
+extern Sim_SSD1306_Stats SIM_SSD1306_STATS;
+extern Sim_SSD1306_Timing SIM_SSD1306_MIN; //shortest measured 8080 or SPI times in ns
+
+/**
+ * @brief attach the controller, the IIC front end needs Sim_I2C_Init first
+ *
+ * @param
+ * bus: SIM_SSD1306_8080, SIM_SSD1306_SPI or SIM_SSD1306_IIC
+ *
+ */
+void Sim_SSD1306_Init(uint8_t bus);
+
+/**
+ * @brief a pixel as seen on the glass, (0, 0) is the top left corner
+ *
+ * @return 1: lit
+ *
+ */
+uint8_t Sim_SSD1306_Pixel(uint8_t x, uint8_t y);
+
+/**
+ * @brief write the glass as a binary PGM (P5) image, lit pixels white
+ *
+ * @return 0: success, 1: the file could not be written
+ *
+ */
+uint8_t Sim_SSD1306_Save_PGM(const char *path);
+
+#endif
@@ -0,0 +1,693 @@
+#define _GNU_SOURCE
+#include "w25q_model.h"
+#include "stdio.h"
+#include "string.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// command kinds
+enum
+{
+	SIM_OP_READ,
+	SIM_OP_QREAD, // Fast Read Quad I/O: mode byte, continuous read, wrap
+	SIM_OP_PROGRAM,
+	SIM_OP_ERASE,
+	SIM_OP_WRSR,
+	SIM_OP_RDSR,
+	SIM_OP_WREN,
+	SIM_OP_WRDI,
+	SIM_OP_ID,
+	SIM_OP_JEDEC,
+	SIM_OP_RELEASE_PD,
+	SIM_OP_PD,
+	SIM_OP_EN4B,
+	SIM_OP_EX4B,
+	SIM_OP_WRAP,
+	SIM_OP_RESET_EN,
+	SIM_OP_RESET,
+	SIM_OP_NOP
+};
+
+#define SIM_ADS 0XFF // 3 or 4 address bytes, from the ADS bit
+
+typedef struct _Sim_Flash_Cmd
+{
+	uint8_t cmd;
+	uint8_t kind;
+	uint8_t abytes;	   // address bytes, SIM_ADS: by address mode
+	uint8_t extra;	   // mode and dummy bytes after the address
+	uint8_t addrlines; // lines of address, mode and dummy bytes
+	uint8_t datalines; // lines of the data phase
+	uint8_t quad;	   // needs QE
+	uint32_t arg;	   // erase size, status register number
+} Sim_Flash_Cmd;
+
+static const Sim_Flash_Cmd SIM_FLASH_CMDS[] = {
+	{0X03, SIM_OP_READ, SIM_ADS, 0, 1, 1, 0, 0},
+	{0X13, SIM_OP_READ, 4, 0, 1, 1, 0, 0},
+	{0X0B, SIM_OP_READ, SIM_ADS, 1, 1, 1, 0, 0},
+	{0X0C, SIM_OP_READ, 4, 1, 1, 1, 0, 0},
+	{0X3B, SIM_OP_READ, SIM_ADS, 1, 1, 2, 0, 0},
+	{0X3C, SIM_OP_READ, 4, 1, 1, 2, 0, 0},
+	{0X6B, SIM_OP_READ, SIM_ADS, 1, 1, 4, 1, 0},
+	{0X6C, SIM_OP_READ, 4, 1, 1, 4, 1, 0},
+	{0XEB, SIM_OP_QREAD, SIM_ADS, 3, 4, 4, 1, 0},
+	{0XEC, SIM_OP_QREAD, 4, 3, 4, 4, 1, 0},
+	{0X02, SIM_OP_PROGRAM, SIM_ADS, 0, 1, 1, 0, 0},
+	{0X12, SIM_OP_PROGRAM, 4, 0, 1, 1, 0, 0},
+	{0X32, SIM_OP_PROGRAM, SIM_ADS, 0, 1, 4, 1, 0},
+	{0X34, SIM_OP_PROGRAM, 4, 0, 1, 4, 1, 0},
+	{0X20, SIM_OP_ERASE, SIM_ADS, 0, 1, 0, 0, 0X1000},
+	{0X21, SIM_OP_ERASE, 4, 0, 1, 0, 0, 0X1000},
+	{0X52, SIM_OP_ERASE, SIM_ADS, 0, 1, 0, 0, 0X8000},
+	{0XD8, SIM_OP_ERASE, SIM_ADS, 0, 1, 0, 0, 0X10000},
+	{0XDC, SIM_OP_ERASE, 4, 0, 1, 0, 0, 0X10000},
+	{0XC7, SIM_OP_ERASE, 0, 0, 1, 0, 0, SIM_FLASH_SIZE},
+	{0X60, SIM_OP_ERASE, 0, 0, 1, 0, 0, SIM_FLASH_SIZE},
+	{0X01, SIM_OP_WRSR, 0, 0, 1, 1, 0, 1},
+	{0X31, SIM_OP_WRSR, 0, 0, 1, 1, 0, 2},
+	{0X11, SIM_OP_WRSR, 0, 0, 1, 1, 0, 3},
+	{0X05, SIM_OP_RDSR, 0, 0, 1, 1, 0, 1},
+	{0X35, SIM_OP_RDSR, 0, 0, 1, 1, 0, 2},
+	{0X15, SIM_OP_RDSR, 0, 0, 1, 1, 0, 3},
+	{0X06, SIM_OP_WREN, 0, 0, 1, 0, 0, 0},
+	{0X50, SIM_OP_NOP, 0, 0, 1, 0, 0, 0}, // volatile SR write enable
+	{0X04, SIM_OP_WRDI, 0, 0, 1, 0, 0, 0},
+	{0X90, SIM_OP_ID, 3, 0, 1, 1, 0, 0},
+	{0X9F, SIM_OP_JEDEC, 0, 0, 1, 1, 0, 0},
+	{0XAB, SIM_OP_RELEASE_PD, 0, 3, 1, 1, 0, 0},
+	{0XB9, SIM_OP_PD, 0, 0, 1, 0, 0, 0},
+	{0XB7, SIM_OP_EN4B, 0, 0, 1, 0, 0, 0},
+	{0XE9, SIM_OP_EX4B, 0, 0, 1, 0, 0, 0},
+	{0X77, SIM_OP_WRAP, 0, 4, 4, 0, 1, 0}, // 3 dummy bytes and W7-0
+	{0X66, SIM_OP_RESET_EN, 0, 0, 1, 0, 0, 0},
+	{0X99, SIM_OP_RESET, 0, 0, 1, 0, 0, 0},
+	{0XFF, SIM_OP_NOP, 0, 0, 1, 0, 0, 0}, // continuous read mode reset outside the mode
+};
+
+Sim_Flash_Timing SIM_FLASH_TIMING = {700, 45000, 120000, 150000, 80000000, 10000};
+Sim_Flash_Stats SIM_FLASH_STATS;
+Sim_Flash_Last SIM_FLASH_LAST;
+uint32_t SIM_FLASH_ERASE_COUNT[SIM_FLASH_SECTORS];
+uint8_t *Sim_Flash_Mem;
+
+static int Sim_Flash_Fd = -1;
+static uint8_t *Sim_Flash_Map; // memory-mapped window at SIM_FLASH_MAP_BASE
+
+// chip state
+static uint8_t Sim_Flash_SR[3];		 // status registers, BUSY and WEL kept apart
+static uint8_t Sim_Flash_WEL;
+static uint8_t Sim_Flash_ADS;		 // 4-byte address mode
+static uint8_t Sim_Flash_PD;		 // powered down
+static uint8_t Sim_Flash_ResetEn;	 // 0x66 received
+static uint8_t Sim_Flash_Cont;		 // continuous read mode, next CS cycle starts with the address
+static uint8_t Sim_Flash_ContCmd;	 // read command of the continuous read mode
+static uint8_t Sim_Flash_Wrap;		 // burst wrap of Quad I/O reads, 0: off
+static uint64_t Sim_Flash_BusyUntil; // Sim_Time at which BUSY clears
+static uint8_t Sim_Flash_CS = 1;	 // CS level seen by the PF6 hook
+static uint8_t Sim_Flash_SRLock;	 // status register writes are ignored
+static uint8_t Sim_Flash_ID = 0X18;	 // device ID, W25Q256
+static Sim_Hook Sim_Flash_Watcher;	 // called after each command
+
+// current CS cycle
+static uint8_t Sim_Flash_Sel;
+static uint8_t Sim_Flash_Ignore; // the chip does not respond until CS rises
+static const Sim_Flash_Cmd *Sim_Flash_Op;
+static uint32_t Sim_Flash_N;	 // bytes clocked
+static uint8_t Sim_Flash_ABytes; // address bytes of the command
+static uint32_t Sim_Flash_Addr;
+static uint32_t Sim_Flash_Start; // address as clocked in
+static uint32_t Sim_Flash_Data;	 // data bytes clocked
+static uint8_t Sim_Flash_Extra[4];
+static uint8_t Sim_Flash_AddrLines = 1, Sim_Flash_DataLines = 1;
+static uint8_t Sim_Flash_Page[256]; // page program buffer
+static uint8_t Sim_Flash_PageSet[256];
+
+// power cut
+static uint32_t Sim_Flash_CutOps;
+static uint32_t Sim_Flash_Seed;
+static Sim_Hook Sim_Flash_CutHandler;
+
+/**
+ * @brief count and report a command the chip ignores
+ *
+ */
+static void Sim_Flash_Error(const char *what)
+{
+	if (SIM_FLASH_STATS.errors++ < 8)
+	{
+		printf("flash: %s, cmd %02X at %llu ns\r\n", what, Sim_Flash_Op ? Sim_Flash_Op->cmd : 0,
+			   (unsigned long long)SIM_NS(Sim_Time));
+	}
+	Sim_Flash_Ignore = 1;
+}
+
+static uint32_t Sim_Flash_Rand(void)
+{
+	Sim_Flash_Seed ^= Sim_Flash_Seed << 13;
+	Sim_Flash_Seed ^= Sim_Flash_Seed >> 17;
+	Sim_Flash_Seed ^= Sim_Flash_Seed << 5;
+	return Sim_Flash_Seed;
+}
+
+uint8_t Sim_Flash_Busy(void)
+{
+	return Sim_Time < Sim_Flash_BusyUntil;
+}
+
+uint8_t Sim_Flash_QE(void)
+{
+	return (Sim_Flash_SR[1] & 0X02) != 0;
+}
+
+void Sim_Flash_Lock_SR(uint8_t on)
+{
+	Sim_Flash_SRLock = on;
+}
+
+void Sim_Flash_Set_ID(uint8_t id)
+{
+	Sim_Flash_ID = id;
+}
+
+void Sim_Flash_Watch(Sim_Hook hook)
+{
+	Sim_Flash_Watcher = hook;
+}
+
+/**
+ * @brief power-up state of the volatile bits
+ *
+ */
+static void Sim_Flash_Power_On(void)
+{
+	Sim_Flash_Sel = 0;
+	Sim_Flash_CS = 1;
+	Sim_Flash_WEL = 0;
+	Sim_Flash_ADS = (Sim_Flash_SR[2] >> 1) & 1; // ADP
+	Sim_Flash_PD = 0;
+	Sim_Flash_ResetEn = 0;
+	Sim_Flash_Cont = 0;
+	Sim_Flash_Wrap = 0;
+	Sim_Flash_BusyUntil = 0;
+}
+
+/**
+ * @brief CS of SPI5 on PF6, followed while PF6 is a GPIO output
+ *
+ */
+static void Sim_Flash_Sync(void)
+{
+	uint8_t cs;
+	if (((GPIOF->MODER >> 12) & 3) != 1)
+	{
+		return;
+	}
+	cs = (GPIOF->ODR_[0] >> 6) & 1;
+	if (cs != Sim_Flash_CS)
+	{
+		Sim_Flash_CS = cs;
+		Sim_Flash_Set_Lines(1, 1);
+		Sim_Flash_Select(cs);
+	}
+}
+
+uint8_t Sim_Flash_Open(const char *path, uint8_t erase)
+{
+	struct stat st;
+	uint8_t blank;
+	Sim_Flash_Fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (Sim_Flash_Fd < 0 || fstat(Sim_Flash_Fd, &st) != 0)
+	{
+		return 1;
+	}
+	blank = erase || st.st_size != SIM_FLASH_SIZE;
+	if (blank && (ftruncate(Sim_Flash_Fd, 0) != 0 || ftruncate(Sim_Flash_Fd, SIM_FLASH_SIZE) != 0))
+	{
+		return 1;
+	}
+	Sim_Flash_Mem = mmap(NULL, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, Sim_Flash_Fd, 0);
+	if (Sim_Flash_Mem == MAP_FAILED)
+	{
+		Sim_Flash_Mem = NULL;
+		return 1;
+	}
+	if (blank)
+	{
+		memset(Sim_Flash_Mem, 0XFF, SIM_FLASH_SIZE);
+	}
+	Sim_Flash_Map = mmap((void *)(uintptr_t)SIM_FLASH_MAP_BASE, SIM_FLASH_SIZE, PROT_NONE,
+						 MAP_SHARED | MAP_FIXED_NOREPLACE, Sim_Flash_Fd, 0);
+	if (Sim_Flash_Map == MAP_FAILED)
+	{
+		Sim_Flash_Map = NULL; // memory-mapped reads will fault
+	}
+	memset(&SIM_FLASH_STATS, 0, sizeof(SIM_FLASH_STATS));
+	memset(SIM_FLASH_ERASE_COUNT, 0, sizeof(SIM_FLASH_ERASE_COUNT));
+	memset(Sim_Flash_SR, 0, sizeof(Sim_Flash_SR));
+	Sim_Flash_SRLock = 0;
+	Sim_Flash_ID = 0X18;
+	Sim_Flash_Watcher = NULL;
+	Sim_Flash_CutOps = 0;
+	Sim_Flash_Power_On();
+	Sim_Add_Device(Sim_Flash_Sync, Sim_Flash_Power_On);
+	return 0;
+}
+
+void Sim_Flash_Close(void)
+{
+	if (Sim_Flash_Map)
+	{
+		munmap(Sim_Flash_Map, SIM_FLASH_SIZE);
+		Sim_Flash_Map = NULL;
+	}
+	if (Sim_Flash_Mem)
+	{
+		munmap(Sim_Flash_Mem, SIM_FLASH_SIZE);
+		Sim_Flash_Mem = NULL;
+	}
+	if (Sim_Flash_Fd >= 0)
+	{
+		close(Sim_Flash_Fd);
+		Sim_Flash_Fd = -1;
+	}
+}
+
+void Sim_Flash_Window(uint8_t on)
+{
+	if (Sim_Flash_Map)
+	{
+		mprotect(Sim_Flash_Map, SIM_FLASH_SIZE, on ? PROT_READ : PROT_NONE);
+	}
+}
+
+void Sim_Flash_Cut(uint32_t ops, uint32_t seed, Sim_Hook handler)
+{
+	Sim_Flash_CutOps = ops;
+	Sim_Flash_Seed = seed ? seed : 1;
+	Sim_Flash_CutHandler = handler;
+}
+
+void Sim_Flash_Set_Lines(uint8_t addrlines, uint8_t datalines)
+{
+	Sim_Flash_AddrLines = addrlines;
+	Sim_Flash_DataLines = datalines;
+}
+
+/**
+ * @brief 1: this operation is the one to cut
+ *
+ */
+static uint8_t Sim_Flash_Cut_Now(void)
+{
+	return Sim_Flash_CutOps && --Sim_Flash_CutOps == 0;
+}
+
+/**
+ * @brief the power is gone, hand over to the test
+ *
+ */
+static void Sim_Flash_Power_Lost(void)
+{
+	Sim_Flash_Sel = 0;
+	Sim_Flash_CutHandler();
+}
+
+/**
+ * @brief execute the page program of the current CS cycle
+ * Bytes are programmed in the order they were clocked in.
+ *
+ */
+static void Sim_Flash_Program(void)
+{
+	uint32_t page = Sim_Flash_Addr & ~0XFFUL, count = 0, i, n, k;
+	uint8_t first = (uint8_t)(Sim_Flash_Addr - Sim_Flash_Data), cut = 0;
+	for (i = 0; i < 256; i++)
+	{
+		count += Sim_Flash_PageSet[i];
+	}
+	if (count == 0)
+	{
+		return; // no data, nothing is programmed
+	}
+	n = count;
+	if (Sim_Flash_Cut_Now())
+	{
+		n = Sim_Flash_Rand() % (count + 1); // count: lost just after the program
+		cut = 1;
+	}
+	for (i = 0, k = 0; i < 256 && k <= n; i++)
+	{
+		uint8_t idx = (uint8_t)(first + i);
+		if (!Sim_Flash_PageSet[idx])
+		{
+			continue;
+		}
+		if (k < n)
+		{
+			Sim_Flash_Mem[page + idx] &= Sim_Flash_Page[idx];
+		}
+		else if (n < count)
+		{
+			// torn byte: only some of its 0 bits made it
+			Sim_Flash_Mem[page + idx] &= Sim_Flash_Page[idx] | (uint8_t)Sim_Flash_Rand();
+		}
+		k++;
+	}
+	SIM_FLASH_STATS.programs++;
+	SIM_FLASH_STATS.bytes_programmed += n;
+	if (cut)
+	{
+		Sim_Flash_Power_Lost();
+	}
+	Sim_Flash_BusyUntil = Sim_Time + (uint64_t)SIM_FLASH_TIMING.page_program * (SystemCoreClock / 1000000);
+}
+
+/**
+ * @brief execute the erase of the current CS cycle
+ *
+ */
+static void Sim_Flash_Erase(void)
+{
+	uint32_t size = Sim_Flash_Op->arg, start, n, i, us;
+	start = Sim_Flash_Addr & ~(size - 1) & (SIM_FLASH_SIZE - 1);
+	n = size;
+	if (Sim_Flash_Cut_Now())
+	{
+		n = Sim_Flash_Rand() % size;
+	}
+	memset(Sim_Flash_Mem + start, 0XFF, n);
+	for (i = start / 4096; i <= (start + (n ? n - 1 : 0)) / 4096; i++)
+	{
+		SIM_FLASH_ERASE_COUNT[i]++;
+	}
+	SIM_FLASH_STATS.erases++;
+	if (n < size)
+	{
+		Sim_Flash_Mem[start + n] |= (uint8_t)Sim_Flash_Rand(); // torn byte
+		Sim_Flash_Power_Lost();
+	}
+	us = size == 0X1000 ? SIM_FLASH_TIMING.sector_erase : size == 0X8000	? SIM_FLASH_TIMING.block_erase32
+													  : size == 0X10000 ? SIM_FLASH_TIMING.block_erase64
+																		: SIM_FLASH_TIMING.chip_erase;
+	Sim_Flash_BusyUntil = Sim_Time + (uint64_t)us * (SystemCoreClock / 1000000);
+}
+
+/**
+ * @brief execute the status register write of the current CS cycle
+ *
+ */
+static void Sim_Flash_Write_SR(void)
+{
+	static const uint8_t mask[3] = {0XFC, 0X7B, 0X66}; // writable bits
+	uint8_t reg = Sim_Flash_Op->arg - 1, i;
+	if (Sim_Flash_Data == 0)
+	{
+		return;
+	}
+	if (Sim_Flash_Cut_Now())
+	{
+		Sim_Flash_Power_Lost(); // non-volatile bits keep their old value
+	}
+	for (i = 0; i < Sim_Flash_Data && i < 2 && reg + i < 3 && !Sim_Flash_SRLock; i++)
+	{
+		Sim_Flash_SR[reg + i] = (Sim_Flash_SR[reg + i] & ~mask[reg + i]) | (Sim_Flash_Extra[i] & mask[reg + i]);
+	}
+	Sim_Flash_BusyUntil = Sim_Time + (uint64_t)SIM_FLASH_TIMING.write_sr * (SystemCoreClock / 1000000);
+}
+
+/**
+ * @brief status register value as read
+ *
+ */
+static uint8_t Sim_Flash_Read_SR(uint8_t regno)
+{
+	uint8_t busy = Sim_Flash_Busy();
+	if (regno == 1)
+	{
+		return Sim_Flash_SR[0] | ((Sim_Flash_WEL || busy) ? 0X02 : 0) | busy;
+	}
+	if (regno == 3)
+	{
+		return (Sim_Flash_SR[2] & ~0X01) | Sim_Flash_ADS;
+	}
+	return Sim_Flash_SR[1];
+}
+
+/**
+ * @brief instruction byte of a CS cycle
+ *
+ */
+static void Sim_Flash_Decode(uint8_t cmd)
+{
+	uint8_t i;
+	Sim_Flash_Op = NULL;
+	for (i = 0; i < sizeof(SIM_FLASH_CMDS) / sizeof(SIM_FLASH_CMDS[0]); i++)
+	{
+		if (SIM_FLASH_CMDS[i].cmd == cmd)
+		{
+			Sim_Flash_Op = &SIM_FLASH_CMDS[i];
+			break;
+		}
+	}
+	if (Sim_Flash_Op == NULL)
+	{
+		Sim_Flash_Error("unknown command");
+		return;
+	}
+	if (Sim_Flash_Op->kind != SIM_OP_RESET)
+	{
+		Sim_Flash_ResetEn = 0;
+	}
+	if (Sim_Flash_PD && Sim_Flash_Op->kind != SIM_OP_RELEASE_PD)
+	{
+		Sim_Flash_Error("powered down");
+		return;
+	}
+	if (Sim_Flash_Busy() && Sim_Flash_Op->kind != SIM_OP_RDSR)
+	{
+		Sim_Flash_Error("command while busy");
+		return;
+	}
+	if (Sim_Flash_Op->quad && !(Sim_Flash_SR[1] & 0X02))
+	{
+		Sim_Flash_Error("quad command without QE");
+		return;
+	}
+	if (((Sim_Flash_Op->abytes || Sim_Flash_Op->extra) && Sim_Flash_AddrLines != Sim_Flash_Op->addrlines) ||
+		(Sim_Flash_DataLines && Sim_Flash_Op->datalines && Sim_Flash_DataLines != Sim_Flash_Op->datalines))
+	{
+		Sim_Flash_Error("wrong number of lines");
+		return;
+	}
+	Sim_Flash_ABytes = Sim_Flash_Op->abytes == SIM_ADS ? (Sim_Flash_ADS ? 4 : 3) : Sim_Flash_Op->abytes;
+	SIM_FLASH_STATS.commands++;
+	if (Sim_Flash_Op->kind == SIM_OP_READ || Sim_Flash_Op->kind == SIM_OP_QREAD)
+	{
+		SIM_FLASH_STATS.reads++;
+	}
+	if (Sim_Flash_Op->kind == SIM_OP_RDSR && Sim_Flash_Busy())
+	{
+		SIM_FLASH_STATS.busy_polls++;
+	}
+}
+
+void Sim_Flash_Select(uint8_t cs)
+{
+	uint8_t kind;
+	if (cs == 0)
+	{
+		Sim_Flash_Sel = 1;
+		Sim_Flash_Ignore = 0;
+		Sim_Flash_Op = NULL;
+		Sim_Flash_N = 0;
+		Sim_Flash_Addr = 0;
+		Sim_Flash_Start = 0;
+		Sim_Flash_Data = 0;
+		memset(Sim_Flash_PageSet, 0, sizeof(Sim_Flash_PageSet));
+		if (Sim_Flash_Cont)
+		{
+			// continuous read mode: the cycle starts with the address
+			Sim_Flash_Decode(Sim_Flash_ContCmd);
+			Sim_Flash_N = 1;
+		}
+		return;
+	}
+	if (!Sim_Flash_Sel)
+	{
+		return;
+	}
+	Sim_Flash_Sel = 0;
+	if (Sim_Flash_Ignore || Sim_Flash_Op == NULL)
+	{
+		return;
+	}
+	SIM_FLASH_LAST.cmd = Sim_Flash_Op->cmd;
+	SIM_FLASH_LAST.lines = Sim_Flash_DataLines;
+	SIM_FLASH_LAST.abytes = Sim_Flash_ABytes;
+	SIM_FLASH_LAST.addr = Sim_Flash_Start;
+	SIM_FLASH_LAST.bytes = Sim_Flash_Data;
+	if (Sim_Flash_Op->kind == SIM_OP_QREAD && Sim_Flash_N == 1u + Sim_Flash_ABytes + 1)
+	{
+		// the mode byte is latched, CS raised after it is the continuous
+		// read mode reset (address and mode all ones)
+		Sim_Flash_Cont = (Sim_Flash_Extra[0] & 0X30) == 0X20;
+		return;
+	}
+	if (Sim_Flash_N < 1u + Sim_Flash_ABytes + Sim_Flash_Op->extra)
+	{
+		Sim_Flash_Error("CS raised before the address");
+		return;
+	}
+	kind = Sim_Flash_Op->kind;
+	switch (kind)
+	{
+	case SIM_OP_QREAD:
+		// M5-4 = 10 keeps the chip in continuous read mode
+		Sim_Flash_Cont = (Sim_Flash_Extra[0] & 0X30) == 0X20;
+		Sim_Flash_ContCmd = Sim_Flash_Op->cmd;
+		break;
+	case SIM_OP_PROGRAM:
+	case SIM_OP_ERASE:
+	case SIM_OP_WRSR:
+		if (!Sim_Flash_WEL)
+		{
+			Sim_Flash_Error("no WEL");
+			return;
+		}
+		Sim_Flash_WEL = 0;
+		if (kind == SIM_OP_PROGRAM)
+		{
+			Sim_Flash_Program();
+		}
+		else if (kind == SIM_OP_ERASE)
+		{
+			Sim_Flash_Erase();
+		}
+		else
+		{
+			Sim_Flash_Write_SR();
+		}
+		break;
+	case SIM_OP_WREN:
+		Sim_Flash_WEL = 1;
+		break;
+	case SIM_OP_WRDI:
+		Sim_Flash_WEL = 0;
+		break;
+	case SIM_OP_PD:
+		Sim_Flash_PD = 1;
+		break;
+	case SIM_OP_RELEASE_PD:
+		Sim_Flash_PD = 0;
+		break;
+	case SIM_OP_EN4B:
+		Sim_Flash_ADS = 1;
+		break;
+	case SIM_OP_EX4B:
+		Sim_Flash_ADS = 0;
+		break;
+	case SIM_OP_WRAP:
+		// W4 = 1: off, W6-5: 8, 16, 32 or 64 bytes
+		Sim_Flash_Wrap = (Sim_Flash_Extra[3] & 0X10) ? 0 : 8 << ((Sim_Flash_Extra[3] >> 5) & 3);
+		break;
+	case SIM_OP_RESET_EN:
+		Sim_Flash_ResetEn = 1;
+		break;
+	case SIM_OP_RESET:
+		if (Sim_Flash_ResetEn)
+		{
+			Sim_Flash_Power_On();
+		}
+		break;
+	default:
+		break;
+	}
+	if (Sim_Flash_Watcher)
+	{
+		Sim_Flash_Watcher();
+	}
+}
+
+uint8_t Sim_Flash_Xfer(uint8_t mosi)
+{
+	uint8_t out = 0XFF;
+	uint32_t e;
+	const Sim_Flash_Cmd *op = Sim_Flash_Op;
+	if (!Sim_Flash_Sel || Sim_Flash_Ignore)
+	{
+		return 0XFF;
+	}
+	if (Sim_Flash_N++ == 0)
+	{
+		Sim_Flash_Decode(mosi);
+		return 0XFF;
+	}
+	if (Sim_Flash_N - 1 <= Sim_Flash_ABytes)
+	{
+		Sim_Flash_Addr = (Sim_Flash_Addr << 8) | mosi;
+		Sim_Flash_Start = Sim_Flash_Addr;
+		return 0XFF;
+	}
+	e = Sim_Flash_N - 1 - Sim_Flash_ABytes;
+	if (e <= op->extra)
+	{
+		Sim_Flash_Extra[e - 1] = mosi; // mode byte, W7-0 of 0x77
+		if (e == op->extra)
+		{
+			Sim_Flash_Addr &= SIM_FLASH_SIZE - 1;
+		}
+		return 0XFF;
+	}
+	if (op->extra == 0 && Sim_Flash_Data == 0)
+	{
+		Sim_Flash_Addr &= SIM_FLASH_SIZE - 1;
+	}
+	switch (op->kind)
+	{
+	case SIM_OP_READ:
+	case SIM_OP_QREAD:
+		out = Sim_Flash_Mem[Sim_Flash_Addr];
+		SIM_FLASH_STATS.bytes_read++;
+		if (op->kind == SIM_OP_QREAD && Sim_Flash_Wrap)
+		{
+			Sim_Flash_Addr = (Sim_Flash_Addr & ~(uint32_t)(Sim_Flash_Wrap - 1)) | ((Sim_Flash_Addr + 1) & (Sim_Flash_Wrap - 1));
+		}
+		else
+		{
+			Sim_Flash_Addr = (Sim_Flash_Addr + 1) & (SIM_FLASH_SIZE - 1);
+		}
+		break;
+	case SIM_OP_PROGRAM:
+		// more than 256 bytes: the address wraps inside the page
+		Sim_Flash_Page[Sim_Flash_Addr & 0XFF] = mosi;
+		Sim_Flash_PageSet[Sim_Flash_Addr & 0XFF] = 1;
+		Sim_Flash_Addr = (Sim_Flash_Addr & ~0XFFUL) | ((Sim_Flash_Addr + 1) & 0XFF);
+		break;
+	case SIM_OP_WRSR:
+		if (Sim_Flash_Data < 2)
+		{
+			Sim_Flash_Extra[Sim_Flash_Data] = mosi;
+		}
+		break;
+	case SIM_OP_RDSR:
+		out = Sim_Flash_Read_SR(op->arg);
+		break;
+	case SIM_OP_ID:
+		// manufacturer then device, swapped by address bit 0
+		out = ((Sim_Flash_Addr ^ Sim_Flash_Data) & 1) ? Sim_Flash_ID : 0XEF;
+		break;
+	case SIM_OP_JEDEC:
+		out = Sim_Flash_Data == 0 ? 0XEF : Sim_Flash_Data == 1 ? 0X40 : Sim_Flash_Data == 2 ? Sim_Flash_ID + 1 : 0XFF;
+		break;
+	case SIM_OP_RELEASE_PD:
+		out = Sim_Flash_ID;
+		break;
+	default:
+		break;
+	}
+	Sim_Flash_Data++;
+	return out;
+}
@@ -0,0 +1,170 @@
+/*
+ * w25q_model.h
+ *
+ */
+
+#ifndef __W25Q_MODEL_H_
+#define __W25Q_MODEL_H_
+#include "sim.h"
+
+/**
+ * Behavioural model of a W25Q256 on SPI5 (CS: PF6) or QUADSPI
+ *
+ * The array is a file mapped with mmap, so its content survives a run and
+ * can be inspected with any hex viewer. A second mapping of the same file
+ * sits at the QUADSPI memory-mapped address and is only readable while
+ * the controller is in memory-mapped mode.
+ *
+ * The chip decodes the byte stream of each CS cycle: 3/4-byte address
+ * mode, WEL, BUSY with datasheet erase/program times on the virtual
+ * clock, QE, continuous read mode, burst wrap and power down. Programming
+ * only clears bits, like the real array. Commands the chip would ignore
+ * (while BUSY, without WEL or QE, on the wrong number of lines, unknown
+ * opcodes) are counted in SIM_FLASH_STATS.errors.
+ *
+ */
+#define SIM_FLASH_SIZE      0X2000000  //32M
+#define SIM_FLASH_SECTORS   (SIM_FLASH_SIZE / 4096)
+#define SIM_FLASH_MAP_BASE  0X90000000 //QSPI_MAP_BASE
+
+typedef struct _Sim_Flash_Timing
+{
+    uint32_t page_program;  //tPP, us
+    uint32_t sector_erase;  //tSE, us
+    uint32_t block_erase32; //tBE1, us
+    uint32_t block_erase64; //tBE2, us
+    uint32_t chip_erase;    //tCE, us
+    uint32_t write_sr;      //tW, us
+} Sim_Flash_Timing;
+
+typedef struct _Sim_Flash_Stats
+{
+    uint32_t commands;         //CS cycles with an instruction
+    uint32_t reads;            //read commands
+    uint32_t bytes_read;       //data bytes sent by read commands
+    uint32_t programs;         //page programs started
+    uint32_t bytes_programmed; //data bytes of the page programs
+    uint32_t erases;           //sector, block and chip erases started
+    uint32_t busy_polls;       //status register reads while BUSY
+    uint32_t errors;           //commands the chip ignored
+} Sim_Flash_Stats;
+
+typedef struct _Sim_Flash_Last
+{
+    uint8_t cmd;    //instruction, also the read of a continuous read mode cycle
+    uint8_t lines;  //data lines
+    uint8_t abytes; //address bytes
+    uint32_t addr;  //address as clocked in
+    uint32_t bytes; //data bytes clocked
+} Sim_Flash_Last;
+
+extern Sim_Flash_Timing SIM_FLASH_TIMING; //typical datasheet values
+extern Sim_Flash_Stats SIM_FLASH_STATS;
+extern Sim_Flash_Last SIM_FLASH_LAST; //the last command executed
+extern uint32_t SIM_FLASH_ERASE_COUNT[SIM_FLASH_SECTORS];
+extern uint8_t *Sim_Flash_Mem; //the array, for checks by the tests
+
+/**
+ * @brief map the backing file and attach the chip to the simulation
+ * Call after Sim_Init.
+ *
+ * @param
+ * path: backing file, created if missing
+ * erase: 1: start with an erased chip
+ *
+ * @return 0: success, 1: the file could not be mapped
+ *
+ */
+uint8_t Sim_Flash_Open(const char *path, uint8_t erase);
+
+/**
+ * @brief unmap the backing file
+ *
+ */
+void Sim_Flash_Close(void);
+
+/**
+ * @brief CS edge
+ *
+ * @param
+ * cs: 0: selected, 1: released, the command is executed
+ *
+ */
+void Sim_Flash_Select(uint8_t cs);
+
+/**
+ * @brief lines used by the address and data phases of the next command,
+ * SPI5 always uses one line
+ *
+ */
+void Sim_Flash_Set_Lines(uint8_t addrlines, uint8_t datalines);
+
+/**
+ * @brief clock one byte
+ *
+ * @param
+ * mosi: byte from the controller
+ *
+ * @return byte from the chip, 0XFF when it does not drive the bus
+ *
+ */
+uint8_t Sim_Flash_Xfer(uint8_t mosi);
+
+/**
+ * @brief 1: an erase, program or status write is in progress
+ *
+ */
+uint8_t Sim_Flash_Busy(void);
+
+/**
+ * @brief 1: QE is set, IO2/IO3 are data lines rather than /WP and /HOLD
+ *
+ */
+uint8_t Sim_Flash_QE(void);
+
+/**
+ * @brief lock the status registers (1), as SRL or an OTP lock does: writes
+ * take tW and change nothing. Sim_Flash_Open unlocks them.
+ *
+ */
+void Sim_Flash_Lock_SR(uint8_t on);
+
+/**
+ * @brief device ID the chip reports to 0x90 and 0x9F, Sim_Flash_Open sets
+ * 0X18 (W25Q256). The array keeps its 32M.
+ *
+ * @param
+ * id: 0X17: W25Q128, 0X18: W25Q256
+ *
+ */
+void Sim_Flash_Set_ID(uint8_t id);
+
+/**
+ * @brief call hook after each command the chip executes, with
+ * SIM_FLASH_LAST set, NULL: none. Sim_Flash_Open clears it.
+ *
+ */
+void Sim_Flash_Watch(Sim_Hook hook);
+
+/**
+ * @brief make the memory-mapped window readable (1) or not (0)
+ *
+ */
+void Sim_Flash_Window(uint8_t on);
+
+/**
+ * @brief cut the power while an operation is running
+ * The ops-th program, erase or status write from now is left half done:
+ * a random part of the page is programmed (the last byte partially) or a
+ * random part of the block erased, then handler is called, which must not
+ * return (longjmp to the test, then Sim_Power_Cycle).
+ *
+ * @param
+ * ops: operation to cut, 1: the next one, 0: disarm
+ * seed: random seed
+ * handler: called at the cut
+ *
+ */
+void Sim_Flash_Cut(uint32_t ops, uint32_t seed, Sim_Hook handler);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * test.h
+ *
+ * Checks of the host tests, each test is a program of its own that
+ * returns non-zero when a check failed.
+ *
+ */
+
+#ifndef __TEST_H_
+#define __TEST_H_
+#include "stdio.h"
+
+static int Test_Failures;
+
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            printf("%s:%d: CHECK(%s) failed\r\n", __FILE__, __LINE__, #cond);       \
+            Test_Failures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                              \
+    do                                                                              \
+    {                                                                               \
+        unsigned long _a = (unsigned long)(a), _b = (unsigned long)(b);             \
+        if (_a != _b)                                                               \
+        {                                                                           \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed: %lu != %lu\r\n", __FILE__,      \
+                   __LINE__, #a, #b, _a, _b);                                       \
+            Test_Failures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+#define TEST_DONE()                                                                 \
+    (printf("%s: %s\r\n", __FILE__, Test_Failures ? "FAILED" : "ok"), Test_Failures ? 1 : 0)
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * test_async.c
+ *
+ * The asynchronous erase/program queue: callbacks in queue order once the
+ * flash has finished, a full queue refusing jobs, W25QXX_Async_Poll
+ * returning at once while the flash is busy, and W25QXX_Async_Flush
+ * draining the queue.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define SECTOR 0X500 // sectors used, 4K each
+#define LEN    600   // bytes of a write job, 3 page programs
+
+/**
+ * @brief a queued job and what the flash must hold when its callback runs
+ *
+ */
+typedef struct _Job_Check
+{
+	uint8_t id;
+	uint32_t addr;
+	const uint8_t *data; // NULL: erased
+	uint16_t len;
+} Job_Check;
+
+static uint8_t Done[16]; // ids in callback order
+static uint8_t Done_Num;
+static uint8_t Done_Bad; // callbacks with the flash busy or the wrong content
+
+static uint8_t Data[2][LEN];
+
+static void Callback(void *arg)
+{
+	const Job_Check *c = (const Job_Check *)arg;
+	uint16_t i;
+	Done[Done_Num++] = c->id;
+	if (Sim_Flash_Busy())
+	{
+		Done_Bad++;
+		return;
+	}
+	for (i = 0; i < c->len; i++)
+	{
+		if (Sim_Flash_Mem[c->addr + i] != (c->data ? c->data[i] : 0XFF))
+		{
+			Done_Bad++;
+			return;
+		}
+	}
+}
+
+static Job_Check Requeued = {99, SECTOR * 4096 + 8192, NULL, 4096};
+
+/**
+ * @brief a callback that queues another job, the slot of its own job is
+ * free already
+ *
+ */
+static void Callback_Requeue(void *arg)
+{
+	Callback(arg);
+	CHECK_EQ(W25QXX_Async_Erase_Sector(SECTOR + 2, Callback, &Requeued), 0);
+}
+
+/**
+ * @brief a full queue of erases and writes, polled to the end
+ *
+ */
+static void Test_Order(void)
+{
+	static Job_Check jobs[W25QXX_JOB_NUM - 1];
+	uint32_t i, polls = 0, busy_polls = 0, commands;
+	uint64_t t, slowest = 0;
+	uint8_t busy;
+
+	memset(Sim_Flash_Mem + SECTOR * 4096, 0, 3 * 4096); // programmed, the erases must show
+	Done_Num = Done_Bad = 0;
+	// job 6 erases what job 1 wrote, job 5 queues one more erase
+	jobs[0] = (Job_Check){0, SECTOR * 4096, NULL, 4096};
+	jobs[1] = (Job_Check){1, SECTOR * 4096 + 100, Data[0], LEN};
+	jobs[2] = (Job_Check){2, (SECTOR + 1) * 4096, NULL, 4096};
+	jobs[3] = (Job_Check){3, (SECTOR + 1) * 4096, Data[1], LEN};
+	jobs[4] = (Job_Check){4, (SECTOR + 1) * 4096 + 2048, Data[0], LEN};
+	jobs[5] = (Job_Check){5, SECTOR * 4096 + 8192, NULL, 4096};
+	jobs[6] = (Job_Check){6, SECTOR * 4096, NULL, 4096};
+	for (i = 0; i < W25QXX_JOB_NUM - 1; i++)
+	{
+		if (jobs[i].data)
+		{
+			CHECK_EQ(W25QXX_Async_Write_NoCheck(jobs[i].data, jobs[i].addr, jobs[i].len, Callback, &jobs[i]), 0);
+		}
+		else
+		{
+			CHECK_EQ(W25QXX_Async_Erase_Sector(jobs[i].addr / 4096, i == 5 ? Callback_Requeue : Callback, &jobs[i]), 0);
+		}
+	}
+	CHECK_EQ(W25QXX_Async_Erase_Sector(SECTOR, Callback, NULL), 1); // full
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(Data[0], 0, 1, Callback, NULL), 1);
+	CHECK_EQ(W25QXX_Async_Erase_Chip(Callback, NULL), 1);
+	CHECK(W25QXX_Async_Busy());
+
+	while (W25QXX_Async_Busy())
+	{
+		busy = Sim_Flash_Busy();
+		commands = SIM_FLASH_STATS.commands;
+		t = Sim_Time;
+		W25QXX_Async_Poll();
+		t = Sim_Time - t;
+		polls++;
+		if (busy && Sim_Flash_Busy())
+		{
+			// a status read, nothing else
+			busy_polls++;
+			CHECK(SIM_FLASH_STATS.commands - commands <= 1);
+			slowest = t > slowest ? t : slowest;
+		}
+		Sim_Advance(SIM_CYCLES(10000)); // the rest of the main loop
+	}
+	printf("%lu polls, %lu while busy, slowest of those %lu ns\r\n", (unsigned long)polls, (unsigned long)busy_polls,
+		   (unsigned long)SIM_NS(slowest));
+	CHECK(busy_polls > 5 * SIM_FLASH_TIMING.sector_erase / 10000);
+	CHECK(SIM_NS(slowest) < 5000);
+
+	CHECK_EQ(Done_Num, W25QXX_JOB_NUM);
+	for (i = 0; i < W25QXX_JOB_NUM - 1; i++)
+	{
+		CHECK_EQ(Done[i], i);
+	}
+	CHECK_EQ(Done[W25QXX_JOB_NUM - 1], 99);
+	CHECK_EQ(Done_Bad, 0);
+	CHECK_EQ(Sim_Flash_Mem[SECTOR * 4096 + 100], 0XFF);
+	CHECK(memcmp(Sim_Flash_Mem + (SECTOR + 1) * 4096 + 2048, Data[0], LEN) == 0);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief W25QXX_Async_Flush runs every job, a chip erase included, and
+ * returns with the flash idle
+ *
+ */
+static void Test_Flush(void)
+{
+	static Job_Check write = {0, 0X10000, NULL, LEN}, chip = {1, 0, NULL, 4096}, last = {2, 0X20000, NULL, LEN};
+
+	write.data = Data[1];
+	last.data = Data[0];
+	Done_Num = Done_Bad = 0;
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(Data[1], write.addr, LEN, Callback, &write), 0);
+	CHECK_EQ(W25QXX_Async_Erase_Chip(Callback, &chip), 0);
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(Data[0], last.addr, LEN, Callback, &last), 0);
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(Data[0], 0X30000, LEN, NULL, NULL), 0); // no callback
+	W25QXX_Async_Flush();
+	CHECK(!W25QXX_Async_Busy());
+	CHECK(!Sim_Flash_Busy());
+	CHECK_EQ(Done_Num, 3);
+	CHECK_EQ(Done[0], 0);
+	CHECK_EQ(Done[1], 1);
+	CHECK_EQ(Done[2], 2);
+	CHECK_EQ(Done_Bad, 0); // the chip erase was seen before the last writes
+	CHECK_EQ(Sim_Flash_Mem[0X10000], 0XFF);
+	CHECK(memcmp(Sim_Flash_Mem + 0X30000, Data[0], LEN) == 0);
+	W25QXX_Async_Flush(); // nothing queued
+	CHECK_EQ(Done_Num, 3);
+	CHECK_EQ(W25QXX_ReadSR(1) & 0X01, 0);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_async.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	SIM_FLASH_TIMING.chip_erase = 100000; // 100 ms instead of the typical 80 s
+	for (i = 0; i < LEN; i++)
+	{
+		Data[0][i] = (uint8_t)(i * 3 + 1);
+		Data[1][i] = (uint8_t)(i ^ 0X5A);
+	}
+	W25QXX_Init();
+	Test_Order();
+	Test_Flush();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
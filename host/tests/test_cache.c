@@ -0,0 +1,195 @@
+/*
+ * test_cache.c
+ *
+ * The page read cache: coherence with every write and erase path of the
+ * driver, LRU replacement, and a replay of font, configuration and asset
+ * reads with and without the cache.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "w25qxx_cache.h"
+#include "string.h"
+
+#define FONT   0X100000 // 95 glyphs of 36 bytes
+#define CONFIG 0X110000 // 512 bytes of settings
+#define ASSETS 0X200000 // 256K of bitmaps
+
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+/**
+ * @brief a cached read returns what the flash holds
+ *
+ */
+static uint8_t Coherent(uint32_t addr, uint16_t len)
+{
+	uint8_t buf[600];
+	W25QXX_Cache_Read(buf, addr, len);
+	return memcmp(buf, Sim_Flash_Mem + addr, len) == 0;
+}
+
+static void Test_Coherence(void)
+{
+	uint8_t buf[300];
+	uint32_t hits;
+
+	memset(buf, 0X5A, sizeof(buf));
+	W25QXX_Write(buf, 0X3000F0, sizeof(buf));
+	CHECK(Coherent(0X300000, 600));
+	hits = W25QXX_CACHE_STATS.hits;
+	CHECK(Coherent(0X300000, 600));
+	CHECK_EQ(W25QXX_CACHE_STATS.hits - hits, 3);
+
+	// write with an erase of the sector
+	memset(buf, 0XA5, sizeof(buf));
+	W25QXX_Write(buf, 0X300100, 100);
+	CHECK(Coherent(0X300000, 600));
+
+	// program only
+	memset(buf, 0X0F, 40);
+	W25QXX_Write_NoCheck(buf, 0X3001F0, 40);
+	CHECK(Coherent(0X300000, 600));
+
+	W25QXX_Erase_Sector(0X300);
+	CHECK(Coherent(0X300000, 600));
+	W25QXX_Write(buf, 0X300000, 40);
+	CHECK(Coherent(0X300000, 600));
+	CHECK_EQ(W25QXX_Erase_Range(0X300000, 0X10000), 0); // one 64K block
+	CHECK(Coherent(0X300000, 600));
+	W25QXX_Write(buf, 0X300000, 40);
+	CHECK(Coherent(0X300000, 600));
+	W25QXX_Erase_Chip();
+	CHECK(Coherent(0X300000, 600));
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief the least recently used line is the one replaced
+ *
+ */
+static void Test_LRU(void)
+{
+	static uint8_t big[W25QXX_CACHE_SIZE];
+	uint8_t b;
+	uint32_t i, misses, evictions, hits;
+
+	W25QXX_Cache_Flush();
+	for (i = 0; i < W25QXX_CACHE_LINES; i++)
+	{
+		W25QXX_Cache_Read(&b, 0X400000 + i * 256, 1);
+	}
+	W25QXX_Cache_Read(&b, 0X400000, 1); // page 0 used again
+	misses = W25QXX_CACHE_STATS.misses;
+	evictions = W25QXX_CACHE_STATS.evictions;
+	W25QXX_Cache_Read(&b, 0X400000 + W25QXX_CACHE_LINES * 256, 1);
+	CHECK_EQ(W25QXX_CACHE_STATS.evictions - evictions, 1);
+	W25QXX_Cache_Read(&b, 0X400000, 1);
+	CHECK_EQ(W25QXX_CACHE_STATS.misses - misses, 1); // page 0 stayed
+	W25QXX_Cache_Read(&b, 0X400000 + 256, 1);
+	CHECK_EQ(W25QXX_CACHE_STATS.misses - misses, 2); // page 1 went
+
+	// a read of the whole budget bypasses the cache
+	misses = W25QXX_CACHE_STATS.misses;
+	hits = W25QXX_CACHE_STATS.hits;
+	W25QXX_Cache_Read(big, 0X400000, sizeof(big));
+	CHECK_EQ(W25QXX_CACHE_STATS.hits, hits);
+	CHECK_EQ(W25QXX_CACHE_STATS.misses, misses);
+	CHECK(memcmp(big, Sim_Flash_Mem + 0X400000, sizeof(big)) == 0);
+}
+
+/**
+ * @brief text rendering with a settings lookup per line and now and then
+ * a bitmap
+ *
+ */
+static void Replay(uint8_t cached)
+{
+	static uint8_t buf[2048];
+	uint32_t i;
+	Seed = 5;
+	for (i = 0; i < 4000; i++)
+	{
+		if (i % 40 == 0)
+		{
+			cached ? W25QXX_Cache_Read(buf, CONFIG + (Rand() % 32) * 16, 16)
+				   : W25QXX_Read(buf, CONFIG + (Rand() % 32) * 16, 16);
+		}
+		else if (i % 500 == 0)
+		{
+			cached ? W25QXX_Cache_Read(buf, ASSETS + (Rand() % 128) * 2048, 2048)
+				   : W25QXX_Read(buf, ASSETS + (Rand() % 128) * 2048, 2048);
+		}
+		else
+		{
+			cached ? W25QXX_Cache_Read(buf, FONT + (32 + Rand() % 60) * 36, 36)
+				   : W25QXX_Read(buf, FONT + (32 + Rand() % 60) * 36, 36);
+		}
+	}
+}
+
+static void Test_Replay(void)
+{
+	uint32_t bytes, direct, commands, direct_commands;
+	uint64_t t, direct_t;
+
+	bytes = SIM_FLASH_STATS.bytes_read;
+	commands = SIM_FLASH_STATS.reads;
+	t = Sim_Time;
+	Replay(0);
+	direct = SIM_FLASH_STATS.bytes_read - bytes;
+	direct_commands = SIM_FLASH_STATS.reads - commands;
+	direct_t = Sim_Time - t;
+
+	W25QXX_Cache_Flush();
+	memset(&W25QXX_CACHE_STATS, 0, sizeof(W25QXX_CACHE_STATS));
+	bytes = SIM_FLASH_STATS.bytes_read;
+	commands = SIM_FLASH_STATS.reads;
+	t = Sim_Time;
+	Replay(1);
+	bytes = SIM_FLASH_STATS.bytes_read - bytes;
+	commands = SIM_FLASH_STATS.reads - commands;
+	t = Sim_Time - t;
+	printf("W25QXX_Read: %lu commands %lu bytes %lu us\r\n", (unsigned long)direct_commands, (unsigned long)direct,
+		   (unsigned long)(SIM_NS(direct_t) / 1000));
+	printf("%u-byte cache: %lu commands %lu bytes %lu us, %lu hits %lu misses %lu evictions\r\n", W25QXX_CACHE_SIZE,
+		   (unsigned long)commands, (unsigned long)bytes, (unsigned long)(SIM_NS(t) / 1000),
+		   (unsigned long)W25QXX_CACHE_STATS.hits, (unsigned long)W25QXX_CACHE_STATS.misses,
+		   (unsigned long)W25QXX_CACHE_STATS.evictions);
+	CHECK_EQ(commands, W25QXX_CACHE_STATS.misses); // one line fill per miss
+	CHECK(bytes * 4 < direct);
+	CHECK(t < direct_t);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_cache.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	SIM_FLASH_TIMING.chip_erase = 1000; // the typical 80 s only cost run time
+	for (i = 0; i < 0X40000; i++)
+	{
+		Sim_Flash_Mem[FONT + i] = (uint8_t)(i * 7);
+		Sim_Flash_Mem[ASSETS + i] = (uint8_t)(i >> 3);
+	}
+	W25QXX_Init();
+	W25QXX_Cache_Flush();
+	Test_Replay();
+	Test_Coherence();
+	Test_LRU();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,202 @@
+/*
+ * test_erase.c
+ *
+ * The erase commands W25QXX_Erase_Range plans for each alignment of the
+ * start and the end of a range, below and above 16M where 32K erase has
+ * no 4-byte address form, and the modelled erase time against one sector
+ * erase per 4K.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define STEPS 600 // erase commands logged
+
+/**
+ * @brief an erase command as the flash saw it
+ *
+ */
+typedef struct _Erase_Step
+{
+	uint8_t cmd;
+	uint8_t abytes;
+	uint32_t addr;
+} Erase_Step;
+
+static Erase_Step Log[STEPS];
+static uint32_t Log_Num;
+
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+static void Watch(void)
+{
+	uint8_t cmd = SIM_FLASH_LAST.cmd;
+	if ((cmd == 0X21 || cmd == 0X52 || cmd == 0XDC || cmd == 0X20 || cmd == 0XD8) && Log_Num < STEPS)
+	{
+		Log[Log_Num].cmd = cmd;
+		Log[Log_Num].abytes = SIM_FLASH_LAST.abytes;
+		Log[Log_Num].addr = SIM_FLASH_LAST.addr;
+		Log_Num++;
+	}
+}
+
+static uint32_t Step_Size(uint8_t cmd)
+{
+	return cmd == 0XDC ? 0X10000 : cmd == 0X52 ? 0X8000 : 0X1000;
+}
+
+/**
+ * @brief erase a range over programmed data: the commands tile it, with
+ * 32K erases only below 16M, and nothing outside it is erased
+ *
+ * @return modelled erase time in us
+ *
+ */
+static uint32_t Erase(uint32_t addr, uint32_t len)
+{
+	uint32_t i, pos = addr, bad = 0;
+	uint64_t t;
+
+	memset(Sim_Flash_Mem + addr - 0X1000, 0X00, len + 0X2000);
+	Log_Num = 0;
+	t = Sim_Time;
+	CHECK_EQ(W25QXX_Erase_Range(addr, len), 0);
+	t = Sim_Time - t;
+	for (i = 0; i < Log_Num; i++)
+	{
+		CHECK_EQ(Log[i].addr, pos);
+		CHECK_EQ(Log[i].addr % Step_Size(Log[i].cmd), 0);
+		CHECK_EQ(Log[i].abytes, Log[i].cmd == 0X52 ? 3 : 4);
+		CHECK(Log[i].cmd != 0X52 || Log[i].addr + 0X8000 <= 0X1000000);
+		pos += Step_Size(Log[i].cmd);
+	}
+	CHECK_EQ(pos, addr + len);
+	for (i = 0; i < len; i++)
+	{
+		bad += Sim_Flash_Mem[addr + i] != 0XFF;
+	}
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(Sim_Flash_Mem[addr - 1], 0X00);
+	CHECK_EQ(Sim_Flash_Mem[addr + len], 0X00);
+	return (uint32_t)(SIM_NS(t) / 1000);
+}
+
+/**
+ * @brief the erase commands of a range, one letter each
+ *
+ */
+static void Check_Plan(uint32_t addr, uint32_t len, const char *plan)
+{
+	char got[STEPS + 1];
+	uint32_t i;
+
+	Erase(addr, len);
+	for (i = 0; i < Log_Num; i++)
+	{
+		got[i] = Log[i].cmd == 0XDC ? 'B' : Log[i].cmd == 0X52 ? 'H' : 'S';
+	}
+	got[Log_Num] = 0;
+	if (strcmp(got, plan) != 0)
+	{
+		printf("%08lX+%05lX: %s, expected %s\r\n", (unsigned long)addr, (unsigned long)len, got, plan);
+	}
+	CHECK(strcmp(got, plan) == 0);
+}
+
+/**
+ * @brief B: 64K block, H: 32K half block, S: 4K sector
+ *
+ */
+static void Test_Plan(void)
+{
+	CHECK_EQ(W25QXX_Erase_Range(0X101000, 0X800), 1);
+	CHECK_EQ(W25QXX_Erase_Range(0X101800, 0X1000), 1);
+
+	// below 16M
+	Check_Plan(0X100000, 0X40000, "BBBB");  // 64K aligned both ends
+	Check_Plan(0X108000, 0X18000, "HB");    // 32K aligned start
+	Check_Plan(0X100000, 0X18000, "BH");    // 32K aligned end
+	Check_Plan(0X101000, 0X1F000, "SSSSSSSHB");
+	Check_Plan(0X100000, 0X1D000, "BHSSSSS");
+	Check_Plan(0X103000, 0X1A000, "SSSSSHHSSSSS"); // no 64K fits
+	Check_Plan(0X108000, 0X4000, "SSSS");   // aligned, too short for 32K
+	Check_Plan(0X101000, 0X1000, "S");
+	Check_Plan(0XFF0000, 0X10000, "B");     // the last block below 16M
+	Check_Plan(0XFF8000, 0X18000, "HB");    // 32K below 16M, then 64K above
+
+	// above 16M: the 32K erase would need a 3-byte address
+	Check_Plan(0X1000000, 0X40000, "BBBB");
+	Check_Plan(0X1008000, 0X18000, "SSSSSSSSB");
+	Check_Plan(0X1000000, 0X18000, "BSSSSSSSS");
+	Check_Plan(0X1003000, 0X1A000, "SSSSSSSSSSSSSSSSSSSSSSSSSS");
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief random ranges either side of 16M
+ *
+ */
+static void Test_Random(void)
+{
+	uint32_t i, addr, len;
+
+	for (i = 0; i < 200; i++)
+	{
+		addr = 0XF00000 + (Rand() % 0X200) * 0X1000;
+		len = (1 + Rand() % 0X60) * 0X1000;
+		Erase(addr, len);
+	}
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief 1M, 64K aligned and not, against 256 sector erases
+ *
+ */
+static void Test_Bench(void)
+{
+	static const uint32_t starts[] = {0X200000, 0X209000, 0X1200000, 0X1209000};
+	uint32_t i, us, sectors = 256 * SIM_FLASH_TIMING.sector_erase;
+
+	for (i = 0; i < sizeof(starts) / sizeof(starts[0]); i++)
+	{
+		us = Erase(starts[i], 0X100000);
+		printf("1M at %08lX: %lu erases %lu ms, 256 sector erases %lu ms\r\n", (unsigned long)starts[i],
+			   (unsigned long)Log_Num, (unsigned long)(us / 1000), (unsigned long)(sectors / 1000));
+		CHECK(us * 3 < sectors);
+	}
+}
+
+int main(void)
+{
+	Sim_Flash_Timing timing;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_erase.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	W25QXX_Init();
+	Sim_Flash_Watch(Watch);
+	Test_Bench();
+	timing = SIM_FLASH_TIMING;
+	SIM_FLASH_TIMING.sector_erase = 45; // the plans only cost run time
+	SIM_FLASH_TIMING.block_erase32 = 120;
+	SIM_FLASH_TIMING.block_erase64 = 150;
+	Test_Plan();
+	Test_Random();
+	SIM_FLASH_TIMING = timing;
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,231 @@
+/*
+ * test_ftl.c
+ *
+ * FTL recovery after power loss at random points of page programs and
+ * sector erases, and the erase count spread of a skewed workload.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "w25qxx_cache.h"
+#include "ftl.h"
+#include "setjmp.h"
+#include "string.h"
+
+#define COLD_PAGES 2400 // written once, then only moved by GC and wear leveling
+#define HOT_PAGES  16   // rewritten all the time
+#define CUTS       150
+
+static uint16_t Version[FTL_PAGE_NUM]; // last version FTL_Write returned for, 0: never written
+static jmp_buf Cut_Jmp;
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+static void Cut_Handler(void)
+{
+	longjmp(Cut_Jmp, 1);
+}
+
+/**
+ * @brief page content of a version: lpn, version, then a pattern
+ *
+ */
+static void Fill(uint8_t *buf, uint16_t lpn, uint16_t ver)
+{
+	uint16_t i;
+	buf[0] = (uint8_t)lpn;
+	buf[1] = (uint8_t)(lpn >> 8);
+	buf[2] = (uint8_t)ver;
+	buf[3] = (uint8_t)(ver >> 8);
+	for (i = 4; i < FTL_PAGE_SIZE; i++)
+	{
+		buf[i] = (uint8_t)(lpn * 31 + ver * 7 + i);
+	}
+}
+
+/**
+ * @brief the version a page holds, 0 for an erased page
+ *
+ * @return 0: a complete version or erased, 1: corrupted
+ *
+ */
+static uint8_t Check(uint16_t lpn, uint16_t *ver)
+{
+	uint8_t buf[FTL_PAGE_SIZE], want[FTL_PAGE_SIZE];
+	uint16_t i;
+	FTL_Read(lpn, buf);
+	for (i = 0; i < FTL_PAGE_SIZE && buf[i] == 0XFF; i++)
+	{
+	}
+	if (i == FTL_PAGE_SIZE)
+	{
+		*ver = 0;
+		return 0;
+	}
+	*ver = buf[2] | (buf[3] << 8);
+	Fill(want, lpn, *ver);
+	return memcmp(buf, want, FTL_PAGE_SIZE) != 0;
+}
+
+/**
+ * @brief every page holds its last written version
+ *
+ */
+static void Check_All(uint16_t num)
+{
+	uint16_t lpn, ver;
+	uint32_t bad = 0;
+	for (lpn = 0; lpn < num; lpn++)
+	{
+		if (Check(lpn, &ver) || ver != Version[lpn])
+		{
+			if (bad++ < 4)
+			{
+				printf("lpn %u: version %u, expected %u\r\n", lpn, ver, Version[lpn]);
+			}
+		}
+	}
+	CHECK_EQ(bad, 0);
+}
+
+/**
+ * @brief a hot page most of the time, sometimes a cold one
+ *
+ */
+static uint16_t Pick(void)
+{
+	return Rand() % 10 ? Rand() % HOT_PAGES : HOT_PAGES + Rand() % (COLD_PAGES - HOT_PAGES);
+}
+
+static void Write(uint16_t lpn)
+{
+	uint8_t buf[FTL_PAGE_SIZE];
+	Fill(buf, lpn, Version[lpn] + 1);
+	CHECK_EQ(FTL_Write(lpn, buf), 0);
+	Version[lpn]++;
+}
+
+/**
+ * @brief power loss at random flash operations, each followed by a reboot
+ *
+ */
+static void Test_Power_Loss(void)
+{
+	volatile uint16_t lpn = 0;
+	volatile uint32_t cut;
+	uint16_t ver;
+	uint32_t n;
+
+	for (cut = 0; cut < CUTS; cut++)
+	{
+		Sim_Flash_Cut(1 + Rand() % 40, cut + 1, Cut_Handler);
+		if (setjmp(Cut_Jmp) == 0)
+		{
+			for (n = 0; n < 100000; n++)
+			{
+				lpn = Pick();
+				Write(lpn);
+			}
+			CHECK(0); // the cut never came
+			return;
+		}
+		// reboot
+		Sim_Flash_Cut(0, 0, NULL);
+		Sim_Power_Cycle();
+		W25QXX_Cache_Flush();
+		W25QXX_Init();
+		FTL_Init();
+
+		// the interrupted write is either complete or not there at all
+		CHECK_EQ(Check(lpn, &ver), 0);
+		CHECK(ver == Version[lpn] || ver == Version[lpn] + 1);
+		Version[lpn] = ver;
+		if (cut % 25 == 24)
+		{
+			Check_All(COLD_PAGES);
+		}
+		else
+		{
+			Check_All(HOT_PAGES);
+		}
+		if (Test_Failures)
+		{
+			printf("after cut %lu\r\n", (unsigned long)cut);
+			return;
+		}
+	}
+	Check_All(COLD_PAGES);
+}
+
+/**
+ * @brief hot pages only, dynamic and static wear leveling keep the erase
+ * counts together
+ *
+ */
+static void Test_Wear(void)
+{
+	uint32_t n, s, min, max, fmin = 0XFFFFFFFF, fmax = 0, erases;
+
+	erases = SIM_FLASH_STATS.erases;
+	for (n = 0; n < 200000; n++)
+	{
+		Write(Rand() % HOT_PAGES);
+	}
+	erases = SIM_FLASH_STATS.erases - erases;
+	FTL_Get_Wear(&min, &max);
+	for (s = FTL_START_SECTOR; s < FTL_START_SECTOR + FTL_SECTOR_NUM; s++)
+	{
+		if (SIM_FLASH_ERASE_COUNT[s] < fmin)
+		{
+			fmin = SIM_FLASH_ERASE_COUNT[s];
+		}
+		if (SIM_FLASH_ERASE_COUNT[s] > fmax)
+		{
+			fmax = SIM_FLASH_ERASE_COUNT[s];
+		}
+	}
+	printf("skewed workload: %lu writes to %u of %u pages, %lu erases, erase count %lu ~ %lu (FTL %lu ~ %lu)\r\n",
+		   (unsigned long)n, HOT_PAGES, COLD_PAGES, (unsigned long)erases, (unsigned long)fmin, (unsigned long)fmax,
+		   (unsigned long)min, (unsigned long)max);
+	CHECK(fmax - fmin <= FTL_WL_THRESHOLD + 8);
+	Check_All(COLD_PAGES);
+}
+
+int main(void)
+{
+	uint16_t lpn;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_ftl.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	// every status poll is simulated, the typical busy times make the
+	// skewed workload take minutes and change nothing here
+	SIM_FLASH_TIMING.page_program = 10;
+	SIM_FLASH_TIMING.sector_erase = 50;
+	W25QXX_Init();
+	FTL_Format();
+	FTL_Init();
+	for (lpn = 0; lpn < COLD_PAGES; lpn++)
+	{
+		Write(lpn);
+	}
+	Test_Power_Loss();
+	if (Test_Failures == 0)
+	{
+		Test_Wear();
+	}
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,546 @@
+/*
+ * test_iic.c
+ *
+ * Bus timing of the bit-banged iic.c at the three speeds, measured edge by
+ * edge by the I2C model against the UM10204 minimums, with repeated starts,
+ * clock stretching and a device busy in its write cycle. A device that logs
+ * its addressing, data bytes and stops checks the framing of burst
+ * register writes and reads.
+ *
+ * Built as test_iic_hw (IIC_USE_HW 1) the same calls go through the I2C2
+ * compatibility layer of iic_hw.c, which has no Fast-mode Plus, and the
+ * layer's own cases are added: write buffering, byte by byte sequential
+ * receives and a stop after an acknowledged read.
+ *
+ * Both builds also run the bus instances of iic.c: two buses on their own
+ * pins, a scan, devices of different speeds sharing a bus and the bus lock.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "hal.h"
+#include "i2c_model.h"
+#include "iic.h"
+#include "iic_hw.h"
+#include "string.h"
+
+#if IIC_USE_HW
+#define SIM_SPEED(speed) ((speed) == IIC_SPEED_FAST_PLUS ? SIM_I2C_FAST : (speed))
+#else
+#define SIM_SPEED(speed) (speed)
+#endif
+
+static Sim_I2C_Mem Eeprom;
+static Sim_I2C_Bus Sim_Bus_A, Sim_Bus_B;
+static Sim_I2C_Mem Mem_A, Mem_B, Sensor;
+static IIC_Bus Bus_A, Bus_B;
+
+// a register memory that logs what it sees: W/R addressed for a write or a
+// read, w/r a data byte, P a stop
+static Sim_I2C_Mem Logged;
+static Sim_I2C_Device Logged_Mem; // the callbacks of the register memory
+static char Log[128];
+static uint8_t Log_Len;
+
+static void Log_Add(char c)
+{
+	if (Log_Len < sizeof(Log) - 1)
+	{
+		Log[Log_Len++] = c;
+		Log[Log_Len] = 0;
+	}
+}
+
+static void Log_Start(Sim_I2C_Device *dev, uint8_t read)
+{
+	Log_Add(read ? 'R' : 'W');
+	Logged_Mem.start(dev, read);
+}
+
+static uint8_t Log_Write(Sim_I2C_Device *dev, uint8_t data)
+{
+	Log_Add('w');
+	return Logged_Mem.write(dev, data);
+}
+
+static uint8_t Log_Read(Sim_I2C_Device *dev)
+{
+	Log_Add('r');
+	return Logged_Mem.read(dev);
+}
+
+static void Log_Stop(Sim_I2C_Device *dev)
+{
+	Log_Add('P');
+	if (Logged_Mem.stop)
+	{
+		Logged_Mem.stop(dev);
+	}
+}
+
+/**
+ * @brief every bus parameter was measured and none is below the minimum
+ *
+ */
+static void Check_Timing(void)
+{
+	CHECK_EQ(SIM_I2C_STATS.violations, 0);
+	CHECK(SIM_I2C_MIN.low != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.high != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.su_sta != 0XFFFFFFFF); // a repeated start was seen
+	CHECK(SIM_I2C_MIN.hd_sta != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.su_sto != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.buf != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.su_dat != 0XFFFFFFFF);
+}
+
+/**
+ * @brief the shortest SCL period (rising edge to rising edge) of the edges
+ * recorded on a bus since edge n
+ *
+ * @return the period in ns, 0XFFFFFFFF: less than two rising edges
+ *
+ */
+static uint32_t Min_Period(const Sim_I2C_Bus *bus, uint32_t n)
+{
+	uint32_t p, min = 0XFFFFFFFF;
+	int64_t rise = -1;
+	for (n++; n < bus->edges; n++)
+	{
+		const Sim_I2C_Edge *e = &bus->trace[n % SIM_I2C_TRACE_SIZE];
+		if (e->scl && !bus->trace[(n - 1) % SIM_I2C_TRACE_SIZE].scl)
+		{
+			if (rise >= 0)
+			{
+				p = (uint32_t)SIM_NS(e->time - (uint64_t)rise);
+				min = p < min ? p : min;
+			}
+			rise = (int64_t)e->time;
+		}
+	}
+	return min;
+}
+
+/**
+ * @brief register write and read, IIC_Read_Reg uses a repeated start. SCL
+ * low and high times and the clock period against the UM10204 tLOW, tHIGH
+ * and fSCL of the mode, from this table rather than the model's.
+ *
+ */
+static void Test_Speed(uint8_t speed)
+{
+	static const uint32_t um10204[3][3] = {{4700, 4000, 10000}, {1300, 600, 2500}, {500, 260, 1000}};
+	const uint32_t *spec = um10204[SIM_SPEED(speed)];
+	uint8_t buf[16], back[16];
+	uint8_t i;
+	uint32_t edges = SIM_I2C_BUS.edges, period;
+
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = (uint8_t)(0X5A ^ (i * 13) ^ speed);
+	}
+	IIC_Set_Speed(speed);
+	Sim_I2C_Set_Speed(SIM_SPEED(speed));
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X20, 1, buf, sizeof(buf)), IIC_OK);
+	CHECK(memcmp(Eeprom.mem + 0X20, buf, sizeof(buf)) == 0);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X20, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK_EQ(IIC_Read(0XA0, back, 1), IIC_OK); // pointer moved on
+	CHECK_EQ(back[0], 0XFF);
+	CHECK_EQ(SIM_I2C_STATS.restarts, 1);
+	CHECK_EQ(SIM_I2C_STATS.nacks, 0);
+	period = Min_Period(&SIM_I2C_BUS, edges);
+	printf("speed %u: tLOW %lu ns, tHIGH %lu ns, SCL period %lu ns\r\n", speed, (unsigned long)SIM_I2C_MIN.low,
+		   (unsigned long)SIM_I2C_MIN.high, (unsigned long)period);
+	CHECK(SIM_I2C_MIN.low >= spec[0] && SIM_I2C_MIN.low != 0XFFFFFFFF);
+	CHECK(SIM_I2C_MIN.high >= spec[1] && SIM_I2C_MIN.high != 0XFFFFFFFF);
+	CHECK(period >= spec[2] && period != 0XFFFFFFFF);
+	Check_Timing();
+	if (SIM_I2C_STATS.violations)
+	{
+		printf("speed %u: see test_iic.trace\r\n", speed);
+		Sim_I2C_Save_Trace("test_iic.trace");
+	}
+}
+
+/**
+ * @brief burst register writes and reads with a 2-byte register address:
+ * one address phase each, and a read turns the bus around with a repeated
+ * start, no stop before the data
+ *
+ */
+static void Test_Burst(void)
+{
+	static const uint8_t lens[] = {1, 2, 40};
+	uint8_t buf[40], back[40], i, k;
+	uint32_t starts, restarts, stops;
+
+	IIC_Set_Speed(IIC_SPEED_FAST);
+	Sim_I2C_Set_Speed(SIM_I2C_FAST);
+	for (k = 0; k < sizeof(lens); k++)
+	{
+		for (i = 0; i < lens[k]; i++)
+		{
+			buf[i] = (uint8_t)(k * 40 + i * 7);
+		}
+		starts = SIM_I2C_STATS.starts;
+		restarts = SIM_I2C_STATS.restarts;
+		stops = SIM_I2C_STATS.stops;
+		Log_Len = 0;
+		CHECK_EQ(IIC_Write_Reg(0XA4, 0X1234 + k * 64, 2, buf, lens[k]), IIC_OK);
+		CHECK_EQ(Log_Len, 3 + lens[k] + 1); // Www, the data, P
+		CHECK(strncmp(Log, "Www", 3) == 0 && Log[Log_Len - 1] == 'P');
+		CHECK(strspn(Log + 3, "w") == lens[k]);
+		CHECK(memcmp(Logged.mem + 0X1234 + k * 64, buf, lens[k]) == 0);
+		CHECK_EQ(SIM_I2C_STATS.starts - starts, 1);
+		CHECK_EQ(SIM_I2C_STATS.restarts, restarts);
+		CHECK_EQ(SIM_I2C_STATS.stops - stops, 1);
+
+		starts = SIM_I2C_STATS.starts;
+		stops = SIM_I2C_STATS.stops;
+		Log_Len = 0;
+		CHECK_EQ(IIC_Read_Reg(0XA4, 0X1234 + k * 64, 2, back, lens[k]), IIC_OK);
+		CHECK_EQ(Log_Len, 4 + lens[k] + 1); // Www, R, the data, P
+		CHECK(strncmp(Log, "WwwR", 4) == 0 && Log[Log_Len - 1] == 'P');
+		CHECK(strspn(Log + 4, "r") == lens[k]);
+		CHECK(memcmp(back, buf, lens[k]) == 0);
+		CHECK_EQ(SIM_I2C_STATS.starts - starts, 2);
+		CHECK_EQ(SIM_I2C_STATS.restarts - restarts, 1);
+		CHECK_EQ(SIM_I2C_STATS.stops - stops, 1);
+	}
+	CHECK_EQ(SIM_I2C_STATS.nacks, 0);
+	Check_Timing();
+}
+
+/**
+ * @brief the compatibility primitives of iic.h, with a repeated start
+ *
+ */
+static void Test_Primitives(void)
+{
+	uint8_t a, b;
+
+	IIC_Set_Speed(IIC_SPEED_FAST);
+	Sim_I2C_Set_Speed(SIM_I2C_FAST);
+	Eeprom.mem[0X40] = 0X12;
+	Eeprom.mem[0X41] = 0X34;
+	IIC_Start();
+	IIC_Send_Byte(0XA0);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	IIC_Send_Byte(0X40);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	IIC_Start();
+	IIC_Send_Byte(0XA1);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	a = IIC_Read_Byte(1);
+	b = IIC_Read_Byte(0);
+	IIC_Stop();
+	CHECK_EQ(a, 0X12);
+	CHECK_EQ(b, 0X34);
+	CHECK_EQ(SIM_I2C_STATS.starts, 2); // no address-only frame before the transfer
+	CHECK_EQ(SIM_I2C_STATS.restarts, 1);
+
+	IIC_Start();
+	IIC_Send_Byte(0XB0); // nobody there
+	CHECK_EQ(IIC_Wait_Ack(), 1);
+	CHECK_EQ(SIM_I2C_STATS.stops, 2); // IIC_Wait_Ack sent the stop
+	Check_Timing();
+}
+
+/**
+ * @brief a device that stretches SCL after every acknowledge bit, then one
+ * that holds it past IIC_STRETCH_TIMEOUT
+ *
+ */
+static void Test_Stretch(void)
+{
+	uint8_t buf[4] = {9, 8, 7, 6}, back[4];
+	uint64_t t;
+
+	IIC_Set_Speed(IIC_SPEED_FAST_PLUS);
+	Sim_I2C_Set_Speed(SIM_SPEED(SIM_I2C_FAST_PLUS));
+	Eeprom.dev.stretch_ns = 20000;
+	t = Sim_Time;
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X60, 1, buf, sizeof(buf)), IIC_OK);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X60, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK(SIM_NS(Sim_Time - t) > 12 * 20000ULL); // 12 acknowledged bytes
+	Check_Timing();
+	Eeprom.dev.stretch_ns = 0;
+#if !IIC_USE_HW // the controller has no stretching limit, the HAL timeout resets it
+
+	// released in the middle of the register byte: the bus is cleared and
+	// the next transfer starts from a real start
+	Eeprom.dev.stretch_ns = (IIC_STRETCH_TIMEOUT + 5) * 1000000UL;
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X60, 1, buf + 3, 1), IIC_ERR_TIMEOUT);
+	CHECK_EQ(Eeprom.mem[0X60], 9);
+	Eeprom.dev.stretch_ns = 0;
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X60, 1, back, 1), IIC_OK);
+	CHECK_EQ(back[0], 9);
+	CHECK_EQ(SIM_I2C_STATS.violations, 0);
+#endif
+}
+
+/**
+ * @brief an EEPROM NACKs its address during the write cycle
+ *
+ */
+static void Test_Busy(void)
+{
+	uint8_t v = 0X77;
+
+	IIC_Set_Speed(IIC_SPEED_STANDARD);
+	Sim_I2C_Set_Speed(SIM_I2C_STANDARD);
+	Eeprom.dev.busy_ns = 5000000; // tWR 5 ms
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X80, 1, &v, 1), IIC_OK);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X80, 1, &v, 1), IIC_ERR_NACK);
+	Sim_Advance(SIM_CYCLES(5000000ULL));
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X80, 1, &v, 1), IIC_OK);
+	CHECK_EQ(v, 0X77);
+	CHECK_EQ(SIM_I2C_STATS.violations, 0);
+	Eeprom.dev.busy_ns = 0;
+}
+
+/**
+ * @brief an EEPROM on PB10/PB11 and another on PC0/PC1 with the same
+ * address: each bus only reaches its own
+ *
+ */
+static void Test_Buses(void)
+{
+	uint8_t a[8] = "bus A", b[8] = "bus B", back[8], found[8];
+	uint32_t edges;
+
+	Sim_I2C_Bus_Init(&Sim_Bus_A, GPIOB, GPIO_PIN_10, GPIO_PIN_11, SIM_I2C_STANDARD);
+	Sim_I2C_Bus_Init(&Sim_Bus_B, GPIOC, GPIO_PIN_0, GPIO_PIN_1, SIM_I2C_FAST);
+	Sim_I2C_Mem_Init(&Mem_A, 0XA0, 1);
+	Sim_I2C_Mem_Init(&Mem_B, 0XA0, 1);
+	Sim_I2C_Mem_Init(&Sensor, 0X3C, 1);
+	Sim_I2C_Bus_Attach(&Sim_Bus_A, &Mem_A.dev);
+	Sim_I2C_Bus_Attach(&Sim_Bus_A, &Sensor.dev);
+	Sim_I2C_Bus_Attach(&Sim_Bus_B, &Mem_B.dev);
+	IIC_Bus_Init(&Bus_A, GPIOB, GPIO_PIN_10, GPIOB, GPIO_PIN_11, IIC_SPEED_STANDARD);
+	IIC_Bus_Init(&Bus_B, GPIOC, GPIO_PIN_0, GPIOC, GPIO_PIN_1, IIC_SPEED_FAST);
+
+	edges = SIM_I2C_BUS.edges;
+	CHECK_EQ(IIC_Bus_Write_Reg(&Bus_A, 0XA0, 0X10, 1, a, sizeof(a)), IIC_OK);
+	CHECK_EQ(IIC_Bus_Write_Reg(&Bus_B, 0XA0, 0X10, 1, b, sizeof(b)), IIC_OK);
+	CHECK(memcmp(Mem_A.mem + 0X10, a, sizeof(a)) == 0);
+	CHECK(memcmp(Mem_B.mem + 0X10, b, sizeof(b)) == 0);
+	CHECK_EQ(IIC_Bus_Read_Reg(&Bus_A, 0XA0, 0X10, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, a, sizeof(a)) == 0);
+	CHECK_EQ(IIC_Bus_Read_Reg(&Bus_B, 0XA0, 0X10, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, b, sizeof(b)) == 0);
+	CHECK_EQ(SIM_I2C_BUS.edges, edges); // PH4/PH5 stayed idle
+	CHECK_EQ(Sim_Bus_A.stats.starts, 3);
+	CHECK_EQ(Sim_Bus_B.stats.starts, 3);
+	CHECK_EQ(Sim_Bus_A.stats.restarts, 1);
+	CHECK_EQ(Sim_Bus_A.stats.violations, 0);
+	CHECK_EQ(Sim_Bus_B.stats.violations, 0);
+
+	// a probe of every address finds the attached devices and nothing else
+	memset(found, 0, sizeof(found));
+	CHECK_EQ(IIC_Bus_Scan(&Bus_A, found, sizeof(found)), 2);
+	CHECK_EQ(found[0], 0X3C);
+	CHECK_EQ(found[1], 0XA0);
+	CHECK_EQ(IIC_Bus_Scan(&Bus_B, found, sizeof(found)), 1);
+	CHECK_EQ(found[0], 0XA0);
+	CHECK_EQ(Sim_Bus_A.stats.nacks, 0X70 - 2);
+	CHECK_EQ(Sim_Bus_A.stats.violations, 0);
+}
+
+/**
+ * @brief a Fast-mode device on the Standard-mode bus A: its transfers run
+ * at its speed, the next ones at the bus speed again
+ *
+ */
+static void Test_Device_Speed(void)
+{
+	IIC_Device slow = {&Bus_A, 0XA0, IIC_SPEED_STANDARD, 1, 0};
+	IIC_Device fast = {&Bus_A, 0X3C, IIC_SPEED_FAST, 1, 0};
+	uint8_t v[4] = {1, 2, 3, 4}, back[4];
+	uint32_t n, period;
+
+	// the bus model checks the Fast-mode minimums, Standard mode meets them
+	Sim_I2C_Bus_Set_Speed(&Sim_Bus_A, SIM_I2C_FAST);
+	n = Sim_Bus_A.edges;
+	CHECK_EQ(IIC_Dev_Write_Reg(&fast, 0X00, v, sizeof(v)), IIC_OK);
+	period = Min_Period(&Sim_Bus_A, n);
+	printf("fast device: SCL period %lu ns, ", (unsigned long)period);
+	CHECK(period >= 1300 + 600 && period < 3000); // tLOW + tHIGH of Fast mode
+	CHECK_EQ(Bus_A.speed, IIC_SPEED_STANDARD);
+
+	n = Sim_Bus_A.edges;
+	CHECK_EQ(IIC_Bus_Read_Reg(&Bus_A, 0X3C, 0X00, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, v, sizeof(v)) == 0);
+	period = Min_Period(&Sim_Bus_A, n);
+	printf("then the bus: %lu ns, ", (unsigned long)period);
+	CHECK(period >= 4700 + 4000);
+
+	n = Sim_Bus_A.edges;
+	CHECK_EQ(IIC_Dev_Read_Reg(&slow, 0X10, back, 4), IIC_OK);
+	CHECK(memcmp(back, "bus ", 4) == 0);
+	period = Min_Period(&Sim_Bus_A, n);
+	printf("standard device: %lu ns\r\n", (unsigned long)period);
+	CHECK(period >= 4700 + 4000);
+	CHECK_EQ(Sim_Bus_A.stats.violations, 0);
+}
+
+/**
+ * @brief a held bus lock turns transfers away without touching the lines
+ *
+ */
+static void Test_Lock(void)
+{
+	IIC_Device dev = {&Bus_B, 0XA0, IIC_SPEED_FAST, 1, 0};
+	uint8_t v = 0X99;
+	uint32_t edges;
+
+	CHECK_EQ(IIC_Bus_Lock(&Bus_B), 0);
+	CHECK_EQ(IIC_Bus_Lock(&Bus_B), 1);
+	edges = Sim_Bus_B.edges;
+	CHECK_EQ(IIC_Dev_Write_Reg(&dev, 0X20, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(IIC_Dev_Read(&dev, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(Sim_Bus_B.edges, edges);
+	CHECK_EQ(Mem_B.mem[0X20], 0XFF);
+	IIC_Bus_Unlock(&Bus_B);
+	CHECK_EQ(IIC_Dev_Write_Reg(&dev, 0X20, &v, 1), IIC_OK);
+	CHECK_EQ(Mem_B.mem[0X20], 0X99);
+#if !IIC_USE_HW
+
+	// the IIC_* functions take the lock of IIC_BUS1, so a driver using them
+	// (the OLED on I2C) cannot cut into an IIC_Device transaction
+	CHECK_EQ(IIC_Bus_Lock(&IIC_BUS1), 0);
+	edges = SIM_I2C_BUS.edges;
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X20, 1, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X20, 1, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(IIC_Write(0XA0, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(IIC_Read(0XA0, &v, 1), IIC_ERR_BUSY);
+	CHECK_EQ(SIM_I2C_BUS.edges, edges);
+	IIC_Bus_Unlock(&IIC_BUS1);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X20, 1, &v, 1), IIC_OK);
+	CHECK_EQ(IIC_BUS1.lock, 0);
+#endif
+}
+
+#if IIC_USE_HW
+
+/**
+ * @brief the primitives of iic.h as HAL sequential frames
+ *
+ */
+static void Test_Compat(void)
+{
+	uint8_t buf[100], back[100];
+	uint32_t xfers, dma, stops;
+	uint8_t i;
+
+	IIC_Set_Speed(IIC_SPEED_FAST);
+	Sim_I2C_Set_Speed(SIM_I2C_FAST);
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	// more than IIC_HW_BUF_SIZE bytes: the empty first frame, a full buffer
+	// as a next frame, the rest as the last frame, one start and one stop
+	xfers = SIM_HAL_STATS.i2c_xfers;
+	dma = SIM_HAL_STATS.i2c_dma;
+	IIC_Start();
+	IIC_Send_Byte(0XA0);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	IIC_Send_Byte(0X00);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		IIC_Send_Byte(buf[i]);
+		CHECK_EQ(IIC_Wait_Ack(), 0);
+	}
+	IIC_Stop();
+	CHECK(memcmp(Eeprom.mem, buf, sizeof(buf)) == 0);
+	CHECK_EQ(SIM_HAL_STATS.i2c_xfers - xfers, 3);
+	CHECK_EQ(SIM_HAL_STATS.i2c_dma - dma, 2);
+	CHECK_EQ(SIM_HAL_STATS.i2c_probes, 0);
+	CHECK_EQ(SIM_I2C_STATS.starts, 1);
+	CHECK_EQ(SIM_I2C_STATS.stops, 1);
+
+	// one received frame per byte after a repeated start: I2C_FIRST_FRAME,
+	// then I2C_NEXT_FRAME without a start, I2C_LAST_FRAME nACKs and stops
+	xfers = SIM_HAL_STATS.i2c_xfers;
+	IIC_Start();
+	IIC_Send_Byte(0XA0);
+	IIC_Wait_Ack();
+	IIC_Send_Byte(0X00);
+	IIC_Wait_Ack();
+	IIC_Start();
+	IIC_Send_Byte(0XA1);
+	CHECK_EQ(IIC_Wait_Ack(), 0);
+	for (i = 0; i < sizeof(back); i++)
+	{
+		back[i] = IIC_Read_Byte(i + 1 < sizeof(back));
+	}
+	IIC_Stop();
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK_EQ(SIM_HAL_STATS.i2c_xfers - xfers, 2 + sizeof(back));
+	CHECK_EQ(SIM_I2C_STATS.starts, 3);
+	CHECK_EQ(SIM_I2C_STATS.restarts, 1);
+	CHECK_EQ(SIM_I2C_STATS.stops, 2);
+	CHECK_EQ(SIM_I2C_STATS.nacks, 0);
+
+	// the last byte acked: IIC_Stop sets CR1 STOP, the controller ends the
+	// byte the device started (MSB 0, it holds SDA low) with a nACK
+	Eeprom.mem[2] = 0X00;
+	stops = SIM_I2C_STATS.stops;
+	IIC_Start();
+	IIC_Send_Byte(0XA0);
+	IIC_Wait_Ack();
+	IIC_Send_Byte(0X00);
+	IIC_Wait_Ack();
+	IIC_Start();
+	IIC_Send_Byte(0XA1);
+	IIC_Wait_Ack();
+	back[0] = IIC_Read_Byte(1);
+	back[1] = IIC_Read_Byte(1);
+	IIC_Stop();
+	Sim_Sync(); // the register write takes effect at the next access
+	CHECK_EQ(SIM_I2C_STATS.stops - stops, 1);
+	CHECK_EQ(back[0], buf[0]);
+	CHECK_EQ(back[1], buf[1]);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X10, 1, back, 4), IIC_OK); // the bus is free
+	CHECK(memcmp(back, buf + 0X10, 4) == 0);
+	CHECK_EQ(SIM_I2C_STATS.stops - stops, 2);
+	Check_Timing();
+}
+
+#endif
+
+int main(void)
+{
+	Sim_Init();
+	Sim_I2C_Init(GPIOH, GPIO_PIN_4, GPIO_PIN_5, SIM_I2C_STANDARD);
+	Sim_I2C_Mem_Init(&Eeprom, 0XA0, 1);
+	Sim_I2C_Attach(&Eeprom.dev);
+	Sim_I2C_Mem_Init(&Logged, 0XA4, 2);
+	Logged_Mem = Logged.dev;
+	Logged.dev.start = Log_Start;
+	Logged.dev.write = Log_Write;
+	Logged.dev.read = Log_Read;
+	Logged.dev.stop = Log_Stop;
+	Sim_I2C_Attach(&Logged.dev);
+	IIC_Init();
+	Test_Speed(IIC_SPEED_STANDARD);
+	Test_Speed(IIC_SPEED_FAST);
+	Test_Speed(IIC_SPEED_FAST_PLUS);
+	Test_Burst();
+	Test_Primitives();
+	Test_Stretch();
+	Test_Busy();
+#if IIC_USE_HW
+	Test_Compat();
+#endif
+	Test_Buses();
+	Test_Device_Speed();
+	Test_Lock();
+	return TEST_DONE();
+}
@@ -0,0 +1,267 @@
+/*
+ * test_kv.c
+ *
+ * KV store recovery after power loss at random points of record appends,
+ * compaction and sector erases, lookup cost and writes per erase.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "w25qxx_cache.h"
+#include "kvstore.h"
+#include "setjmp.h"
+#include "string.h"
+
+#define KEYS 40
+#define CUTS 300
+
+static uint16_t Version[KEYS]; // 0: not set, odd: deleted after a set
+static jmp_buf Cut_Jmp;
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+static void Cut_Handler(void)
+{
+	longjmp(Cut_Jmp, 1);
+}
+
+static void Key(char *key, uint8_t k)
+{
+	sprintf(key, "key%02u", k);
+}
+
+/**
+ * @brief value of a key at a version, even versions are set
+ *
+ * @return length
+ *
+ */
+static uint16_t Value(uint8_t *buf, uint8_t k, uint16_t ver)
+{
+	uint16_t len = 4 + (k * 37 + ver * 11) % 200, i;
+	buf[0] = k;
+	buf[1] = (uint8_t)ver;
+	buf[2] = (uint8_t)(ver >> 8);
+	for (i = 3; i < len; i++)
+	{
+		buf[i] = (uint8_t)(k + ver * 3 + i);
+	}
+	return len;
+}
+
+/**
+ * @brief the version a key has in the store
+ *
+ * @return 0: a complete version, 1: a value that was never written
+ *
+ */
+static uint8_t Check(uint8_t k, uint16_t *ver)
+{
+	char key[8];
+	uint8_t buf[KV_VALUE_MAX], want[KV_VALUE_MAX];
+	uint16_t len;
+	Key(key, k);
+	if (KV_Get(key, buf, sizeof(buf), &len))
+	{
+		*ver = 0; // not set or deleted
+		return 0;
+	}
+	*ver = buf[1] | (buf[2] << 8);
+	return buf[0] != k || (*ver & 1) || len != Value(want, k, *ver) || memcmp(buf, want, len) != 0;
+}
+
+/**
+ * @brief the state a key should have: versions 2, 4, ... are values,
+ * odd versions mean deleted
+ *
+ */
+static uint8_t Same(uint16_t ver, uint16_t expected)
+{
+	return (expected & 1 || expected == 0) ? ver == 0 : ver == expected;
+}
+
+static void Check_All(void)
+{
+	uint8_t k;
+	uint16_t ver;
+	for (k = 0; k < KEYS; k++)
+	{
+		if (Check(k, &ver) || !Same(ver, Version[k]))
+		{
+			printf("%u: version %u, expected %u\r\n", k, ver, Version[k]);
+			Test_Failures++;
+		}
+	}
+}
+
+/**
+ * @brief set a key to its next value, or delete it now and then
+ *
+ */
+static void Update(uint8_t k)
+{
+	char key[8];
+	uint8_t buf[KV_VALUE_MAX];
+	uint16_t ver = Version[k], len;
+	Key(key, k);
+	if ((ver & 1) == 0 && ver && Rand() % 8 == 0)
+	{
+		if (KV_Delete(key) == 0)
+		{
+			Version[k] = ver + 1;
+		}
+	}
+	else
+	{
+		ver = (ver | 1) + 1;
+		len = Value(buf, k, ver);
+		CHECK_EQ(KV_Set(key, buf, len), 0);
+		Version[k] = ver;
+	}
+	KV_Poll();
+}
+
+static void Reboot(void)
+{
+	Sim_Flash_Cut(0, 0, NULL);
+	Sim_Power_Cycle();
+	W25QXX_Cache_Flush();
+	W25QXX_Init();
+	KV_Init();
+}
+
+/**
+ * @brief power loss at random flash operations, each followed by a reboot
+ *
+ */
+static void Test_Power_Loss(void)
+{
+	volatile uint8_t k = 0;
+	volatile uint32_t cut;
+	volatile uint16_t before = 0;
+	uint16_t ver;
+	uint32_t n;
+
+	for (cut = 0; cut < CUTS; cut++)
+	{
+		Sim_Flash_Cut(1 + Rand() % 30, cut + 1, Cut_Handler);
+		if (setjmp(Cut_Jmp) == 0)
+		{
+			for (n = 0; n < 100000; n++)
+			{
+				k = Rand() % KEYS;
+				before = Version[k];
+				Update(k);
+			}
+			CHECK(0); // the cut never came
+			return;
+		}
+		Reboot();
+
+		// the interrupted update is either complete or not there at all
+		CHECK_EQ(Check(k, &ver), 0);
+		if (!Same(ver, before))
+		{
+			Version[k] = (before | 1) + 1; // set, or deleted
+			if (!Same(ver, Version[k]))
+			{
+				Version[k] = before + 1;
+			}
+			CHECK(Same(ver, Version[k]));
+		}
+		else
+		{
+			Version[k] = before;
+		}
+		Check_All();
+		if (Test_Failures)
+		{
+			printf("after cut %lu, key %u\r\n", (unsigned long)cut, k);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief flash reads and time of KV_Get, records written per erase
+ *
+ */
+static void Test_Cost(void)
+{
+	char key[8];
+	uint8_t buf[KV_VALUE_MAX];
+	uint32_t reads, n, erases;
+	uint64_t t;
+	uint8_t k;
+
+	for (k = 0; k < KEYS; k++)
+	{
+		if (Version[k] == 0 || (Version[k] & 1))
+		{
+			Update(k);
+		}
+	}
+
+	reads = SIM_FLASH_STATS.reads;
+	t = Sim_Time;
+	for (k = 0; k < KEYS; k++)
+	{
+		Key(key, k);
+		CHECK_EQ(KV_Get(key, buf, sizeof(buf), NULL), 0);
+	}
+	printf("KV_Get hit: %lu flash reads, %lu ns per key\r\n", (unsigned long)(SIM_FLASH_STATS.reads - reads) / KEYS,
+		   (unsigned long)(SIM_NS(Sim_Time - t) / KEYS));
+	CHECK_EQ(SIM_FLASH_STATS.reads - reads, 2 * KEYS); // record header, then the value
+
+	reads = SIM_FLASH_STATS.reads;
+	for (k = 0; k < KEYS; k++)
+	{
+		sprintf(key, "none%02u", k);
+		CHECK_EQ(KV_Get(key, buf, sizeof(buf), NULL), 1);
+	}
+	printf("KV_Get miss: %lu flash reads for %u keys\r\n", (unsigned long)(SIM_FLASH_STATS.reads - reads), KEYS);
+	CHECK(SIM_FLASH_STATS.reads - reads <= 2); // only 16-bit hash collisions read flash
+
+	erases = SIM_FLASH_STATS.erases;
+	for (n = 0; n < 5000; n++)
+	{
+		Update(Rand() % KEYS);
+	}
+	erases = SIM_FLASH_STATS.erases - erases;
+	printf("%lu updates of %u keys, %lu erases, %lu updates per erase\r\n", (unsigned long)n, KEYS,
+		   (unsigned long)erases, (unsigned long)(erases ? n / erases : n));
+	CHECK(erases && n / erases >= 10);
+	Check_All();
+}
+
+int main(void)
+{
+	Sim_Init();
+	if (Sim_Flash_Open("test_kv.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	// every status poll is simulated, the typical busy times only cost
+	// run time here
+	SIM_FLASH_TIMING.page_program = 10;
+	SIM_FLASH_TIMING.sector_erase = 50;
+	W25QXX_Init();
+	KV_Format();
+	Test_Power_Loss();
+	if (Test_Failures == 0)
+	{
+		Test_Cost();
+	}
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,145 @@
+/*
+ * test_map.c
+ *
+ * Memory-mapped reads of the 32M image on QUADSPI: lookups in place
+ * against copies through W25QXX_Read, and memory-mapped mode left and
+ * re-entered once per write, erase and queued job while a mapping is held.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "hal.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define FONT    0X1F00000 // 95 glyphs of 36 bytes, above 16M
+#define GLYPH   36
+#define LOOKUPS 1000
+
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+/**
+ * @brief glyph lookups, copied and in place
+ *
+ */
+static void Test_Lookup(void)
+{
+	uint8_t glyph[GLYPH];
+	const uint8_t *font, *chip;
+	uint32_t i, off, commands, sum = 0, bad = 0;
+	uint64_t t;
+
+	chip = W25QXX_Map(0, SIM_FLASH_SIZE);
+	CHECK(chip != NULL);
+	CHECK(W25QXX_Map(SIM_FLASH_SIZE - 16, 17) == NULL); // past the end
+	font = W25QXX_Map(FONT, 95 * GLYPH);
+	CHECK(font == chip + FONT);
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps, 1); // nested mappings share one entry
+	if (chip == NULL || font == NULL)
+	{
+		return;
+	}
+	CHECK_EQ(chip[SIM_FLASH_SIZE - 1], Sim_Flash_Mem[SIM_FLASH_SIZE - 1]);
+
+	commands = SIM_FLASH_STATS.commands;
+	t = Sim_Time;
+	for (i = 0; i < LOOKUPS; i++)
+	{
+		off = (Rand() % 95) * GLYPH;
+		W25QXX_Read(glyph, FONT + off, GLYPH); // leaves memory-mapped mode for the read
+		bad += memcmp(glyph, font + off, GLYPH) != 0;
+	}
+	t = Sim_Time - t;
+	printf("W25QXX_Read: %lu commands, %lu ns per glyph; ", (unsigned long)(SIM_FLASH_STATS.commands - commands),
+		   (unsigned long)(SIM_NS(t) / LOOKUPS));
+	CHECK_EQ(bad, 0);
+
+	commands = SIM_FLASH_STATS.commands;
+	for (i = 0; i < LOOKUPS; i++)
+	{
+		off = (Rand() % 95) * GLYPH;
+		sum += font[off] + font[off + GLYPH - 1];
+	}
+	printf("mapped: %lu commands (checksum %lu)\r\n", (unsigned long)(SIM_FLASH_STATS.commands - commands),
+		   (unsigned long)sum);
+	CHECK_EQ(SIM_FLASH_STATS.commands, commands);
+	CHECK(Sim_QSPI_Mapped());
+	W25QXX_Unmap();
+	CHECK(Sim_QSPI_Mapped()); // the chip mapping is still held
+	W25QXX_Unmap();
+	CHECK(!Sim_QSPI_Mapped());
+	CHECK_EQ(SIM_HAL_STATS.qspi_errors, 0);
+}
+
+/**
+ * @brief writes and erases under a held mapping: one exit and re-entry
+ * each, never while BUSY, and the mapping shows the new data
+ *
+ */
+static void Test_Write(void)
+{
+	static uint8_t buf[1000];
+	const uint8_t *p = W25QXX_Map(0X100000, 0X10000);
+	uint32_t maps;
+
+	CHECK(p != NULL);
+	if (p == NULL)
+	{
+		return;
+	}
+	memset(buf, 0X3C, sizeof(buf));
+	maps = SIM_HAL_STATS.qspi_maps;
+	W25QXX_Write(buf, 0X100080, sizeof(buf)); // 5 pages
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps - maps, 1);
+	CHECK(memcmp(p + 0X80, buf, sizeof(buf)) == 0);
+
+	maps = SIM_HAL_STATS.qspi_maps;
+	W25QXX_Erase_Sector(0X100);
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps - maps, 1);
+	CHECK_EQ(p[0X80], 0XFF);
+
+	W25QXX_Write_NoCheck(buf, 0X102000, 16);
+	CHECK_EQ(p[0X2000], 0X3C);
+	maps = SIM_HAL_STATS.qspi_maps;
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(buf, 0X101000, 256, NULL, NULL), 0);
+	CHECK_EQ(W25QXX_Async_Erase_Sector(0X102, NULL, NULL), 0);
+	W25QXX_Async_Flush();
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps - maps, 2); // one per job
+	CHECK(memcmp(p + 0X1000, buf, 256) == 0);
+	CHECK_EQ(p[0X2000], 0XFF);
+
+	CHECK_EQ(SIM_HAL_STATS.qspi_busy_maps, 0);
+	CHECK_EQ(SIM_HAL_STATS.qspi_errors, 0);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+	W25QXX_Unmap();
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_map.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	for (i = 0; i < 95 * GLYPH; i++)
+	{
+		Sim_Flash_Mem[FONT + i] = (uint8_t)(i * 11 + 3);
+	}
+	Sim_Flash_Mem[SIM_FLASH_SIZE - 1] = 0X42;
+	W25QXX_Init();
+	Test_Lookup();
+	Test_Write();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,268 @@
+/*
+ * test_models.c
+ *
+ * The models themselves, driven through the unmodified drivers: flash
+ * identification, program/erase semantics and busy times, OLED display
+ * RAM and I2C register memory round trips.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "hal.h"
+#include "w25q_model.h"
+#include "ssd1306_model.h"
+#include "i2c_model.h"
+#include "w25qxx.h"
+#include "oled.h"
+#include "iic.h"
+#include "string.h"
+
+extern uint8_t OLED_GRAM[8][128];
+
+static void Test_Flash(void)
+{
+	uint8_t buf[300], back[300];
+	uint16_t i;
+	uint64_t t;
+
+	W25QXX_Init();
+	CHECK_EQ(W25QXX_TYPE, W25Q256);
+	CHECK_EQ(W25QXX_ReadSR(3) & 0X01, 0); // 3-byte mode kept
+
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = (uint8_t)(i * 7 + 1);
+	}
+	W25QXX_Write(buf, 0X10000F0, sizeof(buf)); // crosses a page, 4-byte commands
+	W25QXX_Read(back, 0X10000F0, sizeof(back));
+	CHECK(memcmp(buf, back, sizeof(buf)) == 0);
+	CHECK(memcmp(Sim_Flash_Mem + 0X10000F0, buf, sizeof(buf)) == 0);
+
+	// programming only clears bits
+	memset(buf, 0X0F, 16);
+	W25QXX_Write_NoCheck(buf, 0X2000, 16);
+	memset(buf, 0XF0, 16);
+	W25QXX_Write_NoCheck(buf, 0X2000, 16);
+	W25QXX_Read(back, 0X2000, 16);
+	CHECK_EQ(back[0], 0X00);
+	CHECK_EQ(back[15], 0X00);
+
+	// erase takes tSE on the virtual clock
+	t = Sim_Time;
+	W25QXX_Erase_Sector(2);
+	CHECK(SIM_NS(Sim_Time - t) >= SIM_FLASH_TIMING.sector_erase * 1000ULL);
+	CHECK(SIM_FLASH_STATS.busy_polls > 0);
+	W25QXX_Read(back, 0X2000, 16);
+	CHECK_EQ(back[0], 0XFF);
+	CHECK_EQ(SIM_FLASH_ERASE_COUNT[2], 1);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+#if W25QXX_USE_QSPI
+	CHECK(SIM_HAL_STATS.qspi_cmds > 0);
+	CHECK_EQ(SIM_HAL_STATS.qspi_errors, 0);
+#else
+	CHECK(SIM_HAL_STATS.spi_polled > 0);
+#endif
+}
+
+/**
+ * @brief the read command W25QXX_Init selected: opcode and data lines seen
+ * by the flash, and on QUADSPI the phases of the command register
+ *
+ */
+static void Test_Lanes(void)
+{
+	uint8_t back[100];
+
+	W25QXX_Read(back, 0X1000100, sizeof(back));
+	Sim_Sync(); // CS raised on PF6
+	CHECK(memcmp(back, Sim_Flash_Mem + 0X1000100, sizeof(back)) == 0);
+	CHECK_EQ(SIM_FLASH_LAST.bytes, sizeof(back));
+	CHECK_EQ(SIM_FLASH_LAST.lines, W25QXX_LANES);
+#if W25QXX_USE_QSPI
+	CHECK_EQ(W25QXX_LANES, W25QXX_QSPI_LANES);
+	CHECK_EQ(SIM_QSPI_LAST.NbData, sizeof(back));
+	CHECK_EQ(SIM_QSPI_LAST.AddressSize, QSPI_ADDRESS_32_BITS);
+	CHECK_EQ(SIM_HAL_STATS.qspi_floating, 0);
+	if (W25QXX_LANES == 4)
+	{
+		CHECK_EQ(SIM_FLASH_LAST.cmd, 0XEC); // Fast Read Quad I/O, 4-byte address
+		CHECK_EQ(SIM_QSPI_LAST.AddressMode, QSPI_ADDRESS_4_LINES);
+		CHECK_EQ(SIM_QSPI_LAST.AlternateByteMode, QSPI_ALTERNATE_BYTES_4_LINES);
+		CHECK_EQ(SIM_QSPI_LAST.AlternateBytes, 0XFF);
+		CHECK_EQ(SIM_QSPI_LAST.DummyCycles, 4);
+		CHECK_EQ(SIM_QSPI_LAST.DataMode, QSPI_DATA_4_LINES);
+		CHECK(Sim_Flash_QE());
+	}
+	else
+	{
+		CHECK_EQ(SIM_FLASH_LAST.cmd, 0X3C); // Fast Read Dual Output, 4-byte address
+		CHECK_EQ(SIM_QSPI_LAST.AddressMode, QSPI_ADDRESS_1_LINE);
+		CHECK_EQ(SIM_QSPI_LAST.AlternateByteMode, QSPI_ALTERNATE_BYTES_NONE);
+		CHECK_EQ(SIM_QSPI_LAST.DummyCycles, 8);
+		CHECK_EQ(SIM_QSPI_LAST.DataMode, QSPI_DATA_2_LINES);
+		CHECK(!Sim_Flash_QE()); // QE left alone
+	}
+#else
+	CHECK_EQ(W25QXX_LANES, 1);
+	CHECK_EQ(SIM_FLASH_LAST.cmd, 0X0C); // Fast Read, 4-byte address
+#endif
+}
+
+#if W25QXX_USE_QSPI && W25QXX_QSPI_LANES == 4
+/**
+ * @brief QE cannot be set: Dual Output reads, with IO2/IO3 held inactive
+ * as /WP and /HOLD by the pull-ups
+ *
+ */
+static void Test_QE_Fail(void)
+{
+	uint8_t back[100];
+
+	W25QXX_Write_Enable();
+	W25QXX_Write_SR(2, W25QXX_ReadSR(2) & ~0X02);
+	W25QXX_Wait_Busy();
+	CHECK(!Sim_Flash_QE());
+	Sim_Flash_Lock_SR(1);
+	W25QXX_Init();
+	CHECK(!Sim_Flash_QE());
+	CHECK_EQ(W25QXX_LANES, 2);
+	W25QXX_Read(back, 0X1000100, sizeof(back));
+	CHECK(memcmp(back, Sim_Flash_Mem + 0X1000100, sizeof(back)) == 0);
+	CHECK_EQ(SIM_FLASH_LAST.cmd, 0X3C);
+	CHECK_EQ(SIM_FLASH_LAST.lines, 2);
+	CHECK_EQ(SIM_QSPI_LAST.DummyCycles, 8);
+	CHECK_EQ(SIM_HAL_STATS.qspi_floating, 0);
+	CHECK_EQ(SIM_HAL_STATS.qspi_errors, 0);
+
+	Sim_Flash_Lock_SR(0);
+	W25QXX_Init();
+	CHECK_EQ(W25QXX_LANES, 4);
+	CHECK(Sim_Flash_QE());
+}
+#endif
+
+#if !W25QXX_USE_QSPI
+/**
+ * @brief the sector erase, page program and read W25QXX_Init selected, as
+ * the flash saw them at addr. A missing or extra dummy byte shifts the
+ * data read back.
+ *
+ */
+static void Check_Cmds(uint32_t addr, uint8_t erase, uint8_t program, uint8_t read, uint8_t abytes)
+{
+	uint8_t buf[32], back[32];
+	uint16_t i;
+
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = (uint8_t)(addr + i * 5);
+	}
+	CHECK_EQ(W25QXX_Async_Erase_Sector(addr / 4096, NULL, NULL), 0);
+	W25QXX_Async_Poll(); // write enable and the erase
+	Sim_Sync();
+	CHECK_EQ(SIM_FLASH_LAST.cmd, erase);
+	CHECK_EQ(SIM_FLASH_LAST.abytes, abytes);
+	CHECK_EQ(SIM_FLASH_LAST.addr, addr & ~0XFFFUL);
+	W25QXX_Async_Flush();
+
+	CHECK_EQ(W25QXX_Async_Write_NoCheck(buf, addr, sizeof(buf), NULL, NULL), 0);
+	W25QXX_Async_Poll();
+	Sim_Sync();
+	CHECK_EQ(SIM_FLASH_LAST.cmd, program);
+	CHECK_EQ(SIM_FLASH_LAST.abytes, abytes);
+	CHECK_EQ(SIM_FLASH_LAST.addr, addr);
+	CHECK_EQ(SIM_FLASH_LAST.bytes, sizeof(buf));
+	W25QXX_Async_Flush();
+
+	W25QXX_Read(back, addr, sizeof(back));
+	Sim_Sync();
+	CHECK_EQ(SIM_FLASH_LAST.cmd, read);
+	CHECK_EQ(SIM_FLASH_LAST.abytes, abytes);
+	CHECK_EQ(SIM_FLASH_LAST.addr, addr);
+	CHECK_EQ(SIM_FLASH_LAST.bytes, sizeof(back));
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+}
+
+/**
+ * @brief Fast Read and the 4-byte address commands of a W25Q256 below and
+ * above 16M, the 3-byte address ones of a W25Q128
+ *
+ */
+static void Test_Cmds(void)
+{
+	uint8_t back[32];
+
+	Check_Cmds(0X100, 0X21, 0X12, 0X0C, 4);
+	Check_Cmds(0XFFF0E0, 0X21, 0X12, 0X0C, 4);
+	Check_Cmds(0X1000000, 0X21, 0X12, 0X0C, 4);
+	Check_Cmds(0X1FFF0E0, 0X21, 0X12, 0X0C, 4);
+	W25QXX_Read(back, 0XFFFFF0, sizeof(back)); // one command across 16M
+	Sim_Sync();
+	CHECK_EQ(SIM_FLASH_LAST.addr, 0XFFFFF0);
+	CHECK_EQ(SIM_FLASH_LAST.bytes, sizeof(back));
+	CHECK(memcmp(back, Sim_Flash_Mem + 0XFFFFF0, sizeof(back)) == 0);
+	CHECK_EQ(W25QXX_ReadSR(3) & 0X01, 0); // ADS
+
+	Sim_Flash_Set_ID(0X17);
+	W25QXX_Init();
+	CHECK_EQ(W25QXX_TYPE, W25Q128);
+	Check_Cmds(0X100, 0X20, 0X02, 0X0B, 3);
+	Check_Cmds(0XFFF0E0, 0X20, 0X02, 0X0B, 3);
+	Sim_Flash_Set_ID(0X18);
+	W25QXX_Init();
+	CHECK_EQ(W25QXX_TYPE, W25Q256);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+#endif
+
+static void Test_OLED(void)
+{
+	Sim_SSD1306_Init(SIM_SSD1306_8080);
+	OLED_Init();
+	OLED_ShowString(0, 0, (const uint8_t *)"HOST", 16);
+	OLED_Fill(100, 40, 120, 60, 1);
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	CHECK_EQ(SIM_SSD1306_STATS.violations, 0);
+	CHECK_EQ(Sim_SSD1306_Save_PGM("test_models.pgm"), 0);
+}
+
+static void Test_IIC(void)
+{
+	static Sim_I2C_Mem eeprom;
+	uint8_t buf[8] = {1, 2, 3, 4, 5, 6, 7, 8}, back[8];
+
+	Sim_I2C_Init(GPIOH, GPIO_PIN_4, GPIO_PIN_5, SIM_I2C_STANDARD);
+	Sim_I2C_Mem_Init(&eeprom, 0XA0, 1);
+	Sim_I2C_Attach(&eeprom.dev);
+	IIC_Init();
+	CHECK_EQ(IIC_Write_Reg(0XA0, 0X10, 1, buf, sizeof(buf)), IIC_OK);
+	CHECK(memcmp(eeprom.mem + 0X10, buf, sizeof(buf)) == 0);
+	CHECK_EQ(IIC_Read_Reg(0XA0, 0X10, 1, back, sizeof(back)), IIC_OK);
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK_EQ(IIC_Write(0XB0, buf, 1), IIC_ERR_NACK); // nobody there
+	CHECK_EQ(SIM_I2C_STATS.violations, 0);
+}
+
+int main(void)
+{
+	Sim_Init();
+	if (Sim_Flash_Open("test_models.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	Test_Flash();
+	Test_Lanes();
+#if !W25QXX_USE_QSPI
+	Test_Cmds();
+#endif
+#if W25QXX_USE_QSPI && W25QXX_QSPI_LANES == 4
+	Test_QE_Fail();
+#endif
+	Test_OLED();
+	Test_IIC();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
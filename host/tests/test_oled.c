@@ -0,0 +1,578 @@
+/*
+ * test_oled.c
+ *
+ * The bus writer of oled.c decoded by the SSD1306 model, on the 8080 bus
+ * by default, SPI or IIC with OLED_MODE: every data value through the pin
+ * mapping, the SSD1306 write cycle timing, the DC or control byte framing
+ * and the bytes and data bursts a full and a partial refresh send. Glyphs
+ * and rectangles against the OLED_DrawPoint loops they replaced, and the
+ * text console.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "ssd1306_model.h"
+#include "i2c_model.h"
+#include "oled.h"
+#include "iic.h"
+#include "oledfont.h"
+#include "string.h"
+
+extern uint8_t OLED_GRAM[8][128];
+
+static uint32_t Seed = 1;
+
+static uint32_t Rand(void)
+{
+	Seed = Seed * 1103515245 + 12345;
+	return Seed >> 8;
+}
+
+// the model's front end and the fastest time a display byte may take
+static const uint8_t Bus = OLED_MODE == OLED_SPI ? SIM_SSD1306_SPI : OLED_MODE == OLED_IIC ? SIM_SSD1306_IIC : SIM_SSD1306_8080;
+static const uint32_t Byte_NS = OLED_MODE == OLED_SPI ? 8 * 100 : OLED_MODE == OLED_IIC ? 9 * 2500 : 300;
+
+static void Check_Timing(void)
+{
+	static const Sim_SSD1306_Timing spec[2] = {{300, 60, 60, 40}, {100, 20, 20, 15}};
+	const Sim_SSD1306_Timing *s = &spec[Bus == SIM_SSD1306_SPI];
+
+	CHECK_EQ(SIM_SSD1306_STATS.violations, 0);
+	if (Bus == SIM_SSD1306_IIC)
+	{
+		CHECK_EQ(SIM_I2C_STATS.violations, 0);
+		CHECK_EQ(SIM_I2C_STATS.nacks, 0);
+		return;
+	}
+	CHECK(SIM_SSD1306_MIN.cycle >= s->cycle && SIM_SSD1306_MIN.cycle != 0XFFFFFFFF);
+	CHECK(SIM_SSD1306_MIN.low >= s->low && SIM_SSD1306_MIN.low != 0XFFFFFFFF);
+	CHECK(SIM_SSD1306_MIN.high >= s->high && SIM_SSD1306_MIN.high != 0XFFFFFFFF);
+	CHECK(SIM_SSD1306_MIN.setup >= s->setup && SIM_SSD1306_MIN.setup != 0XFFFFFFFF);
+}
+
+/**
+ * @brief a frame holding every byte value, sent in full
+ *
+ */
+static void Test_Frame(void)
+{
+	uint32_t data, commands, bursts;
+	uint64_t t;
+	uint8_t x, y, v;
+
+	for (y = 0; y < 64; y++)
+	{
+		for (x = 0; x < 128; x++)
+		{
+			v = (uint8_t)((y / 8) * 128 + x);
+			OLED_DrawPoint(x, y, (v >> (y % 8)) & 1);
+		}
+	}
+	data = SIM_SSD1306_STATS.data;
+	commands = SIM_SSD1306_STATS.commands;
+	bursts = SIM_SSD1306_STATS.bursts;
+	t = Sim_Time;
+	OLED_Refresh_Gram();
+	t = Sim_Time - t;
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+#if OLED_HORIZONTAL_ADDR
+	CHECK_EQ(SIM_SSD1306_STATS.data - data, 1024);
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 6); // one window
+	CHECK_EQ(SIM_SSD1306_STATS.bursts - bursts, 1);
+#else
+	// column 0 of pages 0, 2, 4 and 6 holds 0 already, those spans start at 1
+	CHECK_EQ(SIM_SSD1306_STATS.data - data, 1024 - 4);
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 8 * 3);
+	CHECK_EQ(SIM_SSD1306_STATS.bursts - bursts, 8);
+#endif
+	CHECK(SIM_NS(t) < 1024 * 2ULL * Byte_NS);
+	printf("full frame: %lu us, %lu ns per byte", (unsigned long)(SIM_NS(t) / 1000), (unsigned long)(SIM_NS(t) / 1024));
+	if (Bus != SIM_SSD1306_IIC)
+	{
+		printf(", %s cycle min %lu ns", Bus == SIM_SSD1306_SPI ? "SCLK" : "WR", (unsigned long)SIM_SSD1306_MIN.cycle);
+	}
+	printf("\r\n");
+	Check_Timing();
+}
+
+/**
+ * @brief a few pixels on separate pages, then a refresh with nothing new
+ *
+ */
+static void Test_Partial(void)
+{
+	uint32_t data, commands;
+
+	OLED_DrawPoint(5, 3, 1);
+	OLED_DrawPoint(6, 30, 1);
+	OLED_DrawPoint(7, 60, 1);
+	data = SIM_SSD1306_STATS.data;
+	commands = SIM_SSD1306_STATS.commands;
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	CHECK_EQ(SIM_SSD1306_STATS.data - data, 3);
+#if OLED_HORIZONTAL_ADDR
+	// a window per page beats the 3 x 8 box
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 3 * 6);
+#else
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 3 * 3);
+#endif
+	data = SIM_SSD1306_STATS.data;
+	OLED_Refresh_Gram();
+	CHECK_EQ(SIM_SSD1306_STATS.data, data);
+
+	// opposite corners: 2 bytes, not a 128 x 8 box
+	OLED_DrawPoint(0, 0, 1);
+	OLED_DrawPoint(127, 63, 0);
+	data = SIM_SSD1306_STATS.data;
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	CHECK_EQ(SIM_SSD1306_STATS.data - data, 2);
+
+	// a block: the box has no unchanged byte, one window
+	data = SIM_SSD1306_STATS.data;
+	commands = SIM_SSD1306_STATS.commands;
+	OLED_Fill(10, 16, 20, 47, 1);
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	CHECK_EQ(SIM_SSD1306_STATS.data - data, 11 * 4);
+#if OLED_HORIZONTAL_ADDR
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 6);
+#else
+	CHECK_EQ(SIM_SSD1306_STATS.commands - commands, 4 * 3);
+#endif
+
+	OLED_ShowString(0, 16, (const uint8_t *)"OLED BUS", 16);
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	CHECK_EQ(Sim_SSD1306_Pixel(7, 60), 1);
+	Check_Timing();
+}
+
+static uint8_t Get(uint8_t x, uint8_t y)
+{
+	return (OLED_GRAM[7 - y / 8][x] >> (7 - y % 8)) & 1;
+}
+
+/**
+ * @brief random updates, each followed by a refresh that writes every
+ * changed byte once and nothing outside the changed spans but what the
+ * window of horizontal addressing takes in
+ *
+ */
+static void Test_Dirty(void)
+{
+	static uint8_t flipped[64][128];
+	uint8_t lo[8], hi[8], start, end, first, last, page, in, x, y, n, i;
+	uint16_t spans, pages, col, bad = 0;
+	uint32_t round, data, sent = 0;
+	char text[8];
+
+	for (round = 0; round < 300; round++)
+	{
+		if (round % 4 == 3)
+		{
+			// text, the glyphs of a string do not overlap
+			for (i = 0; i < 4; i++)
+			{
+				text[i] = (char)(' ' + Rand() % 95);
+			}
+			text[4] = 0;
+			OLED_ShowString(Rand() % 100, Rand() % 48, (const uint8_t *)text, 12);
+		}
+		else
+		{
+			// pixels flipped once each, so no byte changes back, and
+			// pixels drawn as they are
+			memset(flipped, 0, sizeof(flipped));
+			n = 1 + Rand() % (round % 4 == 0 ? 3 : 40);
+			for (i = 0; i < n; i++)
+			{
+				x = Rand() % 128;
+				y = Rand() % 64;
+				if (!flipped[y][x])
+				{
+					flipped[y][x] = 1;
+					OLED_DrawPoint(x, y, !Get(x, y));
+				}
+				x = Rand() % 128;
+				y = Rand() % 64;
+				if (!flipped[y][x])
+				{
+					OLED_DrawPoint(x, y, Get(x, y)); // no change, nothing to send
+				}
+			}
+		}
+		start = 0XFF;
+		end = 0;
+		first = 0XFF;
+		last = 0;
+		spans = pages = 0;
+		for (page = 0; page < 8; page++)
+		{
+			lo[page] = 0XFF;
+			hi[page] = 0;
+			for (col = 0; col < 128; col++)
+			{
+				if (OLED_GRAM[page][col] != SIM_SSD1306_RAM[page][col])
+				{
+					lo[page] = lo[page] == 0XFF ? col : lo[page];
+					hi[page] = col;
+				}
+			}
+			if (lo[page] == 0XFF)
+			{
+				continue;
+			}
+			first = first == 0XFF ? page : first;
+			last = page;
+			start = lo[page] < start ? lo[page] : start;
+			end = hi[page] > end ? hi[page] : end;
+			spans += hi[page] - lo[page] + 1;
+			pages++;
+		}
+		memset(SIM_SSD1306_WRITES, 0, sizeof(SIM_SSD1306_WRITES));
+		data = SIM_SSD1306_STATS.data;
+		OLED_Refresh_Gram();
+		sent += SIM_SSD1306_STATS.data - data;
+		for (page = 0; page < 8; page++)
+		{
+			for (col = 0; col < 128; col++)
+			{
+				in = lo[page] <= col && col <= hi[page];
+				if (OLED_HORIZONTAL_ADDR && pages != 0 &&
+					!(pages > 1 && (last - first + 1) * (end - start + 1) > spans + 6 * (pages - 1)))
+				{
+					in = first <= page && page <= last && start <= col && col <= end; // one window
+				}
+				bad += SIM_SSD1306_WRITES[page][col] != in;
+			}
+		}
+		bad += memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) != 0;
+	}
+	printf("300 updates: %lu data bytes, full frames would take %lu\r\n", (unsigned long)sent,
+		   (unsigned long)(300 * 1024));
+	CHECK_EQ(bad, 0);
+	Check_Timing();
+}
+
+/**
+ * @brief OLED_ShowChar as the OLED_DrawPoint loop the blitter replaced
+ *
+ */
+static void Ref_Char(uint8_t x, uint8_t y, uint8_t chr, uint8_t size, uint8_t mode)
+{
+	const unsigned char *glyph = size == 12 ? asc2_1206[chr - ' '] : size == 16 ? asc2_1608[chr - ' '] : asc2_2412[chr - ' '];
+	uint8_t csize = (size / 8 + ((size % 8) ? 1 : 0)) * (size / 2);
+	uint8_t y0 = y, temp, t, t1;
+	for (t = 0; t < csize; t++)
+	{
+		temp = glyph[t];
+		for (t1 = 0; t1 < 8; t1++)
+		{
+			OLED_DrawPoint(x, y, (temp & 0X80) ? mode : !mode);
+			temp <<= 1;
+			y++;
+			if ((y - y0) == size)
+			{
+				y = y0;
+				x++;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief every glyph of the three fonts at every y, aligned to a page or
+ * not and past the bottom, at random x up to past the right edge, in both
+ * modes, over random GRAM
+ *
+ */
+static void Test_Glyphs(void)
+{
+	static const uint8_t sizes[3] = {12, 16, 24};
+	static uint8_t back[8][128], got[8][128];
+	uint32_t bad = 0, i;
+	uint8_t s, chr, y, x, mode;
+
+	for (i = 0; i < sizeof(back); i++)
+	{
+		back[i / 128][i % 128] = (uint8_t)Rand();
+	}
+	for (s = 0; s < 3; s++)
+	{
+		for (chr = ' '; chr <= '~'; chr++)
+		{
+			for (y = 0; y < 64; y++)
+			{
+				x = Rand() % 128;
+				for (mode = 0; mode < 2; mode++)
+				{
+					memcpy(OLED_GRAM, back, sizeof(back));
+					OLED_ShowChar(x, y, chr, sizes[s], mode);
+					memcpy(got, OLED_GRAM, sizeof(got));
+					memcpy(OLED_GRAM, back, sizeof(back));
+					Ref_Char(x, y, chr, sizes[s], mode);
+					bad += memcmp(got, OLED_GRAM, sizeof(got)) != 0;
+				}
+			}
+		}
+	}
+	CHECK_EQ(bad, 0);
+
+	// the marks of the blitter bring the display up to date
+	OLED_Clear();
+	OLED_ShowString(3, 5, (const uint8_t *)"Glyph 12", 12);
+	OLED_ShowString(1, 19, (const uint8_t *)"Glyph 16", 16);
+	OLED_ShowString(0, 37, (const uint8_t *)"Gly 24", 24);
+	OLED_ShowChar(120, 50, 'W', 24, 0);
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	Check_Timing();
+}
+
+/**
+ * @brief a rectangle operation against the OLED_DrawPoint loop it
+ * replaces, from the same GRAM, then a refresh that must leave the
+ * display RAM equal to GRAM
+ *
+ * @param
+ * op: 0/1: OLED_Fill clear/set, 2: OLED_Clear_Rect, 3: OLED_Invert_Rect,
+ *     4/5: OLED_DrawHLine/OLED_DrawVLine (x2 or y2 unused), t: their dot
+ *
+ * @return 0: same pixels, 1: they differ
+ *
+ */
+static uint8_t Rect(uint8_t op, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t t)
+{
+	static uint8_t before[8][128], after[8][128];
+	int x, y, xe = op == 5 ? x1 : x2, ye = op == 4 ? y1 : y2;
+
+	memcpy(before, OLED_GRAM, sizeof(OLED_GRAM));
+	switch (op)
+	{
+	case 0:
+	case 1:
+		OLED_Fill(x1, y1, x2, y2, op);
+		break;
+	case 2:
+		OLED_Clear_Rect(x1, y1, x2, y2);
+		break;
+	case 3:
+		OLED_Invert_Rect(x1, y1, x2, y2);
+		break;
+	case 4:
+		OLED_DrawHLine(x1, x2, y1, t);
+		break;
+	default:
+		OLED_DrawVLine(x1, y1, y2, t);
+		break;
+	}
+	OLED_Refresh_Gram(); // every changed byte was marked
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	memcpy(after, OLED_GRAM, sizeof(OLED_GRAM));
+
+	memcpy(OLED_GRAM, before, sizeof(OLED_GRAM));
+	for (x = x1; x <= xe && x < 128; x++)
+	{
+		for (y = y1; y <= ye && y < 64; y++)
+		{
+			OLED_DrawPoint(x, y, op == 3 ? !Get(x, y) : op < 2 ? op : op == 2 ? 0 : t);
+		}
+	}
+	return memcmp(after, OLED_GRAM, sizeof(OLED_GRAM)) != 0;
+}
+
+/**
+ * @brief OLED_Fill, OLED_Clear_Rect, OLED_Invert_Rect and the lines on
+ * partial top and bottom pages, inside one page, past the screen edge and
+ * with reversed coordinates (nothing drawn), then at random
+ *
+ */
+static void Test_Rects(void)
+{
+	static const uint8_t cases[][4] = {
+		{3, 5, 120, 60},  // partial top and bottom pages
+		{0, 8, 127, 15},  // one whole page
+		{10, 9, 20, 13},  // inside one page
+		{10, 7, 20, 8},	  // one row of two pages
+		{0, 0, 127, 63},  // the screen
+		{100, 50, 200, 90}, // past the edges
+		{20, 30, 10, 40}, // reversed x
+		{10, 40, 20, 30}, // reversed y
+	};
+	uint32_t i, bad = 0, n = Bus == SIM_SSD1306_IIC ? 100 : 1000;
+	uint8_t op;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		for (op = 0; op < 6; op++)
+		{
+			bad += Rect(op, cases[i][0], cases[i][1], cases[i][2], cases[i][3], op & 1);
+			bad += Rect(op, cases[i][0], cases[i][1], cases[i][2], cases[i][3], !(op & 1));
+		}
+	}
+	CHECK_EQ(bad, 0);
+	for (i = 0; i < n; i++)
+	{
+		bad += Rect(Rand() % 6, Rand() % 136, Rand() % 70, Rand() % 136, Rand() % 70, Rand() & 1);
+	}
+	CHECK_EQ(bad, 0);
+	OLED_Refresh_Gram();
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	Check_Timing();
+}
+
+/**
+ * @brief the glass in drawing coordinates, [y][x]. OLED_DrawPoint puts y
+ * on RAM line 63 - y and A1 mirrors the columns: the module shows the
+ * controller's glass turned by 180 degrees.
+ *
+ */
+static void Glass(uint8_t g[64][128])
+{
+	uint8_t x, y;
+	for (y = 0; y < 64; y++)
+	{
+		for (x = 0; x < 128; x++)
+		{
+			g[y][x] = Sim_SSD1306_Pixel(127 - x, 63 - y);
+		}
+	}
+}
+
+// the console as the test expects it: every line written, '\r' overwrites
+static char Con_Lines[64][24];
+static uint8_t Con_Line, Con_Col, Con_Size;
+
+static void Con_Feed(const char *p)
+{
+	uint8_t per = 128 / (Con_Size / 2);
+	for (; *p; p++)
+	{
+		if (*p == '\n' || (*p != '\r' && Con_Col == per)) // wraps at the next char
+		{
+			Con_Line++;
+			Con_Col = 0;
+		}
+		if (*p == '\r')
+		{
+			Con_Col = 0;
+		}
+		else if (*p != '\n')
+		{
+			Con_Lines[Con_Line][Con_Col++] = *p;
+		}
+	}
+}
+
+/**
+ * @brief the glass shows the newest lines from the top, drawn from the
+ * font tables
+ *
+ */
+static uint8_t Con_Check(void)
+{
+	static uint8_t glass[64][128], want[64][128];
+	uint8_t pitch = Con_Size > 16 ? 32 : 16, rows = 64 / pitch, bpc = (Con_Size + 7) / 8;
+	uint8_t first = Con_Line + 1 > rows ? Con_Line + 1 - rows : 0, i, j, t, k;
+	const unsigned char *glyph;
+	uint32_t bits;
+	const char *p;
+
+	memset(want, 0, sizeof(want));
+	for (i = 0; first + i <= Con_Line; i++)
+	{
+		for (p = Con_Lines[first + i], j = 0; p[j]; j++)
+		{
+			glyph = Con_Size == 12 ? asc2_1206[p[j] - ' '] : Con_Size == 16 ? asc2_1608[p[j] - ' '] : asc2_2412[p[j] - ' '];
+			for (t = 0; t < Con_Size / 2; t++)
+			{
+				for (bits = 0, k = 0; k < bpc; k++)
+				{
+					bits = (bits << 8) | *glyph++;
+				}
+				for (k = 0; k < Con_Size; k++)
+				{
+					want[i * pitch + k][j * (Con_Size / 2) + t] = (bits >> (bpc * 8 - 1 - k)) & 1;
+				}
+			}
+		}
+	}
+	Glass(glass);
+	return memcmp(glass, want, sizeof(glass)) == 0;
+}
+
+/**
+ * @brief console output of one font size: overwrite, wrap, and enough new
+ * lines at the bottom for the start line to go round 64 more than once
+ *
+ */
+static void Console(uint8_t size)
+{
+	static const char *const text = "first\n\rover\rOV\nwrap: 0123456789abcdefghijklmnopqrstuvwxyz\nlast";
+	uint8_t pitch = size > 16 ? 32 : 16, i;
+	uint32_t data, commands;
+	char line[8] = "\nline?";
+
+	memset(Con_Lines, 0, sizeof(Con_Lines));
+	Con_Line = Con_Col = 0;
+	Con_Size = size;
+	OLED_Console_Init(size);
+	OLED_Console_Puts((const uint8_t *)text);
+	Con_Feed(text);
+	CHECK(Con_Check());
+
+	for (i = 0; i < 2 * 64 / pitch + 1; i++)
+	{
+		// the new row is cleared and sent, nothing else
+		data = SIM_SSD1306_STATS.data;
+		commands = SIM_SSD1306_STATS.commands;
+		OLED_Console_Puts((const uint8_t *)"\n");
+		Con_Feed("\n");
+		CHECK_EQ(SIM_SSD1306_STATS.data - data, 128 * pitch / 8);
+		CHECK(SIM_SSD1306_STATS.commands - commands <= 3 * pitch / 8 + 1); // window or page addresses, start line
+		line[5] = 'A' + i;
+		OLED_Console_Puts((const uint8_t *)line + 1);
+		Con_Feed(line + 1);
+		CHECK(Con_Check());
+	}
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+}
+
+/**
+ * @brief the text console in each font size
+ *
+ */
+static void Test_Console(void)
+{
+	Console(12);
+	Console(16);
+	Console(24);
+	OLED_Console_Init(16); // start line 0 for the other tests
+	Check_Timing();
+}
+
+int main(void)
+{
+	Sim_Init();
+	if (Bus == SIM_SSD1306_IIC)
+	{
+		Sim_I2C_Init(GPIOH, GPIO_PIN_4, GPIO_PIN_5, SIM_I2C_FAST);
+	}
+	Sim_SSD1306_Init(Bus);
+	OLED_Init();
+	if (Bus == SIM_SSD1306_IIC)
+	{
+		IIC_Set_Speed(IIC_SPEED_FAST);
+	}
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+	Test_Frame();
+	Test_Partial();
+	Test_Dirty();
+	Test_Glyphs();
+	Test_Rects();
+	Test_Console();
+	return TEST_DONE();
+}
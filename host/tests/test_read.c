@@ -0,0 +1,301 @@
+/*
+ * test_read.c
+ *
+ * The DMA threshold of SPI5 transfers, W25QXX_Read_Multi merging and the
+ * commands it issues per transport (a chain in continuous read mode on
+ * QUADSPI), a random glyph benchmark, leaving continuous read mode after
+ * memory-mapped reads, and burst wrap on QUADSPI.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "hal.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "spi.h"
+#include "string.h"
+
+#define BASE   0X30000
+#define GLYPH  36 // 12x24 ASCII glyph of oledfont.h
+#define GLYPHS 40 // a line of text
+
+static uint8_t Pattern(uint32_t addr)
+{
+	return (uint8_t)(addr * 13 + (addr >> 8));
+}
+
+static uint8_t Same(const uint8_t *buf, uint32_t addr, uint16_t len)
+{
+	uint16_t i;
+	for (i = 0; i < len; i++)
+	{
+		if (buf[i] != Pattern(addr + i))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#if !W25QXX_USE_QSPI
+/**
+ * @brief SPI5 transfers of SPI5_DMA_MIN_SIZE bytes and more go by DMA,
+ * shorter ones polled, and the driver never hands DMA a buffer of its own
+ * stack
+ *
+ */
+static void Test_DMA(void)
+{
+	static uint8_t buf[300];
+	const uint16_t sizes[] = {1, SPI5_DMA_MIN_SIZE - 1, SPI5_DMA_MIN_SIZE, SPI5_DMA_MIN_SIZE + 1, 256};
+	uint32_t polled, dma, stack, i;
+	uint16_t len;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		polled = SIM_HAL_STATS.spi_polled;
+		dma = SIM_HAL_STATS.spi_dma;
+		SPI5_Transmit(buf, sizes[i]);
+		SPI5_Receive(buf, sizes[i]);
+		SPI5_TransmitReceive(buf, buf, sizes[i]);
+		CHECK_EQ(SIM_HAL_STATS.spi_dma - dma, sizes[i] >= SPI5_DMA_MIN_SIZE ? 3 : 0);
+		CHECK_EQ(SIM_HAL_STATS.spi_polled - polled, sizes[i] >= SPI5_DMA_MIN_SIZE ? 0 : 3);
+	}
+	polled = SIM_HAL_STATS.spi_polled;
+	dma = SIM_HAL_STATS.spi_dma;
+	SPI5_Transmit(buf, 0);
+	SPI5_Receive(buf, 0);
+	SPI5_TransmitReceive(buf, buf, 0);
+	CHECK_EQ(SIM_HAL_STATS.spi_polled + SIM_HAL_STATS.spi_dma, polled + dma);
+
+	// 0X0C, 4 address bytes and the dummy byte ahead of the data, in one
+	// transfer up to 16 bytes
+	stack = SIM_HAL_STATS.dma_stack;
+	for (len = 1; len <= 2 * SPI5_DMA_MIN_SIZE; len++)
+	{
+		polled = SIM_HAL_STATS.spi_polled;
+		dma = SIM_HAL_STATS.spi_dma;
+		W25QXX_Read(buf, BASE + len, len);
+		CHECK(Same(buf, BASE + len, len));
+		if (6 + len <= 16) // one transfer
+		{
+			CHECK_EQ(SIM_HAL_STATS.spi_dma - dma, 6 + len >= SPI5_DMA_MIN_SIZE);
+			CHECK_EQ(SIM_HAL_STATS.spi_polled - polled, 6 + len < SPI5_DMA_MIN_SIZE);
+		}
+		else
+		{
+			CHECK_EQ(SIM_HAL_STATS.spi_dma - dma, len >= SPI5_DMA_MIN_SIZE);
+			CHECK_EQ(SIM_HAL_STATS.spi_polled - polled, 1 + (len < SPI5_DMA_MIN_SIZE));
+		}
+	}
+	for (len = 1; len <= 2 * SPI5_DMA_MIN_SIZE; len++)
+	{
+		memset(buf, (uint8_t)len, len);
+		dma = SIM_HAL_STATS.spi_dma;
+		W25QXX_Write_NoCheck(buf, 0X80000 + len * 64, len);
+		CHECK_EQ(SIM_HAL_STATS.spi_dma - dma, 5 + len <= 16 ? 5 + len >= SPI5_DMA_MIN_SIZE : len >= SPI5_DMA_MIN_SIZE);
+		CHECK_EQ(Sim_Flash_Mem[0X80000 + len * 64 + len - 1], (uint8_t)len);
+	}
+	CHECK_EQ(SIM_HAL_STATS.dma_stack, stack);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+#endif
+
+/**
+ * @brief requests out of order: a gap of W25QXX_MULTI_GAP merges, one more
+ * byte does not, an overlap starts a new read, an empty request is skipped
+ *
+ */
+static void Test_Multi(void)
+{
+	static uint8_t a[10], b[40], c[8], d[4], e[1];
+	W25QXX_Read_Req req[5];
+	uint32_t reads, bytes, stack;
+	uint16_t n;
+	uint64_t t, t_multi;
+
+	req[0].addr = BASE + 10 + W25QXX_MULTI_GAP + 40 + W25QXX_MULTI_GAP + 1; // c: one byte too far
+	req[0].buf = c;
+	req[0].len = sizeof(c);
+	req[1].addr = BASE + 10 + W25QXX_MULTI_GAP; // b: merged with a
+	req[1].buf = b;
+	req[1].len = sizeof(b);
+	req[2].addr = req[0].addr + 2; // d: overlaps c
+	req[2].buf = d;
+	req[2].len = sizeof(d);
+	req[3].addr = BASE; // a
+	req[3].buf = a;
+	req[3].len = sizeof(a);
+	req[4].addr = BASE + 1;
+	req[4].buf = e;
+	req[4].len = 0;
+
+	reads = SIM_FLASH_STATS.reads;
+	bytes = SIM_FLASH_STATS.bytes_read;
+	stack = SIM_HAL_STATS.dma_stack;
+	t = Sim_Time;
+	n = W25QXX_Read_Multi(req, 5);
+	t_multi = Sim_Time - t;
+	CHECK_EQ(SIM_FLASH_STATS.reads - reads, n);
+	CHECK_EQ(SIM_HAL_STATS.dma_stack, stack);
+	CHECK_EQ(n, 3); // a+b, c, d
+	CHECK_EQ(SIM_FLASH_STATS.bytes_read - bytes, 10 + W25QXX_MULTI_GAP + 40 + 8 + 4);
+	for (n = 1; n < 5; n++)
+	{
+		CHECK(req[n - 1].addr <= req[n].addr); // sorted in place
+	}
+	CHECK(Same(a, BASE, sizeof(a)));
+	CHECK(Same(b, BASE + 10 + W25QXX_MULTI_GAP, sizeof(b)));
+	CHECK(Same(c, req[3].addr, sizeof(c)));
+	CHECK(Same(d, req[4].addr, sizeof(d)));
+
+	// the same requests one W25QXX_Read each
+	t = Sim_Time;
+	for (n = 0; n < 5; n++)
+	{
+		if (req[n].len)
+		{
+			W25QXX_Read(req[n].buf, req[n].addr, req[n].len);
+		}
+	}
+	CHECK(t_multi <= Sim_Time - t);
+}
+
+/**
+ * @brief a line of random characters from a 95-glyph font table, one
+ * W25QXX_Read per glyph against one W25QXX_Read_Multi for the line
+ *
+ */
+static void Test_Glyphs(void)
+{
+	static uint8_t glyph[GLYPHS][GLYPH];
+	W25QXX_Read_Req req[GLYPHS];
+	uint32_t reads, cmds, single_cmds, seed = 7;
+	uint16_t i, n;
+	uint64_t t, t_single;
+
+	for (i = 0; i < GLYPHS; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		req[i].addr = BASE + ((seed >> 16) % 95) * GLYPH;
+		req[i].buf = glyph[i];
+		req[i].len = GLYPH;
+	}
+	reads = SIM_FLASH_STATS.reads;
+	cmds = SIM_HAL_STATS.qspi_cmds;
+	t = Sim_Time;
+	for (i = 0; i < GLYPHS; i++)
+	{
+		W25QXX_Read(req[i].buf, req[i].addr, req[i].len);
+	}
+	t_single = Sim_Time - t;
+	single_cmds = SIM_HAL_STATS.qspi_cmds - cmds;
+	printf("%u glyphs, W25QXX_Read: %lu commands %lu ns, ", GLYPHS, (unsigned long)(SIM_FLASH_STATS.reads - reads),
+		   (unsigned long)SIM_NS(t_single));
+
+	memset(glyph, 0, sizeof(glyph));
+	reads = SIM_FLASH_STATS.reads;
+	cmds = SIM_HAL_STATS.qspi_cmds;
+	t = Sim_Time;
+	n = W25QXX_Read_Multi(req, GLYPHS);
+	t = Sim_Time - t;
+	printf("W25QXX_Read_Multi: %lu commands %lu ns\r\n", (unsigned long)n, (unsigned long)SIM_NS(t));
+	CHECK_EQ(SIM_FLASH_STATS.reads - reads, n);
+	CHECK(n < GLYPHS); // neighbouring glyphs share a read
+	CHECK(t < t_single);
+#if W25QXX_USE_QSPI
+	CHECK_EQ(single_cmds, GLYPHS);
+	CHECK_EQ(SIM_HAL_STATS.qspi_cmds - cmds, n); // no mode reset after the chain
+	CHECK_EQ(W25QXX_ReadSR(1) & 0X01, 0);		 // normal commands again
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+#else
+	(void)single_cmds;
+#endif
+	for (i = 0; i < GLYPHS; i++)
+	{
+		CHECK(Same(req[i].buf, req[i].addr, GLYPH));
+	}
+}
+
+/**
+ * @brief after memory-mapped reads in continuous read mode the chip takes
+ * normal commands again
+ *
+ */
+static void Test_Map(void)
+{
+	uint8_t buf[32];
+	const uint8_t *p = W25QXX_Map(BASE + 100, 64);
+#if W25QXX_USE_QSPI
+	CHECK(p != NULL);
+	if (p != NULL)
+	{
+		CHECK(Same(p, BASE + 100, 64));
+	}
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps, 1);
+	W25QXX_Unmap();
+	CHECK(!Sim_QSPI_Mapped());
+#else
+	CHECK(p == NULL);
+#endif
+	W25QXX_Read(buf, BASE + 200, sizeof(buf));
+	CHECK(Same(buf, BASE + 200, sizeof(buf)));
+	CHECK_EQ(W25QXX_ReadSR(1) & 0X01, 0);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief reads inside a wrap window are plain reads, one across the
+ * window comes back wrapped
+ *
+ */
+static void Test_Wrap(void)
+{
+	uint8_t buf[16];
+#if W25QXX_USE_QSPI
+	CHECK_EQ(W25QXX_LANES, 4);
+	CHECK_EQ(W25QXX_Set_Burst_Wrap(12), 1);
+	CHECK_EQ(W25QXX_Set_Burst_Wrap(16), 0);
+	W25QXX_Read(buf, BASE + 0X40, 16);
+	CHECK(Same(buf, BASE + 0X40, 16));
+	W25QXX_Read(buf, BASE + 0X48, 16); // critical word first
+	CHECK(Same(buf, BASE + 0X48, 8));
+	CHECK(Same(buf + 8, BASE + 0X40, 8));
+	CHECK_EQ(W25QXX_Set_Burst_Wrap(0), 0);
+	W25QXX_Read(buf, BASE + 0X48, 16);
+	CHECK(Same(buf, BASE + 0X48, 16));
+	CHECK_EQ(SIM_HAL_STATS.qspi_errors, 0);
+#else
+	CHECK_EQ(W25QXX_Set_Burst_Wrap(16), 1); // single line on SPI5
+	W25QXX_Read(buf, BASE + 0X48, 16);
+	CHECK(Same(buf, BASE + 0X48, 16));
+#endif
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_read.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	for (i = 0; i < 4096; i++)
+	{
+		Sim_Flash_Mem[BASE + i] = Pattern(BASE + i);
+	}
+	W25QXX_Init();
+#if !W25QXX_USE_QSPI
+	Test_DMA();
+#endif
+	Test_Multi();
+	Test_Glyphs();
+	Test_Map();
+	Test_Wrap();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,135 @@
+/*
+ * test_stream.c
+ *
+ * W25QXX_Read_Stream over several megabytes of a W25Q256, across the 16M
+ * boundary of 3-byte addresses, in one command on SPI5 and through the
+ * memory-mapped window on QUADSPI (whose reads the model does not time).
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "hal.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define START 0XF00000	// 1M below the 16M boundary
+#define SIZE  0X400000	// 4M
+#define CHUNK 512
+
+/**
+ * @brief what the callback has seen
+ *
+ */
+typedef struct _Stream_Check
+{
+	uint32_t addr; // address of the next byte
+	uint32_t chunks;
+	uint32_t bad;  // bytes that differ from the pattern
+	uint32_t stop; // stop after this address, 0: never
+} Stream_Check;
+
+static uint8_t Pattern(uint32_t addr)
+{
+	return (uint8_t)(addr ^ (addr >> 8) ^ (addr >> 16));
+}
+
+static uint8_t Chunk(const uint8_t *pData, uint16_t Len, void *arg)
+{
+	Stream_Check *c = (Stream_Check *)arg;
+	uint16_t i;
+	for (i = 0; i < Len; i++)
+	{
+		c->bad += pData[i] != Pattern(c->addr + i);
+	}
+	c->addr += Len;
+	c->chunks++;
+	return c->stop && c->addr >= c->stop;
+}
+
+static void Test_Stream(void)
+{
+	static uint8_t chunk[CHUNK];
+	Stream_Check c;
+	uint32_t reads, bytes, commands, maps, i;
+	uint64_t t;
+
+	memset(&c, 0, sizeof(c));
+	c.addr = START;
+	reads = SIM_FLASH_STATS.reads;
+	bytes = SIM_FLASH_STATS.bytes_read;
+	commands = SIM_FLASH_STATS.commands;
+	maps = SIM_HAL_STATS.qspi_maps;
+	t = Sim_Time;
+	CHECK_EQ(W25QXX_Read_Stream(START, SIZE + 100, chunk, CHUNK, Chunk, &c), 0);
+	t = Sim_Time - t;
+	CHECK_EQ(c.addr, START + SIZE + 100);
+	CHECK_EQ(c.chunks, SIZE / CHUNK + 1);
+	CHECK_EQ(c.bad, 0);
+#if W25QXX_USE_QSPI
+	// entering continuous read mode and leaving it, the chunks in between
+	// are copied from the window
+	CHECK(SIM_FLASH_STATS.reads - reads <= 2);
+	CHECK(SIM_FLASH_STATS.commands - commands <= 2);
+	CHECK_EQ(SIM_HAL_STATS.qspi_maps - maps, 1);
+	CHECK(!Sim_QSPI_Mapped());
+	(void)bytes;
+#else
+	CHECK_EQ(SIM_FLASH_STATS.bytes_read - bytes, SIZE + 100);
+	CHECK_EQ(SIM_FLASH_STATS.reads - reads, 1);
+	CHECK_EQ(SIM_FLASH_STATS.commands - commands, 1);
+	(void)maps;
+#endif
+	printf("%lu bytes in %lu chunks, %lu read commands, %lu us\r\n", (unsigned long)(SIZE + 100),
+		   (unsigned long)c.chunks, (unsigned long)(SIM_FLASH_STATS.reads - reads), (unsigned long)(SIM_NS(t) / 1000));
+
+	// stopped by the callback
+	memset(&c, 0, sizeof(c));
+	c.addr = START;
+	c.stop = START + 3 * CHUNK;
+	CHECK_EQ(W25QXX_Read_Stream(START, SIZE, chunk, CHUNK, Chunk, &c), 1);
+	CHECK_EQ(c.chunks, 3);
+	CHECK_EQ(c.bad, 0);
+
+	// the last bytes of the chip, then past the end: the flash wraps to 0
+	memset(&c, 0, sizeof(c));
+	c.addr = SIM_FLASH_SIZE - CHUNK;
+	for (i = SIM_FLASH_SIZE - CHUNK; i < SIM_FLASH_SIZE; i++)
+	{
+		Sim_Flash_Mem[i] = Pattern(i);
+	}
+	Sim_Flash_Mem[0] = Pattern(SIM_FLASH_SIZE);
+	CHECK_EQ(W25QXX_Read_Stream(SIM_FLASH_SIZE - CHUNK, CHUNK + 1, chunk, CHUNK, Chunk, &c), 0);
+	CHECK_EQ(c.chunks, 2);
+	CHECK_EQ(c.bad, 0);
+	CHECK(!Sim_QSPI_Mapped());
+
+	// the chip takes commands again
+	CHECK_EQ(W25QXX_ReadSR(1) & 0X01, 0);
+	CHECK_EQ(W25QXX_Read_Stream(START, 10, NULL, CHUNK, Chunk, &c), 1);
+	CHECK_EQ(W25QXX_Read_Stream(START, 10, chunk, 0, Chunk, &c), 1);
+	CHECK_EQ(W25QXX_Read_Stream(START, 10, chunk, CHUNK, NULL, &c), 1);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+	CHECK_EQ(SIM_HAL_STATS.dma_stack, 0);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Sim_Init();
+	if (Sim_Flash_Open("test_stream.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	for (i = START; i < START + SIZE + 100; i++)
+	{
+		Sim_Flash_Mem[i] = Pattern(i);
+	}
+	W25QXX_Init();
+	Test_Stream();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
@@ -0,0 +1,236 @@
+/*
+ * test_trace.c
+ *
+ * Trace points compiled in (TRACE_ENABLE 1): the drivers run against the
+ * models, then the Trace_Dump lines are parsed and checked against the
+ * calls made and the virtual clock.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "ssd1306_model.h"
+#include "i2c_model.h"
+#include "w25qxx.h"
+#include "oled.h"
+#include "iic.h"
+#include "trace.h"
+#include "string.h"
+#include <unistd.h>
+
+#define READS  50
+#define WRITES 10
+#define FRAMES 20
+#define REGS   10
+
+extern uint8_t OLED_GRAM[8][128];
+
+/**
+ * @brief one Trace_Dump line
+ *
+ */
+typedef struct _Dump
+{
+	unsigned long n, p50, p99, max, bytes, xfers;
+} Dump;
+
+static char Dump_Text[2048];
+static unsigned long Dump_Records, Dump_MHz;
+
+/**
+ * @brief run Trace_Dump with stdout going to a temporary file
+ *
+ */
+static void Capture(void)
+{
+	FILE *f = tmpfile();
+	int fd;
+	size_t n;
+
+	fflush(stdout);
+	fd = dup(1);
+	dup2(fileno(f), 1);
+	Trace_Dump();
+	fflush(stdout);
+	dup2(fd, 1);
+	close(fd);
+	rewind(f);
+	n = fread(Dump_Text, 1, sizeof(Dump_Text) - 1, f);
+	Dump_Text[n] = 0;
+	fclose(f);
+	Dump_Records = Dump_MHz = 0;
+	CHECK_EQ(sscanf(Dump_Text, "trace: %lu records, %lu MHz", &Dump_Records, &Dump_MHz), 2);
+}
+
+/**
+ * @brief the line of a traced function
+ *
+ * @return 0: found, 1: no line
+ *
+ */
+static uint8_t Find(const char *name, Dump *d)
+{
+	char key[24];
+	const char *p;
+	memset(d, 0, sizeof(*d));
+	snprintf(key, sizeof(key), "\n%s ", name);
+	p = strstr(Dump_Text, key);
+	if (p == NULL)
+	{
+		return 1;
+	}
+	p += strlen(key);
+	return sscanf(p, " n=%lu p50=%lu p99=%lu max=%lu cycles, %lu bytes, %lu xfers", &d->n, &d->p50, &d->p99, &d->max,
+				  &d->bytes, &d->xfers) != 6;
+}
+
+static void Check_Order(const Dump *d)
+{
+	CHECK(d->p50 <= d->p99);
+	CHECK(d->p99 <= d->max);
+}
+
+/**
+ * @brief flash reads, writes with and without an erase
+ *
+ */
+static void Test_Flash(void)
+{
+	static uint8_t buf[256];
+	uint64_t t, once;
+	uint16_t i;
+	Dump d;
+
+	W25QXX_Init();
+	W25QXX_Erase_Sector(16);
+	Trace_Init();
+	t = Sim_Time;
+	for (i = 0; i < READS; i++)
+	{
+		W25QXX_Read(buf, 16 * 4096, sizeof(buf));
+	}
+	once = (Sim_Time - t) / READS;
+	for (i = 0; i < WRITES; i++)
+	{
+		memset(buf, 0XFF >> (i % 8), 100); // clears bits, then one write sets them again
+		W25QXX_Write(buf, 16 * 4096 + 512, 100);
+	}
+	Capture();
+	CHECK_EQ(Dump_MHz, SIM_CORE_CLOCK / 1000000);
+	CHECK_EQ(Dump_Records, READS + WRITES);
+
+	CHECK_EQ(Find("W25QXX_Read", &d), 0);
+	CHECK_EQ(d.n, READS);
+	CHECK_EQ(d.bytes, READS * 256UL);
+	CHECK_EQ(d.xfers, READS * 2UL); // header, then the data
+	CHECK_EQ(d.p50, d.max);			 // the same read every time
+	CHECK(d.p50 <= once && d.p50 + 100 > once);
+
+	CHECK_EQ(Find("W25QXX_Write", &d), 0);
+	CHECK_EQ(d.n, WRITES);
+	CHECK_EQ(d.bytes, WRITES * 100UL);
+	CHECK(d.xfers >= WRITES * 2UL); // status polls included
+	Check_Order(&d);
+	CHECK(d.max >= SIM_CYCLES(SIM_FLASH_TIMING.sector_erase * 1000ULL)); // the write that erased
+	CHECK(d.p50 < SIM_CYCLES(SIM_FLASH_TIMING.sector_erase * 1000ULL));
+
+	CHECK(Find("OLED_Refresh_Gram", &d) != 0); // nothing else traced
+	printf("%s", Dump_Text);
+}
+
+/**
+ * @brief OLED refreshes of a few changed columns, then one with nothing to
+ * send, and I2C register writes and reads
+ *
+ */
+static void Test_Bus(void)
+{
+	static Sim_I2C_Mem eeprom;
+	uint8_t reg[4] = {1, 2, 3, 4};
+	uint16_t i;
+	Dump d;
+
+	Sim_SSD1306_Init(SIM_SSD1306_8080);
+	OLED_Init();
+	Sim_I2C_Init(GPIOH, GPIO_PIN_4, GPIO_PIN_5, SIM_I2C_FAST);
+	Sim_I2C_Mem_Init(&eeprom, 0XA0, 1);
+	Sim_I2C_Attach(&eeprom.dev);
+	IIC_Init();
+	IIC_Set_Speed(IIC_SPEED_FAST);
+	OLED_Refresh_Gram();
+
+	Trace_Init();
+	for (i = 0; i < FRAMES; i++)
+	{
+		OLED_DrawPoint(i * 6, 10, 1); // one column of page 1
+		OLED_Refresh_Gram();
+	}
+	OLED_Refresh_Gram();
+	for (i = 0; i < REGS; i++)
+	{
+		CHECK_EQ(IIC_Write_Reg(0XA0, i * 4, 1, reg, sizeof(reg)), IIC_OK);
+		CHECK_EQ(IIC_Read_Reg(0XA0, i * 4, 1, reg, sizeof(reg)), IIC_OK);
+	}
+	Capture();
+	CHECK_EQ(Dump_Records, FRAMES + 1 + 2 * REGS);
+
+	CHECK_EQ(Find("OLED_Refresh_Gram", &d), 0);
+	CHECK_EQ(d.n, FRAMES + 1);
+	CHECK_EQ(d.bytes, FRAMES); // one GDDRAM byte per frame
+	Check_Order(&d);
+	CHECK(d.p50 > 0);
+	CHECK(memcmp(SIM_SSD1306_RAM, OLED_GRAM, sizeof(OLED_GRAM)) == 0);
+
+	CHECK_EQ(Find("IIC_Write", &d), 0);
+	CHECK_EQ(d.n, REGS);
+	CHECK_EQ(d.bytes, REGS * 4UL);
+	CHECK_EQ(d.xfers, REGS); // one start each
+	Check_Order(&d);
+	// 6 bytes of 9 bits, each at least tLOW + tHIGH = 1.9 us
+	CHECK(d.p50 >= SIM_CYCLES(6 * 9 * 1900ULL));
+
+	CHECK_EQ(Find("IIC_Read", &d), 0);
+	CHECK_EQ(d.n, REGS);
+	CHECK_EQ(d.xfers, REGS * 2UL); // start and repeated start
+	CHECK(Find("W25QXX_Read", &d) != 0);
+	printf("%s", Dump_Text);
+}
+
+/**
+ * @brief more calls than records: the dump covers the newest
+ * TRACE_BUF_SIZE
+ *
+ */
+static void Test_Wrap(void)
+{
+	uint8_t buf[16];
+	uint16_t i;
+	Dump d;
+
+	Trace_Init();
+	for (i = 0; i < TRACE_BUF_SIZE + 44; i++)
+	{
+		W25QXX_Read(buf, 16 * 4096, sizeof(buf));
+	}
+	Capture();
+	CHECK_EQ(Dump_Records, TRACE_BUF_SIZE);
+	CHECK_EQ(Find("W25QXX_Read", &d), 0);
+	CHECK_EQ(d.n, TRACE_BUF_SIZE);
+	CHECK_EQ(d.bytes, TRACE_BUF_SIZE * 16UL);
+}
+
+int main(void)
+{
+	Sim_Init();
+	if (Sim_Flash_Open("test_trace.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	Test_Flash();
+	Test_Bus();
+	Test_Wrap();
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
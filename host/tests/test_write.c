@@ -0,0 +1,192 @@
+/*
+ * test_write.c
+ *
+ * The erase-avoiding read-modify-write of W25QXX_Write, checked against
+ * the erase and program commands the flash model executes, and a small
+ * benchmark of typical configuration update patterns.
+ *
+ */
+
+#include "test.h"
+#include "sim.h"
+#include "w25q_model.h"
+#include "w25qxx.h"
+#include "string.h"
+
+/**
+ * @brief per pattern: writes, and what the driver and the flash did
+ *
+ */
+typedef struct _Bench
+{
+	const char *name;
+	uint32_t writes;
+	uint32_t naive; // erases of a write that erases whenever the range is not blank
+	uint32_t erases;
+	uint32_t pages;
+	uint32_t bytes;
+} Bench;
+
+static void Bench_Begin(Bench *b, const char *name)
+{
+	memset(b, 0, sizeof(*b));
+	b->name = name;
+	memset(&W25QXX_STATS, 0, sizeof(W25QXX_STATS));
+	memset(&SIM_FLASH_STATS, 0, sizeof(SIM_FLASH_STATS));
+}
+
+static void Bench_Write(Bench *b, uint8_t *data, uint32_t addr, uint16_t len)
+{
+	uint16_t i;
+	for (i = 0; i < len && Sim_Flash_Mem[addr + i] == 0XFF; i++)
+	{
+	}
+	b->naive += i < len;
+	b->writes++;
+	W25QXX_Write(data, addr, len);
+}
+
+static void Bench_End(Bench *b)
+{
+	b->erases = W25QXX_STATS.erases;
+	b->pages = W25QXX_STATS.pages_programmed;
+	b->bytes = SIM_FLASH_STATS.bytes_programmed;
+	CHECK_EQ(SIM_FLASH_STATS.erases, b->erases);
+	CHECK_EQ(SIM_FLASH_STATS.programs, b->pages);
+	printf("%-22s %5lu writes %5lu erases (naive %5lu) %6lu pages %8lu bytes, %lu bytes saved\r\n", b->name,
+		   (unsigned long)b->writes, (unsigned long)b->erases, (unsigned long)b->naive, (unsigned long)b->pages,
+		   (unsigned long)b->bytes, (unsigned long)W25QXX_STATS.bytes_saved);
+}
+
+/**
+ * @brief erase decisions of single writes
+ *
+ */
+static void Test_Rules(void)
+{
+	uint8_t buf[64], back[64];
+
+	W25QXX_Erase_Sector(16);
+	W25QXX_Erase_Sector(17);
+	memset(&W25QXX_STATS, 0, sizeof(W25QXX_STATS));
+	memset(&SIM_FLASH_STATS, 0, sizeof(SIM_FLASH_STATS));
+
+	// blank range: program only, one page
+	memset(buf, 0XF5, sizeof(buf));
+	W25QXX_Write(buf, 16 * 4096 + 100, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 0);
+	CHECK_EQ(SIM_FLASH_STATS.programs, 1);
+
+	// (old & new) == new: no erase, only the changed bytes
+	buf[10] = 0X05;
+	buf[20] = 0X01;
+	W25QXX_Write(buf, 16 * 4096 + 100, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 0);
+	CHECK_EQ(SIM_FLASH_STATS.programs, 2);
+	CHECK_EQ(SIM_FLASH_STATS.bytes_programmed, 64 + 11);
+
+	// the same data again: nothing at all
+	W25QXX_Write(buf, 16 * 4096 + 100, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.programs, 2);
+
+	// a blank range next to programmed bytes of the same sector: no erase
+	W25QXX_Write(buf, 16 * 4096 + 2048, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 0);
+
+	// a 0 -> 1 bit: one erase, then only the two pages holding data
+	buf[10] = 0XFF;
+	W25QXX_Write(buf, 16 * 4096 + 100, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 1);
+	CHECK_EQ(SIM_FLASH_STATS.programs, 3 + 2);
+	W25QXX_Read(back, 16 * 4096 + 100, sizeof(back));
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	W25QXX_Read(back, 16 * 4096 + 2048, sizeof(back)); // kept across the erase
+	CHECK_EQ(back[0], 0XF5);
+	CHECK_EQ(back[10], 0X05);
+	CHECK_EQ(back[20], 0X01);
+
+	// across a sector boundary, only the sector that needs it is erased
+	memset(buf, 0X00, sizeof(buf));
+	W25QXX_Write(buf, 17 * 4096 - 32, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 1);
+	memset(buf, 0X0F, sizeof(buf));
+	W25QXX_Write(buf, 17 * 4096 - 32, sizeof(buf));
+	CHECK_EQ(SIM_FLASH_STATS.erases, 3);
+	CHECK_EQ(SIM_FLASH_ERASE_COUNT[16], 3);
+	CHECK_EQ(SIM_FLASH_ERASE_COUNT[17], 2);
+	W25QXX_Read(back, 17 * 4096 - 32, sizeof(back));
+	CHECK(memcmp(back, buf, sizeof(buf)) == 0);
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+}
+
+/**
+ * @brief configuration update patterns
+ *
+ */
+static void Test_Bench(void)
+{
+	static uint8_t cfg[128];
+	uint8_t map[64], rec[32];
+	Bench b;
+	uint32_t i;
+
+	// a boot counter kept as a bitmap, one more bit cleared per boot
+	W25QXX_Erase_Sector(32);
+	Bench_Begin(&b, "boot bitmap");
+	memset(map, 0XFF, sizeof(map));
+	for (i = 0; i < 512; i++)
+	{
+		map[i / 8] &= ~(0X80 >> (i % 8));
+		Bench_Write(&b, map, 32 * 4096, sizeof(map));
+	}
+	Bench_End(&b);
+	CHECK_EQ(b.erases, 0);
+	CHECK_EQ(b.pages, 512);
+
+	// a log of records appended to an erased sector
+	W25QXX_Erase_Sector(33);
+	Bench_Begin(&b, "record append");
+	for (i = 0; i < 4096 / sizeof(rec); i++)
+	{
+		memset(rec, (uint8_t)i, sizeof(rec));
+		Bench_Write(&b, rec, 33 * 4096 + i * sizeof(rec), sizeof(rec));
+	}
+	Bench_End(&b);
+	CHECK_EQ(b.erases, 0);
+
+	// a structure rewritten with new field values, the rest of the sector
+	// holds a calibration table
+	W25QXX_Erase_Sector(34);
+	memset(rec, 0X3C, sizeof(rec));
+	W25QXX_Write(rec, 34 * 4096 + 3072, sizeof(rec));
+	Bench_Begin(&b, "config rewrite");
+	for (i = 0; i < 200; i++)
+	{
+		cfg[i % sizeof(cfg)] = (uint8_t)(i * 37);
+		cfg[(i * 7) % sizeof(cfg)] ^= 0X81;
+		Bench_Write(&b, cfg, 34 * 4096, sizeof(cfg));
+	}
+	Bench_End(&b);
+	CHECK(b.erases < b.naive);
+	CHECK(b.pages <= b.writes + b.erases); // the table page is the only extra after an erase
+	W25QXX_Read(map, 34 * 4096 + 3072, sizeof(rec));
+	CHECK(memcmp(map, rec, sizeof(rec)) == 0);
+	W25QXX_Read(map, 34 * 4096, sizeof(map));
+	CHECK(memcmp(map, cfg, sizeof(map)) == 0);
+}
+
+int main(void)
+{
+	Sim_Init();
+	if (Sim_Flash_Open("test_write.flash", 1) != 0)
+	{
+		printf("cannot map the flash file\r\n");
+		return 1;
+	}
+	W25QXX_Init();
+	Test_Rules();
+	Test_Bench();
+	CHECK_EQ(SIM_FLASH_STATS.errors, 0);
+	Sim_Flash_Close();
+	return TEST_DONE();
+}
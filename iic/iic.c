@@ -1,41 +1,188 @@
 #include "iic.h"
-#include "delay.h"
+#include "iic_hw.h"
+#include "stddef.h"
+#include "trace.h"
 
 /**
- * @brief initialization IIC
+ * I2C minimum timings in ns (UM10204 table 10)
  *
  */
-void IIC_Init(void)
+static const IIC_Timing IIC_TIMING[3] = {
+	{4700, 4000, 4700, 4000, 4000, 4700}, // Standard-mode 100 kHz
+	{1300, 600, 600, 600, 600, 1300},	  // Fast-mode 400 kHz
+	{500, 260, 260, 260, 260, 500},		  // Fast-mode Plus 1 MHz
+};
+
+// shortest SCL period in ns (1 / fSCL max), tLOW + tHIGH alone is shorter
+static const uint32_t IIC_PERIOD[3] = {10000, 2500, 1000};
+
+// bus pins, open drain: writing 1 releases the line
+#define IIC_BUS_SCL(bus, v) ((bus)->scl_port->BSRR = (v) ? (uint32_t)(bus)->scl_pin : (uint32_t)(bus)->scl_pin << 16)
+#define IIC_BUS_SDA(bus, v) ((bus)->sda_port->BSRR = (v) ? (uint32_t)(bus)->sda_pin : (uint32_t)(bus)->sda_pin << 16)
+#define IIC_BUS_READ_SCL(bus) (((bus)->scl_port->IDR & (bus)->scl_pin) != 0)
+#define IIC_BUS_READ_SDA(bus) (((bus)->sda_port->IDR & (bus)->sda_pin) != 0)
+
+/**
+ * @brief busy wait on the DWT cycle counter
+ *
+ * @param
+ * cycles: core clock cycles
+ *
+ */
+static void IIC_Delay(uint32_t cycles)
+{
+	uint32_t start = DWT->CYCCNT;
+	while (DWT->CYCCNT - start < cycles)
+	{
+	}
+}
+
+/**
+ * @brief convert ns to core clock cycles, rounded up
+ *
+ */
+static uint32_t IIC_Ns_To_Cycles(uint32_t ns)
+{
+	return (ns * (SystemCoreClock / 1000000) + 999) / 1000;
+}
+
+/**
+ * @brief release SCL and wait until it is high, a device may stretch the clock
+ *
+ */
+static void IIC_Bus_SCL_High(IIC_Bus *bus)
+{
+	uint32_t start;
+	IIC_BUS_SCL(bus, 1);
+	start = DWT->CYCCNT;
+	while (!IIC_BUS_READ_SCL(bus))
+	{
+		if (DWT->CYCCNT - start > bus->stretch)
+		{
+			bus->timeout = 1;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief set the speed of a bus
+ * The timings are calibrated against SystemCoreClock, call again after a
+ * core clock change.
+ *
+ * @param
+ * bus: the bus
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ *
+ */
+void IIC_Bus_Set_Speed(IIC_Bus *bus, uint8_t speed)
+{
+	const IIC_Timing *t;
+	if (speed > IIC_SPEED_FAST_PLUS)
+	{
+		speed = IIC_SPEED_STANDARD;
+	}
+	t = &IIC_TIMING[speed];
+	// SCL low takes the rest of the period so fSCL stays within the mode
+	bus->cycles.low = IIC_Ns_To_Cycles(IIC_PERIOD[speed] - t->high > t->low ? IIC_PERIOD[speed] - t->high : t->low);
+	bus->cycles.high = IIC_Ns_To_Cycles(t->high);
+	bus->cycles.su_sta = IIC_Ns_To_Cycles(t->su_sta);
+	bus->cycles.hd_sta = IIC_Ns_To_Cycles(t->hd_sta);
+	bus->cycles.su_sto = IIC_Ns_To_Cycles(t->su_sto);
+	bus->cycles.buf = IIC_Ns_To_Cycles(t->buf);
+	bus->stretch = IIC_STRETCH_TIMEOUT * (SystemCoreClock / 1000);
+	bus->speed = speed;
+}
+
+/**
+ * @brief initialization a bit-banged bus
+ *
+ * @param
+ * bus: the bus
+ * scl_port, scl_pin: SCL pin, e.g. GPIOH, GPIO_PIN_4
+ * sda_port, sda_pin: SDA pin
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ *
+ */
+void IIC_Bus_Init(IIC_Bus *bus, GPIO_TypeDef *scl_port, uint16_t scl_pin, GPIO_TypeDef *sda_port, uint16_t sda_pin, uint8_t speed)
 {
 	GPIO_InitTypeDef GPIO_Initure;
 
-	__HAL_RCC_GPIOH_CLK_ENABLE(); // Enable GPIO H Clock
+	bus->scl_port = scl_port;
+	bus->scl_pin = scl_pin;
+	bus->sda_port = sda_port;
+	bus->sda_pin = sda_pin;
+	bus->lock = 0;
+	bus->timeout = 0;
 
-	// config PH4 and PH5
-	GPIO_Initure.Pin = GPIO_PIN_4 | GPIO_PIN_5;
-	GPIO_Initure.Mode = GPIO_MODE_OUTPUT_PP; // push pull
+	// Enable GPIO clocks, the ports are 0x400 apart from GPIOA
+	RCC->AHB1ENR |= 1 << (((uint32_t)scl_port - GPIOA_BASE) / 0x400);
+	RCC->AHB1ENR |= 1 << (((uint32_t)sda_port - GPIOA_BASE) / 0x400);
+
+	// open drain so that SCL and SDA can be read back
+	GPIO_Initure.Mode = GPIO_MODE_OUTPUT_OD; // open drain
 	GPIO_Initure.Pull = GPIO_PULLUP;		 // pull up
 	GPIO_Initure.Speed = GPIO_SPEED_FAST;	 // fast speed
-	HAL_GPIO_Init(GPIOH, &GPIO_Initure);
+	GPIO_Initure.Pin = scl_pin;
+	HAL_GPIO_Init(scl_port, &GPIO_Initure);
+	GPIO_Initure.Pin = sda_pin;
+	HAL_GPIO_Init(sda_port, &GPIO_Initure);
+
+	// DWT cycle counter for the bus timing
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	IIC_Bus_Set_Speed(bus, speed);
 
-	IIC_SDA = 1;
-	IIC_SCL = 1;
+	IIC_BUS_SDA(bus, 1);
+	IIC_BUS_SCL(bus, 1);
 }
 
 /**
  * @brief  Data transfer is initiated with a start condition (S) signaled by
  *         SDA being pulled low while SCL stays high.
+ *         For a repeated start SCL is low after the last ack bit, it is
+ *         held low for tLOW before it is released.
  *
  */
-void IIC_Start(void)
+static void IIC_Bus_Start(IIC_Bus *bus)
 {
-	SDA_OUT();
-	IIC_SDA = 1;
-	IIC_SCL = 1;
-	delay_us(4);
-	IIC_SDA = 0; // START:when CLK is high,DATA change form high to low
-	delay_us(4);
-	IIC_SCL = 0; // lock I2C busand ready to send or receive data
+	TRACE_XFER();
+	bus->timeout = 0;
+	IIC_BUS_SDA(bus, 1);
+	IIC_Delay(bus->cycles.low);
+	IIC_Bus_SCL_High(bus);
+	IIC_Delay(bus->cycles.su_sta);
+	IIC_BUS_SDA(bus, 0); // START:when CLK is high,DATA change form high to low
+	IIC_Delay(bus->cycles.hd_sta);
+	IIC_BUS_SCL(bus, 0); // lock I2C bus, and ready to send or receive data
+}
+
+/**
+ * @brief after a stretching timeout the device may be anywhere in a byte,
+ *        clock SCL until it releases SDA, at most 9 clocks (UM10204 3.1.16)
+ *
+ */
+static void IIC_Bus_Clear(IIC_Bus *bus)
+{
+	uint8_t i;
+	IIC_Delay(bus->cycles.high);
+	IIC_BUS_SCL(bus, 0);
+	IIC_BUS_SDA(bus, 1);
+	for (i = 0; i < 9; i++)
+	{
+		IIC_Delay(bus->cycles.low);
+		if (IIC_BUS_READ_SDA(bus))
+		{
+			return;
+		}
+		IIC_Bus_SCL_High(bus);
+		if (!IIC_BUS_READ_SCL(bus))
+		{
+			return; // still held low, nothing more to do
+		}
+		IIC_Delay(bus->cycles.high);
+		IIC_BUS_SCL(bus, 0);
+	}
 }
 
 /**
@@ -43,42 +190,475 @@ void IIC_Start(void)
  *         SDA rising.
  *
  */
-void IIC_Stop(void)
+static void IIC_Bus_Stop(IIC_Bus *bus)
 {
-	SDA_OUT();
-	IIC_SCL = 0;
-	IIC_SDA = 0; // STOP:when CLK is high DATA change form low to high
-	delay_us(4);
-	IIC_SCL = 1;
-	delay_us(4);
-	IIC_SDA = 1;
+	if (bus->timeout)
+	{
+		IIC_Bus_Clear(bus);
+	}
+	IIC_BUS_SCL(bus, 0);
+	IIC_BUS_SDA(bus, 0); // STOP:when CLK is high DATA change form low to high
+	IIC_Delay(bus->cycles.low);
+	IIC_Bus_SCL_High(bus);
+	IIC_Delay(bus->cycles.su_sto);
+	IIC_BUS_SDA(bus, 1);
+	IIC_Delay(bus->cycles.buf);
 }
 
 /**
  * @brief Wait ACK Signal
+ * SDA is sampled while SCL is high, a stop is sent if it stays high or
+ * SCL is held low past IIC_STRETCH_TIMEOUT.
+ *
+ * @return 0: ack, 1: nack or timeout
  *
  */
-uint8_t IIC_Wait_Ack(void)
+static uint8_t IIC_Bus_Wait_Ack(IIC_Bus *bus)
 {
-	uint8_t ucErrTime = 0;
-	SDA_IN(); 
-	IIC_SDA = 1;
-	delay_us(1);
-	IIC_SCL = 1;
-	delay_us(1);
-	while (READ_SDA)
+	uint32_t start;
+	IIC_BUS_SDA(bus, 1);
+	IIC_Delay(bus->cycles.low);
+	IIC_Bus_SCL_High(bus);
+	if (bus->timeout)
 	{
-		ucErrTime++;
-		if (ucErrTime > 250)
+		IIC_Bus_Stop(bus);
+		return 1;
+	}
+	start = DWT->CYCCNT;
+	while (IIC_BUS_READ_SDA(bus))
+	{
+		if (DWT->CYCCNT - start > bus->cycles.high)
 		{
-			IIC_Stop();
+			IIC_Bus_Stop(bus);
 			return 1;
 		}
 	}
-	IIC_SCL = 0;
+	IIC_Delay(bus->cycles.high);
+	IIC_BUS_SCL(bus, 0);
 	return 0;
 }
 
+/**
+ * @brief send an ACK or NACK bit
+ *
+ * @param
+ * ack: 1: ACK, 0: NACK
+ *
+ */
+static void IIC_Bus_Ack(IIC_Bus *bus, uint8_t ack)
+{
+	IIC_BUS_SCL(bus, 0);
+	IIC_BUS_SDA(bus, !ack);
+	IIC_Delay(bus->cycles.low);
+	IIC_Bus_SCL_High(bus);
+	IIC_Delay(bus->cycles.high);
+	IIC_BUS_SCL(bus, 0);
+}
+
+/**
+ * @brief  Write a byte to I2C bus
+ *
+ * @param
+ * txd: the send data
+ */
+static void IIC_Bus_Send_Byte(IIC_Bus *bus, uint8_t txd)
+{
+	uint8_t t;
+	IIC_BUS_SCL(bus, 0);
+	for (t = 0; t < 8; t++)
+	{
+		IIC_BUS_SDA(bus, txd & 0x80);
+		txd <<= 1;
+		IIC_Delay(bus->cycles.low);
+		IIC_Bus_SCL_High(bus);
+		if (bus->timeout)
+		{
+			return; // the caller's IIC_Bus_Wait_Ack sends the stop
+		}
+		IIC_Delay(bus->cycles.high);
+		IIC_BUS_SCL(bus, 0);
+	}
+}
+
+/**
+ * @brief Read a byte from I2C bus
+ *
+ * @param
+ * ack: when ack=1, send ACK, when ack=0, send nACK
+ *
+ * @return read a btye from I2C bus
+ */
+static uint8_t IIC_Bus_Read_Byte(IIC_Bus *bus, uint8_t ack)
+{
+	uint8_t i, receive = 0;
+	IIC_BUS_SDA(bus, 1); // release SDA
+	for (i = 0; i < 8; i++)
+	{
+		IIC_BUS_SCL(bus, 0);
+		IIC_Delay(bus->cycles.low);
+		IIC_Bus_SCL_High(bus);
+		if (bus->timeout)
+		{
+			return receive;
+		}
+		receive <<= 1;
+		if (IIC_BUS_READ_SDA(bus))
+		{
+			receive++;
+		}
+		IIC_Delay(bus->cycles.high);
+	}
+	IIC_Bus_Ack(bus, ack);
+	return receive;
+}
+
+/**
+ * @brief send a byte and wait for its ack, a NACK sends a stop
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+static uint8_t IIC_Bus_Send_Acked(IIC_Bus *bus, uint8_t txd)
+{
+	IIC_Bus_Send_Byte(bus, txd);
+	if (IIC_Bus_Wait_Ack(bus))
+	{
+		return bus->timeout ? IIC_ERR_TIMEOUT : IIC_ERR_NACK;
+	}
+	return IIC_OK;
+}
+
+/**
+ * @brief start, then send the device and register address
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+static uint8_t IIC_Bus_Send_Reg(IIC_Bus *bus, uint8_t addr, uint16_t reg, uint8_t regsize)
+{
+	uint8_t err;
+	IIC_Bus_Start(bus);
+	if ((err = IIC_Bus_Send_Acked(bus, addr & 0XFE)))
+	{
+		return err;
+	}
+	if (regsize == 2 && (err = IIC_Bus_Send_Acked(bus, reg >> 8)))
+	{
+		return err;
+	}
+	return IIC_Bus_Send_Acked(bus, reg & 0XFF);
+}
+
+/**
+ * @brief send data and stop
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+static uint8_t IIC_Bus_Send_Data(IIC_Bus *bus, const uint8_t *pData, uint16_t len)
+{
+	uint16_t i;
+	uint8_t err;
+	for (i = 0; i < len; i++)
+	{
+		if ((err = IIC_Bus_Send_Acked(bus, pData[i])))
+		{
+			return err;
+		}
+	}
+	IIC_Bus_Stop(bus);
+	return bus->timeout ? IIC_ERR_TIMEOUT : IIC_OK;
+}
+
+/**
+ * @brief (repeated) start, read data and stop
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+static uint8_t IIC_Bus_Recv_Data(IIC_Bus *bus, uint8_t addr, uint8_t *pData, uint16_t len)
+{
+	uint16_t i;
+	uint8_t err;
+	IIC_Bus_Start(bus);
+	if ((err = IIC_Bus_Send_Acked(bus, addr | 0X01)))
+	{
+		return err;
+	}
+	for (i = 0; i < len && !bus->timeout; i++)
+	{
+		pData[i] = IIC_Bus_Read_Byte(bus, i + 1 < len); // nACK the last byte
+	}
+	IIC_Bus_Stop(bus);
+	return bus->timeout ? IIC_ERR_TIMEOUT : IIC_OK;
+}
+
+/**
+ * @brief  Write data to device, one address phase
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+uint8_t IIC_Bus_Write(IIC_Bus *bus, uint8_t addr, const uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	TRACE_BEGIN(trace, len);
+	IIC_Bus_Start(bus);
+	err = IIC_Bus_Send_Acked(bus, addr & 0XFE);
+	if (!err)
+	{
+		err = IIC_Bus_Send_Data(bus, pData, len);
+	}
+	TRACE_END(TRACE_IIC_WRITE, trace);
+	return err;
+}
+
+/**
+ * @brief  Read data from device, the last byte is nACKed
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+uint8_t IIC_Bus_Read(IIC_Bus *bus, uint8_t addr, uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	TRACE_BEGIN(trace, len);
+	err = IIC_Bus_Recv_Data(bus, addr, pData, len);
+	TRACE_END(TRACE_IIC_READ, trace);
+	return err;
+}
+
+/**
+ * @brief  Write device registers in one burst
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+uint8_t IIC_Bus_Write_Reg(IIC_Bus *bus, uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	TRACE_BEGIN(trace, len);
+	err = IIC_Bus_Send_Reg(bus, addr, reg, regsize);
+	if (!err)
+	{
+		err = IIC_Bus_Send_Data(bus, pData, len);
+	}
+	TRACE_END(TRACE_IIC_WRITE, trace);
+	return err;
+}
+
+/**
+ * @brief  Read device registers after a repeated start
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+uint8_t IIC_Bus_Read_Reg(IIC_Bus *bus, uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	TRACE_BEGIN(trace, len);
+	err = IIC_Bus_Send_Reg(bus, addr, reg, regsize);
+	if (!err)
+	{
+		err = IIC_Bus_Recv_Data(bus, addr, pData, len);
+	}
+	TRACE_END(TRACE_IIC_READ, trace);
+	return err;
+}
+
+/**
+ * @brief check if a device acknowledges its address
+ *
+ * @return 0: present, 1: no answer
+ */
+uint8_t IIC_Bus_Probe(IIC_Bus *bus, uint8_t addr)
+{
+	return IIC_Bus_Write(bus, addr, NULL, 0) != IIC_OK;
+}
+
+/**
+ * @brief probe the 7 bit addresses 0x08 ~ 0x77
+ *
+ * @return number of devices found
+ */
+uint8_t IIC_Bus_Scan(IIC_Bus *bus, uint8_t *found, uint8_t max)
+{
+	uint8_t addr, n = 0;
+	for (addr = 0X08; addr <= 0X77 && n < max; addr++)
+	{
+		if (!IIC_Bus_Probe(bus, addr << 1))
+		{
+			found[n++] = addr << 1;
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief take the bus lock, safe against other tasks and interrupts
+ *
+ * @return 0: locked, 1: the bus is in use
+ */
+uint8_t IIC_Bus_Lock(IIC_Bus *bus)
+{
+	do
+	{
+		if (__LDREXW(&bus->lock))
+		{
+			__CLREX();
+			return 1;
+		}
+	} while (__STREXW(1, &bus->lock));
+	__DMB();
+	return 0;
+}
+
+/**
+ * @brief release the bus lock
+ *
+ */
+void IIC_Bus_Unlock(IIC_Bus *bus)
+{
+	__DMB();
+	bus->lock = 0;
+}
+
+/**
+ * @brief run one device transaction: lock, switch to the device speed and
+ * back, retry on NACK
+ *
+ * @param
+ * dev: the device
+ * reg: register address, or IIC_DEV_NOREG
+ * pData: write data or read buffer
+ * len: the length of data
+ * read: 1: read, 0: write
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+static uint8_t IIC_Dev_Xfer(IIC_Device *dev, uint32_t reg, uint8_t *pData, uint16_t len, uint8_t read)
+{
+	IIC_Bus *bus = dev->bus;
+	uint8_t err, tries = 0, speed = bus->speed;
+	if (IIC_Bus_Lock(bus))
+	{
+		return IIC_ERR_BUSY;
+	}
+	if (speed != dev->speed)
+	{
+		IIC_Bus_Set_Speed(bus, dev->speed);
+	}
+	do
+	{
+		if (reg == IIC_DEV_NOREG)
+		{
+			err = read ? IIC_Bus_Read(bus, dev->addr, pData, len) : IIC_Bus_Write(bus, dev->addr, pData, len);
+		}
+		else if (read)
+		{
+			err = IIC_Bus_Read_Reg(bus, dev->addr, reg, dev->regsize, pData, len);
+		}
+		else
+		{
+			err = IIC_Bus_Write_Reg(bus, dev->addr, reg, dev->regsize, pData, len);
+		}
+	} while (err == IIC_ERR_NACK && tries++ < dev->retries);
+	if (speed != dev->speed)
+	{
+		IIC_Bus_Set_Speed(bus, speed); // back to the speed of the other devices
+	}
+	IIC_Bus_Unlock(bus);
+	return err;
+}
+
+/**
+ * @brief  Write data to a device
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Dev_Write(IIC_Device *dev, const uint8_t *pData, uint16_t len)
+{
+	return IIC_Dev_Xfer(dev, IIC_DEV_NOREG, (uint8_t *)pData, len, 0);
+}
+
+/**
+ * @brief  Read data from a device
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Dev_Read(IIC_Device *dev, uint8_t *pData, uint16_t len)
+{
+	return IIC_Dev_Xfer(dev, IIC_DEV_NOREG, pData, len, 1);
+}
+
+/**
+ * @brief  Write device registers
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Dev_Write_Reg(IIC_Device *dev, uint16_t reg, const uint8_t *pData, uint16_t len)
+{
+	return IIC_Dev_Xfer(dev, reg, (uint8_t *)pData, len, 0);
+}
+
+/**
+ * @brief  Read device registers
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Dev_Read_Reg(IIC_Device *dev, uint16_t reg, uint8_t *pData, uint16_t len)
+{
+	return IIC_Dev_Xfer(dev, reg, pData, len, 1);
+}
+
+#if !IIC_USE_HW // bit-banged bus, see iic_hw.c for the I2C2 controller
+
+IIC_Bus IIC_BUS1; // PH4 (SCL), PH5 (SDA), used by the IIC_* functions
+
+/**
+ * @brief initialization IIC
+ *
+ */
+void IIC_Init(void)
+{
+	IIC_Bus_Init(&IIC_BUS1, GPIOH, GPIO_PIN_4, GPIOH, GPIO_PIN_5, IIC_SPEED);
+}
+
+/**
+ * @brief set the bus speed
+ *
+ * @param
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ *
+ */
+void IIC_Set_Speed(uint8_t speed)
+{
+	IIC_Bus_Set_Speed(&IIC_BUS1, speed);
+}
+
+/**
+ * @brief  Data transfer is initiated with a start condition (S) signaled by
+ *         SDA being pulled low while SCL stays high.
+ *
+ */
+void IIC_Start(void)
+{
+	IIC_Bus_Start(&IIC_BUS1);
+}
+
+/**
+ * @brief  A stop condition (P) is signaled when SCL rises, followed by
+ *         SDA rising.
+ *
+ */
+void IIC_Stop(void)
+{
+	IIC_Bus_Stop(&IIC_BUS1);
+}
+
+/**
+ * @brief Wait ACK Signal
+ *
+ * @return 0: ack, 1: nack or timeout
+ *
+ */
+uint8_t IIC_Wait_Ack(void)
+{
+	return IIC_Bus_Wait_Ack(&IIC_BUS1);
+}
+
 /**
  * @brief Each frame in a message is followed by an acknowledge bit.
  * If an address frame or data frame was successfully received,
@@ -87,13 +667,7 @@ uint8_t IIC_Wait_Ack(void)
  */
 void IIC_Ack(void)
 {
-	IIC_SCL = 0;
-	SDA_OUT();
-	IIC_SDA = 0;
-	delay_us(2);
-	IIC_SCL = 1;
-	delay_us(2);
-	IIC_SCL = 0;
+	IIC_Bus_Ack(&IIC_BUS1, 1);
 }
 
 /**
@@ -102,36 +676,18 @@ void IIC_Ack(void)
  */
 void IIC_NAck(void)
 {
-	IIC_SCL = 0;
-	SDA_OUT();
-	IIC_SDA = 1;
-	delay_us(2);
-	IIC_SCL = 1;
-	delay_us(2);
-	IIC_SCL = 0;
+	IIC_Bus_Ack(&IIC_BUS1, 0);
 }
 
 /**
- * @brief  Write a byte to I2C bus. Return 0 if ack by the target.
+ * @brief  Write a byte to I2C bus
  *
  * @param
  * txd: the send data
  */
 void IIC_Send_Byte(uint8_t txd)
 {
-	uint8_t t;
-	SDA_OUT();
-	IIC_SCL = 0;
-	for (t = 0; t < 8; t++)
-	{
-		IIC_SDA = (txd & 0x80) >> 7;
-		txd <<= 1;
-		delay_us(2);
-		IIC_SCL = 1;
-		delay_us(2);
-		IIC_SCL = 0;
-		delay_us(2);
-	}
+	IIC_Bus_Send_Byte(&IIC_BUS1, txd);
 }
 
 /**
@@ -144,27 +700,111 @@ void IIC_Send_Byte(uint8_t txd)
  */
 uint8_t IIC_Read_Byte(unsigned char ack)
 {
-	unsigned char i, receive = 0;
-	SDA_IN();
-	for (i = 0; i < 8; i++)
+	return IIC_Bus_Read_Byte(&IIC_BUS1, ack);
+}
+
+uint8_t IIC_Write(uint8_t addr, const uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	if (IIC_Bus_Lock(&IIC_BUS1))
 	{
-		IIC_SCL = 0;
-		delay_us(2);
-		IIC_SCL = 1;
-		receive <<= 1;
-		if (READ_SDA)
-		{
-			receive++;
-		}
-		delay_us(1);
+		return IIC_ERR_BUSY;
 	}
-	if (!ack)
+	err = IIC_Bus_Write(&IIC_BUS1, addr, pData, len);
+	IIC_Bus_Unlock(&IIC_BUS1);
+	return err;
+}
+
+uint8_t IIC_Read(uint8_t addr, uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	if (IIC_Bus_Lock(&IIC_BUS1))
+	{
+		return IIC_ERR_BUSY;
+	}
+	err = IIC_Bus_Read(&IIC_BUS1, addr, pData, len);
+	IIC_Bus_Unlock(&IIC_BUS1);
+	return err;
+}
+
+uint8_t IIC_Write_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	if (IIC_Bus_Lock(&IIC_BUS1))
 	{
-		IIC_NAck();
+		return IIC_ERR_BUSY;
 	}
-	else
+	err = IIC_Bus_Write_Reg(&IIC_BUS1, addr, reg, regsize, pData, len);
+	IIC_Bus_Unlock(&IIC_BUS1);
+	return err;
+}
+
+uint8_t IIC_Read_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len)
+{
+	uint8_t err;
+	if (IIC_Bus_Lock(&IIC_BUS1))
 	{
-		IIC_Ack();
+		return IIC_ERR_BUSY;
 	}
-	return receive;
+	err = IIC_Bus_Read_Reg(&IIC_BUS1, addr, reg, regsize, pData, len);
+	IIC_Bus_Unlock(&IIC_BUS1);
+	return err;
+}
+
+#else // the I2C2 controller does whole transactions
+
+void IIC_Set_Speed(uint8_t speed)
+{
+	I2C2_Handler.Init.ClockSpeed = speed == IIC_SPEED_STANDARD ? 100000 : IIC_HW_SPEED; // no Fast-mode Plus
+	HAL_I2C_Init(&I2C2_Handler);
+}
+
+uint8_t IIC_Write(uint8_t addr, const uint8_t *pData, uint16_t len)
+{
+	return IIC_HW_Write(addr & 0XFE, pData, len) ? IIC_ERR_NACK : IIC_OK;
+}
+
+uint8_t IIC_Read(uint8_t addr, uint8_t *pData, uint16_t len)
+{
+	return IIC_HW_Read(addr & 0XFE, pData, len) ? IIC_ERR_NACK : IIC_OK;
+}
+
+uint8_t IIC_Write_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len)
+{
+	return IIC_HW_Mem_Write(addr & 0XFE, reg, regsize, pData, len) ? IIC_ERR_NACK : IIC_OK;
+}
+
+uint8_t IIC_Read_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len)
+{
+	return IIC_HW_Mem_Read(addr & 0XFE, reg, regsize, pData, len) ? IIC_ERR_NACK : IIC_OK;
+}
+
+#endif
+
+/**
+ * @brief  Write a byte to device
+ *
+ * @param
+ * addr: device address
+ * data: the data
+ */
+void IIC_Write_One_Byte(uint8_t addr, uint8_t data)
+{
+	IIC_Write(addr, &data, 1);
+}
+
+/**
+ * @brief  read a byte from device
+ *
+ * @param
+ * addr: device address
+ *
+ * @return the data, 0XFF if the device does not answer
+ *
+ */
+uint8_t IIC_Read_One_Byte(uint8_t addr)
+{
+	uint8_t data = 0XFF;
+	IIC_Read(addr, &data, 1);
+	return data;
 }
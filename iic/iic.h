@@ -7,6 +7,7 @@
 #define _IIC_H_
 #include "sys.h"
 	
+//default bus pins (IIC_BUS1)
 //IO Direction
 #define SDA_IN()  {GPIOH->MODER&=~(3<<(5*2));GPIOH->MODER|=0<<5*2;}	//PH5 input
 #define SDA_OUT() {GPIOH->MODER&=~(3<<(5*2));GPIOH->MODER|=1<<5*2;} //PH5 output
@@ -15,6 +16,73 @@
 #define IIC_SCL   PHout(4) //SCL
 #define IIC_SDA   PHout(5) //SDA
 #define READ_SDA  PHin(5)  //input SDA
+#define READ_SCL  PHin(4)  //input SCL, for clock stretching
+
+//bus speed, see IIC_Set_Speed
+#define IIC_SPEED_STANDARD  0 //100 kHz
+#define IIC_SPEED_FAST      1 //400 kHz
+#define IIC_SPEED_FAST_PLUS 2 //1 MHz, bit-banged bus only
+#ifndef IIC_SPEED
+#define IIC_SPEED IIC_SPEED_STANDARD //speed set by IIC_Init
+#endif
+#define IIC_STRETCH_TIMEOUT 25 //ms a device may hold SCL low
+
+// transaction results
+#define IIC_OK          0 //success
+#define IIC_ERR_NACK    1 //address or data not acknowledged
+#define IIC_ERR_TIMEOUT 2 //bus held low by a device
+#define IIC_ERR_BUSY    3 //bus locked by another task
+
+/**
+ * I2C timings, in ns in the speed profiles and in core clock cycles in a bus
+ *
+ */
+typedef struct _IIC_Timing
+{
+    uint32_t low;    //tLOW, SCL low
+    uint32_t high;   //tHIGH, SCL high
+    uint32_t su_sta; //tSU;STA, repeated start setup
+    uint32_t hd_sta; //tHD;STA, start hold
+    uint32_t su_sto; //tSU;STO, stop setup
+    uint32_t buf;    //tBUF, bus free between stop and start
+} IIC_Timing;
+
+/**
+ * A bit-banged bus, any two GPIO pins with pull-ups
+ *
+ */
+typedef struct _IIC_Bus
+{
+    GPIO_TypeDef *scl_port;
+    uint16_t scl_pin;
+    GPIO_TypeDef *sda_port;
+    uint16_t sda_pin;
+    IIC_Timing cycles;      //timing of the current speed
+    uint32_t stretch;       //clock stretching limit in cycles
+    uint8_t speed;          //IIC_SPEED_xxx
+    uint8_t timeout;        //SCL held low since the last start
+    volatile uint32_t lock; //0: free, taken with LDREX/STREX
+} IIC_Bus;
+
+/**
+ * A device on a bus, transactions lock the bus, run at the device speed
+ * (the bus speed is restored after) and are retried on NACK (e.g. an
+ * EEPROM busy with a write cycle)
+ *
+ */
+typedef struct _IIC_Device
+{
+    IIC_Bus *bus;
+    uint8_t addr;    //device address (8 bit, write)
+    uint8_t speed;   //IIC_SPEED_xxx
+    uint8_t regsize; //1 or 2 bytes register address
+    uint8_t retries; //extra attempts after a NACK
+} IIC_Device;
+
+#define IIC_DEV_NOREG 0XFFFFFFFF
+
+extern IIC_Bus IIC_BUS1; //PH4/PH5, bus of the IIC_* functions (bit-banged build), IIC_Write,
+                         //IIC_Read, IIC_Write_Reg and IIC_Read_Reg take its lock
 
 /**
  * @brief initialization IIC
@@ -22,6 +90,15 @@
  */
 void IIC_Init(void);                
 
+/**
+ * @brief set the bus speed, SCL high/low and setup/hold times follow the
+ *        I2C minimums of the speed mode, counted in core clock cycles
+ *
+ * @param
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ */
+void IIC_Set_Speed(uint8_t speed);
+
 /**
  * @brief  Data transfer is initiated with a start condition (S) signaled by
  *         SDA being pulled low while SCL stays high.
@@ -53,6 +130,8 @@ void IIC_NAck(void);
 /**
  * @brief Wait ACK Signal
  *
+ * @return 0: ack, 1: nack or SCL stretched past IIC_STRETCH_TIMEOUT,
+ *         a stop is sent
  */
 uint8_t IIC_Wait_Ack(void); 
 
@@ -94,5 +173,140 @@ void IIC_Write_One_Byte(uint8_t addr,uint8_t data);
  */   
 uint8_t IIC_Read_One_Byte(uint8_t addr);	 
 
+/**
+ * @brief  Write data to device, one address phase
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: the data
+ * len: the length of data, 0 only probes the address
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Write(uint8_t addr, const uint8_t *pData, uint16_t len);
+
+/**
+ * @brief  Read data from device, the last byte is nACKed
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Read(uint8_t addr, uint8_t *pData, uint16_t len);
+
+/**
+ * @brief  Write device registers: address, register address and the data
+ *         in one burst
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address, sent MSB first
+ * regsize: 1 or 2 bytes register address
+ * pData: the data
+ * len: the length of data
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Write_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len);
+
+/**
+ * @brief  Read device registers: the register address is written, then
+ *         read after a repeated start
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address, sent MSB first
+ * regsize: 1 or 2 bytes register address
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Read_Reg(uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len);
+
+// bus instances
+
+/**
+ * @brief  initialization a bit-banged bus
+ *
+ * @param
+ * bus: the bus
+ * scl_port, scl_pin: SCL pin, e.g. GPIOH, GPIO_PIN_4
+ * sda_port, sda_pin: SDA pin
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ */
+void IIC_Bus_Init(IIC_Bus *bus, GPIO_TypeDef *scl_port, uint16_t scl_pin, GPIO_TypeDef *sda_port, uint16_t sda_pin, uint8_t speed);
+
+/**
+ * @brief  set the speed of a bus
+ *
+ * @param
+ * bus: the bus
+ * speed: IIC_SPEED_STANDARD, IIC_SPEED_FAST or IIC_SPEED_FAST_PLUS
+ */
+void IIC_Bus_Set_Speed(IIC_Bus *bus, uint8_t speed);
+
+/**
+ * @brief  IIC_Write, IIC_Read, IIC_Write_Reg and IIC_Read_Reg on a bus,
+ *         the caller holds the bus
+ *
+ * @return IIC_OK, IIC_ERR_NACK or IIC_ERR_TIMEOUT
+ */
+uint8_t IIC_Bus_Write(IIC_Bus *bus, uint8_t addr, const uint8_t *pData, uint16_t len);
+uint8_t IIC_Bus_Read(IIC_Bus *bus, uint8_t addr, uint8_t *pData, uint16_t len);
+uint8_t IIC_Bus_Write_Reg(IIC_Bus *bus, uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len);
+uint8_t IIC_Bus_Read_Reg(IIC_Bus *bus, uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len);
+
+/**
+ * @brief  check if a device acknowledges its address
+ *
+ * @param
+ * bus: the bus
+ * addr: device address (8 bit, write)
+ *
+ * @return 0: present, 1: no answer
+ */
+uint8_t IIC_Bus_Probe(IIC_Bus *bus, uint8_t addr);
+
+/**
+ * @brief  probe the 7 bit addresses 0x08 ~ 0x77
+ *
+ * @param
+ * bus: the bus
+ * found: the 8 bit addresses that answered
+ * max: size of found
+ *
+ * @return number of devices found
+ */
+uint8_t IIC_Bus_Scan(IIC_Bus *bus, uint8_t *found, uint8_t max);
+
+/**
+ * @brief  take the bus lock, does not wait
+ *
+ * @return 0: locked, 1: the bus is in use
+ */
+uint8_t IIC_Bus_Lock(IIC_Bus *bus);
+
+/**
+ * @brief  release the bus lock
+ *
+ */
+void IIC_Bus_Unlock(IIC_Bus *bus);
+
+// devices, each call locks the bus and uses the device speed and retries
+
+/**
+ * @brief  Write or read data / registers of a device
+ *
+ * @return IIC_OK, IIC_ERR_NACK, IIC_ERR_TIMEOUT or IIC_ERR_BUSY
+ */
+uint8_t IIC_Dev_Write(IIC_Device *dev, const uint8_t *pData, uint16_t len);
+uint8_t IIC_Dev_Read(IIC_Device *dev, uint8_t *pData, uint16_t len);
+uint8_t IIC_Dev_Write_Reg(IIC_Device *dev, uint16_t reg, const uint8_t *pData, uint16_t len);
+uint8_t IIC_Dev_Read_Reg(IIC_Device *dev, uint16_t reg, uint8_t *pData, uint16_t len);
+
 #endif
 
@@ -0,0 +1,449 @@
+#include "iic_hw.h"
+#include "iic.h"
+#include "string.h"
+
+I2C_HandleTypeDef I2C2_Handler;		 // I2C2 Handle
+DMA_HandleTypeDef I2C2_TxDMA_Handler; // I2C2 TX DMA Handle
+DMA_HandleTypeDef I2C2_RxDMA_Handler; // I2C2 RX DMA Handle
+
+/**
+ * @brief initialization I2C2, DMA and interrupts
+ *
+ */
+void IIC_HW_Init(void)
+{
+	I2C2_Handler.Instance = I2C2;
+	I2C2_Handler.Init.ClockSpeed = IIC_HW_SPEED;
+	I2C2_Handler.Init.DutyCycle = I2C_DUTYCYCLE_2;
+	I2C2_Handler.Init.OwnAddress1 = 0;
+	I2C2_Handler.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+	I2C2_Handler.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+	I2C2_Handler.Init.OwnAddress2 = 0;
+	I2C2_Handler.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+	I2C2_Handler.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+	HAL_I2C_Init(&I2C2_Handler);
+}
+
+/**
+ * @brief low level HAL initialization I2C
+ *
+ */
+void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c)
+{
+	GPIO_InitTypeDef GPIO_Initure;
+
+	__HAL_RCC_GPIOH_CLK_ENABLE();
+	__HAL_RCC_I2C2_CLK_ENABLE();
+
+	// PH4 (SCL), PH5 (SDA)
+	GPIO_Initure.Pin = GPIO_PIN_4 | GPIO_PIN_5;
+	GPIO_Initure.Mode = GPIO_MODE_AF_OD; // open drain
+	GPIO_Initure.Pull = GPIO_PULLUP;
+	GPIO_Initure.Speed = GPIO_SPEED_FAST;
+	GPIO_Initure.Alternate = GPIO_AF4_I2C2;
+	HAL_GPIO_Init(GPIOH, &GPIO_Initure);
+
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	// I2C2_TX: DMA1 Stream7 Channel7
+	I2C2_TxDMA_Handler.Instance = DMA1_Stream7;
+	I2C2_TxDMA_Handler.Init.Channel = DMA_CHANNEL_7;
+	I2C2_TxDMA_Handler.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	I2C2_TxDMA_Handler.Init.PeriphInc = DMA_PINC_DISABLE;
+	I2C2_TxDMA_Handler.Init.MemInc = DMA_MINC_ENABLE;
+	I2C2_TxDMA_Handler.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	I2C2_TxDMA_Handler.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	I2C2_TxDMA_Handler.Init.Mode = DMA_NORMAL;
+	I2C2_TxDMA_Handler.Init.Priority = DMA_PRIORITY_MEDIUM;
+	I2C2_TxDMA_Handler.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	HAL_DMA_DeInit(&I2C2_TxDMA_Handler);
+	HAL_DMA_Init(&I2C2_TxDMA_Handler);
+	__HAL_LINKDMA(hi2c, hdmatx, I2C2_TxDMA_Handler);
+
+	// I2C2_RX: DMA1 Stream2 Channel7
+	I2C2_RxDMA_Handler.Instance = DMA1_Stream2;
+	I2C2_RxDMA_Handler.Init.Channel = DMA_CHANNEL_7;
+	I2C2_RxDMA_Handler.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	I2C2_RxDMA_Handler.Init.PeriphInc = DMA_PINC_DISABLE;
+	I2C2_RxDMA_Handler.Init.MemInc = DMA_MINC_ENABLE;
+	I2C2_RxDMA_Handler.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	I2C2_RxDMA_Handler.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	I2C2_RxDMA_Handler.Init.Mode = DMA_NORMAL;
+	I2C2_RxDMA_Handler.Init.Priority = DMA_PRIORITY_HIGH;
+	I2C2_RxDMA_Handler.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	HAL_DMA_DeInit(&I2C2_RxDMA_Handler);
+	HAL_DMA_Init(&I2C2_RxDMA_Handler);
+	__HAL_LINKDMA(hi2c, hdmarx, I2C2_RxDMA_Handler);
+
+	HAL_NVIC_SetPriority(I2C2_EV_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(I2C2_EV_IRQn);
+	HAL_NVIC_SetPriority(I2C2_ER_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(I2C2_ER_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Stream7_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+}
+
+/**
+ * @brief I2C2 event interrupt
+ *
+ */
+void I2C2_EV_IRQHandler(void)
+{
+	HAL_I2C_EV_IRQHandler(&I2C2_Handler);
+}
+
+/**
+ * @brief I2C2 error interrupt
+ *
+ */
+void I2C2_ER_IRQHandler(void)
+{
+	HAL_I2C_ER_IRQHandler(&I2C2_Handler);
+}
+
+/**
+ * @brief I2C2 RX DMA interrupt
+ *
+ */
+void DMA1_Stream2_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&I2C2_RxDMA_Handler);
+}
+
+/**
+ * @brief I2C2 TX DMA interrupt
+ *
+ */
+void DMA1_Stream7_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&I2C2_TxDMA_Handler);
+}
+
+/**
+ * @brief wait for a started transfer to complete
+ * On timeout the controller is reinitialized to release the bus.
+ *
+ * @param
+ * status: result of the HAL start call
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+static uint8_t IIC_HW_Wait(HAL_StatusTypeDef status)
+{
+	uint32_t tickstart;
+	if (status != HAL_OK)
+	{
+		return 1;
+	}
+	tickstart = HAL_GetTick();
+	while (HAL_I2C_GetState(&I2C2_Handler) != HAL_I2C_STATE_READY)
+	{
+		if (HAL_GetTick() - tickstart > IIC_HW_TIMEOUT)
+		{
+			HAL_I2C_DeInit(&I2C2_Handler);
+			HAL_I2C_Init(&I2C2_Handler);
+			return 1;
+		}
+	}
+	return HAL_I2C_GetError(&I2C2_Handler) != HAL_I2C_ERROR_NONE;
+}
+
+/**
+ * @brief write data to a device
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: the data
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Write(uint8_t addr, const uint8_t *pData, uint16_t len)
+{
+	if (len == 0)
+	{
+		return HAL_I2C_IsDeviceReady(&I2C2_Handler, addr, 1, IIC_HW_TIMEOUT) != HAL_OK;
+	}
+	if (len >= IIC_HW_DMA_MIN)
+	{
+		return IIC_HW_Wait(HAL_I2C_Master_Transmit_DMA(&I2C2_Handler, addr, (uint8_t *)pData, len));
+	}
+	return IIC_HW_Wait(HAL_I2C_Master_Transmit_IT(&I2C2_Handler, addr, (uint8_t *)pData, len));
+}
+
+/**
+ * @brief read data from a device
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Read(uint8_t addr, uint8_t *pData, uint16_t len)
+{
+	if (len >= IIC_HW_DMA_MIN)
+	{
+		return IIC_HW_Wait(HAL_I2C_Master_Receive_DMA(&I2C2_Handler, addr, pData, len));
+	}
+	return IIC_HW_Wait(HAL_I2C_Master_Receive_IT(&I2C2_Handler, addr, pData, len));
+}
+
+/**
+ * @brief write device registers
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address
+ * regsize: 1 or 2 bytes register address
+ * pData: the data
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Mem_Write(uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len)
+{
+	uint16_t size = regsize == 2 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT;
+	if (len >= IIC_HW_DMA_MIN)
+	{
+		return IIC_HW_Wait(HAL_I2C_Mem_Write_DMA(&I2C2_Handler, addr, reg, size, (uint8_t *)pData, len));
+	}
+	return IIC_HW_Wait(HAL_I2C_Mem_Write_IT(&I2C2_Handler, addr, reg, size, (uint8_t *)pData, len));
+}
+
+/**
+ * @brief read device registers
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address
+ * regsize: 1 or 2 bytes register address
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Mem_Read(uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len)
+{
+	uint16_t size = regsize == 2 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT;
+	if (len >= IIC_HW_DMA_MIN)
+	{
+		return IIC_HW_Wait(HAL_I2C_Mem_Read_DMA(&I2C2_Handler, addr, reg, size, pData, len));
+	}
+	return IIC_HW_Wait(HAL_I2C_Mem_Read_IT(&I2C2_Handler, addr, reg, size, pData, len));
+}
+
+#if IIC_USE_HW
+
+/**
+ * iic.h compatibility layer
+ *
+ * IIC_Start ... IIC_Stop is replayed as HAL sequential transfers: the
+ * first byte after a start is the address, written bytes are buffered,
+ * a repeated start or IIC_Stop sends them. Each IIC_Read_Byte is one
+ * received frame, the last one (nACK) ends with a stop.
+ *
+ * A write address is sent at once as an empty first frame, so the
+ * IIC_Wait_Ack that follows it reports whether the device acked, as in an
+ * acknowledge polling loop. The buffered bytes follow as next frames of
+ * the same transfer, without another start. A read address goes out with
+ * the first IIC_Read_Byte, a NACK of it reads 0XFF and fails the next
+ * IIC_Wait_Ack.
+ *
+ */
+#define IIC_HW_IDLE 0  // no transfer
+#define IIC_HW_ADDR 1  // start sent, next byte is the address
+#define IIC_HW_WRITE 2 // writing, bytes buffered
+#define IIC_HW_READ 3  // reading
+
+static uint8_t IIC_HW_State = IIC_HW_IDLE;
+static uint8_t IIC_HW_Addr;
+static uint8_t IIC_HW_Buf[IIC_HW_BUF_SIZE];
+static uint16_t IIC_HW_Len = 0;
+static uint8_t IIC_HW_Sent = 0; // a frame of this address phase was sent
+static uint8_t IIC_HW_Err = 0;
+
+/**
+ * @brief send the buffered bytes
+ *
+ * @param
+ * stop: 1: end with a stop, 0: keep the bus for the next frame
+ *
+ */
+static void IIC_HW_Flush(uint8_t stop)
+{
+	uint32_t opt;
+	HAL_StatusTypeDef status;
+	if (IIC_HW_Err)
+	{
+		return;
+	}
+	if (stop)
+	{
+		opt = IIC_HW_Sent ? I2C_LAST_FRAME : I2C_FIRST_AND_LAST_FRAME;
+	}
+	else
+	{
+		opt = IIC_HW_Sent ? I2C_NEXT_FRAME : I2C_FIRST_FRAME;
+	}
+	if (IIC_HW_Len >= IIC_HW_DMA_MIN)
+	{
+		status = HAL_I2C_Master_Seq_Transmit_DMA(&I2C2_Handler, IIC_HW_Addr, IIC_HW_Buf, IIC_HW_Len, opt);
+	}
+	else
+	{
+		status = HAL_I2C_Master_Seq_Transmit_IT(&I2C2_Handler, IIC_HW_Addr, IIC_HW_Buf, IIC_HW_Len, opt);
+	}
+	IIC_HW_Err = IIC_HW_Wait(status);
+	IIC_HW_Len = 0;
+	IIC_HW_Sent = 1;
+}
+
+/**
+ * @brief initialization IIC
+ *
+ */
+void IIC_Init(void)
+{
+	IIC_HW_Init();
+}
+
+/**
+ * @brief start or repeated start
+ *
+ */
+void IIC_Start(void)
+{
+	if (IIC_HW_State == IIC_HW_IDLE)
+	{
+		IIC_HW_Err = 0;
+		IIC_HW_Len = 0;
+		IIC_HW_Sent = 0;
+	}
+	IIC_HW_State = IIC_HW_ADDR;
+}
+
+/**
+ * @brief stop, sends the buffered bytes
+ *
+ */
+void IIC_Stop(void)
+{
+	if (IIC_HW_State == IIC_HW_WRITE)
+	{
+		IIC_HW_Flush(1);
+	}
+	else if (IIC_HW_State == IIC_HW_READ && IIC_HW_Sent && !IIC_HW_Err)
+	{
+		SET_BIT(I2C2->CR1, I2C_CR1_STOP); // the last byte was acked
+	}
+	IIC_HW_State = IIC_HW_IDLE;
+}
+
+/**
+ * @brief result of the last transfer, sends a stop on error
+ *
+ * @return 0: ack, 1: nack or bus error
+ *
+ */
+uint8_t IIC_Wait_Ack(void)
+{
+	if (IIC_HW_Err)
+	{
+		IIC_HW_State = IIC_HW_IDLE;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief acks are sent by IIC_Read_Byte
+ *
+ */
+void IIC_Ack(void)
+{
+}
+
+/**
+ * @brief acks are sent by IIC_Read_Byte
+ *
+ */
+void IIC_NAck(void)
+{
+}
+
+/**
+ * @brief buffer a byte, the first byte after a start is the address
+ *
+ * @param
+ * txd: the send data
+ */
+void IIC_Send_Byte(uint8_t txd)
+{
+	if (IIC_HW_State == IIC_HW_ADDR)
+	{
+		if (IIC_HW_Len || IIC_HW_Sent)
+		{
+			IIC_HW_Flush(0); // repeated start, send the register address
+		}
+		IIC_HW_Addr = txd & 0XFE;
+		IIC_HW_Len = 0;
+		IIC_HW_Sent = 0;
+		IIC_HW_State = (txd & 0X01) ? IIC_HW_READ : IIC_HW_WRITE;
+		if (IIC_HW_State == IIC_HW_WRITE && !IIC_HW_Err)
+		{
+			// start and address now, for IIC_Wait_Ack
+			IIC_HW_Err = IIC_HW_Wait(HAL_I2C_Master_Seq_Transmit_IT(&I2C2_Handler, IIC_HW_Addr, IIC_HW_Buf, 0, I2C_FIRST_FRAME));
+			IIC_HW_Sent = 1;
+		}
+		return;
+	}
+	if (IIC_HW_State != IIC_HW_WRITE)
+	{
+		return;
+	}
+	if (IIC_HW_Len == IIC_HW_BUF_SIZE)
+	{
+		IIC_HW_Flush(0);
+	}
+	IIC_HW_Buf[IIC_HW_Len++] = txd;
+}
+
+/**
+ * @brief Read a byte from I2C bus
+ *
+ * @param
+ * ack: when ack=1, send ACK, when ack=0, send nACK and stop
+ *
+ * @return read a btye from I2C bus
+ */
+uint8_t IIC_Read_Byte(unsigned char ack)
+{
+	uint8_t receive = 0XFF;
+	uint32_t opt;
+	if (IIC_HW_State != IIC_HW_READ || IIC_HW_Err)
+	{
+		return receive;
+	}
+	if (ack)
+	{
+		opt = IIC_HW_Sent ? I2C_NEXT_FRAME : I2C_FIRST_FRAME;
+	}
+	else
+	{
+		opt = IIC_HW_Sent ? I2C_LAST_FRAME : I2C_FIRST_AND_LAST_FRAME;
+	}
+	IIC_HW_Err = IIC_HW_Wait(HAL_I2C_Master_Seq_Receive_IT(&I2C2_Handler, IIC_HW_Addr, &receive, 1, opt));
+	IIC_HW_Sent = ack;
+	return receive;
+}
+
+#endif
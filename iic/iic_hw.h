@@ -0,0 +1,98 @@
+/*
+ * iic_hw.h
+ *
+ */
+
+#ifndef _IIC_HW_H_
+#define _IIC_HW_H_
+#include "sys.h"
+
+/**
+ * I2C2 controller backend of the iic module
+ *
+ * PH4 (SCL) and PH5 (SDA) are the I2C2 pins (AF4), so the same bus can be
+ * driven by the controller instead of bit-banging. Completion is interrupt
+ * driven, transfers of IIC_HW_DMA_MIN bytes or more use DMA:
+ * I2C2_RX: DMA1 Stream2 Channel7, I2C2_TX: DMA1 Stream7 Channel7
+ *
+ * With IIC_USE_HW the IIC_* primitives of iic.h are a compatibility layer:
+ * a write address goes out at once, the bytes sent after it are buffered
+ * and go out at IIC_Stop or at a repeated start, so IIC_Wait_Ack reports
+ * the address ACK at once and a data NACK only at that point.
+ *
+ */
+#ifndef IIC_USE_HW
+#define IIC_USE_HW 0 //1: iic.h primitives use the I2C2 controller
+#endif
+#define IIC_HW_SPEED    400000 //SCL Hz, max 400000 (no Fast-mode Plus on STM32F4)
+#define IIC_HW_DMA_MIN  16     //shorter transfers use interrupts only
+#define IIC_HW_BUF_SIZE 64     //compatibility layer write buffer
+#define IIC_HW_TIMEOUT  100    //ms
+
+extern I2C_HandleTypeDef I2C2_Handler;
+
+/**
+ * @brief initialization I2C2, DMA and interrupts
+ *
+ */
+void IIC_HW_Init(void);
+
+/**
+ * @brief write data to a device
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: the data
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Write(uint8_t addr, const uint8_t *pData, uint16_t len);
+
+/**
+ * @brief read data from a device
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Read(uint8_t addr, uint8_t *pData, uint16_t len);
+
+/**
+ * @brief write device registers, the register address and the data are
+ * sent in one transfer
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address
+ * regsize: 1 or 2 bytes register address
+ * pData: the data
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Mem_Write(uint8_t addr, uint16_t reg, uint8_t regsize, const uint8_t *pData, uint16_t len);
+
+/**
+ * @brief read device registers, the register address is written and read
+ * after a repeated start
+ *
+ * @param
+ * addr: device address (8 bit, write)
+ * reg: register address
+ * regsize: 1 or 2 bytes register address
+ * pData: read to buffer
+ * len: the length of data
+ *
+ * @return 0: success, 1: NACK, bus error or timeout
+ *
+ */
+uint8_t IIC_HW_Mem_Read(uint8_t addr, uint16_t reg, uint8_t regsize, uint8_t *pData, uint16_t len);
+
+#endif
@@ -2,6 +2,9 @@
 #include "stdlib.h"
 #include "oledfont.h"
 #include "delay.h"
+#include "iic.h"
+#include "string.h"
+#include "trace.h"
 
 /**
  *128 x 64 Dot Matrix
@@ -16,7 +19,85 @@
  *[7]0 1 2 3 ... 127
  */
 
-uint8_t OLED_GRAM[128][8];
+uint8_t OLED_GRAM[8][128];
+
+// OLED_Rect_Op operations
+#define OLED_OP_CLEAR 0
+#define OLED_OP_SET 1
+#define OLED_OP_INVERT 2
+
+// changed columns of each page since the last refresh, clean if start > end
+static uint8_t OLED_DirtyStart[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+static uint8_t OLED_DirtyEnd[8] = {127, 127, 127, 127, 127, 127, 127, 127};
+
+/**
+ * @brief mark columns of a page as changed
+ *
+ * @param
+ * page: page (0~7)
+ * x1: start column
+ * x2: end column
+ *
+ */
+static void OLED_Mark_Dirty(uint8_t page, uint8_t x1, uint8_t x2)
+{
+	if (OLED_DirtyStart[page] > OLED_DirtyEnd[page])
+	{
+		OLED_DirtyStart[page] = x1;
+		OLED_DirtyEnd[page] = x2;
+		return;
+	}
+	if (x1 < OLED_DirtyStart[page])
+	{
+		OLED_DirtyStart[page] = x1;
+	}
+	if (x2 > OLED_DirtyEnd[page])
+	{
+		OLED_DirtyEnd[page] = x2;
+	}
+}
+
+/**
+ * BSRR images of the data bus, D[7:0] is split over three ports:
+ * D[3:0]-->PC[9:6], D4-->PC11, D5-->PD3, D[7:6]-->PB[9:8]
+ * Each image sets the 1 bits and resets the 0 bits of its port in one
+ * write, without a read-modify-write of ODR.
+ *
+ */
+static uint32_t OLED_BsrrC[32]; // D[4:0]
+static uint32_t OLED_BsrrB[4];	// D[7:6]
+static uint32_t OLED_WrCycles;	// WR (8080) or SCLK (SPI) low and high time, core clock cycles
+#define OLED_BSRR_D(data) ((data) & 0X20 ? 1 << 3 : 1 << (3 + 16)) // D5
+#define OLED_BSRR(set, mask) ((set) | (((mask) & ~(set)) << 16))
+
+/**
+ * @brief size the WR strobe or the SCLK phases from SystemCoreClock, half
+ * of OLED_8080_TCYCLE or OLED_SPI_TCYCLE each, and build the data bus
+ * BSRR lookup tables of the 8080 interface
+ *
+ */
+static void OLED_Bus_Init(void)
+{
+	uint8_t i;
+	uint32_t set;
+	uint32_t tcycle = OLED_MODE == OLED_SPI ? OLED_SPI_TCYCLE : OLED_8080_TCYCLE;
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	OLED_WrCycles = (tcycle / 2 * (SystemCoreClock / 1000000) + 999) / 1000;
+	if (OLED_MODE != OLED_PARALLEL)
+	{
+		return;
+	}
+	for (i = 0; i < 32; i++)
+	{
+		set = ((i & 0X0F) << 6) | ((i & 0X10) << 7);
+		OLED_BsrrC[i] = OLED_BSRR(set, (0XF << 6) | (1 << 11));
+	}
+	for (i = 0; i < 4; i++)
+	{
+		OLED_BsrrB[i] = OLED_BSRR(i << 8, 3 << 8);
+	}
+}
 
 /**
  * @brief initialization OLED
@@ -25,54 +106,72 @@ uint8_t OLED_GRAM[128][8];
 void OLED_Init(void)
 {
 	RCC->AHB1ENR |= 0X8F; // Enable PORTA~F,PORTH clock
+	GPIO_Set(GPIOA, PIN15, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU); // config PA15 (RST)
 	if (OLED_MODE == OLED_PARALLEL)
 	{																													 // using 8080 interface
-		GPIO_Set(GPIOA, PIN15, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU);							 // config PA15
 		GPIO_Set(GPIOB, PIN3 | PIN4 | PIN7 | PIN8 | PIN9, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU);	 // config PB3,4,7,8,9
 		GPIO_Set(GPIOC, PIN6 | PIN7 | PIN8 | PIN9 | PIN11, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU); // coffig PC6~9,PC11
 		GPIO_Set(GPIOD, PIN3, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU);								 // config PD3
 		GPIO_Set(GPIOH, PIN8, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU);								 // config PH8
+		OLED_Bus_Init();
 		OLED_WR = 1;
 		OLED_RD = 1;
 
 		OLED_CS = 1;
 		OLED_RS = 1;
-
-		OLED_RST = 0;
-		delay_ms(100);
-		OLED_RST = 1;
-
-		OLED_WR_Byte(0xAE, OLED_CMD); // Send command AEh for display OFF
-		OLED_WR_Byte(0xD5, OLED_CMD); // Set Display Clock Divide Ratio/ Oscillator Frequency (D5h)
-		OLED_WR_Byte(80, OLED_CMD);	  //[3:0], the division factor;[7:4], frequency
-		OLED_WR_Byte(0xA8, OLED_CMD); // Set Multiplex Ratio
-		OLED_WR_Byte(0X3F, OLED_CMD); // default 0X3F(1/64)
-		OLED_WR_Byte(0xD3, OLED_CMD); // Set Display Offset
-		OLED_WR_Byte(0X00, OLED_CMD); // default 0
-
-		OLED_WR_Byte(0x40, OLED_CMD); // Set Display Start Line (X5X4X3X2X1X0 of 40h~7Fh) < B[6:0]
-
-		OLED_WR_Byte(0x8D, OLED_CMD); // The Charge Pump must be enabled by the following command: 8Dh
-		OLED_WR_Byte(0x14, OLED_CMD); // Charge Pump Setting 14h ; Enable Charge Pump AFh; Display ON
-		OLED_WR_Byte(0x20, OLED_CMD); // Set Memory Addressing Mode
-		OLED_WR_Byte(0x02, OLED_CMD);
-		OLED_WR_Byte(0xA1, OLED_CMD); // Set Segment Re-map,bit0:0,0->0;1,0->127;
-		OLED_WR_Byte(0xC0, OLED_CMD); // Set COM Output Scan Direction
-		OLED_WR_Byte(0xDA, OLED_CMD); // Set COM Pins Hardware Configuration
-		OLED_WR_Byte(0x12, OLED_CMD);
-
-		OLED_WR_Byte(0x81, OLED_CMD); // Set Contrast Control for BANK0 (81h)
-		OLED_WR_Byte(0xEF, OLED_CMD); // 1~255(00h-FFh); default 0X7F
-		OLED_WR_Byte(0xD9, OLED_CMD); // Set Pre-charge Period
-		OLED_WR_Byte(0xf1, OLED_CMD); //[3:0],PHASE 1;[7:4],PHASE 2;
-		OLED_WR_Byte(0xDB, OLED_CMD); // Set Vcomh Deselect Level (DBh)
-		OLED_WR_Byte(0x30, OLED_CMD); //[6:4] 000,0.65*vcc;001,0.77*vcc;011,0.83*vcc;
-
-		OLED_WR_Byte(0xA4, OLED_CMD); // Entire Dispaly ON;bit0:1,ON;0,OFF;(/)
-		OLED_WR_Byte(0xA6, OLED_CMD); // Set Normal/Inverse Dispaly
-		OLED_WR_Byte(0xAF, OLED_CMD); // Set Dispaly ON/OFF
-		OLED_Clear();
 	}
+	else if (OLED_MODE == OLED_SPI)
+	{ // using 4-wire SPI, D0: SCLK, D1: SDIN
+		GPIO_Set(GPIOB, PIN4 | PIN7, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU); // config PB4,7
+		GPIO_Set(GPIOC, PIN6 | PIN7, GPIO_MODE_OUT, GPIO_OTYPE_PP, GPIO_SPEED_100M, GPIO_PUPD_PU); // config PC6,7
+		OLED_Bus_Init();
+		OLED_CS = 1;
+		OLED_RS = 1;
+		OLED_SCLK = 1;
+	}
+	else
+	{ // using IIC bus of the iic module
+		IIC_Init();
+	}
+
+	OLED_RST = 0;
+	delay_ms(100);
+	OLED_RST = 1;
+
+	OLED_WR_Byte(0xAE, OLED_CMD); // Send command AEh for display OFF
+	OLED_WR_Byte(0xD5, OLED_CMD); // Set Display Clock Divide Ratio/ Oscillator Frequency (D5h)
+	OLED_WR_Byte(80, OLED_CMD);	  //[3:0], the division factor;[7:4], frequency
+	OLED_WR_Byte(0xA8, OLED_CMD); // Set Multiplex Ratio
+	OLED_WR_Byte(0X3F, OLED_CMD); // default 0X3F(1/64)
+	OLED_WR_Byte(0xD3, OLED_CMD); // Set Display Offset
+	OLED_WR_Byte(0X00, OLED_CMD); // default 0
+
+	OLED_WR_Byte(0x40, OLED_CMD); // Set Display Start Line (X5X4X3X2X1X0 of 40h~7Fh) < B[6:0]
+
+	OLED_WR_Byte(0x8D, OLED_CMD); // The Charge Pump must be enabled by the following command: 8Dh
+	OLED_WR_Byte(0x14, OLED_CMD); // Charge Pump Setting 14h ; Enable Charge Pump AFh; Display ON
+	OLED_WR_Byte(0x20, OLED_CMD); // Set Memory Addressing Mode
+#if OLED_HORIZONTAL_ADDR
+	OLED_WR_Byte(0x00, OLED_CMD); // horizontal
+#else
+	OLED_WR_Byte(0x02, OLED_CMD); // page
+#endif
+	OLED_WR_Byte(0xA1, OLED_CMD); // Set Segment Re-map,bit0:0,0->0;1,0->127;
+	OLED_WR_Byte(0xC0, OLED_CMD); // Set COM Output Scan Direction
+	OLED_WR_Byte(0xDA, OLED_CMD); // Set COM Pins Hardware Configuration
+	OLED_WR_Byte(0x12, OLED_CMD);
+
+	OLED_WR_Byte(0x81, OLED_CMD); // Set Contrast Control for BANK0 (81h)
+	OLED_WR_Byte(0xEF, OLED_CMD); // 1~255(00h-FFh); default 0X7F
+	OLED_WR_Byte(0xD9, OLED_CMD); // Set Pre-charge Period
+	OLED_WR_Byte(0xf1, OLED_CMD); //[3:0],PHASE 1;[7:4],PHASE 2;
+	OLED_WR_Byte(0xDB, OLED_CMD); // Set Vcomh Deselect Level (DBh)
+	OLED_WR_Byte(0x30, OLED_CMD); //[6:4] 000,0.65*vcc;001,0.77*vcc;011,0.83*vcc;
+
+	OLED_WR_Byte(0xA4, OLED_CMD); // Entire Dispaly ON;bit0:1,ON;0,OFF;(/)
+	OLED_WR_Byte(0xA6, OLED_CMD); // Set Normal/Inverse Dispaly
+	OLED_WR_Byte(0xAF, OLED_CMD); // Set Dispaly ON/OFF
+	OLED_Clear();
 }
 
 //Դ浽LCD
@@ -86,13 +185,9 @@ void OLED_Init(void)
  */
 void OLED_Data_Out(uint8_t data)
 {
-	uint16_t dat = data & 0X0F;
-	GPIOC->ODR &= ~(0XF << 6);		// clear bit6 to  bit9
-	GPIOC->ODR |= dat << 6;			// D[3:0]-->PC[9:6]
-	PCout(11) = (data >> 4) & 0X01; // D4
-	PDout(3) = (data >> 5) & 0X01;	// D5
-	PBout(8) = (data >> 6) & 0X01;	// D6
-	PBout(9) = (data >> 7) & 0X01;	// D7
+	GPIOC->BSRR = OLED_BsrrC[data & 0X1F]; // D[4:0]
+	GPIOD->BSRR = OLED_BSRR_D(data);	   // D5
+	GPIOB->BSRR = OLED_BsrrB[data >> 6];   // D[7:6]
 }
 
 /**
@@ -105,23 +200,96 @@ void OLED_Data_Out(uint8_t data)
  */
 void OLED_WR_Byte(uint8_t data, uint8_t cmd)
 {
-	OLED_Data_Out(data);
+	OLED_WR_Bytes(&data, 1, cmd);
+}
 
-	// commnad
-	if (cmd == OLED_CMD)
+/**
+ * @brief write a block of bytes to OLED in one bus transaction
+ *
+ * @param
+ * buf: data or commands
+ * len: the length of buf
+ * cmd:  data or command
+ *
+ */
+void OLED_WR_Bytes(const uint8_t *buf, uint16_t len, uint8_t cmd)
+{
+	uint16_t i;
+	uint8_t t, dat;
+	uint32_t start;
+
+	TRACE_XFER();
+	if (OLED_MODE == OLED_PARALLEL)
 	{
+		OLED_RS = (cmd == OLED_DATA); // DC: 0: command, 1: data
+		OLED_CS = 0;
+		for (i = 0; i < len; i++)
+		{
+			// WR low while the data is set up, latched on the rising edge
+			GPIOH->BSRR = 1 << (8 + 16);
+			start = DWT->CYCCNT;
+			OLED_Data_Out(buf[i]);
+			while (DWT->CYCCNT - start < OLED_WrCycles)
+			{
+			}
+			GPIOH->BSRR = 1 << 8;
+			start = DWT->CYCCNT;
+			while (DWT->CYCCNT - start < OLED_WrCycles)
+			{
+			}
+		}
+		OLED_CS = 1;
 		OLED_RS = 1;
 	}
-	else // data
+	else if (OLED_MODE == OLED_SPI)
 	{
-		OLED_RS = 0;
+		OLED_RS = (cmd == OLED_DATA);
+		OLED_CS = 0;
+		for (i = 0; i < len; i++)
+		{
+			dat = buf[i];
+			for (t = 0; t < 8; t++) // MSB first, sampled on the rising edge
+			{
+				OLED_SCLK = 0;
+				start = DWT->CYCCNT;
+				OLED_SDIN = (dat & 0X80) >> 7;
+				dat <<= 1;
+				while (DWT->CYCCNT - start < OLED_WrCycles)
+				{
+				}
+				OLED_SCLK = 1;
+				start = DWT->CYCCNT;
+				while (DWT->CYCCNT - start < OLED_WrCycles)
+				{
+				}
+			}
+		}
+		OLED_CS = 1;
+		OLED_RS = 1;
+	}
+	else
+	{
+		IIC_Start();
+		IIC_Send_Byte(OLED_IIC_ADDR);
+		if (IIC_Wait_Ack())
+		{
+			return; // no ack, IIC_Wait_Ack has sent the stop
+		}
+		IIC_Send_Byte(cmd == OLED_DATA ? 0X40 : 0X00); // control byte, Co = 0
+		if (IIC_Wait_Ack())
+		{
+			return;
+		}
+		for (i = 0; i < len; i++)
+		{
+			IIC_Send_Byte(buf[i]);
+			if (IIC_Wait_Ack())
+			{
+				return;
+			}
+		}
+		IIC_Stop();
 	}
-
-	OLED_CS = 0;
-	OLED_WR = 0;
-	OLED_WR = 1;
-	OLED_CS = 1;
-	OLED_RS = 1;
 }
 
 /**
@@ -159,13 +327,11 @@ void OLED_Display_Off(void)
  */
 void OLED_Clear(void)
 {
-	uint8_t i, n;
+	uint8_t i;
+	memset(OLED_GRAM, 0X00, sizeof(OLED_GRAM));
 	for (i = 0; i < 8; i++)
 	{
-		for (n = 0; n < 128; n++)
-		{
-			OLED_GRAM[n][i] = 0X00;
-		}
+		OLED_Mark_Dirty(i, 0, 127);
 	}
 	OLED_Refresh_Gram();
 }
@@ -181,7 +347,7 @@ void OLED_Clear(void)
  */
 void OLED_DrawPoint(uint8_t x, uint8_t y, uint8_t t)
 {
-	uint8_t pos, bx, temp = 0;
+	uint8_t pos, bx, temp = 0, old;
 	if (x < 0 || x > 127 || y < 0 || y > 63)
 	{
 		return; // out of range
@@ -189,46 +355,211 @@ void OLED_DrawPoint(uint8_t x, uint8_t y, uint8_t t)
 	pos = 7 - y / 8;
 	bx = y % 8;
 	temp = 1 << (7 - bx);
+	old = OLED_GRAM[pos][x];
 	if (t)
 	{
-		OLED_GRAM[x][pos] |= temp;
+		OLED_GRAM[pos][x] |= temp;
 	}
 	else
 	{
-		OLED_GRAM[x][pos] &= ~temp;
+		OLED_GRAM[pos][x] &= ~temp;
+	}
+	if (OLED_GRAM[pos][x] != old)
+	{
+		OLED_Mark_Dirty(pos, x, x);
 	}
 }
 
 /**
- * @brief fill a rectangle
+ * @brief write a vertical run of pixels into one GRAM column
+ * The 8 page bytes of a column form a 64-bit word, page pos = 7 - y / 8,
+ * bit 7 - y % 8, so pixel y sits at word bit 63 - y and the run is
+ * written with one
+ * shift and mask per page instead of one OLED_DrawPoint per pixel.
  *
  * @param
- * x1: start X coordinate
- * y1: start Y coordinate
- * x2: end x coordinate
- * y2: end y coordinate
- * t: 1: filled dot  0: empyt dot
+ * x: X coordinate
+ * y: Y coordinate of the first pixel
+ * bits: pixels, the MSB (bit len-1) is drawn at y
+ * len: number of pixels (1~31)
  *
  */
-void OLED_Fill(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t dot)
+static void OLED_Put_Column(uint8_t x, uint8_t y, uint32_t bits, uint8_t len)
 {
-	if (x1 < x2 || y1 < y2)
+	int8_t shift = 64 - y - len; // word bit of the last pixel
+	int8_t s;
+	uint8_t page, lo, hi, mask, data, old;
+	uint32_t ones = (1UL << len) - 1;
+	if (x > 127 || y > 63)
 	{
-		return;
+		return; // out of range
+	}
+	lo = shift < 0 ? 0 : shift / 8;
+	hi = (63 - y) / 8;
+	for (page = lo; page <= hi; page++)
+	{
+		s = shift - page * 8;
+		if (s >= 0)
+		{
+			mask = (uint8_t)(ones << s);
+			data = (uint8_t)(bits << s);
+		}
+		else
+		{
+			mask = (uint8_t)(ones >> -s);
+			data = (uint8_t)(bits >> -s);
+		}
+		old = OLED_GRAM[page][x];
+		OLED_GRAM[page][x] = (old & ~mask) | (data & mask);
+		if (OLED_GRAM[page][x] != old)
+		{
+			OLED_Mark_Dirty(page, x, x);
+		}
 	}
+}
 
-	uint8_t x, y;
-	for (x = x1; x <= x2; x++)
+/**
+ * @brief set, clear or invert a rectangle in GRAM
+ * Rows y1~y2 are word bits 63-y2 ~ 63-y1 of each GRAM column, so only the
+ * top and bottom pages need a partial mask, inner pages take whole bytes.
+ *
+ * @param
+ * x1, y1: start coordinate
+ * x2, y2: end coordinate, clipped to the screen
+ * op: OLED_OP_SET, OLED_OP_CLEAR or OLED_OP_INVERT
+ *
+ */
+static void OLED_Rect_Op(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t op)
+{
+	uint8_t x, page, lo, hi, mask;
+	if (x2 > 127)
 	{
-		for (y = y1; y <= y2; y++)
+		x2 = 127;
+	}
+	if (y2 > 63)
+	{
+		y2 = 63;
+	}
+	if (x1 > x2 || y1 > y2)
+	{
+		return;
+	}
+	lo = (63 - y2) / 8;
+	hi = (63 - y1) / 8;
+	for (page = lo; page <= hi; page++)
+	{
+		mask = 0XFF;
+		if (page == lo)
 		{
-			OLED_DrawPoint(x, y, dot);
+			mask &= 0XFF << ((63 - y2) % 8);
 		}
+		if (page == hi)
+		{
+			mask &= 0XFF >> (7 - (63 - y1) % 8);
+		}
+		if (mask == 0XFF && op != OLED_OP_INVERT)
+		{
+			// whole bytes, a page row is contiguous in GRAM
+			memset(&OLED_GRAM[page][x1], op == OLED_OP_SET ? 0XFF : 0X00, x2 - x1 + 1);
+			OLED_Mark_Dirty(page, x1, x2);
+			continue;
+		}
+		for (x = x1; x <= x2; x++)
+		{
+			if (op == OLED_OP_SET)
+			{
+				OLED_GRAM[page][x] |= mask;
+			}
+			else if (op == OLED_OP_CLEAR)
+			{
+				OLED_GRAM[page][x] &= ~mask;
+			}
+			else
+			{
+				OLED_GRAM[page][x] ^= mask;
+			}
+		}
+		OLED_Mark_Dirty(page, x1, x2);
 	}
+}
 
+/**
+ * @brief fill a rectangle
+ *
+ * @param
+ * x1: start X coordinate
+ * y1: start Y coordinate
+ * x2: end x coordinate
+ * y2: end y coordinate
+ * t: 1: filled dot  0: empyt dot
+ *
+ */
+void OLED_Fill(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t dot)
+{
+	OLED_Rect_Op(x1, y1, x2, y2, dot ? OLED_OP_SET : OLED_OP_CLEAR);
 	OLED_Refresh_Gram();
 }
 
+/**
+ * @brief clear a rectangle in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * y1: start Y coordinate
+ * x2: end x coordinate
+ * y2: end y coordinate
+ *
+ */
+void OLED_Clear_Rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+{
+	OLED_Rect_Op(x1, y1, x2, y2, OLED_OP_CLEAR);
+}
+
+/**
+ * @brief invert a rectangle in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * y1: start Y coordinate
+ * x2: end x coordinate
+ * y2: end y coordinate
+ *
+ */
+void OLED_Invert_Rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+{
+	OLED_Rect_Op(x1, y1, x2, y2, OLED_OP_INVERT);
+}
+
+/**
+ * @brief draw a horizontal line in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * x2: end X coordinate
+ * y: Y coordinate
+ * t: 1: filled dot  0: empyt dot
+ *
+ */
+void OLED_DrawHLine(uint8_t x1, uint8_t x2, uint8_t y, uint8_t t)
+{
+	OLED_Rect_Op(x1, y, x2, y, t ? OLED_OP_SET : OLED_OP_CLEAR);
+}
+
+/**
+ * @brief draw a vertical line in GRAM, no refresh
+ *
+ * @param
+ * x: X coordinate
+ * y1: start Y coordinate
+ * y2: end Y coordinate
+ * t: 1: filled dot  0: empyt dot
+ *
+ */
+void OLED_DrawVLine(uint8_t x, uint8_t y1, uint8_t y2, uint8_t t)
+{
+	OLED_Rect_Op(x, y1, x, y2, t ? OLED_OP_SET : OLED_OP_CLEAR);
+}
+
 /**
  * @brief show a char at(x, y)
  *
@@ -245,50 +576,44 @@ void OLED_ShowChar(uint8_t x, uint8_t y, uint8_t chr, uint8_t size, uint8_t mode
 	{
 		return;
 	}
-	uint8_t temp, t, t1;
-	uint8_t y0 = y;
-	// Get the number of bytes occupied by the dot matrix set corresponding to a character of the font
-	uint8_t csize = (size / 8 + ((size % 8) ? 1 : 0)) * (size / 2);
+	const unsigned char *glyph;
+	uint32_t bits;
+	uint8_t t, t1;
+	// Get the number of bytes occupied by one column of the font
+	uint8_t bpc = size / 8 + ((size % 8) ? 1 : 0);
 	chr = chr - ' '; // offset
 
-	for (t = 0; t < csize; t++)
+	if (size == 12)
 	{
-		if (size == 12)
-		{
-			temp = asc2_1206[chr][t]; // 1206 ASCII font
-		}
-		else if (size == 16)
-		{
-			temp = asc2_1608[chr][t]; // 1608 ASCII font
-		}
-		else if (size == 24)
-		{
-			temp = asc2_2412[chr][t]; // 2412 ASCII font
-		}
-		else
+		glyph = asc2_1206[chr]; // 1206 ASCII font
+	}
+	else if (size == 16)
+	{
+		glyph = asc2_1608[chr]; // 1608 ASCII font
+	}
+	else if (size == 24)
+	{
+		glyph = asc2_2412[chr]; // 2412 ASCII font
+	}
+	else
+	{
+		return; // invalid font
+	}
+
+	// each column is bpc bytes, top pixel in the MSB of the first byte
+	for (t = 0; t < size / 2; t++)
+	{
+		bits = 0;
+		for (t1 = 0; t1 < bpc; t1++)
 		{
-			return; // invalid font
+			bits = (bits << 8) | *glyph++;
 		}
-
-		for (t1 = 0; t1 < 8; t1++)
+		bits >>= bpc * 8 - size;
+		if (!mode)
 		{
-			if (temp & 0x80)
-			{
-				OLED_DrawPoint(x, y, mode);
-			}
-			else
-			{
-				OLED_DrawPoint(x, y, !mode);
-			}
-			temp <<= 1;
-			y++;
-			if ((y - y0) == size)
-			{
-				y = y0;
-				x++;
-				break;
-			}
+			bits = ~bits;
 		}
+		OLED_Put_Column(x + t, y, bits, size);
 	}
 }
 
@@ -324,7 +649,7 @@ void OLED_ShowNum(uint8_t x, uint8_t y, uint32_t num, uint8_t len, uint8_t size)
 	uint8_t enshow = 0;
 	for (t = 0; t < len; t++)
 	{
-		temp = (num / pow(10, len - t - 1)) % 10;
+		temp = (num / _pow(10, len - t - 1)) % 10;
 		if (enshow == 0 && t < (len - 1))
 		{
 			if (temp == 0)
@@ -373,21 +698,209 @@ void OLED_ShowString(uint8_t x, uint8_t y, const uint8_t *p, uint8_t size)
 	}
 }
 
+// text console state
+static uint8_t OLED_ConStart = 0;  // display start line
+static uint8_t OLED_ConSize = 16;  // font size
+static uint8_t OLED_ConPitch = 16; // row height, divides 64
+static uint8_t OLED_ConRow = 0;    // cursor row on screen
+static uint8_t OLED_ConCol = 0;    // cursor X coordinate
+
+/**
+ * @brief start a new console line, scroll the screen up one row at the bottom
+ * Screen row sy shows GRAM row (sy - start line) & 63, so lowering the start
+ * line by one row pitch moves the whole image up. Only the reused row is
+ * cleared and sent, instead of a full frame.
+ *
+ */
+static void OLED_Console_Newline(void)
+{
+	uint8_t y;
+	OLED_ConCol = 0;
+	if (OLED_ConRow < 64 / OLED_ConPitch - 1)
+	{
+		OLED_ConRow++;
+		return;
+	}
+	OLED_ConStart = (OLED_ConStart - OLED_ConPitch) & 63;
+	y = (OLED_ConRow * OLED_ConPitch - OLED_ConStart) & 63;
+	OLED_Clear_Rect(0, y, 127, y + OLED_ConPitch - 1); // oldest row, now at the bottom
+	OLED_Refresh_Gram();
+	OLED_WR_Byte(0x40 | OLED_ConStart, OLED_CMD); // Set Display Start Line
+}
+
+/**
+ * @brief initialization the text console, clear screen
+ *
+ * @param
+ * size: font size 12/16/24
+ *
+ */
+void OLED_Console_Init(uint8_t size)
+{
+	OLED_ConSize = size;
+	OLED_ConPitch = size > 16 ? 32 : 16;
+	OLED_ConStart = 0;
+	OLED_ConRow = 0;
+	OLED_ConCol = 0;
+	OLED_WR_Byte(0x40, OLED_CMD); // Set Display Start Line 0
+	OLED_Clear();
+}
+
+/**
+ * @brief write a char to the console, no refresh
+ *
+ * @param
+ * chr: ASCII char, '\n': new line, '\r': back to column 0
+ *
+ */
+void OLED_Console_Putc(uint8_t chr)
+{
+	if (chr == '\n')
+	{
+		OLED_Console_Newline();
+		return;
+	}
+	if (chr == '\r')
+	{
+		OLED_ConCol = 0;
+		return;
+	}
+	if (chr < ' ' || chr > '~')
+	{
+		return; // invalid char
+	}
+	if (OLED_ConCol > 128 - OLED_ConSize / 2)
+	{
+		OLED_Console_Newline();
+	}
+	OLED_ShowChar(OLED_ConCol, (OLED_ConRow * OLED_ConPitch - OLED_ConStart) & 63, chr, OLED_ConSize, 1);
+	OLED_ConCol += OLED_ConSize / 2;
+}
+
+/**
+ * @brief write a string to the console and refresh
+ *
+ * @param
+ * *p: the string start address
+ *
+ */
+void OLED_Console_Puts(const uint8_t *p)
+{
+	while (*p)
+	{
+		OLED_Console_Putc(*p++);
+	}
+	OLED_Refresh_Gram();
+}
+
 /**
  * @brief update RAM to OLED memory
+ * Page addressing: the changed column span of each page is sent.
+ * Horizontal addressing: the column/page window is set once to the bounding
+ * box of the changed spans, a full width window is one 128 * pages burst.
+ * When the box holds more unchanged bytes than a window per changed page
+ * costs in commands, each page gets its own window instead.
  *
  */
 void OLED_Refresh_Gram(void)
 {
-	uint8_t i, n;
+	uint8_t cmds[6];
+	uint8_t i;
+	TRACE_BEGIN(trace, 0);
+#if OLED_HORIZONTAL_ADDR
+	uint8_t lo = 0XFF, hi = 0, start = 0XFF, end = 0;
+	uint16_t spans = 0, pages = 0;
+	for (i = 0; i < 8; i++)
+	{
+		if (OLED_DirtyStart[i] > OLED_DirtyEnd[i])
+		{
+			continue; // page unchanged
+		}
+		if (lo == 0XFF)
+		{
+			lo = i;
+		}
+		hi = i;
+		if (OLED_DirtyStart[i] < start)
+		{
+			start = OLED_DirtyStart[i];
+		}
+		if (OLED_DirtyEnd[i] > end)
+		{
+			end = OLED_DirtyEnd[i];
+		}
+		spans += OLED_DirtyEnd[i] - OLED_DirtyStart[i] + 1;
+		pages++;
+	}
+	if (lo == 0XFF)
+	{
+		TRACE_END(TRACE_OLED_REFRESH, trace);
+		return; // nothing changed
+	}
+	if (pages > 1 && (hi - lo + 1) * (end - start + 1) > spans + 6 * (pages - 1))
+	{
+		// sparse: a window of 6 command bytes per changed page
+		cmds[0] = 0x21;
+		cmds[3] = 0x22;
+		for (i = lo; i <= hi; i++)
+		{
+			if (OLED_DirtyStart[i] > OLED_DirtyEnd[i])
+			{
+				continue;
+			}
+			cmds[1] = OLED_DirtyStart[i];
+			cmds[2] = OLED_DirtyEnd[i];
+			cmds[4] = cmds[5] = i;
+			OLED_WR_Bytes(cmds, 6, OLED_CMD);
+			OLED_WR_Bytes(&OLED_GRAM[i][cmds[1]], cmds[2] - cmds[1] + 1, OLED_DATA);
+			TRACE_ADD(trace, cmds[2] - cmds[1] + 1);
+			OLED_DirtyStart[i] = 0XFF;
+			OLED_DirtyEnd[i] = 0;
+		}
+		TRACE_END(TRACE_OLED_REFRESH, trace);
+		return;
+	}
+	for (i = lo; i <= hi; i++)
+	{
+		OLED_DirtyStart[i] = 0XFF;
+		OLED_DirtyEnd[i] = 0;
+	}
+	cmds[0] = 0x21; // Set Column Address
+	cmds[1] = start;
+	cmds[2] = end;
+	cmds[3] = 0x22; // Set Page Address
+	cmds[4] = lo;
+	cmds[5] = hi;
+	OLED_WR_Bytes(cmds, 6, OLED_CMD);
+	if (start == 0 && end == 127)
+	{
+		OLED_WR_Bytes(&OLED_GRAM[lo][0], (hi - lo + 1) * 128, OLED_DATA);
+		TRACE_ADD(trace, (hi - lo + 1) * 128);
+	}
+	else
+	{
+		for (i = lo; i <= hi; i++) // the address wraps to the next page at end
+		{
+			OLED_WR_Bytes(&OLED_GRAM[i][start], end - start + 1, OLED_DATA);
+			TRACE_ADD(trace, end - start + 1);
+		}
+	}
+#else
 	for (i = 0; i < 8; i++)
 	{
-		OLED_WR_Byte(0xb0 + i, OLED_CMD); // page address0~7
-		OLED_WR_Byte(0x00, OLED_CMD);	  // column address low
-		OLED_WR_Byte(0x10, OLED_CMD);	  // column address high
-		for (n = 0; n < 128; n++)
+		if (OLED_DirtyStart[i] > OLED_DirtyEnd[i])
 		{
-			OLED_WR_Byte(OLED_GRAM[n][i], OLED_DATA);
+			continue; // page unchanged
 		}
+		cmds[0] = 0xb0 + i;                           // page address
+		cmds[1] = 0x00 | (OLED_DirtyStart[i] & 0X0F); // column address low
+		cmds[2] = 0x10 | (OLED_DirtyStart[i] >> 4);   // column address high
+		OLED_WR_Bytes(cmds, 3, OLED_CMD);
+		OLED_WR_Bytes(&OLED_GRAM[i][OLED_DirtyStart[i]], OLED_DirtyEnd[i] - OLED_DirtyStart[i] + 1, OLED_DATA);
+		TRACE_ADD(trace, OLED_DirtyEnd[i] - OLED_DirtyStart[i] + 1);
+		OLED_DirtyStart[i] = 0XFF;
+		OLED_DirtyEnd[i] = 0;
 	}
+#endif
+	TRACE_END(TRACE_OLED_REFRESH, trace);
 }
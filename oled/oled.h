@@ -31,6 +31,25 @@ typedef enum _OLED_DC
     OLED_DATA // WR data
 } OLED_DC;
 
+// bus used to talk to the controller, set BS1/BS2 to match
+#ifndef OLED_MODE
+#define OLED_MODE OLED_PARALLEL
+#endif
+
+#define OLED_IIC_ADDR 0x78 // SA0 = 0, write
+
+// 8080 write cycle in ns, SSD1306 tCYCLE >= 300, tPWLW/tPWHW >= 60
+#define OLED_8080_TCYCLE 300
+
+// 4-wire SPI clock cycle in ns, SSD1306 tCYCLE >= 100, tCLKL/tCLKH >= 20
+#define OLED_SPI_TCYCLE 100
+
+// 1: horizontal addressing, a refresh is one window and data burst
+// 0: page addressing, page and column address sent for each page
+#ifndef OLED_HORIZONTAL_ADDR
+#define OLED_HORIZONTAL_ADDR 1
+#endif
+
 /**
  * CS: OLED CS
  * WR: write data to OLED
@@ -48,6 +67,10 @@ typedef enum _OLED_DC
 #define OLED_WR PHout(8)
 #define OLED_RD PBout(3)
 
+// SPI mode ports
+#define OLED_SCLK PCout(6) // D0
+#define OLED_SDIN PCout(7) // D1
+
 /**
  * @brief initialization OLED
  *
@@ -103,6 +126,54 @@ void OLED_DrawPoint(uint8_t x, uint8_t y, uint8_t t);
  */
 void OLED_Fill(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t dot);
 
+/**
+ * @brief clear a rectangle in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * y1: start Y coordinate
+ * x2: end x coordinate
+ * y2: end y coordinate
+ *
+ */
+void OLED_Clear_Rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+
+/**
+ * @brief invert a rectangle in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * y1: start Y coordinate
+ * x2: end x coordinate
+ * y2: end y coordinate
+ *
+ */
+void OLED_Invert_Rect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+
+/**
+ * @brief draw a horizontal line in GRAM, no refresh
+ *
+ * @param
+ * x1: start X coordinate
+ * x2: end X coordinate
+ * y: Y coordinate
+ * t: 1: filled dot  0: empyt dot
+ *
+ */
+void OLED_DrawHLine(uint8_t x1, uint8_t x2, uint8_t y, uint8_t t);
+
+/**
+ * @brief draw a vertical line in GRAM, no refresh
+ *
+ * @param
+ * x: X coordinate
+ * y1: start Y coordinate
+ * y2: end Y coordinate
+ * t: 1: filled dot  0: empyt dot
+ *
+ */
+void OLED_DrawVLine(uint8_t x, uint8_t y1, uint8_t y2, uint8_t t);
+
 /**
  * @brief show a char at(x, y)
  *
@@ -140,6 +211,44 @@ void OLED_ShowNum(uint8_t x, uint8_t y, u32 num, uint8_t len, uint8_t size);
  */
 void OLED_ShowString(uint8_t x, uint8_t y, const uint8_t *p, uint8_t size);
 
+/**
+ * Text console
+ *
+ * Lines are written from the top, at the bottom the screen scrolls by the
+ * display start line (40h~7Fh), so a new line costs one text row of data.
+ * Rows are 16 pixels high for font 12/16, 32 for font 24.
+ * The other drawing functions assume start line 0, call OLED_Console_Init
+ * again or send 40h before using them.
+ *
+ */
+
+/**
+ * @brief initialization the text console, clear screen
+ *
+ * @param
+ * size: font size 12/16/24
+ *
+ */
+void OLED_Console_Init(uint8_t size);
+
+/**
+ * @brief write a char to the console, no refresh
+ *
+ * @param
+ * chr: ASCII char, '\n': new line, '\r': back to column 0
+ *
+ */
+void OLED_Console_Putc(uint8_t chr);
+
+/**
+ * @brief write a string to the console and refresh
+ *
+ * @param
+ * *p: the string start address
+ *
+ */
+void OLED_Console_Puts(const uint8_t *p);
+
 // OLED Control Functions
 
 /**
@@ -152,8 +261,21 @@ void OLED_ShowString(uint8_t x, uint8_t y, const uint8_t *p, uint8_t size);
  */
 void OLED_WR_Byte(uint8_t dat, uint8_t cmd);
 
+/**
+ * @brief write a block of bytes to OLED in one bus transaction
+ * CS (or the IIC address and control byte) is sent once for the whole block.
+ *
+ * @param
+ * buf: data or commands
+ * len: the length of buf
+ * cmd:  data or command
+ *
+ */
+void OLED_WR_Bytes(const uint8_t *buf, uint16_t len, uint8_t cmd);
+
 /**
  * @brief update RAM to OLED memory
+ * Only the changed columns are sent, see OLED_HORIZONTAL_ADDR.
  *
  */
 void OLED_Refresh_Gram(void);
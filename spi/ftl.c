@@ -0,0 +1,413 @@
+#include "ftl.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define FTL_MAGIC 0X46544C31 // "FTL1"
+#define FTL_NONE 0XFFFF
+
+typedef struct _FTL_Tag
+{
+	uint16_t lpn;
+	uint16_t inv; // ~lpn
+} FTL_Tag;
+
+typedef struct _FTL_Header
+{
+	uint32_t magic;
+	uint32_t seq; // order in which sectors were opened
+	uint32_t erasecount;
+	uint32_t check; // magic ^ seq ^ erasecount
+	FTL_Tag tag[FTL_PAGES_PER_SECTOR];
+} FTL_Header;
+
+// logical page -> physical page (sector * 16 + slot)
+static uint16_t FTL_Map[FTL_PAGE_NUM];
+static uint32_t FTL_EraseCount[FTL_SECTOR_NUM];
+static uint32_t FTL_Seq[FTL_SECTOR_NUM]; // 0: no valid header
+static uint8_t FTL_Valid[FTL_SECTOR_NUM];
+static uint32_t FTL_MaxSeq;
+static uint16_t FTL_Active = FTL_NONE;
+static uint8_t FTL_NextSlot;
+static uint8_t FTL_Buf[FTL_PAGE_SIZE];
+
+/**
+ * @brief flash address of a page in the FTL region
+ *
+ */
+static uint32_t FTL_Addr(uint16_t sec, uint8_t slot)
+{
+	return (FTL_START_SECTOR + (uint32_t)sec) * 4096 + slot * 256;
+}
+
+/**
+ * @brief read the header page of a sector
+ *
+ * @return 1: valid header, 0: erased or torn
+ *
+ */
+static uint8_t FTL_Read_Header(uint16_t sec, FTL_Header *hdr)
+{
+	W25QXX_Read((uint8_t *)hdr, FTL_Addr(sec, 0), sizeof(FTL_Header));
+	return hdr->magic == FTL_MAGIC && hdr->check == (hdr->magic ^ hdr->seq ^ hdr->erasecount);
+}
+
+/**
+ * @brief number of sectors without valid data, the open sector excluded
+ *
+ */
+static uint16_t FTL_Free_Count(void)
+{
+	uint16_t s, n = 0;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (s != FTL_Active && FTL_Valid[s] == 0)
+		{
+			n++;
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief erase the free sector with the lowest erase count and make it the
+ * open sector (dynamic wear leveling)
+ *
+ * @return 0: success, 1: no free sector
+ *
+ */
+static uint8_t FTL_Open_Sector(void)
+{
+	FTL_Header hdr;
+	uint16_t s, sec = FTL_NONE;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (s != FTL_Active && FTL_Valid[s] == 0 && (sec == FTL_NONE || FTL_EraseCount[s] < FTL_EraseCount[sec]))
+		{
+			sec = s;
+		}
+	}
+	if (sec == FTL_NONE)
+	{
+		return 1;
+	}
+	W25QXX_Erase_Sector(FTL_START_SECTOR + sec);
+	FTL_EraseCount[sec]++;
+	hdr.magic = FTL_MAGIC;
+	hdr.seq = ++FTL_MaxSeq;
+	hdr.erasecount = FTL_EraseCount[sec];
+	hdr.check = hdr.magic ^ hdr.seq ^ hdr.erasecount;
+	W25QXX_Write_NoCheck((uint8_t *)&hdr, FTL_Addr(sec, 0), 16); // tags stay erased
+	FTL_Seq[sec] = hdr.seq;
+	FTL_Active = sec;
+	FTL_NextSlot = 1;
+	return 0;
+}
+
+/**
+ * @brief append a logical page to the open sector and remap it
+ *
+ * @return 0: success, 1: no free sector
+ *
+ */
+static uint8_t FTL_Program(uint16_t lpn, const uint8_t *pBuffer)
+{
+	FTL_Tag tag;
+	uint16_t cur;
+	if (FTL_Active == FTL_NONE || FTL_NextSlot > FTL_PAGES_PER_SECTOR)
+	{
+		if (FTL_Open_Sector())
+		{
+			return 1;
+		}
+	}
+	// data first, then the tag that makes it valid
+	W25QXX_Write_NoCheck((uint8_t *)pBuffer, FTL_Addr(FTL_Active, FTL_NextSlot), FTL_PAGE_SIZE);
+	tag.lpn = lpn;
+	tag.inv = ~lpn;
+	W25QXX_Write_NoCheck((uint8_t *)&tag, FTL_Addr(FTL_Active, 0) + 16 + (FTL_NextSlot - 1) * sizeof(FTL_Tag), sizeof(FTL_Tag));
+
+	cur = FTL_Map[lpn];
+	if (cur != FTL_NONE)
+	{
+		FTL_Valid[cur / 16]--;
+	}
+	FTL_Map[lpn] = FTL_Active * 16 + FTL_NextSlot;
+	FTL_Valid[FTL_Active]++;
+	FTL_NextSlot++;
+	return 0;
+}
+
+/**
+ * @brief move the valid pages of a sector to the open sector
+ *
+ * @return 0: success, 1: no free sector
+ *
+ */
+static uint8_t FTL_Relocate(uint16_t sec)
+{
+	FTL_Header hdr;
+	uint8_t slot;
+	uint16_t lpn;
+	FTL_Read_Header(sec, &hdr);
+	for (slot = 1; slot <= FTL_PAGES_PER_SECTOR && FTL_Valid[sec] > 0; slot++)
+	{
+		lpn = hdr.tag[slot - 1].lpn;
+		if (lpn < FTL_PAGE_NUM && FTL_Map[lpn] == sec * 16 + slot)
+		{
+			W25QXX_Read(FTL_Buf, FTL_Addr(sec, slot), FTL_PAGE_SIZE);
+			if (FTL_Program(lpn, FTL_Buf))
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief garbage collection, free the sector with the fewest valid pages
+ *
+ * @return 0: a sector was freed, 1: nothing to collect
+ *
+ */
+static uint8_t FTL_Collect(void)
+{
+	uint16_t s, victim = FTL_NONE;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (s != FTL_Active && FTL_Valid[s] > 0 && FTL_Valid[s] < FTL_PAGES_PER_SECTOR && (victim == FTL_NONE || FTL_Valid[s] < FTL_Valid[victim]))
+		{
+			victim = s;
+		}
+	}
+	if (victim == FTL_NONE)
+	{
+		return 1;
+	}
+	return FTL_Relocate(victim);
+}
+
+/**
+ * @brief static wear leveling, move cold data off the least worn sector
+ * so that it returns to the free pool
+ *
+ */
+static void FTL_Static_WL(void)
+{
+	uint16_t s, cold = FTL_NONE;
+	uint32_t max = 0;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (FTL_EraseCount[s] > max)
+		{
+			max = FTL_EraseCount[s];
+		}
+		if (s != FTL_Active && FTL_Valid[s] > 0 && (cold == FTL_NONE || FTL_EraseCount[s] < FTL_EraseCount[cold]))
+		{
+			cold = s;
+		}
+	}
+	if (cold != FTL_NONE && max - FTL_EraseCount[cold] > FTL_WL_THRESHOLD && FTL_Free_Count() >= FTL_GC_FREE)
+	{
+		FTL_Relocate(cold);
+	}
+}
+
+/**
+ * @brief mount the FTL, rebuild the mapping from the sector headers
+ * Must be called after W25QXX_Init.
+ *
+ */
+void FTL_Init(void)
+{
+	FTL_Header hdr;
+	uint16_t s, lpn, cur;
+	uint8_t slot;
+	uint32_t known = 0, total = 0;
+
+	memset(FTL_Map, 0XFF, sizeof(FTL_Map));
+	memset(FTL_Valid, 0, sizeof(FTL_Valid));
+	FTL_MaxSeq = 0;
+	FTL_Active = FTL_NONE;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (!FTL_Read_Header(s, &hdr))
+		{
+			FTL_Seq[s] = 0;
+			FTL_EraseCount[s] = 0XFFFFFFFF; // unknown, set below
+			continue;
+		}
+		FTL_Seq[s] = hdr.seq;
+		FTL_EraseCount[s] = hdr.erasecount;
+		known++;
+		total += hdr.erasecount;
+		if (hdr.seq > FTL_MaxSeq)
+		{
+			FTL_MaxSeq = hdr.seq;
+			FTL_Active = s;
+		}
+		// a later copy wins: newer sector, or later slot in the same sector
+		for (slot = 1; slot <= FTL_PAGES_PER_SECTOR; slot++)
+		{
+			lpn = hdr.tag[slot - 1].lpn;
+			if ((uint16_t)(lpn ^ hdr.tag[slot - 1].inv) != 0XFFFF || lpn >= FTL_PAGE_NUM)
+			{
+				continue; // unused or torn
+			}
+			cur = FTL_Map[lpn];
+			if (cur == FTL_NONE || cur / 16 == s || FTL_Seq[cur / 16] < hdr.seq)
+			{
+				FTL_Map[lpn] = s * 16 + slot;
+			}
+		}
+	}
+	for (lpn = 0; lpn < FTL_PAGE_NUM; lpn++)
+	{
+		if (FTL_Map[lpn] != FTL_NONE)
+		{
+			FTL_Valid[FTL_Map[lpn] / 16]++;
+		}
+	}
+	// sectors erased just before power loss lost their count
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (FTL_EraseCount[s] == 0XFFFFFFFF)
+		{
+			FTL_EraseCount[s] = known ? total / known : 0;
+		}
+	}
+	// continue after the last used slot of the newest sector
+	if (FTL_Active != FTL_NONE)
+	{
+		FTL_Read_Header(FTL_Active, &hdr);
+		FTL_NextSlot = 1;
+		for (slot = 1; slot <= FTL_PAGES_PER_SECTOR; slot++)
+		{
+			if (hdr.tag[slot - 1].lpn != 0XFFFF || hdr.tag[slot - 1].inv != 0XFFFF)
+			{
+				FTL_NextSlot = slot + 1;
+			}
+		}
+		// skip data pages torn before their tag was written
+		while (FTL_NextSlot <= FTL_PAGES_PER_SECTOR)
+		{
+			W25QXX_Read(FTL_Buf, FTL_Addr(FTL_Active, FTL_NextSlot), FTL_PAGE_SIZE);
+			for (s = 0; s < FTL_PAGE_SIZE && FTL_Buf[s] == 0XFF; s++)
+			{
+			}
+			if (s == FTL_PAGE_SIZE)
+			{
+				break;
+			}
+			FTL_NextSlot++;
+		}
+	}
+}
+
+/**
+ * @brief erase the whole FTL region, all logical pages read as 0xFF
+ *
+ */
+void FTL_Format(void)
+{
+	FTL_Header hdr;
+	uint16_t s;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		// sectors without a header are erased again before they are opened
+		if (FTL_Read_Header(s, &hdr))
+		{
+			W25QXX_Erase_Sector(FTL_START_SECTOR + s);
+			FTL_EraseCount[s] = hdr.erasecount + 1;
+		}
+		FTL_Seq[s] = 0;
+		FTL_Valid[s] = 0;
+	}
+	memset(FTL_Map, 0XFF, sizeof(FTL_Map));
+	FTL_Active = FTL_NONE;
+}
+
+/**
+ * @brief read a logical page
+ *
+ * @param
+ * lpn: logical page number (0 ~ FTL_PAGE_NUM-1)
+ * pBuffer: FTL_PAGE_SIZE bytes buffer
+ *
+ * @return 0: success, 1: invalid page number
+ *
+ */
+uint8_t FTL_Read(uint16_t lpn, uint8_t *pBuffer)
+{
+	uint16_t cur;
+	if (lpn >= FTL_PAGE_NUM)
+	{
+		return 1;
+	}
+	cur = FTL_Map[lpn];
+	if (cur == FTL_NONE)
+	{
+		memset(pBuffer, 0XFF, FTL_PAGE_SIZE);
+	}
+	else
+	{
+		W25QXX_Read(pBuffer, FTL_Addr(cur / 16, cur % 16), FTL_PAGE_SIZE);
+	}
+	return 0;
+}
+
+/**
+ * @brief write a logical page
+ *
+ * @param
+ * lpn: logical page number (0 ~ FTL_PAGE_NUM-1)
+ * pBuffer: FTL_PAGE_SIZE bytes data
+ *
+ * @return 0: success, 1: invalid page number or no free sector
+ *
+ */
+uint8_t FTL_Write(uint16_t lpn, const uint8_t *pBuffer)
+{
+	if (lpn >= FTL_PAGE_NUM)
+	{
+		return 1;
+	}
+	if (FTL_Active == FTL_NONE || FTL_NextSlot > FTL_PAGES_PER_SECTOR)
+	{
+		FTL_Static_WL();
+		while (FTL_Free_Count() < FTL_GC_FREE)
+		{
+			if (FTL_Collect())
+			{
+				break;
+			}
+		}
+	}
+	return FTL_Program(lpn, pBuffer);
+}
+
+/**
+ * @brief get the erase count spread of the FTL region
+ *
+ * @param
+ * min: lowest erase count
+ * max: highest erase count
+ *
+ */
+void FTL_Get_Wear(uint32_t *min, uint32_t *max)
+{
+	uint16_t s;
+	*min = 0XFFFFFFFF;
+	*max = 0;
+	for (s = 0; s < FTL_SECTOR_NUM; s++)
+	{
+		if (FTL_EraseCount[s] < *min)
+		{
+			*min = FTL_EraseCount[s];
+		}
+		if (FTL_EraseCount[s] > *max)
+		{
+			*max = FTL_EraseCount[s];
+		}
+	}
+}
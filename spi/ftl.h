@@ -0,0 +1,83 @@
+/*
+ * ftl.h
+ *
+ */
+
+#ifndef __FTL_H_
+#define __FTL_H_
+#include "sys.h"
+
+/**
+ * Log-structured flash translation layer on W25QXX sectors
+ *
+ * Logical pages (256 bytes) are appended to the open sector and remapped
+ * on every write, so rewriting the same logical page spreads erases over
+ * the whole region.
+ *
+ * Physical sector layout (4K):
+ *  ______________________________________________________
+ *  | page 0                              | page 1 ~ 15  |
+ *  | magic seq erasecount check | 15 tags | data pages   |
+ *  |____________________________|_________|______________|
+ *
+ * tag: logical page number and its complement, programmed after the data
+ * page, so a write torn by power loss is never mapped.
+ *
+ */
+#define FTL_START_SECTOR      7680 //first W25QXX sector used (30M)
+#define FTL_SECTOR_NUM        256  //sectors used (1M)
+#define FTL_SPARE_SECTORS     4    //sectors not exported, needed by GC
+#define FTL_PAGE_SIZE         256
+#define FTL_PAGES_PER_SECTOR  15   //page 0 holds the header and tags
+#define FTL_PAGE_NUM          ((FTL_SECTOR_NUM - FTL_SPARE_SECTORS) * FTL_PAGES_PER_SECTOR)
+#define FTL_GC_FREE           2    //free sectors kept before a new sector is opened
+#define FTL_WL_THRESHOLD      64   //erase count spread that triggers static wear leveling
+
+/**
+ * @brief mount the FTL, rebuild the mapping from the sector headers
+ * Must be called after W25QXX_Init.
+ *
+ */
+void FTL_Init(void);
+
+/**
+ * @brief erase the whole FTL region, all logical pages read as 0xFF
+ *
+ */
+void FTL_Format(void);
+
+/**
+ * @brief read a logical page
+ *
+ * @param
+ * lpn: logical page number (0 ~ FTL_PAGE_NUM-1)
+ * pBuffer: FTL_PAGE_SIZE bytes buffer
+ *
+ * @return 0: success, 1: invalid page number
+ *
+ */
+uint8_t FTL_Read(uint16_t lpn, uint8_t *pBuffer);
+
+/**
+ * @brief write a logical page
+ *
+ * @param
+ * lpn: logical page number (0 ~ FTL_PAGE_NUM-1)
+ * pBuffer: FTL_PAGE_SIZE bytes data
+ *
+ * @return 0: success, 1: invalid page number or no free sector
+ *
+ */
+uint8_t FTL_Write(uint16_t lpn, const uint8_t *pBuffer);
+
+/**
+ * @brief get the erase count spread of the FTL region
+ *
+ * @param
+ * min: lowest erase count
+ * max: highest erase count
+ *
+ */
+void FTL_Get_Wear(uint32_t *min, uint32_t *max);
+
+#endif
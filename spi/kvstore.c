@@ -0,0 +1,597 @@
+#include "kvstore.h"
+#include "w25qxx.h"
+#include "string.h"
+
+#define KV_MAGIC 0X4B563031 // "KV01"
+#define KV_HEAD_SIZE 16		// sector header
+#define KV_REC_SIZE 8		// record header
+#define KV_TYPE_VALUE 0XA5
+#define KV_TYPE_DELETE 0X5A
+#define KV_EMPTY 0XFFFFFFFF
+#define KV_NONE 0XFFFF
+#define KV_END 0		  // KV_Load: end of log
+#define KV_CORRUPT 0XFFFF // KV_Load: unreadable record header
+
+// hash index, the low 16 bits of the key hash are kept to skip flash reads
+static uint32_t KV_IndexAddr[KV_INDEX_SIZE];
+static uint16_t KV_IndexHash[KV_INDEX_SIZE];
+static uint16_t KV_IndexCount;
+
+// circular log: KV_Tail is the oldest sector, KV_Head the one written
+static uint32_t KV_Seq[KV_SECTOR_NUM];
+static uint32_t KV_MaxSeq;
+static uint16_t KV_Tail;
+static uint16_t KV_Head;
+static uint16_t KV_Used;
+static uint16_t KV_Off; // write offset in KV_Head
+
+static uint8_t KV_Buf[KV_REC_SIZE + KV_KEY_MAX + KV_VALUE_MAX];
+static uint8_t KV_Key[KV_REC_SIZE + KV_KEY_MAX];
+
+/**
+ * @brief flash address of an offset in a sector of the store
+ *
+ */
+static uint32_t KV_Addr(uint16_t sec, uint16_t off)
+{
+	return (KV_START_SECTOR + (uint32_t)sec) * 4096 + off;
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3)
+ *
+ */
+static uint32_t KV_CRC32(uint32_t crc, const uint8_t *data, uint16_t len)
+{
+	uint8_t i;
+	crc = ~crc;
+	while (len--)
+	{
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+		{
+			crc = (crc >> 1) ^ (0XEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+/**
+ * @brief FNV-1a hash of a key
+ *
+ */
+static uint32_t KV_Hash(const uint8_t *key, uint8_t klen)
+{
+	uint32_t hash = 2166136261U;
+	while (klen--)
+	{
+		hash ^= *key++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/**
+ * @brief find the index slot of a key
+ *
+ * @return slot, KV_NONE if the key is not in the index
+ *
+ */
+static uint16_t KV_Find(const uint8_t *key, uint8_t klen, uint16_t hash)
+{
+	uint16_t i = hash & (KV_INDEX_SIZE - 1);
+	while (KV_IndexAddr[i] != KV_EMPTY)
+	{
+		if (KV_IndexHash[i] == hash)
+		{
+			W25QXX_Read(KV_Key, KV_IndexAddr[i], KV_REC_SIZE + klen);
+			if (KV_Key[1] == klen && memcmp(KV_Key + KV_REC_SIZE, key, klen) == 0)
+			{
+				return i;
+			}
+		}
+		i = (i + 1) & (KV_INDEX_SIZE - 1);
+	}
+	return KV_NONE;
+}
+
+/**
+ * @brief point a key to a record, add it if it is not in the index
+ *
+ * @return 0: success, 1: index full
+ *
+ */
+static uint8_t KV_Index_Set(const uint8_t *key, uint8_t klen, uint16_t hash, uint32_t addr)
+{
+	uint16_t i = KV_Find(key, klen, hash);
+	if (i == KV_NONE)
+	{
+		if (KV_IndexCount >= KV_INDEX_SIZE / 4 * 3)
+		{
+			return 1;
+		}
+		i = hash & (KV_INDEX_SIZE - 1);
+		while (KV_IndexAddr[i] != KV_EMPTY)
+		{
+			i = (i + 1) & (KV_INDEX_SIZE - 1);
+		}
+		KV_IndexHash[i] = hash;
+		KV_IndexCount++;
+	}
+	KV_IndexAddr[i] = addr;
+	return 0;
+}
+
+/**
+ * @brief remove an index slot, later entries of the probe chain are shifted
+ * back so that lookups never need tombstones
+ *
+ */
+static void KV_Index_Remove(uint16_t i)
+{
+	uint16_t j = i, home;
+	while (1)
+	{
+		j = (j + 1) & (KV_INDEX_SIZE - 1);
+		if (KV_IndexAddr[j] == KV_EMPTY)
+		{
+			break;
+		}
+		home = KV_IndexHash[j] & (KV_INDEX_SIZE - 1);
+		// move j into the hole unless its home lies cyclically in (i, j]
+		if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j)))
+		{
+			KV_IndexAddr[i] = KV_IndexAddr[j];
+			KV_IndexHash[i] = KV_IndexHash[j];
+			i = j;
+		}
+	}
+	KV_IndexAddr[i] = KV_EMPTY;
+	KV_IndexCount--;
+}
+
+/**
+ * @brief load a record into KV_Buf
+ *
+ * @param
+ * sec: sector
+ * off: record offset
+ * valid: set to 1 if the CRC matches
+ *
+ * @return record size, KV_END at the end of the log, KV_CORRUPT if the
+ * header is unreadable
+ *
+ */
+static uint16_t KV_Load(uint16_t sec, uint16_t off, uint8_t *valid)
+{
+	uint8_t klen;
+	uint16_t vlen, size;
+	uint32_t crc;
+	*valid = 0;
+	if (off + KV_REC_SIZE > 4096)
+	{
+		return KV_END;
+	}
+	W25QXX_Read(KV_Buf, KV_Addr(sec, off), KV_REC_SIZE);
+	if (KV_Buf[0] == 0XFF && KV_Buf[1] == 0XFF && KV_Buf[2] == 0XFF && KV_Buf[3] == 0XFF)
+	{
+		return KV_END;
+	}
+	klen = KV_Buf[1];
+	vlen = KV_Buf[2] | (KV_Buf[3] << 8);
+	size = KV_REC_SIZE + klen + vlen;
+	if ((KV_Buf[0] != KV_TYPE_VALUE && KV_Buf[0] != KV_TYPE_DELETE) || klen == 0 || klen > KV_KEY_MAX || vlen > KV_VALUE_MAX || off + size > 4096)
+	{
+		return KV_CORRUPT;
+	}
+	W25QXX_Read(KV_Buf + KV_REC_SIZE, KV_Addr(sec, off) + KV_REC_SIZE, klen + vlen);
+	crc = KV_Buf[4] | (KV_Buf[5] << 8) | (KV_Buf[6] << 16) | ((uint32_t)KV_Buf[7] << 24);
+	*valid = crc == KV_CRC32(KV_CRC32(0, KV_Buf, 4), KV_Buf + KV_REC_SIZE, klen + vlen);
+	return size;
+}
+
+/**
+ * @brief check that a sector is erased, an erase cut by power loss may
+ * have cleared the header and left old records behind it
+ *
+ * @return 1: every byte is 0xFF
+ *
+ */
+static uint8_t KV_Blank(uint16_t sec)
+{
+	uint16_t off, n, i;
+	for (off = 0; off < 4096; off += n)
+	{
+		n = 4096 - off < sizeof(KV_Buf) ? 4096 - off : sizeof(KV_Buf);
+		W25QXX_Read(KV_Buf, KV_Addr(sec, off), n);
+		for (i = 0; i < n; i++)
+		{
+			if (KV_Buf[i] != 0XFF)
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief start the next sector of the log
+ *
+ * @return 0: success, 1: no free sector
+ *
+ */
+static uint8_t KV_Open_Next(void)
+{
+	uint32_t hdr[3];
+	if (KV_Used == KV_SECTOR_NUM)
+	{
+		return 1;
+	}
+	KV_Head = (KV_Head + 1) % KV_SECTOR_NUM;
+	if (KV_Used == 0)
+	{
+		KV_Tail = KV_Head;
+	}
+	hdr[0] = KV_MAGIC;
+	hdr[1] = ++KV_MaxSeq;
+	hdr[2] = hdr[0] ^ hdr[1];
+	W25QXX_Write_NoCheck((uint8_t *)hdr, KV_Addr(KV_Head, 0), sizeof(hdr));
+	KV_Seq[KV_Head] = hdr[1];
+	KV_Used++;
+	KV_Off = KV_HEAD_SIZE;
+	return 0;
+}
+
+/**
+ * @brief append the record in KV_Buf, without compaction
+ *
+ * @return record address, KV_EMPTY if the log is full
+ *
+ */
+static uint32_t KV_Append(uint16_t size)
+{
+	uint32_t addr;
+	if (KV_Off + size > 4096 && KV_Open_Next())
+	{
+		return KV_EMPTY;
+	}
+	addr = KV_Addr(KV_Head, KV_Off);
+	W25QXX_Write_NoCheck(KV_Buf, addr, size);
+	KV_Off += size;
+	return addr;
+}
+
+/**
+ * @brief copy the live records of the oldest sector to the head and erase it
+ *
+ * @return 0: success, 1: nothing to compact or no room for the live records
+ *
+ */
+static uint8_t KV_Compact(void)
+{
+	uint16_t sec = KV_Tail;
+	uint16_t off = KV_HEAD_SIZE, size, slot;
+	uint32_t addr;
+	uint8_t valid;
+	if (KV_Used <= 1)
+	{
+		return 1;
+	}
+	while (1)
+	{
+		size = KV_Load(sec, off, &valid);
+		if (size == KV_END || size == KV_CORRUPT)
+		{
+			break;
+		}
+		// deleted keys are dropped: no older sector can still hold them
+		if (valid && KV_Buf[0] == KV_TYPE_VALUE)
+		{
+			slot = KV_Find(KV_Buf + KV_REC_SIZE, KV_Buf[1], (uint16_t)KV_Hash(KV_Buf + KV_REC_SIZE, KV_Buf[1]));
+			if (slot != KV_NONE && KV_IndexAddr[slot] == KV_Addr(sec, off))
+			{
+				addr = KV_Append(size);
+				if (addr == KV_EMPTY)
+				{
+					return 1;
+				}
+				KV_IndexAddr[slot] = addr;
+			}
+		}
+		off += size;
+	}
+	W25QXX_Erase_Sector(KV_START_SECTOR + sec);
+	KV_Seq[sec] = 0;
+	KV_Tail = (KV_Tail + 1) % KV_SECTOR_NUM;
+	KV_Used--;
+	return 0;
+}
+
+/**
+ * @brief make room for a record at the head, compacting if needed
+ *
+ * @return 0: success, 1: flash full
+ *
+ */
+static uint8_t KV_Reserve(uint16_t size)
+{
+	uint16_t n = 0;
+	if (KV_Off + size <= 4096)
+	{
+		return 0;
+	}
+	// keep one sector free for the records moved by compaction
+	while (KV_SECTOR_NUM - KV_Used < 2 && n++ < KV_SECTOR_NUM)
+	{
+		if (KV_Compact())
+		{
+			return 1;
+		}
+		if (KV_Off + size <= 4096)
+		{
+			return 0;
+		}
+	}
+	return KV_Open_Next();
+}
+
+/**
+ * @brief build a record in KV_Buf
+ *
+ * @return record size
+ *
+ */
+static uint16_t KV_Build(uint8_t type, const uint8_t *key, uint8_t klen, const void *value, uint16_t vlen)
+{
+	uint32_t crc;
+	KV_Buf[0] = type;
+	KV_Buf[1] = klen;
+	KV_Buf[2] = (uint8_t)vlen;
+	KV_Buf[3] = (uint8_t)(vlen >> 8);
+	memcpy(KV_Buf + KV_REC_SIZE, key, klen);
+	memcpy(KV_Buf + KV_REC_SIZE + klen, value, vlen);
+	crc = KV_CRC32(KV_CRC32(0, KV_Buf, 4), KV_Buf + KV_REC_SIZE, klen + vlen);
+	KV_Buf[4] = (uint8_t)crc;
+	KV_Buf[5] = (uint8_t)(crc >> 8);
+	KV_Buf[6] = (uint8_t)(crc >> 16);
+	KV_Buf[7] = (uint8_t)(crc >> 24);
+	return KV_REC_SIZE + klen + vlen;
+}
+
+/**
+ * @brief mount the store, rebuild the index from the log
+ * Must be called after W25QXX_Init.
+ *
+ */
+void KV_Init(void)
+{
+	uint32_t hdr[4];
+	uint16_t s, i, off, size, slot;
+	uint8_t valid;
+	uint32_t minseq = 0XFFFFFFFF;
+
+	memset(KV_IndexAddr, 0XFF, sizeof(KV_IndexAddr));
+	KV_IndexCount = 0;
+	KV_MaxSeq = 0;
+	KV_Used = 0;
+	KV_Tail = 0;
+	KV_Head = KV_SECTOR_NUM - 1;
+	for (s = 0; s < KV_SECTOR_NUM; s++)
+	{
+		W25QXX_Read((uint8_t *)hdr, KV_Addr(s, 0), sizeof(hdr));
+		KV_Seq[s] = 0;
+		if (hdr[0] == KV_MAGIC && hdr[2] == (hdr[0] ^ hdr[1]))
+		{
+			KV_Seq[s] = hdr[1];
+			KV_Used++;
+			if (hdr[1] < minseq)
+			{
+				minseq = hdr[1];
+				KV_Tail = s;
+			}
+			if (hdr[1] > KV_MaxSeq)
+			{
+				KV_MaxSeq = hdr[1];
+				KV_Head = s;
+			}
+		}
+		else if (!KV_Blank(s))
+		{
+			W25QXX_Erase_Sector(KV_START_SECTOR + s); // header or erase torn
+		}
+	}
+	if (KV_Used == 0)
+	{
+		KV_Open_Next();
+		return;
+	}
+	// replay the log from the oldest sector, later records win
+	for (i = 0; i < KV_Used; i++)
+	{
+		s = (KV_Tail + i) % KV_SECTOR_NUM;
+		off = KV_HEAD_SIZE;
+		while (1)
+		{
+			size = KV_Load(s, off, &valid);
+			if (size == KV_END)
+			{
+				break;
+			}
+			if (size == KV_CORRUPT)
+			{
+				off = 4096; // no way to find the next record, seal the sector
+				break;
+			}
+			if (valid)
+			{
+				if (KV_Buf[0] == KV_TYPE_VALUE)
+				{
+					KV_Index_Set(KV_Buf + KV_REC_SIZE, KV_Buf[1], (uint16_t)KV_Hash(KV_Buf + KV_REC_SIZE, KV_Buf[1]), KV_Addr(s, off));
+				}
+				else
+				{
+					slot = KV_Find(KV_Buf + KV_REC_SIZE, KV_Buf[1], (uint16_t)KV_Hash(KV_Buf + KV_REC_SIZE, KV_Buf[1]));
+					if (slot != KV_NONE)
+					{
+						KV_Index_Remove(slot);
+					}
+				}
+			}
+			off += size;
+		}
+		KV_Off = off;
+	}
+}
+
+/**
+ * @brief erase the store, all keys are removed
+ *
+ */
+void KV_Format(void)
+{
+	uint16_t s;
+	for (s = 0; s < KV_SECTOR_NUM; s++)
+	{
+		W25QXX_Erase_Sector(KV_START_SECTOR + s);
+		KV_Seq[s] = 0;
+	}
+	memset(KV_IndexAddr, 0XFF, sizeof(KV_IndexAddr));
+	KV_IndexCount = 0;
+	KV_Used = 0;
+	KV_Head = KV_SECTOR_NUM - 1;
+	KV_Open_Next();
+}
+
+/**
+ * @brief set the value of a key
+ *
+ * @param
+ * key: zero terminated key (max KV_KEY_MAX)
+ * value: value data
+ * len: value length (max KV_VALUE_MAX)
+ *
+ * @return 0: success, 1: invalid length, index or flash full
+ *
+ */
+uint8_t KV_Set(const char *key, const void *value, uint16_t len)
+{
+	uint16_t klen = strlen(key);
+	uint16_t hash, slot, size;
+	uint32_t addr;
+	if (klen == 0 || klen > KV_KEY_MAX || len > KV_VALUE_MAX)
+	{
+		return 1;
+	}
+	hash = (uint16_t)KV_Hash((const uint8_t *)key, klen);
+	// an unchanged value costs no flash write
+	slot = KV_Find((const uint8_t *)key, klen, hash);
+	if (slot != KV_NONE && (KV_Key[2] | (KV_Key[3] << 8)) == len)
+	{
+		W25QXX_Read(KV_Buf, KV_IndexAddr[slot] + KV_REC_SIZE + klen, len);
+		if (memcmp(KV_Buf, value, len) == 0)
+		{
+			return 0;
+		}
+	}
+	if (slot == KV_NONE && KV_IndexCount >= KV_INDEX_SIZE / 4 * 3)
+	{
+		return 1;
+	}
+	if (KV_Reserve(KV_REC_SIZE + klen + len))
+	{
+		return 1;
+	}
+	size = KV_Build(KV_TYPE_VALUE, (const uint8_t *)key, klen, value, len);
+	addr = KV_Append(size);
+	if (addr == KV_EMPTY)
+	{
+		return 1;
+	}
+	return KV_Index_Set((const uint8_t *)key, klen, hash, addr);
+}
+
+/**
+ * @brief get the value of a key
+ *
+ * @param
+ * key: zero terminated key
+ * value: read to buffer
+ * size: buffer size, longer values are truncated
+ * len: value length, may be NULL
+ *
+ * @return 0: success, 1: key not found
+ *
+ */
+uint8_t KV_Get(const char *key, void *value, uint16_t size, uint16_t *len)
+{
+	uint16_t klen = strlen(key);
+	uint16_t slot, vlen;
+	if (klen == 0 || klen > KV_KEY_MAX)
+	{
+		return 1;
+	}
+	slot = KV_Find((const uint8_t *)key, klen, (uint16_t)KV_Hash((const uint8_t *)key, klen));
+	if (slot == KV_NONE)
+	{
+		return 1;
+	}
+	vlen = KV_Key[2] | (KV_Key[3] << 8); // header read by KV_Find
+	if (len)
+	{
+		*len = vlen;
+	}
+	W25QXX_Read(value, KV_IndexAddr[slot] + KV_REC_SIZE + klen, vlen < size ? vlen : size);
+	return 0;
+}
+
+/**
+ * @brief remove a key
+ *
+ * @param
+ * key: zero terminated key
+ *
+ * @return 0: success, 1: key not found or flash full
+ *
+ */
+uint8_t KV_Delete(const char *key)
+{
+	uint16_t klen = strlen(key);
+	uint16_t slot, size;
+	if (klen == 0 || klen > KV_KEY_MAX)
+	{
+		return 1;
+	}
+	slot = KV_Find((const uint8_t *)key, klen, (uint16_t)KV_Hash((const uint8_t *)key, klen));
+	if (slot == KV_NONE)
+	{
+		return 1;
+	}
+	if (KV_Reserve(KV_REC_SIZE + klen))
+	{
+		return 1;
+	}
+	// compaction may have moved entries, look the key up again
+	slot = KV_Find((const uint8_t *)key, klen, (uint16_t)KV_Hash((const uint8_t *)key, klen));
+	size = KV_Build(KV_TYPE_DELETE, (const uint8_t *)key, klen, 0, 0);
+	if (KV_Append(size) == KV_EMPTY)
+	{
+		return 1;
+	}
+	KV_Index_Remove(slot);
+	return 0;
+}
+
+/**
+ * @brief background compaction, call from the main loop
+ * Compacts at most one sector per call while fewer than KV_GC_FREE
+ * sectors are free.
+ *
+ */
+void KV_Poll(void)
+{
+	if (KV_SECTOR_NUM - KV_Used < KV_GC_FREE)
+	{
+		KV_Compact();
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * kvstore.h
+ *
+ */
+
+#ifndef __KVSTORE_H_
+#define __KVSTORE_H_
+#include "sys.h"
+
+/**
+ * Append-only key/value store in W25QXX flash
+ *
+ * Records are appended to a circular log of sectors, an update never
+ * erases. A RAM hash index (open addressing, linear probing) maps each key
+ * to its newest record. Compaction copies the live records of the oldest
+ * sector to the head of the log and erases it.
+ *
+ * sector: | magic seq check (12) | pad (4) | record | record | ... | 0xFF |
+ * record: | type | klen | vlen (2) | crc32 (4) | key | value |
+ * type:   0xA5 value, 0x5A deleted key
+ *
+ * A record torn by power loss fails its CRC and is ignored at mount.
+ *
+ */
+#define KV_START_SECTOR   7936 //first W25QXX sector used (31M)
+#define KV_SECTOR_NUM     16   //sectors used (64K)
+#define KV_GC_FREE        2    //KV_Poll compacts while fewer sectors are free
+#define KV_INDEX_SIZE     256  //index slots, power of 2, 3/4 may be used
+#define KV_KEY_MAX        32   //max key length
+#define KV_VALUE_MAX      1024 //max value length
+
+/**
+ * @brief mount the store, rebuild the index from the log
+ * Must be called after W25QXX_Init.
+ *
+ */
+void KV_Init(void);
+
+/**
+ * @brief erase the store, all keys are removed
+ *
+ */
+void KV_Format(void);
+
+/**
+ * @brief set the value of a key
+ *
+ * @param
+ * key: zero terminated key (max KV_KEY_MAX)
+ * value: value data
+ * len: value length (max KV_VALUE_MAX)
+ *
+ * @return 0: success, 1: invalid length, index or flash full
+ *
+ */
+uint8_t KV_Set(const char *key, const void *value, uint16_t len);
+
+/**
+ * @brief get the value of a key
+ *
+ * @param
+ * key: zero terminated key
+ * value: read to buffer
+ * size: buffer size, longer values are truncated
+ * len: value length, may be NULL
+ *
+ * @return 0: success, 1: key not found
+ *
+ */
+uint8_t KV_Get(const char *key, void *value, uint16_t size, uint16_t *len);
+
+/**
+ * @brief remove a key
+ *
+ * @param
+ * key: zero terminated key
+ *
+ * @return 0: success, 1: key not found or flash full
+ *
+ */
+uint8_t KV_Delete(const char *key);
+
+/**
+ * @brief background compaction, call from the main loop
+ * Compacts at most one sector per call while fewer than KV_GC_FREE
+ * sectors are free.
+ *
+ */
+void KV_Poll(void);
+
+#endif
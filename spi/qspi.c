@@ -0,0 +1,241 @@
+#include "qspi.h"
+
+#ifdef HAL_QSPI_MODULE_ENABLED
+
+QSPI_HandleTypeDef QSPI_Handler; // QUADSPI Handle
+
+/**
+ * @brief initialization QUADSPI, 32M flash
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Init(void)
+{
+	QSPI_Handler.Instance = QUADSPI;
+	QSPI_Handler.Init.ClockPrescaler = 2; // QSPI clock = AHB / 3
+	QSPI_Handler.Init.FifoThreshold = 4;
+	QSPI_Handler.Init.SampleShifting = QSPI_SAMPLE_SHIFTING_HALFCYCLE;
+	QSPI_Handler.Init.FlashSize = POSITION_VAL(0X2000000) - 1; // 32M
+	QSPI_Handler.Init.ChipSelectHighTime = QSPI_CS_HIGH_TIME_5_CYCLE;
+	QSPI_Handler.Init.ClockMode = QSPI_CLOCK_MODE_0;
+	QSPI_Handler.Init.FlashID = QSPI_FLASH_ID_1;
+	QSPI_Handler.Init.DualFlash = QSPI_DUALFLASH_DISABLE;
+	return HAL_QSPI_Init(&QSPI_Handler) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief low level HAL initialization QUADSPI
+ *
+ */
+void HAL_QSPI_MspInit(QSPI_HandleTypeDef *hqspi)
+{
+	GPIO_InitTypeDef GPIO_Initure;
+
+	__HAL_RCC_QSPI_CLK_ENABLE();
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	__HAL_RCC_GPIOF_CLK_ENABLE();
+
+	// PB6: NCS
+	GPIO_Initure.Pin = GPIO_PIN_6;
+	GPIO_Initure.Mode = GPIO_MODE_AF_PP;
+	GPIO_Initure.Pull = GPIO_PULLUP;
+	GPIO_Initure.Speed = GPIO_SPEED_HIGH;
+	GPIO_Initure.Alternate = GPIO_AF10_QUADSPI;
+	HAL_GPIO_Init(GPIOB, &GPIO_Initure);
+
+	// PF8, PF9: IO0, IO1
+	GPIO_Initure.Pin = GPIO_PIN_8 | GPIO_PIN_9;
+	GPIO_Initure.Pull = GPIO_NOPULL;
+	GPIO_Initure.Alternate = GPIO_AF10_QUADSPI;
+	HAL_GPIO_Init(GPIOF, &GPIO_Initure);
+
+	// PB2: CLK
+	GPIO_Initure.Pin = GPIO_PIN_2;
+	GPIO_Initure.Alternate = GPIO_AF9_QUADSPI;
+	HAL_GPIO_Init(GPIOB, &GPIO_Initure);
+
+	// PF6, PF7: IO3, IO2, the flash /HOLD and /WP while QE is clear, pulled
+	// up so that 1 and 2 line commands are not held or write protected
+	GPIO_Initure.Pin = GPIO_PIN_6 | GPIO_PIN_7;
+	GPIO_Initure.Pull = GPIO_PULLUP;
+	GPIO_Initure.Alternate = GPIO_AF9_QUADSPI;
+	HAL_GPIO_Init(GPIOF, &GPIO_Initure);
+}
+
+/**
+ * @brief HAL mode of a phase from its line count
+ *
+ */
+static uint32_t QSPI_Address_Mode(uint8_t lines)
+{
+	return lines == 4 ? QSPI_ADDRESS_4_LINES : lines == 2 ? QSPI_ADDRESS_2_LINES : QSPI_ADDRESS_1_LINE;
+}
+
+static uint32_t QSPI_Alternate_Mode(uint8_t lines)
+{
+	return lines == 4 ? QSPI_ALTERNATE_BYTES_4_LINES : lines == 2 ? QSPI_ALTERNATE_BYTES_2_LINES : QSPI_ALTERNATE_BYTES_1_LINE;
+}
+
+static uint32_t QSPI_Data_Mode(uint8_t lines)
+{
+	return lines == 4 ? QSPI_DATA_4_LINES : lines == 2 ? QSPI_DATA_2_LINES : lines == 1 ? QSPI_DATA_1_LINE : QSPI_DATA_NONE;
+}
+
+/**
+ * @brief fill a HAL command, parameters as QSPI_Command
+ *
+ */
+static void QSPI_Fill_Command(QSPI_CommandTypeDef *Cmdhandler, uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint32_t len)
+{
+	Cmdhandler->Instruction = cmd;
+	Cmdhandler->InstructionMode = QSPI_INSTRUCTION_1_LINE;
+	Cmdhandler->Address = addr;
+	Cmdhandler->AddressSize = addrbytes == 4 ? QSPI_ADDRESS_32_BITS : QSPI_ADDRESS_24_BITS;
+	Cmdhandler->AddressMode = addrbytes ? QSPI_Address_Mode(addrlines) : QSPI_ADDRESS_NONE;
+	Cmdhandler->AlternateBytes = mode & 0XFF;
+	Cmdhandler->AlternateBytesSize = QSPI_ALTERNATE_BYTES_8_BITS;
+	Cmdhandler->AlternateByteMode = mode == QSPI_NO_MODE ? QSPI_ALTERNATE_BYTES_NONE : QSPI_Alternate_Mode(addrlines);
+	Cmdhandler->DummyCycles = dummycycles;
+	Cmdhandler->DataMode = QSPI_Data_Mode(datalines);
+	Cmdhandler->NbData = len;
+	Cmdhandler->DdrMode = QSPI_DDR_MODE_DISABLE;
+	Cmdhandler->DdrHoldHalfCycle = QSPI_DDR_HHC_ANALOG_DELAY;
+	Cmdhandler->SIOOMode = QSPI_SIOO_INST_EVERY_CMD;
+}
+
+/**
+ * @brief send a command, the instruction is always on 1 line
+ *
+ * @param
+ * cmd: instruction
+ * addr: address
+ * addrbytes: 0 (no address), 3 or 4
+ * addrlines: lines used by the address, 1, 2 or 4
+ * mode: mode byte sent after the address on the address lines, QSPI_NO_MODE: none
+ * dummycycles: clocks between address (or mode byte) and data
+ * datalines: lines used by the data, 0 (no data), 1, 2 or 4
+ * len: number of data bytes
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Command(uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint32_t len)
+{
+	QSPI_CommandTypeDef Cmdhandler;
+
+	QSPI_Fill_Command(&Cmdhandler, cmd, addr, addrbytes, addrlines, mode, dummycycles, datalines, len);
+	return HAL_QSPI_Command(&QSPI_Handler, &Cmdhandler, QSPI_TIMEOUT) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief receive the data phase of the last command
+ *
+ * @param
+ * pData: receive buffer
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Receive(uint8_t *pData)
+{
+	return HAL_QSPI_Receive(&QSPI_Handler, pData, QSPI_TIMEOUT) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief transmit the data phase of the last command
+ *
+ * @param
+ * pData: data to send
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Transmit(const uint8_t *pData)
+{
+	return HAL_QSPI_Transmit(&QSPI_Handler, (uint8_t *)pData, QSPI_TIMEOUT) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief enter memory-mapped mode, reads of QSPI_MAP_BASE + addr issue the
+ * given read command
+ *
+ * @param
+ * cmd: read instruction
+ * addrbytes: 3 or 4
+ * addrlines: lines used by the address, 1, 2 or 4
+ * mode: mode byte sent after the address, QSPI_NO_MODE: none
+ * dummycycles: clocks between address (or mode byte) and data
+ * datalines: lines used by the data, 1, 2 or 4
+ * sioo: 1: send the instruction only with the first read
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Memory_Mapped(uint8_t cmd, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint8_t sioo)
+{
+	QSPI_CommandTypeDef Cmdhandler;
+	QSPI_MemoryMappedTypeDef Mapped;
+
+	QSPI_Fill_Command(&Cmdhandler, cmd, 0, addrbytes, addrlines, mode, dummycycles, datalines, 0);
+	if (sioo)
+	{
+		Cmdhandler.SIOOMode = QSPI_SIOO_INST_ONLY_FIRST_CMD;
+	}
+	Mapped.TimeOutActivation = QSPI_TIMEOUT_COUNTER_DISABLE;
+	Mapped.TimeOutPeriod = 0;
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+	if (SCB->CCR & SCB_CCR_DC_Msk)
+	{
+		SCB_CleanInvalidateDCache(); // flash content may have changed
+	}
+#endif
+	return HAL_QSPI_MemoryMapped(&QSPI_Handler, &Cmdhandler, &Mapped) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief leave memory-mapped mode, needed before any QSPI_Command
+ *
+ */
+void QSPI_Abort(void)
+{
+	HAL_QSPI_Abort(&QSPI_Handler);
+}
+
+/**
+ * @brief a read of a flash in continuous read mode: the command of
+ * QSPI_Command without its instruction phase, the flash takes the cycle as
+ * a repeat of the read that entered the mode
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Continue(uint32_t addr, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint32_t len)
+{
+	QSPI_CommandTypeDef Cmdhandler;
+
+	QSPI_Fill_Command(&Cmdhandler, 0, addr, addrbytes, addrlines, mode, dummycycles, datalines, len);
+	Cmdhandler.InstructionMode = QSPI_INSTRUCTION_NONE;
+	return HAL_QSPI_Command(&QSPI_Handler, &Cmdhandler, QSPI_TIMEOUT) == HAL_OK ? 0 : 1;
+}
+
+/**
+ * @brief clock an all ones address and mode byte on 4 lines without an
+ * instruction, ends a continuous read mode of the flash
+ *
+ * @param
+ * addrbytes: 3 or 4
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Mode_Reset(uint8_t addrbytes)
+{
+	QSPI_CommandTypeDef Cmdhandler;
+
+	QSPI_Fill_Command(&Cmdhandler, 0XFF, 0XFFFFFFFF, addrbytes, 4, 0XFF, 0, 0, 0);
+	Cmdhandler.InstructionMode = QSPI_INSTRUCTION_NONE;
+	return HAL_QSPI_Command(&QSPI_Handler, &Cmdhandler, QSPI_TIMEOUT) == HAL_OK ? 0 : 1;
+}
+
+#endif
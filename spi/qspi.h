@@ -0,0 +1,130 @@
+/*
+ * qspi.h
+ *
+ */
+
+#ifndef __QSPI_H_
+#define __QSPI_H_
+#include "sys.h"
+
+/**
+ * QUADSPI driver for the W25QXX
+ *
+ * Only parts with a QUADSPI peripheral (HAL_QSPI_MODULE_ENABLED, e.g. the
+ * STM32F7 version of the board) have it. The STM32F429 has none, there the
+ * flash stays on SPI5.
+ *
+ * CLK: PB2, NCS: PB6, IO0: PF8, IO1: PF9, IO2: PF7, IO3: PF6
+ *
+ */
+#ifdef HAL_QSPI_MODULE_ENABLED
+
+extern QSPI_HandleTypeDef QSPI_Handler;
+
+#define QSPI_TIMEOUT 1000   // ms
+#define QSPI_NO_MODE 0XFFFF // no mode byte after the address
+#define QSPI_MAP_BASE 0X90000000 // flash address 0 in memory-mapped mode
+
+/**
+ * @brief initialization QUADSPI, 32M flash
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Init(void);
+
+/**
+ * @brief send a command, the instruction is always on 1 line
+ *
+ * @param
+ * cmd: instruction
+ * addr: address
+ * addrbytes: 0 (no address), 3 or 4
+ * addrlines: lines used by the address, 1, 2 or 4
+ * mode: mode byte sent after the address on the address lines, QSPI_NO_MODE: none
+ * dummycycles: clocks between address (or mode byte) and data
+ * datalines: lines used by the data, 0 (no data), 1, 2 or 4
+ * len: number of data bytes
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Command(uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint32_t len);
+
+/**
+ * @brief receive the data phase of the last command
+ *
+ * @param
+ * pData: receive buffer
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Receive(uint8_t *pData);
+
+/**
+ * @brief transmit the data phase of the last command
+ *
+ * @param
+ * pData: data to send
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Transmit(const uint8_t *pData);
+
+/**
+ * @brief enter memory-mapped mode, reads of QSPI_MAP_BASE + addr issue the
+ * given read command. Cleans and invalidates the D-cache, if enabled, so no
+ * stale lines of an earlier mapping are hit.
+ *
+ * @param
+ * cmd: read instruction
+ * addrbytes: 3 or 4
+ * addrlines: lines used by the address, 1, 2 or 4
+ * mode: mode byte sent after the address, QSPI_NO_MODE: none
+ * dummycycles: clocks between address (or mode byte) and data
+ * datalines: lines used by the data, 1, 2 or 4
+ * sioo: 1: send the instruction only with the first read, for flash
+ * continuous read modes
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Memory_Mapped(uint8_t cmd, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint8_t sioo);
+
+/**
+ * @brief a read of a flash in continuous read mode (M5-4 = 10): as
+ * QSPI_Command, without the instruction. The indirect mode counterpart of
+ * the sioo option of QSPI_Memory_Mapped.
+ *
+ * @param
+ * addr, addrbytes, addrlines, mode, dummycycles, datalines, len: as
+ * QSPI_Command, mode 0XFF leaves the continuous read mode after this read
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Continue(uint32_t addr, uint8_t addrbytes, uint8_t addrlines, uint16_t mode, uint8_t dummycycles, uint8_t datalines, uint32_t len);
+
+/**
+ * @brief clock an all ones address and mode byte on 4 lines without an
+ * instruction, ends a continuous read mode of the flash (M5-4 = 10)
+ *
+ * @param
+ * addrbytes: 3 or 4, as the read command that entered the mode
+ *
+ * @return 0: success, 1: error
+ *
+ */
+uint8_t QSPI_Mode_Reset(uint8_t addrbytes);
+
+/**
+ * @brief leave memory-mapped mode, needed before any QSPI_Command
+ *
+ */
+void QSPI_Abort(void);
+
+#endif
+
+#endif
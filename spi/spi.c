@@ -1,6 +1,11 @@
 #include "spi.h"
+#include "trace.h"
 
-SPI_HandleTypeDef SPI5_Handler; // SPI Handle
+SPI_HandleTypeDef SPI5_Handler;       // SPI Handle
+DMA_HandleTypeDef SPI5_TxDMA_Handler; // SPI5 TX DMA Handle
+DMA_HandleTypeDef SPI5_RxDMA_Handler; // SPI5 RX DMA Handle
+
+#define SPI5_TIMEOUT 1000 // ms
 
 /**
  * @brief initialization SPI 5
@@ -45,6 +50,61 @@ void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi)
     GPIO_Initure.Speed = GPIO_SPEED_FAST;
     GPIO_Initure.Alternate = GPIO_AF5_SPI5;
     HAL_GPIO_Init(GPIOF, &GPIO_Initure);
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    // SPI5_TX: DMA2 Stream4 Channel2
+    SPI5_TxDMA_Handler.Instance = DMA2_Stream4;
+    SPI5_TxDMA_Handler.Init.Channel = DMA_CHANNEL_2;
+    SPI5_TxDMA_Handler.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    SPI5_TxDMA_Handler.Init.PeriphInc = DMA_PINC_DISABLE;
+    SPI5_TxDMA_Handler.Init.MemInc = DMA_MINC_ENABLE;
+    SPI5_TxDMA_Handler.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    SPI5_TxDMA_Handler.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    SPI5_TxDMA_Handler.Init.Mode = DMA_NORMAL;
+    SPI5_TxDMA_Handler.Init.Priority = DMA_PRIORITY_MEDIUM;
+    SPI5_TxDMA_Handler.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_DeInit(&SPI5_TxDMA_Handler);
+    HAL_DMA_Init(&SPI5_TxDMA_Handler);
+    __HAL_LINKDMA(hspi, hdmatx, SPI5_TxDMA_Handler);
+
+    // SPI5_RX: DMA2 Stream3 Channel2, higher priority so RX never overruns
+    SPI5_RxDMA_Handler.Instance = DMA2_Stream3;
+    SPI5_RxDMA_Handler.Init.Channel = DMA_CHANNEL_2;
+    SPI5_RxDMA_Handler.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    SPI5_RxDMA_Handler.Init.PeriphInc = DMA_PINC_DISABLE;
+    SPI5_RxDMA_Handler.Init.MemInc = DMA_MINC_ENABLE;
+    SPI5_RxDMA_Handler.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    SPI5_RxDMA_Handler.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    SPI5_RxDMA_Handler.Init.Mode = DMA_NORMAL;
+    SPI5_RxDMA_Handler.Init.Priority = DMA_PRIORITY_HIGH;
+    SPI5_RxDMA_Handler.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_DeInit(&SPI5_RxDMA_Handler);
+    HAL_DMA_Init(&SPI5_RxDMA_Handler);
+    __HAL_LINKDMA(hspi, hdmarx, SPI5_RxDMA_Handler);
+
+    HAL_NVIC_SetPriority(DMA2_Stream3_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream3_IRQn);
+    HAL_NVIC_SetPriority(DMA2_Stream4_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream4_IRQn);
+}
+
+/**
+ * @brief SPI5 RX DMA interrupt
+ *
+ */
+void DMA2_Stream3_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&SPI5_RxDMA_Handler);
+}
+
+/**
+ * @brief SPI5 TX DMA interrupt
+ *
+ */
+void DMA2_Stream4_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&SPI5_TxDMA_Handler);
 }
 
 /**
@@ -76,6 +136,113 @@ void SPI5_SetSpeed(uint8_t SPI_BaudRatePrescaler)
 uint8_t SPI5_ReadWriteByte(uint8_t TxData)
 {
     uint8_t Rxdata;
+    TRACE_XFER();
     HAL_SPI_TransmitReceive(&SPI5_Handler, &TxData, &Rxdata, 1, 1000);
     return Rxdata;
 }
+
+/**
+ * @brief wait for the running DMA transfer of SPI 5
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+static uint8_t SPI5_DMA_Wait(void)
+{
+    uint32_t tickstart = HAL_GetTick();
+    while (HAL_SPI_GetState(&SPI5_Handler) != HAL_SPI_STATE_READY)
+    {
+        if ((HAL_GetTick() - tickstart) > SPI5_TIMEOUT)
+        {
+            HAL_SPI_DMAStop(&SPI5_Handler);
+            return 1;
+        }
+    }
+    return (SPI5_Handler.ErrorCode == HAL_SPI_ERROR_NONE) ? 0 : 1;
+}
+
+/**
+ * @brief transmit a block of bytes, the received bytes are discarded
+ *
+ * @param
+ * pData: data to send
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_Transmit(const uint8_t *pData, uint16_t Size)
+{
+    if (Size == 0)
+    {
+        return 0;
+    }
+    TRACE_XFER();
+    if (Size < SPI5_DMA_MIN_SIZE)
+    {
+        return HAL_SPI_Transmit(&SPI5_Handler, (uint8_t *)pData, Size, SPI5_TIMEOUT) == HAL_OK ? 0 : 1;
+    }
+    if (HAL_SPI_Transmit_DMA(&SPI5_Handler, (uint8_t *)pData, Size) != HAL_OK)
+    {
+        return 1;
+    }
+    return SPI5_DMA_Wait();
+}
+
+/**
+ * @brief receive a block of bytes, the bytes sent are don't care
+ *
+ * @param
+ * pData: receive buffer
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_Receive(uint8_t *pData, uint16_t Size)
+{
+    if (Size == 0)
+    {
+        return 0;
+    }
+    TRACE_XFER();
+    if (Size < SPI5_DMA_MIN_SIZE)
+    {
+        return HAL_SPI_Receive(&SPI5_Handler, pData, Size, SPI5_TIMEOUT) == HAL_OK ? 0 : 1;
+    }
+    // full duplex master: HAL clocks the buffer itself out on MOSI
+    if (HAL_SPI_Receive_DMA(&SPI5_Handler, pData, Size) != HAL_OK)
+    {
+        return 1;
+    }
+    return SPI5_DMA_Wait();
+}
+
+/**
+ * @brief transmit and receive a block of bytes at the same time
+ *
+ * @param
+ * pTxData: data to send
+ * pRxData: receive buffer, may be the same as pTxData
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_TransmitReceive(const uint8_t *pTxData, uint8_t *pRxData, uint16_t Size)
+{
+    if (Size == 0)
+    {
+        return 0;
+    }
+    TRACE_XFER();
+    if (Size < SPI5_DMA_MIN_SIZE)
+    {
+        return HAL_SPI_TransmitReceive(&SPI5_Handler, (uint8_t *)pTxData, pRxData, Size, SPI5_TIMEOUT) == HAL_OK ? 0 : 1;
+    }
+    if (HAL_SPI_TransmitReceive_DMA(&SPI5_Handler, (uint8_t *)pTxData, pRxData, Size) != HAL_OK)
+    {
+        return 1;
+    }
+    return SPI5_DMA_Wait();
+}
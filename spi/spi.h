@@ -12,7 +12,51 @@
 //SPI Handle
 extern SPI_HandleTypeDef SPI5_Handler;  
 
+//DMA Handle (SPI5_TX: DMA2 Stream4 Channel2, SPI5_RX: DMA2 Stream3 Channel2)
+extern DMA_HandleTypeDef SPI5_TxDMA_Handler;
+extern DMA_HandleTypeDef SPI5_RxDMA_Handler;
+
+//transfers shorter than this are sent by polling, the DMA setup costs more
+#define SPI5_DMA_MIN_SIZE   16
+
 void SPI5_Init(void);
 void SPI5_SetSpeed(uint8_t SPI_BaudRatePrescaler);
 uint8_t SPI5_ReadWriteByte(uint8_t TxData);
+
+/**
+ * @brief transmit a block of bytes, the received bytes are discarded
+ *
+ * @param
+ * pData: data to send
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_Transmit(const uint8_t *pData, uint16_t Size);
+
+/**
+ * @brief receive a block of bytes, the bytes sent are don't care
+ *
+ * @param
+ * pData: receive buffer
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_Receive(uint8_t *pData, uint16_t Size);
+
+/**
+ * @brief transmit and receive a block of bytes at the same time
+ *
+ * @param
+ * pTxData: data to send
+ * pRxData: receive buffer, may be the same as pTxData
+ * Size: number of bytes
+ *
+ * @return 0: success, 1: error or timeout
+ *
+ */
+uint8_t SPI5_TransmitReceive(const uint8_t *pTxData, uint8_t *pRxData, uint16_t Size);
 #endif
@@ -1,9 +1,389 @@
 #include "w25qxx.h"
 #include "spi.h"
+#include "qspi.h"
+#include "w25qxx_cache.h"
 #include "delay.h"
 #include "usart.h"
+#include "trace.h"
+#include "string.h"
+#include "stdlib.h"
+
+#if W25QXX_USE_QSPI && !defined(HAL_QSPI_MODULE_ENABLED)
+#error "W25QXX_USE_QSPI needs a part with QUADSPI and HAL_QSPI_MODULE_ENABLED"
+#endif
 
 uint16_t W25QXX_TYPE = W25Q256; // default W25Q256
+W25QXX_Stats W25QXX_STATS;		// erase/program counters
+uint8_t W25QXX_LANES = 1;		// data lines of reads
+
+// command set of the detected chip, selected by W25QXX_Select_Cmds
+static uint8_t W25QXX_AddrBytes = 4;
+static uint8_t W25QXX_CmdRead = W25X_FastReadData4B;
+static uint8_t W25QXX_CmdPageProgram = W25X_PageProgram4B;
+static uint8_t W25QXX_CmdSectorErase = W25X_SectorErase4B;
+static uint8_t W25QXX_CmdBlockErase = W25X_BlockErase4B;
+#if W25QXX_USE_QSPI
+static uint8_t W25QXX_ReadAddrLines = 1;		// address lines of W25QXX_CmdRead
+static uint16_t W25QXX_ReadMode = QSPI_NO_MODE; // mode byte of W25QXX_CmdRead
+static uint8_t W25QXX_ReadDummy = 8;			// dummy clocks of W25QXX_CmdRead
+static uint8_t W25QXX_ProgramLines = 1;			// data lines of W25QXX_CmdPageProgram
+static uint32_t W25QXX_StreamAddr;				// next address of the continuous read
+static const uint8_t *W25QXX_StreamMap;			// next byte of the continuous read, NULL: not mapped
+static uint32_t W25QXX_StreamLeft;				// bytes up to the end of the chip
+static uint8_t W25QXX_MapCount = 0;				// W25QXX_Map calls not yet unmapped
+static uint8_t W25QXX_MapHold = 0;				// nested W25QXX_Map_Suspend calls
+static uint8_t W25QXX_MapContinuous = 0;		// mapped reads use continuous read mode
+#endif
+
+/**
+ * @brief select the read/program/erase commands for W25QXX_TYPE
+ * W25Q256 uses the dedicated 4-byte address commands, the others the
+ * 3-byte address ones. Single line reads use Fast Read, which runs at the
+ * full SCK rate set by SPI5_SetSpeed.
+ *
+ * With QUADSPI, 4 lanes select Fast Read Quad I/O (0xEB/0xEC, address,
+ * mode byte 0XFF and data on 4 lines, 4 dummy clocks) and Quad Page Program
+ * (0x32/0x34), 2 lanes select Fast Read Dual Output (0x3B/0x3C).
+ *
+ * @param
+ * lanes: data lines of reads, 1, 2 or 4
+ *
+ */
+static void W25QXX_Select_Cmds(uint8_t lanes)
+{
+	uint8_t addr4 = W25QXX_TYPE == W25Q256;
+	if (W25QXX_TYPE == W25Q256)
+	{
+		W25QXX_AddrBytes = 4;
+		W25QXX_CmdRead = W25X_FastReadData4B;
+		W25QXX_CmdPageProgram = W25X_PageProgram4B;
+		W25QXX_CmdSectorErase = W25X_SectorErase4B;
+		W25QXX_CmdBlockErase = W25X_BlockErase4B;
+	}
+	else
+	{
+		W25QXX_AddrBytes = 3;
+		W25QXX_CmdRead = W25X_FastReadData;
+		W25QXX_CmdPageProgram = W25X_PageProgram;
+		W25QXX_CmdSectorErase = W25X_SectorErase;
+		W25QXX_CmdBlockErase = W25X_BlockErase;
+	}
+	W25QXX_LANES = 1;
+#if W25QXX_USE_QSPI
+	W25QXX_ReadAddrLines = 1;
+	W25QXX_ReadMode = QSPI_NO_MODE;
+	W25QXX_ReadDummy = 8;
+	W25QXX_ProgramLines = 1;
+	if (lanes == 4)
+	{
+		W25QXX_CmdRead = addr4 ? W25X_FastReadQuadIO4B : W25X_FastReadQuadIO;
+		W25QXX_ReadAddrLines = 4;
+		W25QXX_ReadMode = 0XFF; // M5-4 != 10, no continuous read mode
+		W25QXX_ReadDummy = 4;
+		W25QXX_CmdPageProgram = addr4 ? W25X_QuadPageProgram4B : W25X_QuadPageProgram;
+		W25QXX_ProgramLines = 4;
+		W25QXX_LANES = 4;
+	}
+	else if (lanes == 2)
+	{
+		W25QXX_CmdRead = addr4 ? W25X_FastReadDual4B : W25X_FastReadDual;
+		W25QXX_LANES = 2;
+	}
+#else
+	(void)lanes;
+	(void)addr4;
+#endif
+}
+
+#if W25QXX_USE_QSPI
+
+/**
+ * @brief chip size in bytes, 0: unknown type
+ *
+ */
+static uint32_t W25QXX_Size(void)
+{
+	if (W25QXX_TYPE < W25Q80 || W25QXX_TYPE > W25Q256)
+	{
+		return 0;
+	}
+	return 1UL << ((W25QXX_TYPE & 0XFF) + 1); // W25Q80 (0X13): 1M
+}
+
+/**
+ * @brief enter memory-mapped mode
+ * Quad I/O reads keep the chip in continuous read mode and the controller
+ * sends the instruction only once, each mapped read then starts with the
+ * address: 8 clocks less per random access.
+ *
+ * @return 0: success, 1: error
+ *
+ */
+static uint8_t W25QXX_Map_Enter(void)
+{
+	W25QXX_MapContinuous = W25QXX_LANES == 4;
+	return QSPI_Memory_Mapped(W25QXX_CmdRead, W25QXX_AddrBytes, W25QXX_ReadAddrLines,
+							  W25QXX_MapContinuous ? W25X_ContinuousRead : W25QXX_ReadMode,
+							  W25QXX_ReadDummy, W25QXX_LANES, W25QXX_MapContinuous);
+}
+
+/**
+ * @brief leave memory-mapped mode
+ *
+ */
+static void W25QXX_Map_Leave(void)
+{
+	QSPI_Abort();
+	if (W25QXX_MapContinuous)
+	{
+		QSPI_Mode_Reset(W25QXX_AddrBytes);
+	}
+}
+
+/**
+ * @brief leave memory-mapped mode for an operation, calls nest
+ * Program and erase operations hold it from the first command until BUSY
+ * has cleared, the commands inside only nest.
+ *
+ */
+static void W25QXX_Map_Suspend(void)
+{
+	if (W25QXX_MapHold++ == 0 && W25QXX_MapCount)
+	{
+		W25QXX_Map_Leave();
+	}
+}
+
+/**
+ * @brief end an operation started by W25QXX_Map_Suspend, memory-mapped
+ * mode (and with it the D-cache invalidation) is re-entered by the
+ * outermost one
+ *
+ */
+static void W25QXX_Map_Resume(void)
+{
+	if (W25QXX_MapHold && --W25QXX_MapHold == 0 && W25QXX_MapCount)
+	{
+		W25QXX_Map_Enter();
+	}
+}
+
+/**
+ * @brief single line command with optional address, dummy and data phases
+ * on QUADSPI
+ *
+ * @param
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * dummy: number of dummy bytes after the address
+ * pData: receive buffer
+ * len: number of bytes to read
+ *
+ */
+static void W25QXX_Cmd_Read(uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t dummy, uint8_t *pData, uint16_t len)
+{
+	W25QXX_Map_Suspend();
+	if (QSPI_Command(cmd, addr, addrbytes, 1, QSPI_NO_MODE, dummy * 8, 1, len) == 0)
+	{
+		QSPI_Receive(pData);
+	}
+	W25QXX_Map_Resume();
+}
+
+/**
+ * @brief single line command with optional address and data phases on
+ * QUADSPI
+ *
+ * @param
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * pData: data to send
+ * len: number of bytes to send, 0: none
+ *
+ */
+static void W25QXX_Cmd_Write(uint8_t cmd, uint32_t addr, uint8_t addrbytes, const uint8_t *pData, uint16_t len)
+{
+	W25QXX_Map_Suspend();
+	if (QSPI_Command(cmd, addr, addrbytes, 1, QSPI_NO_MODE, 0, len ? 1 : 0, len) == 0 && len)
+	{
+		QSPI_Transmit(pData);
+	}
+	W25QXX_Map_Resume();
+}
+
+/**
+ * @brief read with the command set selected for W25QXX_LANES
+ *
+ */
+static void W25QXX_Read_Data(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+	W25QXX_Map_Suspend();
+	if (QSPI_Command(W25QXX_CmdRead, ReadAddr, W25QXX_AddrBytes, W25QXX_ReadAddrLines, W25QXX_ReadMode,
+					 W25QXX_ReadDummy, W25QXX_LANES, NumByteToRead) == 0)
+	{
+		QSPI_Receive(pBuffer);
+	}
+	W25QXX_Map_Resume();
+}
+
+/**
+ * @brief page program with the command set selected for W25QXX_LANES
+ *
+ */
+static void W25QXX_Program_Data(const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+	W25QXX_Map_Suspend();
+	if (QSPI_Command(W25QXX_CmdPageProgram, WriteAddr, W25QXX_AddrBytes, 1, QSPI_NO_MODE, 0,
+					 W25QXX_ProgramLines, NumByteToWrite) == 0)
+	{
+		QSPI_Transmit(pBuffer);
+	}
+	W25QXX_Map_Resume();
+}
+
+#else
+
+// SPI5 has no memory-mapped mode
+#define W25QXX_Map_Suspend()
+#define W25QXX_Map_Resume()
+
+/**
+ * @brief build the command, address and dummy bytes of a transaction
+ *
+ * @param
+ * buf: 9 bytes at least
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * dummy: number of dummy bytes after the address
+ *
+ * @return number of bytes
+ *
+ */
+static uint8_t W25QXX_Cmd_Header(uint8_t *buf, uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t dummy)
+{
+	uint8_t len = 0;
+	buf[len++] = cmd;
+	if (addrbytes == 4)
+	{
+		buf[len++] = (uint8_t)((addr) >> 24);
+	}
+	if (addrbytes)
+	{
+		buf[len++] = (uint8_t)((addr) >> 16);
+		buf[len++] = (uint8_t)((addr) >> 8);
+		buf[len++] = (uint8_t)addr;
+	}
+	while (dummy--)
+	{
+		buf[len++] = 0XFF;
+	}
+	return len;
+}
+
+/**
+ * @brief send a command, its address and dummy bytes in one SPI transfer
+ * CS must already be low
+ *
+ * @param
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * dummy: number of dummy bytes after the address
+ *
+ */
+static void W25QXX_Send_Cmd(uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t dummy)
+{
+	uint8_t buf[9];
+	SPI5_Transmit(buf, W25QXX_Cmd_Header(buf, cmd, addr, addrbytes, dummy));
+}
+
+/**
+ * @brief command with optional address, dummy and data phases in one CS
+ * cycle, short register reads go out as a single SPI transfer
+ *
+ * @param
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * dummy: number of dummy bytes after the address
+ * pData: receive buffer
+ * len: number of bytes to read
+ *
+ */
+static void W25QXX_Cmd_Read(uint8_t cmd, uint32_t addr, uint8_t addrbytes, uint8_t dummy, uint8_t *pData, uint16_t len)
+{
+	static uint8_t buf[16]; // 16 bytes go by DMA, which cannot reach a stack in CCM RAM
+	uint8_t n = W25QXX_Cmd_Header(buf, cmd, addr, addrbytes, dummy);
+	W25QXX_CS = 0;
+	if (n + len <= sizeof(buf))
+	{
+		memset(buf + n, 0XFF, len);
+		SPI5_TransmitReceive(buf, buf, n + len);
+		memcpy(pData, buf + n, len);
+	}
+	else
+	{
+		SPI5_Transmit(buf, n);
+		SPI5_Receive(pData, len);
+	}
+	W25QXX_CS = 1;
+}
+
+/**
+ * @brief command with optional address and data phases in one CS cycle,
+ * short writes go out as a single SPI transfer
+ *
+ * @param
+ * cmd: command
+ * addr: flash address
+ * addrbytes: 0 (no address), 3 or 4 address bytes
+ * pData: data to send
+ * len: number of bytes to send, 0: none
+ *
+ */
+static void W25QXX_Cmd_Write(uint8_t cmd, uint32_t addr, uint8_t addrbytes, const uint8_t *pData, uint16_t len)
+{
+	static uint8_t buf[16]; // DMA from 16 bytes on, kept off the stack
+	uint8_t n = W25QXX_Cmd_Header(buf, cmd, addr, addrbytes, 0);
+	W25QXX_CS = 0;
+	if (n + len <= sizeof(buf))
+	{
+		if (len)
+		{
+			memcpy(buf + n, pData, len);
+		}
+		SPI5_Transmit(buf, n + len);
+	}
+	else
+	{
+		SPI5_Transmit(buf, n);
+		SPI5_Transmit(pData, len);
+	}
+	W25QXX_CS = 1;
+}
+
+/**
+ * @brief Fast Read on SPI5
+ *
+ */
+static void W25QXX_Read_Data(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+	W25QXX_Cmd_Read(W25QXX_CmdRead, ReadAddr, W25QXX_AddrBytes, W25X_FastReadDummy, pBuffer, NumByteToRead);
+}
+
+/**
+ * @brief page program on SPI5
+ *
+ */
+static void W25QXX_Program_Data(const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+	W25QXX_Cmd_Write(W25QXX_CmdPageProgram, WriteAddr, W25QXX_AddrBytes, pBuffer, NumByteToWrite);
+}
+
+#endif
 
 /**
  * @brief initialization W25Q256
@@ -12,10 +392,17 @@ uint16_t W25QXX_TYPE = W25Q256; // default W25Q256
  * sector: 8192
  * sector size: 4k
  *
+ * With W25QXX_USE_QSPI the flash is driven by QUADSPI, quad I/O is used
+ * when QE can be set, dual output reads otherwise, and unknown parts stay
+ * single line.
+ *
  */
 void W25QXX_Init(void)
 {
 	uint8_t temp;
+#if W25QXX_USE_QSPI
+	QSPI_Init();
+#else
 	GPIO_InitTypeDef GPIO_Initure;
 
 	__HAL_RCC_GPIOF_CLK_ENABLE(); // Enable GPIO F Clock
@@ -29,17 +416,31 @@ void W25QXX_Init(void)
 	W25QXX_CS = 1;
 	SPI5_Init();
 	SPI5_SetSpeed(SPI_BAUDRATEPRESCALER_2);
+#endif
 	W25QXX_TYPE = W25QXX_ReadID();
+	W25QXX_Select_Cmds(1);
 	if (W25QXX_TYPE == W25Q256)
 	{
+		// the 4-byte address commands do not need the global 4-byte mode,
+		// keep the chip in its power-up 3-byte mode (ADS = 0)
 		temp = W25QXX_ReadSR(3);
-		if ((temp & 0X01) == 0)
+		if ((temp & 0X01) == 1)
 		{
-			W25QXX_CS = 0;
-			SPI5_ReadWriteByte(W25X_Enable4ByteAddr);
-			W25QXX_CS = 1;
+			W25QXX_Cmd_Write(W25X_Exit4ByteAddr, 0, 0, NULL, 0);
 		}
 	}
+#if W25QXX_USE_QSPI
+	if (W25QXX_TYPE >= W25Q80 && W25QXX_TYPE <= W25Q256)
+	{
+#if W25QXX_QSPI_LANES == 4
+		// without QE IO2/IO3 stay /WP and /HOLD, Dual Output only uses
+		// IO0/IO1 and the pull-ups of qspi.c keep the other two inactive
+		W25QXX_Select_Cmds(W25QXX_Quad_Enable() == 0 ? 4 : 2);
+#else
+		W25QXX_Select_Cmds(W25QXX_QSPI_LANES);
+#endif
+	}
+#endif
 }
 
 /**
@@ -70,7 +471,7 @@ void W25QXX_Init(void)
  */
 uint8_t W25QXX_ReadSR(uint8_t regno)
 {
-	uint8_t byte = 0, command = 0;
+	uint8_t sr, command = 0;
 	switch (regno)
 	{
 	case 1:
@@ -86,118 +487,544 @@ uint8_t W25QXX_ReadSR(uint8_t regno)
 		command = W25X_ReadStatusReg1;
 		break;
 	}
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(command);
-	byte = SPI5_ReadWriteByte(0Xff);
-	W25QXX_CS = 1;
-	return byte;
+	W25QXX_Cmd_Read(command, 0, 0, 0, &sr, 1);
+	return sr;
+}
+
+/**
+ * @brief write W25QXX status registers
+ *
+ * @param
+ * regno: W25QXX status register number. range 1 ~ 3.
+ * sr: status register data
+ *
+ */
+void W25QXX_Write_SR(uint8_t regno, uint8_t sr)
+{
+	uint8_t command = 0;
+	switch (regno)
+	{
+	case 1:
+		command = W25X_WriteStatusReg1;
+		break;
+	case 2:
+		command = W25X_WriteStatusReg2;
+		break;
+	case 3:
+		command = W25X_WriteStatusReg3;
+		break;
+	default:
+		command = W25X_WriteStatusReg1;
+		break;
+	}
+	W25QXX_Cmd_Write(command, 0, 0, &sr, 1);
+}
+
+/**
+ * @brief enable write W25QXX
+ *
+ */
+void W25QXX_Write_Enable(void)
+{
+	W25QXX_Cmd_Write(W25X_WriteEnable, 0, 0, NULL, 0);
+}
+
+/**
+ * @brief disable write W25QXX
+ *
+ */
+void W25QXX_Write_Disable(void)
+{
+	W25QXX_Cmd_Write(W25X_WriteDisable, 0, 0, NULL, 0);
+}
+
+/**
+ * @brief set the non-volatile QE bit if it is clear, needed by the quad
+ * read and program commands
+ * SR2 is written alone with 0x31, parts without that command (early
+ * W25Q16/W25Q32) leave QE clear and are reported as not quad capable.
+ *
+ * @return 0: QE set, 1: the part did not take it (no quad support)
+ *
+ */
+uint8_t W25QXX_Quad_Enable(void)
+{
+	uint8_t sr2 = W25QXX_ReadSR(2);
+	if (sr2 & W25X_SR2_QE)
+	{
+		return 0;
+	}
+	W25QXX_Map_Suspend();
+	W25QXX_Write_Enable();
+	W25QXX_Write_SR(2, sr2 | W25X_SR2_QE);
+	W25QXX_Wait_Busy(); // non-volatile write, up to 15ms
+	sr2 = W25QXX_ReadSR(2);
+	W25QXX_Map_Resume();
+	return (sr2 & W25X_SR2_QE) ? 0 : 1;
+}
+
+/**
+ * @brief read W25QXX ID
+ *
+ * @return W25QXX ID
+ *
+ */
+uint16_t W25QXX_ReadID(void)
+{
+	uint8_t buf[2];
+	W25QXX_Cmd_Read(W25X_ManufactDeviceID, 0, 3, 0, buf, 2);
+	return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+/**
+ * @brief read data from  W25QXX FLASH by SPI
+ * Fast Read (0x0B, 0x0C on W25Q256) is used, Read Data (0x03) is limited
+ * to 50MHz SCK
+ * @param
+ * pBuffer: read to buffer
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read(MAX: 65535)
+ *
+ */
+void W25QXX_Read(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+	if (NumByteToRead < 0 || NumByteToRead > 65535)
+	{
+		return;
+	}
+	TRACE_BEGIN(trace, NumByteToRead);
+	W25QXX_Read_Data(pBuffer, ReadAddr, NumByteToRead);
+	TRACE_END(TRACE_W25QXX_READ, trace);
+}
+
+/**
+ * @brief start a page program, does not wait for BUSY to clear
+ *
+ * @param
+ * pBuffer: data in buffer
+ * WriteAddr: flash start address
+ * NumByteToWrite: The number of bytes to write (max 256),
+ * which should not exceed the number of bytes remaining on the page
+ *
+ */
+static void W25QXX_Program_Start(const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+	W25QXX_STATS.pages_programmed++;
+	W25QXX_Cache_Program(pBuffer, WriteAddr, NumByteToWrite);
+	W25QXX_Write_Enable();
+	W25QXX_Program_Data(pBuffer, WriteAddr, NumByteToWrite);
+}
+
+/**
+ * @brief start a sector or block erase, does not wait for BUSY to clear
+ *
+ * @param
+ * cmd: sector, 32K or 64K block erase command
+ * Dst_Addr: byte address inside the sector or block
+ * Size: erase size (4K, 32K, 64K)
+ *
+ */
+static void W25QXX_Erase_Start(uint8_t cmd, uint32_t Dst_Addr, uint32_t Size)
+{
+	W25QXX_STATS.erases++;
+	W25QXX_Cache_Erase(Dst_Addr & ~(Size - 1), Size);
+	W25QXX_Write_Enable(); // SET WEL
+	// 32K erase has no 4-byte form, only issued below 16M
+	W25QXX_Cmd_Write(cmd, Dst_Addr, cmd == W25X_BlockErase32K ? 3 : W25QXX_AddrBytes, NULL, 0);
+}
+
+/**
+ * @brief start a chip erase, does not wait for BUSY to clear
+ *
+ */
+static void W25QXX_Chip_Erase_Start(void)
+{
+	W25QXX_STATS.erases++;
+	W25QXX_Cache_Flush();
+	W25QXX_Write_Enable(); // SET WEL
+	W25QXX_Cmd_Write(W25X_ChipErase, 0, 0, NULL, 0);
+}
+
+/**
+ * @brief start a continuous read, the flash sends data from ReadAddr on
+ * for as long as CS stays low
+ * QUADSPI drives NCS per command, there the chip is mapped and the stream
+ * is copied out of the window: the controller keeps reading sequential
+ * addresses in one burst. Without a mapping each W25QXX_Stream_Read issues
+ * a read at the next address.
+ *
+ * @param
+ * ReadAddr: flash start address
+ *
+ */
+void W25QXX_Stream_Begin(uint32_t ReadAddr)
+{
+#if W25QXX_USE_QSPI
+	W25QXX_StreamAddr = ReadAddr;
+	W25QXX_StreamMap = W25QXX_Map(ReadAddr, 1);
+	W25QXX_StreamLeft = W25QXX_StreamMap ? W25QXX_Size() - ReadAddr : 0;
+#else
+	W25QXX_CS = 0;
+	W25QXX_Send_Cmd(W25QXX_CmdRead, ReadAddr, W25QXX_AddrBytes, W25X_FastReadDummy);
+#endif
+}
+
+/**
+ * @brief read the next bytes of a continuous read
+ *
+ * @param
+ * pBuffer: read to buffer
+ * NumByteToRead: number of bytes to read
+ *
+ */
+void W25QXX_Stream_Read(uint8_t *pBuffer, uint16_t NumByteToRead)
+{
+#if W25QXX_USE_QSPI
+	if (W25QXX_StreamMap && NumByteToRead <= W25QXX_StreamLeft)
+	{
+		memcpy(pBuffer, W25QXX_StreamMap, NumByteToRead);
+		W25QXX_StreamMap += NumByteToRead;
+		W25QXX_StreamLeft -= NumByteToRead;
+	}
+	else
+	{
+		W25QXX_Read_Data(pBuffer, W25QXX_StreamAddr, NumByteToRead); // wraps at the end of the chip
+	}
+	W25QXX_StreamAddr += NumByteToRead;
+#else
+	SPI5_Receive(pBuffer, NumByteToRead);
+#endif
+}
+
+/**
+ * @brief end a continuous read
+ *
+ */
+void W25QXX_Stream_End(void)
+{
+#if W25QXX_USE_QSPI
+	if (W25QXX_StreamMap)
+	{
+		W25QXX_StreamMap = NULL;
+		W25QXX_Unmap();
+	}
+#else
+	W25QXX_CS = 1;
+#endif
+}
+
+/**
+ * @brief read any number of bytes in one transaction, handing them to a
+ * callback chunk by chunk
+ *
+ * @param
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read, no 65535 limit
+ * pChunk: chunk buffer
+ * ChunkSize: chunk buffer size
+ * callback: called for each chunk, returns 0 to continue
+ * arg: passed to callback
+ *
+ * @return 0: all data read, 1: stopped by the callback, no chunk buffer or
+ * no callback
+ *
+ */
+uint8_t W25QXX_Read_Stream(uint32_t ReadAddr, uint32_t NumByteToRead, uint8_t *pChunk, uint16_t ChunkSize, W25QXX_Stream_Callback callback, void *arg)
+{
+	uint16_t len;
+	uint8_t stop = 0;
+	if (pChunk == NULL || ChunkSize == 0 || callback == NULL)
+	{
+		return 1;
+	}
+	W25QXX_Stream_Begin(ReadAddr);
+	while (NumByteToRead > 0 && !stop)
+	{
+		len = NumByteToRead > ChunkSize ? ChunkSize : NumByteToRead;
+		W25QXX_Stream_Read(pChunk, len);
+		NumByteToRead -= len;
+		stop = callback(pChunk, len, arg);
+	}
+	W25QXX_Stream_End();
+	return stop ? 1 : 0;
+}
+
+/**
+ * @brief map a flash region into the address space
+ *
+ * @param
+ * Addr: flash start address
+ * Len: region size in bytes
+ *
+ * @return pointer to the byte at Addr, NULL: no memory-mapped mode, the
+ * region is outside the chip or 255 mappings are held
+ *
+ */
+const uint8_t *W25QXX_Map(uint32_t Addr, uint32_t Len)
+{
+#if W25QXX_USE_QSPI
+	uint32_t size = W25QXX_Size();
+	if (Addr >= size || Len > size - Addr || W25QXX_MapCount == 0XFF)
+	{
+		return NULL;
+	}
+	W25QXX_MapCount++;
+	if (W25QXX_MapCount == 1 && W25QXX_MapHold == 0 && W25QXX_Map_Enter() != 0)
+	{
+		W25QXX_MapCount = 0;
+		return NULL;
+	}
+	return (const uint8_t *)(QSPI_MAP_BASE + Addr);
+#else
+	(void)Addr;
+	(void)Len;
+	return NULL;
+#endif
+}
+
+/**
+ * @brief release a mapping returned by W25QXX_Map, memory-mapped mode is
+ * left with the last one
+ *
+ */
+void W25QXX_Unmap(void)
+{
+#if W25QXX_USE_QSPI
+	if (W25QXX_MapCount == 1 && W25QXX_MapHold == 0)
+	{
+		W25QXX_Map_Leave();
+	}
+	if (W25QXX_MapCount)
+	{
+		W25QXX_MapCount--;
+	}
+#endif
 }
 
 /**
- * @brief write W25QXX status registers
+ * @brief set the burst wrap of Fast Read Quad I/O (0x77)
  *
  * @param
- * regno: W25QXX status register number. range 1 ~ 3.
- * sr: status register data
+ * Wrap: 8, 16, 32 or 64 bytes, 0: off
+ *
+ * @return 0: success, 1: not in quad mode or invalid Wrap
  *
  */
-void W25QXX_Write_SR(uint8_t regno, uint8_t sr)
+uint8_t W25QXX_Set_Burst_Wrap(uint8_t Wrap)
 {
-	uint8_t command = 0;
-	switch (regno)
+#if W25QXX_USE_QSPI
+	uint8_t w; // W6-W4
+	switch (Wrap)
 	{
-	case 1:
-		command = W25X_WriteStatusReg1;
+	case 0:
+		w = 0X10; // W4 = 1: wrap disabled
 		break;
-	case 2:
-		command = W25X_WriteStatusReg2;
+	case 8:
+		w = 0X00;
 		break;
-	case 3:
-		command = W25X_WriteStatusReg3;
+	case 16:
+		w = 0X20;
 		break;
-	default:
-		command = W25X_WriteStatusReg1;
+	case 32:
+		w = 0X40;
 		break;
+	case 64:
+		w = 0X60;
+		break;
+	default:
+		return 1;
 	}
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(command);
-	SPI5_ReadWriteByte(sr);
-	W25QXX_CS = 1;
+	if (W25QXX_LANES != 4)
+	{
+		return 1;
+	}
+	W25QXX_Map_Suspend();
+	// 24 dummy bits then W7-W0, all on 4 lines
+	QSPI_Command(W25X_SetBurstWrap, 0, 3, 4, w, 0, 0, 0);
+	W25QXX_Map_Resume();
+	return 0;
+#else
+	(void)Wrap;
+	return 1;
+#endif
+}
+
+static int W25QXX_Req_Cmp(const void *a, const void *b)
+{
+	uint32_t x = ((const W25QXX_Read_Req *)a)->addr, y = ((const W25QXX_Read_Req *)b)->addr;
+	return x < y ? -1 : x > y;
 }
 
+#if W25QXX_USE_QSPI
+
+static uint8_t W25QXX_MultiBuf[W25QXX_MULTI_SPAN]; // requests merged into one read
+
 /**
- * @brief enable write W25QXX
+ * @brief one read of W25QXX_Read_Multi
+ * In quad mode the reads of one call are chained in continuous read mode:
+ * the first sends the instruction and mode byte 0X20, the others start
+ * with the address, the last one sends mode byte 0XFF and the chip takes
+ * normal commands again.
+ *
+ * @param
+ * pBuffer: read to buffer
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read
+ * first: 1: the first read of the call
+ * last: 1: the last read of the call
  *
  */
-void W25QXX_Write_Enable(void)
+static void W25QXX_Read_Chained(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead, uint8_t first, uint8_t last)
 {
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_WriteEnable);
-	W25QXX_CS = 1;
+	uint16_t mode = last ? W25QXX_ReadMode : W25X_ContinuousRead;
+	uint8_t err;
+	if (W25QXX_LANES != 4)
+	{
+		W25QXX_Read_Data(pBuffer, ReadAddr, NumByteToRead);
+		return;
+	}
+	if (first)
+	{
+		err = QSPI_Command(W25QXX_CmdRead, ReadAddr, W25QXX_AddrBytes, 4, mode, W25QXX_ReadDummy, 4, NumByteToRead);
+	}
+	else
+	{
+		err = QSPI_Continue(ReadAddr, W25QXX_AddrBytes, 4, mode, W25QXX_ReadDummy, 4, NumByteToRead);
+	}
+	if (err == 0)
+	{
+		QSPI_Receive(pBuffer);
+	}
 }
 
 /**
- * @brief disable write W25QXX
+ * @brief read many small regions with the fewest transactions
+ * The requests are sorted by address in place. Requests at most
+ * W25QXX_MULTI_GAP bytes apart, spanning at most W25QXX_MULTI_SPAN bytes,
+ * are read with one command into W25QXX_MultiBuf and copied out.
+ *
+ * @param
+ * pReq: requests
+ * Num: number of requests
+ *
+ * @return number of read commands issued
  *
  */
-void W25QXX_Write_Disable(void)
+uint16_t W25QXX_Read_Multi(W25QXX_Read_Req *pReq, uint16_t Num)
 {
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_WriteDisable);
-	W25QXX_CS = 1;
+	uint16_t i, j, k, n, last, reads = 0;
+	uint32_t end;
+	qsort(pReq, Num, sizeof(pReq[0]), W25QXX_Req_Cmp);
+	for (last = Num; last > 0 && pReq[last - 1].len == 0; last--)
+	{
+	}
+	W25QXX_Map_Suspend(); // once for the whole chain
+	for (i = 0; i < last; i = j)
+	{
+		j = i + 1;
+		if (pReq[i].len == 0)
+		{
+			continue;
+		}
+		end = pReq[i].addr + pReq[i].len;
+		for (n = 1; j < last; j++)
+		{
+			if (pReq[j].len == 0)
+			{
+				continue;
+			}
+			if (pReq[j].addr < end || pReq[j].addr - end > W25QXX_MULTI_GAP ||
+				pReq[j].addr + pReq[j].len - pReq[i].addr > W25QXX_MULTI_SPAN)
+			{
+				break;
+			}
+			end = pReq[j].addr + pReq[j].len;
+			n++;
+		}
+		if (n == 1)
+		{
+			W25QXX_Read_Chained(pReq[i].buf, pReq[i].addr, pReq[i].len, reads == 0, j >= last);
+		}
+		else
+		{
+			W25QXX_Read_Chained(W25QXX_MultiBuf, pReq[i].addr, end - pReq[i].addr, reads == 0, j >= last);
+			for (k = i; k < j; k++)
+			{
+				memcpy(pReq[k].buf, W25QXX_MultiBuf + (pReq[k].addr - pReq[i].addr), pReq[k].len);
+			}
+		}
+		reads++;
+	}
+	W25QXX_Map_Resume();
+	return reads;
 }
 
+#else
+
 /**
- * @brief read W25QXX ID
+ * @brief skip bytes of a continuous read
+ * SPI5 receives them into a static buffer in one transfer, a byte by byte
+ * skip costs more than a new command
  *
- * @return W25QXX ID
+ * @param
+ * NumByteToSkip: number of bytes, at most W25QXX_MULTI_GAP
  *
  */
-uint16_t W25QXX_ReadID(void)
+static void W25QXX_Stream_Skip(uint16_t NumByteToSkip)
 {
-	uint16_t Temp = 0;
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(0x90);
-	SPI5_ReadWriteByte(0x00);
-	SPI5_ReadWriteByte(0x00);
-	SPI5_ReadWriteByte(0x00);
-	Temp |= SPI5_ReadWriteByte(0xFF) << 8;
-	Temp |= SPI5_ReadWriteByte(0xFF);
-	W25QXX_CS = 1;
-	return Temp;
+	static uint8_t gap[W25QXX_MULTI_GAP];
+	SPI5_Receive(gap, NumByteToSkip);
 }
 
 /**
- * @brief read data from  W25QXX FLASH by SPI
+ * @brief read many small regions with the fewest transactions
+ * The requests are sorted by address in place.
+ *
  * @param
- * pBuffer: read to buffer
- * ReadAddr: flash start address
- * NumByteToRead: number of bytes to read(MAX: 65535)
+ * pReq: requests
+ * Num: number of requests
+ *
+ * @return number of read commands issued, one per continuous read
  *
  */
-void W25QXX_Read(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+uint16_t W25QXX_Read_Multi(W25QXX_Read_Req *pReq, uint16_t Num)
 {
-	if (NumByteToRead < 0 || NumByteToRead > 65535)
-	{
-		return;
-	}
-	uint16_t i;
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_ReadData);
-	if (W25QXX_TYPE == W25Q256)
+	uint16_t i, reads = 0;
+	uint8_t open = 0; // a continuous read is open
+	uint32_t pos = 0; // next address of the open read
+	qsort(pReq, Num, sizeof(pReq[0]), W25QXX_Req_Cmp);
+	for (i = 0; i < Num; i++)
 	{
-		SPI5_ReadWriteByte((uint8_t)((ReadAddr) >> 24));
+		if (pReq[i].len == 0)
+		{
+			continue;
+		}
+		if (!open || pReq[i].addr < pos || pReq[i].addr - pos > W25QXX_MULTI_GAP)
+		{
+			if (open)
+			{
+				W25QXX_Stream_End();
+			}
+			W25QXX_Stream_Begin(pReq[i].addr);
+			open = 1;
+			reads++;
+		}
+		else if (pReq[i].addr > pos)
+		{
+			W25QXX_Stream_Skip(pReq[i].addr - pos);
+		}
+		W25QXX_Stream_Read(pReq[i].buf, pReq[i].len);
+		pos = pReq[i].addr + pReq[i].len;
 	}
-	SPI5_ReadWriteByte((uint8_t)((ReadAddr) >> 16));
-	SPI5_ReadWriteByte((uint8_t)((ReadAddr) >> 8));
-	SPI5_ReadWriteByte((uint8_t)ReadAddr);
-	for (i = 0; i < NumByteToRead; i++)
+	if (open)
 	{
-		pBuffer[i] = SPI5_ReadWriteByte(0XFF);
+		W25QXX_Stream_End();
 	}
-	W25QXX_CS = 1;
+	return reads;
 }
 
+#endif
+
 /**
  * @brief write data to W25QXX FLASH by SPI
  *
@@ -210,27 +1037,14 @@ void W25QXX_Read(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
  */
 void W25QXX_Write_Page(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 {
-	if (NumByteToRead < 0 || NumByteToRead > 256)
+	if (NumByteToWrite > 256)
 	{
 		return;
 	}
-	uint16_t i;
-	W25QXX_Write_Enable();
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_PageProgram);
-	if (W25QXX_TYPE == W25Q256)
-	{
-		SPI5_ReadWriteByte((uint8_t)((WriteAddr) >> 24));
-	}
-	SPI5_ReadWriteByte((uint8_t)((WriteAddr) >> 16));
-	SPI5_ReadWriteByte((uint8_t)((WriteAddr) >> 8));
-	SPI5_ReadWriteByte((uint8_t)WriteAddr);
-	for (i = 0; i < NumByteToWrite; i++)
-	{
-		SPI5_ReadWriteByte(pBuffer[i]);
-	}
-	W25QXX_CS = 1;
+	W25QXX_Map_Suspend();
+	W25QXX_Program_Start(pBuffer, WriteAddr, NumByteToWrite);
 	W25QXX_Wait_Busy();
+	W25QXX_Map_Resume();
 }
 
 /**
@@ -251,6 +1065,7 @@ void W25QXX_Write_NoCheck(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByte
 	{
 		pageremain = NumByteToWrite;
 	}
+	W25QXX_Map_Suspend();
 	while (1)
 	{
 		W25QXX_Write_Page(pBuffer, WriteAddr, pageremain);
@@ -274,10 +1089,60 @@ void W25QXX_Write_NoCheck(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByte
 			}
 		}
 	};
+	W25QXX_Map_Resume();
+}
+
+/**
+ * @brief program only the bytes of pData that differ from pOld, one page
+ * program per page from the first to the last changed byte
+ *
+ * @param
+ * pData: new data
+ * pOld: current flash content at Addr, NULL if erased (all 0xFF)
+ * Addr: flash start address
+ * Len: number of bytes (max 4096)
+ *
+ * @return number of bytes programmed
+ *
+ */
+static uint16_t W25QXX_Program_Changed(uint8_t *pData, const uint8_t *pOld, uint32_t Addr, uint16_t Len)
+{
+	uint16_t done = 0, programmed = 0;
+	uint16_t pageremain, first, last, i;
+	while (done < Len)
+	{
+		pageremain = 256 - (Addr + done) % 256;
+		if (pageremain > Len - done)
+		{
+			pageremain = Len - done;
+		}
+		first = pageremain;
+		last = 0;
+		for (i = 0; i < pageremain; i++)
+		{
+			if (pData[done + i] != (pOld ? pOld[done + i] : 0XFF))
+			{
+				if (first == pageremain)
+				{
+					first = i;
+				}
+				last = i;
+			}
+		}
+		if (first < pageremain)
+		{
+			W25QXX_Write_Page(pData + done + first, Addr + done + first, last - first + 1);
+			programmed += last - first + 1;
+		}
+		done += pageremain;
+	}
+	return programmed;
 }
 
 /**
  * @brief write data to W25QXX FLASH by SPI with erase
+ * The sector is only erased when the new data needs a 0 bit turned back
+ * into 1, and only changed pages are programmed.
  *
  * @param
  * pBuffer: data in buffer
@@ -291,9 +1156,11 @@ void W25QXX_Write(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 	uint32_t secpos;
 	uint16_t secoff;
 	uint16_t secremain;
+	uint16_t programmed;
 	uint16_t i;
 	uint8_t *W25QXX_BUF;
 	W25QXX_BUF = W25QXX_BUFFER;
+	TRACE_BEGIN(trace, NumByteToWrite);
 	secpos = WriteAddr / 4096; // sector addr
 	secoff = WriteAddr % 4096; // offset in sector
 	secremain = 4096 - secoff; // Sector remaining space size
@@ -302,28 +1169,42 @@ void W25QXX_Write(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 	{
 		secremain = NumByteToWrite;
 	}
+	W25QXX_Map_Suspend();
 	while (1)
 	{
-		W25QXX_Read(W25QXX_BUF, secpos * 4096, 4096);
+		// only the bytes being written decide whether an erase is needed
+		W25QXX_Read_Data(W25QXX_BUF + secoff, WriteAddr, secremain);
 		for (i = 0; i < secremain; i++)
 		{
-			if (W25QXX_BUF[secoff + i] != 0XFF)
+			if ((W25QXX_BUF[secoff + i] & pBuffer[i]) != pBuffer[i])
 			{
 				break;
 			}
 		}
 		if (i < secremain)
 		{
+			// a bit must go 0 -> 1: keep the rest of the sector and erase
+			if (secoff > 0)
+			{
+				W25QXX_Read_Data(W25QXX_BUF, secpos * 4096, secoff);
+			}
+			if (secoff + secremain < 4096)
+			{
+				W25QXX_Read_Data(W25QXX_BUF + secoff + secremain, secpos * 4096 + secoff + secremain, 4096 - secoff - secremain);
+			}
 			W25QXX_Erase_Sector(secpos);
 			for (i = 0; i < secremain; i++)
 			{
 				W25QXX_BUF[i + secoff] = pBuffer[i];
 			}
-			W25QXX_Write_NoCheck(W25QXX_BUF, secpos * 4096, 4096);
+			programmed = W25QXX_Program_Changed(W25QXX_BUF, 0, secpos * 4096, 4096);
+			W25QXX_STATS.bytes_saved += 4096 - programmed;
 		}
 		else
 		{
-			W25QXX_Write_NoCheck(pBuffer, WriteAddr, secremain);
+			// only clears bits: program the changed bytes in place
+			programmed = W25QXX_Program_Changed(pBuffer, W25QXX_BUF + secoff, WriteAddr, secremain);
+			W25QXX_STATS.bytes_saved += secremain - programmed;
 		}
 		if (NumByteToWrite == secremain)
 		{
@@ -347,6 +1228,8 @@ void W25QXX_Write(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 			}
 		}
 	};
+	W25QXX_Map_Resume();
+	TRACE_END(TRACE_W25QXX_WRITE, trace);
 }
 
 /**
@@ -354,12 +1237,11 @@ void W25QXX_Write(uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
  */
 void W25QXX_Erase_Chip(void)
 {
-	W25QXX_Write_Enable(); // SET WEL
+	W25QXX_Map_Suspend();
 	W25QXX_Wait_Busy();
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_ChipErase);
-	W25QXX_CS = 1;
+	W25QXX_Chip_Erase_Start();
 	W25QXX_Wait_Busy();
+	W25QXX_Map_Resume();
 }
 
 /**
@@ -374,19 +1256,59 @@ void W25QXX_Erase_Sector(uint32_t Dst_Addr)
 {
 	// printf("fe:%x\r\n",Dst_Addr);
 	Dst_Addr *= 4096;
-	W25QXX_Write_Enable(); // SET WEL
+	W25QXX_Map_Suspend();
 	W25QXX_Wait_Busy();
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_SectorErase);
-	if (W25QXX_TYPE == W25Q256)
+	W25QXX_Erase_Start(W25QXX_CmdSectorErase, Dst_Addr, 4096);
+	W25QXX_Wait_Busy();
+	W25QXX_Map_Resume();
+}
+
+/**
+ * @brief erase an address range with the fewest erase commands
+ * Each step uses the largest erase (64K, 32K, 4K) that is aligned at the
+ * current address and fits in the rest of the range.
+ *
+ * @param
+ * Dst_Addr: flash start address, 4K aligned
+ * Len: number of bytes, multiple of 4K
+ *
+ * @return 0: success, 1: range not 4K aligned
+ *
+ */
+uint8_t W25QXX_Erase_Range(uint32_t Dst_Addr, uint32_t Len)
+{
+	uint8_t cmd;
+	uint32_t size;
+	if ((Dst_Addr | Len) & 0XFFF)
 	{
-		SPI5_ReadWriteByte((uint8_t)((Dst_Addr) >> 24));
+		return 1;
 	}
-	SPI5_ReadWriteByte((uint8_t)((Dst_Addr) >> 16));
-	SPI5_ReadWriteByte((uint8_t)((Dst_Addr) >> 8));
-	SPI5_ReadWriteByte((uint8_t)Dst_Addr);
-	W25QXX_CS = 1;
-	W25QXX_Wait_Busy();
+	W25QXX_Map_Suspend();
+	while (Len > 0)
+	{
+		if ((Dst_Addr & 0XFFFF) == 0 && Len >= 0X10000)
+		{
+			cmd = W25QXX_CmdBlockErase;
+			size = 0X10000;
+		}
+		else if ((Dst_Addr & 0X7FFF) == 0 && Len >= 0X8000 && Dst_Addr < 0X1000000)
+		{
+			cmd = W25X_BlockErase32K;
+			size = 0X8000;
+		}
+		else
+		{
+			cmd = W25QXX_CmdSectorErase;
+			size = 0X1000;
+		}
+		W25QXX_Wait_Busy();
+		W25QXX_Erase_Start(cmd, Dst_Addr, size);
+		W25QXX_Wait_Busy();
+		Dst_Addr += size;
+		Len -= size;
+	}
+	W25QXX_Map_Resume();
+	return 0;
 }
 
 /**
@@ -395,9 +1317,11 @@ void W25QXX_Erase_Sector(uint32_t Dst_Addr)
  */
 void W25QXX_Wait_Busy(void)
 {
+	W25QXX_Map_Suspend();
 	while ((W25QXX_ReadSR(1) & 0x01) == 0x01)
 	{
 	};
+	W25QXX_Map_Resume();
 }
 
 /**
@@ -406,9 +1330,7 @@ void W25QXX_Wait_Busy(void)
  */
 void W25QXX_PowerDown(void)
 {
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_PowerDown);
-	W25QXX_CS = 1;
+	W25QXX_Cmd_Write(W25X_PowerDown, 0, 0, NULL, 0);
 	delay_us(3);
 }
 
@@ -418,8 +1340,178 @@ void W25QXX_PowerDown(void)
  */
 void W25QXX_WAKEUP(void)
 {
-	W25QXX_CS = 0;
-	SPI5_ReadWriteByte(W25X_ReleasePowerDown); //  send W25X_PowerDown command 0xAB
-	W25QXX_CS = 1;
+	W25QXX_Cmd_Write(W25X_ReleasePowerDown, 0, 0, NULL, 0); //  send W25X_PowerDown command 0xAB
 	delay_us(3);
 }
+
+// job queue of the asynchronous API, one slot is kept empty so that the
+// producer only writes the tail and W25QXX_Async_Poll only the head
+static W25QXX_Job W25QXX_Jobs[W25QXX_JOB_NUM];
+static volatile uint8_t W25QXX_JobHead = 0;
+static volatile uint8_t W25QXX_JobTail = 0;
+static uint8_t W25QXX_JobBusy = 0; // the head job has an operation in progress
+
+/**
+ * @brief put a job into the queue
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+static uint8_t W25QXX_Async_Push(uint8_t op, uint32_t addr, const uint8_t *pBuffer, uint16_t len, W25QXX_Callback callback, void *arg)
+{
+	uint8_t next = (W25QXX_JobTail + 1) % W25QXX_JOB_NUM;
+	W25QXX_Job *job;
+	if (next == W25QXX_JobHead)
+	{
+		return 1;
+	}
+	job = &W25QXX_Jobs[W25QXX_JobTail];
+	job->op = op;
+	job->addr = addr;
+	job->buf = pBuffer;
+	job->len = len;
+	job->callback = callback;
+	job->arg = arg;
+	W25QXX_JobTail = next;
+	return 0;
+}
+
+/**
+ * @brief queue a sector erase
+ *
+ * @param
+ * Dst_Addr: sector address
+ * callback: called from W25QXX_Async_Poll when the erase is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Erase_Sector(uint32_t Dst_Addr, W25QXX_Callback callback, void *arg)
+{
+	return W25QXX_Async_Push(W25QXX_JOB_ERASE_SECTOR, Dst_Addr * 4096, 0, 0, callback, arg);
+}
+
+/**
+ * @brief queue a chip erase
+ *
+ * @param
+ * callback: called from W25QXX_Async_Poll when the erase is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Erase_Chip(W25QXX_Callback callback, void *arg)
+{
+	return W25QXX_Async_Push(W25QXX_JOB_ERASE_CHIP, 0, 0, 0, callback, arg);
+}
+
+/**
+ * @brief queue a write without erase, split into page programs like
+ * W25QXX_Write_NoCheck. pBuffer must stay valid until the callback.
+ *
+ * @param
+ * pBuffer: data in buffer
+ * WriteAddr: flash start address
+ * NumByteToWrite: The number of bytes to write (max 65535)
+ * callback: called from W25QXX_Async_Poll when the write is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Write_NoCheck(const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite, W25QXX_Callback callback, void *arg)
+{
+	return W25QXX_Async_Push(W25QXX_JOB_WRITE, WriteAddr, pBuffer, NumByteToWrite, callback, arg);
+}
+
+/**
+ * @brief advance the job queue, never blocks on the flash
+ *
+ */
+void W25QXX_Async_Poll(void)
+{
+	W25QXX_Job *job;
+	W25QXX_Callback callback;
+	void *arg;
+	uint16_t pageremain;
+	if (W25QXX_JobHead == W25QXX_JobTail)
+	{
+		return;
+	}
+	job = &W25QXX_Jobs[W25QXX_JobHead];
+	if (W25QXX_JobBusy)
+	{
+		if ((W25QXX_ReadSR(1) & 0x01) == 0x01)
+		{
+			return; // still busy, try again next poll
+		}
+		W25QXX_JobBusy = 0;
+		W25QXX_Map_Resume(); // held since the operation started
+	}
+	else if (job->op == W25QXX_JOB_ERASE_SECTOR)
+	{
+		W25QXX_Map_Suspend();
+		W25QXX_Erase_Start(W25QXX_CmdSectorErase, job->addr, 4096);
+		W25QXX_JobBusy = 1;
+		job->op = W25QXX_JOB_DONE;
+		return;
+	}
+	else if (job->op == W25QXX_JOB_ERASE_CHIP)
+	{
+		W25QXX_Map_Suspend();
+		W25QXX_Chip_Erase_Start();
+		W25QXX_JobBusy = 1;
+		job->op = W25QXX_JOB_DONE;
+		return;
+	}
+
+	if (job->op == W25QXX_JOB_WRITE && job->len > 0)
+	{
+		pageremain = 256 - job->addr % 256;
+		if (job->len <= pageremain)
+		{
+			pageremain = job->len;
+		}
+		W25QXX_Map_Suspend();
+		W25QXX_Program_Start(job->buf, job->addr, pageremain);
+		W25QXX_JobBusy = 1;
+		job->buf += pageremain;
+		job->addr += pageremain;
+		job->len -= pageremain;
+		return;
+	}
+
+	// done, free the slot before the callback so it may queue a new job
+	callback = job->callback;
+	arg = job->arg;
+	W25QXX_JobHead = (W25QXX_JobHead + 1) % W25QXX_JOB_NUM;
+	if (callback)
+	{
+		callback(arg);
+	}
+}
+
+/**
+ * @brief check whether asynchronous jobs are pending
+ *
+ * @return 1: jobs pending, 0: queue empty and flash idle
+ *
+ */
+uint8_t W25QXX_Async_Busy(void)
+{
+	return W25QXX_JobHead != W25QXX_JobTail;
+}
+
+/**
+ * @brief run W25QXX_Async_Poll until all queued jobs are done
+ *
+ */
+void W25QXX_Async_Flush(void)
+{
+	while (W25QXX_Async_Busy())
+	{
+		W25QXX_Async_Poll();
+	}
+}
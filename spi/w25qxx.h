@@ -23,6 +23,31 @@
 
 extern uint16_t W25QXX_TYPE;						   
 
+//erase/program counters, may be cleared by the application at any time
+typedef struct _W25QXX_Stats
+{
+    uint32_t erases;           //sector and chip erase commands
+    uint32_t pages_programmed; //page program commands
+    uint32_t bytes_saved;      //bytes W25QXX_Write did not have to program
+} W25QXX_Stats;
+
+extern W25QXX_Stats W25QXX_STATS;
+
+//QUADSPI transport, only on parts with a QUADSPI peripheral. 0: the flash
+//is on SPI5 (STM32F429), all commands single line
+#ifndef W25QXX_USE_QSPI
+#define W25QXX_USE_QSPI     0
+#endif
+
+//widest reads W25QXX_Init selects on QUADSPI: 4 (Quad I/O, sets QE, 2 if
+//QE cannot be set), 2 (Dual Output, QE is left alone) or 1
+#ifndef W25QXX_QSPI_LANES
+#define W25QXX_QSPI_LANES   4
+#endif
+
+//data lines used by reads, 1, 2 or 4, selected by W25QXX_Init
+extern uint8_t W25QXX_LANES;
+
 #define	W25QXX_CS 		PFout(6)  		//W25QXX CS 
 
 ////////////////////////////////////////////////////
@@ -40,6 +65,7 @@ extern uint16_t W25QXX_TYPE;
 #define W25X_FastReadDual		0x3B 
 #define W25X_PageProgram		0x02 
 #define W25X_BlockErase			0xD8 
+#define W25X_BlockErase32K		0x52 
 #define W25X_SectorErase		0x20 
 #define W25X_ChipErase			0xC7 
 #define W25X_PowerDown			0xB9 
@@ -49,6 +75,29 @@ extern uint16_t W25QXX_TYPE;
 #define W25X_JedecDeviceID		0x9F 
 #define W25X_Enable4ByteAddr    0xB7
 #define W25X_Exit4ByteAddr      0xE9
+//4-byte address commands (W25Q256), independent of the ADS mode bit
+#define W25X_ReadData4B         0x13
+#define W25X_FastReadData4B     0x0C
+#define W25X_PageProgram4B      0x12
+#define W25X_SectorErase4B      0x21
+#define W25X_BlockErase4B       0xDC
+//multi line commands, data (and for Quad I/O the address) on IO0~IO3
+#define W25X_FastReadDual4B     0x3C
+#define W25X_FastReadQuadIO     0xEB
+#define W25X_FastReadQuadIO4B   0xEC
+#define W25X_QuadPageProgram    0x32
+#define W25X_QuadPageProgram4B  0x34
+#define W25X_SetBurstWrap       0x77
+
+//Fast Read Quad I/O mode byte that keeps the chip in continuous read mode,
+//the next read skips the instruction
+#define W25X_ContinuousRead     0X20
+
+//status register 2 Quad Enable bit, IO2/IO3 are /WP and /HOLD while clear
+#define W25X_SR2_QE             0X02
+
+//Fast Read needs 8 dummy clocks between address and data
+#define W25X_FastReadDummy      1
 
 /**
  * @brief initialization W25Q256
@@ -118,6 +167,15 @@ void W25QXX_Write_Enable(void);
  */
 void W25QXX_Write_Disable(void);	
 
+/**
+ * @brief set the non-volatile QE bit if it is clear, needed by the quad
+ * read and program commands
+ *
+ * @return 0: QE set, 1: the part did not take it (no quad support)
+ *
+ */
+uint8_t W25QXX_Quad_Enable(void);
+
 /**
  * @brief write data to W25QXX FLASH by SPI (NO CHECK)
  *
@@ -132,6 +190,8 @@ void W25QXX_Write_NoCheck(uint8_t* pBuffer,uint32_t WriteAddr,uint16_t NumByteTo
 
 /**
  * @brief read data from  W25QXX FLASH by SPI
+ * Fast Read (0x0B, 0x0C on W25Q256) is used, Read Data (0x03) is limited
+ * to 50MHz SCK
  * @param
  * pBuffer: read to buffer
  * ReadAddr: flash start address
@@ -140,8 +200,150 @@ void W25QXX_Write_NoCheck(uint8_t* pBuffer,uint32_t WriteAddr,uint16_t NumByteTo
  */
 void W25QXX_Read(uint8_t* pBuffer,uint32_t ReadAddr,uint16_t NumByteToRead);   
 
+////////////////////////////////////////////////////
+//STREAMING READ
+//One Fast Read transaction stays open between W25QXX_Stream_Begin and
+//W25QXX_Stream_End, the address phase is paid once. On QUADSPI the chip is
+//mapped for the stream instead and the data copied out of the window. No
+//other W25QXX function may be called in between.
+
+//chunk callback of W25QXX_Read_Stream, return 0 to continue
+typedef uint8_t (*W25QXX_Stream_Callback)(const uint8_t *pData, uint16_t Len, void *arg);
+
+/**
+ * @brief start a continuous read, the flash sends data from ReadAddr on
+ * for as long as CS stays low
+ *
+ * @param
+ * ReadAddr: flash start address
+ *
+ */
+void W25QXX_Stream_Begin(uint32_t ReadAddr);
+
+/**
+ * @brief read the next bytes of a continuous read
+ *
+ * @param
+ * pBuffer: read to buffer
+ * NumByteToRead: number of bytes to read
+ *
+ */
+void W25QXX_Stream_Read(uint8_t *pBuffer, uint16_t NumByteToRead);
+
+/**
+ * @brief end a continuous read
+ *
+ */
+void W25QXX_Stream_End(void);
+
+/**
+ * @brief read any number of bytes in one transaction, handing them to a
+ * callback chunk by chunk
+ *
+ * @param
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read, no 65535 limit
+ * pChunk: chunk buffer
+ * ChunkSize: chunk buffer size
+ * callback: called for each chunk, returns 0 to continue
+ * arg: passed to callback
+ *
+ * @return 0: all data read, 1: stopped by the callback, no chunk buffer or
+ * no callback
+ *
+ */
+uint8_t W25QXX_Read_Stream(uint32_t ReadAddr, uint32_t NumByteToRead, uint8_t *pChunk, uint16_t ChunkSize, W25QXX_Stream_Callback callback, void *arg);
+
+////////////////////////////////////////////////////
+//MEMORY-MAPPED READ
+//With QUADSPI the flash can be read in place through a pointer, each
+//mapping stays valid until its W25QXX_Unmap. Other W25QXX calls leave
+//memory-mapped mode for their commands: reads for the one command, writes
+//and erases until BUSY has cleared, across W25QXX_Async_Poll calls for a
+//queued job's erase or page program. The pointers must not be used in
+//between, memory-mapped mode is re-entered with the D-cache invalidated
+//once the operation has finished. On SPI5 W25QXX_Map returns NULL, use
+//W25QXX_Read then.
+//
+//  const uint8_t *font = W25QXX_Map(FONT_ADDR, FONT_SIZE);
+//  if (font == NULL) ... copy through W25QXX_Read
+//  ...
+//  W25QXX_Unmap();
+
+/**
+ * @brief map a flash region into the address space
+ *
+ * @param
+ * Addr: flash start address
+ * Len: region size in bytes
+ *
+ * @return pointer to the byte at Addr, NULL: no memory-mapped mode, the
+ * region is outside the chip or 255 mappings are held
+ *
+ */
+const uint8_t *W25QXX_Map(uint32_t Addr, uint32_t Len);
+
+/**
+ * @brief release a mapping returned by W25QXX_Map, memory-mapped mode is
+ * left with the last one
+ *
+ */
+void W25QXX_Unmap(void);
+
+/**
+ * @brief set the burst wrap of Fast Read Quad I/O (0x77)
+ * While set, quad reads and mapped reads wrap inside aligned windows of
+ * Wrap bytes (critical word first line fills). No read may cross a window.
+ * Needs the QUADSPI transport in quad mode (W25QXX_LANES 4).
+ *
+ * @param
+ * Wrap: 8, 16, 32 or 64 bytes, 0: off (power-up default)
+ *
+ * @return 0: success, 1: not in quad mode or invalid Wrap
+ *
+ */
+uint8_t W25QXX_Set_Burst_Wrap(uint8_t Wrap);
+
+////////////////////////////////////////////////////
+//SCATTER-GATHER READ
+
+//bytes between two requests read through (and discarded) rather than
+//paying a new command, address and CS cycle. A new Fast Read costs the
+//opcode, 4 address bytes and a dummy byte, beyond that the gap is slower
+#define W25QXX_MULTI_GAP    6
+
+//QUADSPI: longest run of merged requests, read into a buffer and copied
+#define W25QXX_MULTI_SPAN   256
+
+typedef struct _W25QXX_Read_Req
+{
+    uint32_t addr;  //flash start address
+    uint8_t *buf;   //read to buffer
+    uint16_t len;   //number of bytes to read
+} W25QXX_Read_Req;
+
+/**
+ * @brief read many small regions with the fewest transactions
+ * The requests are sorted by address in place. Requests that are adjacent
+ * or at most W25QXX_MULTI_GAP bytes apart share one continuous read,
+ * overlapping ones start a new read. QUADSPI drives NCS per command, there
+ * a merged run (at most W25QXX_MULTI_SPAN bytes) is read into a buffer,
+ * and in quad mode the reads are chained in continuous read mode, each
+ * after the first without the instruction.
+ *
+ * @param
+ * pReq: requests
+ * Num: number of requests
+ *
+ * @return number of read commands issued, one per continuous read or run
+ *
+ */
+uint16_t W25QXX_Read_Multi(W25QXX_Read_Req *pReq, uint16_t Num);
+
 /**
  * @brief write data to W25QXX FLASH by SPI with erase
+ * The sector is only erased when the new data needs a 0 bit turned back
+ * into 1, and only changed pages are programmed.
  *
  * @param
  * pBuffer: data in buffer
@@ -166,6 +368,22 @@ void W25QXX_Erase_Chip(void);
  */
 void W25QXX_Erase_Sector(uint32_t Dst_Addr);
 
+/**
+ * @brief erase an address range with the fewest erase commands
+ * Each step uses the largest erase (64K, 32K, 4K) that is aligned at the
+ * current address and fits in the rest of the range. Typical erase time
+ * (W25Q256JV): 4K 45ms, 32K 120ms, 64K 150ms. 32K erase has no 4-byte
+ * address form and is only used below 16M.
+ *
+ * @param
+ * Dst_Addr: flash start address, 4K aligned
+ * Len: number of bytes, multiple of 4K
+ *
+ * @return 0: success, 1: range not 4K aligned
+ *
+ */
+uint8_t W25QXX_Erase_Range(uint32_t Dst_Addr, uint32_t Len);
+
 /**
  * @brief wait for busy
  *
@@ -184,4 +402,94 @@ void W25QXX_PowerDown(void);
  */
 void W25QXX_WAKEUP(void);			
 
+////////////////////////////////////////////////////
+//ASYNCHRONOUS ERASE/PROGRAM
+//Jobs are started and advanced by W25QXX_Async_Poll, called from the main
+//loop or a tick hook. Do not use the blocking functions above while
+//W25QXX_Async_Busy() returns 1, call W25QXX_Async_Flush() first.
+#define W25QXX_JOB_NUM  8   //queue slots, one is kept free
+
+typedef enum _W25QXX_JOB_OP
+{
+    W25QXX_JOB_ERASE_SECTOR,
+    W25QXX_JOB_ERASE_CHIP,
+    W25QXX_JOB_WRITE,
+    W25QXX_JOB_DONE         //erase issued, waiting for BUSY to clear
+} W25QXX_JOB_OP;
+
+typedef void (*W25QXX_Callback)(void *arg);
+
+typedef struct _W25QXX_Job
+{
+    uint8_t op;
+    uint32_t addr;
+    const uint8_t *buf;
+    uint16_t len;
+    W25QXX_Callback callback;
+    void *arg;
+} W25QXX_Job;
+
+/**
+ * @brief queue a sector erase
+ *
+ * @param
+ * Dst_Addr: sector address
+ * callback: called from W25QXX_Async_Poll when the erase is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Erase_Sector(uint32_t Dst_Addr, W25QXX_Callback callback, void *arg);
+
+/**
+ * @brief queue a chip erase
+ *
+ * @param
+ * callback: called from W25QXX_Async_Poll when the erase is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Erase_Chip(W25QXX_Callback callback, void *arg);
+
+/**
+ * @brief queue a write without erase, split into page programs like
+ * W25QXX_Write_NoCheck. pBuffer must stay valid until the callback.
+ *
+ * @param
+ * pBuffer: data in buffer
+ * WriteAddr: flash start address
+ * NumByteToWrite: The number of bytes to write (max 65535)
+ * callback: called from W25QXX_Async_Poll when the write is done, may be NULL
+ * arg: passed to callback
+ *
+ * @return 0: queued, 1: queue full
+ *
+ */
+uint8_t W25QXX_Async_Write_NoCheck(const uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite, W25QXX_Callback callback, void *arg);
+
+/**
+ * @brief advance the job queue, never blocks on the flash
+ * Each call reads the status register at most once and starts at most
+ * one erase or page program.
+ *
+ */
+void W25QXX_Async_Poll(void);
+
+/**
+ * @brief check whether asynchronous jobs are pending
+ *
+ * @return 1: jobs pending, 0: queue empty and flash idle
+ *
+ */
+uint8_t W25QXX_Async_Busy(void);
+
+/**
+ * @brief run W25QXX_Async_Poll until all queued jobs are done
+ *
+ */
+void W25QXX_Async_Flush(void);
+
 #endif
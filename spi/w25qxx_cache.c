@@ -0,0 +1,184 @@
+#include "w25qxx_cache.h"
+#include "string.h"
+
+W25QXX_Cache_Stats W25QXX_CACHE_STATS;
+
+#if W25QXX_USE_CACHE
+
+#define W25QXX_CACHE_INVALID 0XFFFFFFFF
+
+typedef struct _W25QXX_Cache_Line
+{
+	uint32_t page;	// flash page number, W25QXX_CACHE_INVALID if empty
+	uint32_t stamp; // last use, the smallest is replaced
+	uint8_t data[W25QXX_CACHE_LINE];
+} W25QXX_Cache_Line;
+
+static W25QXX_Cache_Line W25QXX_Cache[W25QXX_CACHE_LINES];
+static uint32_t W25QXX_CacheClock = 0;
+static uint8_t W25QXX_CacheReady = 0;
+
+/**
+ * @brief find the line holding a page
+ *
+ * @return line, NULL on miss
+ *
+ */
+static W25QXX_Cache_Line *W25QXX_Cache_Find(uint32_t page)
+{
+	uint16_t i;
+	if (!W25QXX_CacheReady)
+	{
+		W25QXX_Cache_Flush();
+	}
+	for (i = 0; i < W25QXX_CACHE_LINES; i++)
+	{
+		if (W25QXX_Cache[i].page == page)
+		{
+			return &W25QXX_Cache[i];
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief load a page into the least recently used line
+ *
+ */
+static W25QXX_Cache_Line *W25QXX_Cache_Load(uint32_t page)
+{
+	W25QXX_Cache_Line *line = &W25QXX_Cache[0];
+	uint16_t i;
+	for (i = 0; i < W25QXX_CACHE_LINES; i++)
+	{
+		if (W25QXX_Cache[i].page == W25QXX_CACHE_INVALID)
+		{
+			line = &W25QXX_Cache[i]; // empty line, nothing to evict
+			break;
+		}
+		if (W25QXX_Cache[i].stamp < line->stamp)
+		{
+			line = &W25QXX_Cache[i];
+		}
+	}
+	if (line->page != W25QXX_CACHE_INVALID)
+	{
+		W25QXX_CACHE_STATS.evictions++;
+	}
+	W25QXX_Read(line->data, page * W25QXX_CACHE_LINE, W25QXX_CACHE_LINE);
+	line->page = page;
+	return line;
+}
+
+/**
+ * @brief read data from W25QXX FLASH through the cache
+ * Reads of W25QXX_CACHE_SIZE bytes or more bypass the cache.
+ *
+ * @param
+ * pBuffer: read to buffer
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read(MAX: 65535)
+ *
+ */
+void W25QXX_Cache_Read(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+	W25QXX_Cache_Line *line;
+	uint16_t off, len;
+	if (NumByteToRead >= W25QXX_CACHE_SIZE)
+	{
+		W25QXX_Read(pBuffer, ReadAddr, NumByteToRead);
+		return;
+	}
+	while (NumByteToRead > 0)
+	{
+		off = ReadAddr % W25QXX_CACHE_LINE;
+		len = W25QXX_CACHE_LINE - off;
+		if (len > NumByteToRead)
+		{
+			len = NumByteToRead;
+		}
+		line = W25QXX_Cache_Find(ReadAddr / W25QXX_CACHE_LINE);
+		if (line)
+		{
+			W25QXX_CACHE_STATS.hits++;
+			W25QXX_CACHE_STATS.bytes_saved += len;
+		}
+		else
+		{
+			W25QXX_CACHE_STATS.misses++;
+			line = W25QXX_Cache_Load(ReadAddr / W25QXX_CACHE_LINE);
+		}
+		line->stamp = ++W25QXX_CacheClock;
+		memcpy(pBuffer, line->data + off, len);
+		pBuffer += len;
+		ReadAddr += len;
+		NumByteToRead -= len;
+	}
+}
+
+/**
+ * @brief drop all cached lines
+ *
+ */
+void W25QXX_Cache_Flush(void)
+{
+	uint16_t i;
+	for (i = 0; i < W25QXX_CACHE_LINES; i++)
+	{
+		W25QXX_Cache[i].page = W25QXX_CACHE_INVALID;
+		W25QXX_Cache[i].stamp = 0;
+	}
+	W25QXX_CacheReady = 1;
+}
+
+/**
+ * @brief apply a page program to the cached lines, called by the driver
+ * Programming can only clear bits, so the line keeps old & new.
+ *
+ * @param
+ * pBuffer: programmed data
+ * Addr: flash start address
+ * Len: number of bytes, within one page
+ *
+ */
+void W25QXX_Cache_Program(const uint8_t *pBuffer, uint32_t Addr, uint16_t Len)
+{
+	W25QXX_Cache_Line *line = W25QXX_Cache_Find(Addr / W25QXX_CACHE_LINE);
+	uint16_t i, off = Addr % W25QXX_CACHE_LINE;
+	if (!line)
+	{
+		return;
+	}
+	for (i = 0; i < Len && off + i < W25QXX_CACHE_LINE; i++)
+	{
+		line->data[off + i] &= pBuffer[i];
+	}
+}
+
+/**
+ * @brief apply an erase to the cached lines, called by the driver
+ *
+ * @param
+ * Addr: flash start address
+ * Len: number of bytes erased
+ *
+ */
+void W25QXX_Cache_Erase(uint32_t Addr, uint32_t Len)
+{
+	uint16_t i;
+	uint32_t first = Addr / W25QXX_CACHE_LINE;
+	uint32_t last = (Addr + Len - 1) / W25QXX_CACHE_LINE;
+	if (!W25QXX_CacheReady)
+	{
+		W25QXX_Cache_Flush();
+	}
+	for (i = 0; i < W25QXX_CACHE_LINES; i++)
+	{
+		if (W25QXX_Cache[i].page != W25QXX_CACHE_INVALID && W25QXX_Cache[i].page >= first && W25QXX_Cache[i].page <= last)
+		{
+			memset(W25QXX_Cache[i].data, 0XFF, W25QXX_CACHE_LINE);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * w25qxx_cache.h
+ *
+ */
+
+#ifndef __W25QXX_CACHE_H_
+#define __W25QXX_CACHE_H_
+#include "sys.h"
+#include "w25qxx.h"
+
+/**
+ * Page read cache in front of W25QXX_Read
+ *
+ * Lines are one flash page (256 bytes), replaced least recently used.
+ * The cache is write-through: page programs and erases issued by the
+ * W25QXX driver update the cached lines, so W25QXX_Cache_Read always
+ * returns the flash content.
+ *
+ */
+#ifndef W25QXX_USE_CACHE
+#define W25QXX_USE_CACHE    1       //0: W25QXX_Cache_Read is W25QXX_Read
+#endif
+#ifndef W25QXX_CACHE_SIZE
+#define W25QXX_CACHE_SIZE   4096    //RAM budget in bytes, a multiple of W25QXX_CACHE_LINE
+#endif
+#define W25QXX_CACHE_LINE   256     //line size, one flash page
+#define W25QXX_CACHE_LINES  (W25QXX_CACHE_SIZE / W25QXX_CACHE_LINE)
+
+#if W25QXX_CACHE_SIZE < W25QXX_CACHE_LINE || W25QXX_CACHE_SIZE % W25QXX_CACHE_LINE != 0
+#error "W25QXX_CACHE_SIZE must be a non-zero multiple of W25QXX_CACHE_LINE"
+#endif
+
+typedef struct _W25QXX_Cache_Stats
+{
+    uint32_t hits;        //pages served from the cache
+    uint32_t misses;      //pages read from flash
+    uint32_t evictions;   //valid lines replaced
+    uint32_t bytes_saved; //bytes not transferred over SPI
+} W25QXX_Cache_Stats;
+
+extern W25QXX_Cache_Stats W25QXX_CACHE_STATS;
+
+#if W25QXX_USE_CACHE
+
+/**
+ * @brief read data from W25QXX FLASH through the cache
+ * Reads of W25QXX_CACHE_SIZE bytes or more bypass the cache.
+ *
+ * @param
+ * pBuffer: read to buffer
+ * ReadAddr: flash start address
+ * NumByteToRead: number of bytes to read(MAX: 65535)
+ *
+ */
+void W25QXX_Cache_Read(uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead);
+
+/**
+ * @brief drop all cached lines
+ *
+ */
+void W25QXX_Cache_Flush(void);
+
+/**
+ * @brief apply a page program to the cached lines, called by the driver
+ *
+ * @param
+ * pBuffer: programmed data
+ * Addr: flash start address
+ * Len: number of bytes, within one page
+ *
+ */
+void W25QXX_Cache_Program(const uint8_t *pBuffer, uint32_t Addr, uint16_t Len);
+
+/**
+ * @brief apply an erase to the cached lines, called by the driver
+ *
+ * @param
+ * Addr: flash start address
+ * Len: number of bytes erased
+ *
+ */
+void W25QXX_Cache_Erase(uint32_t Addr, uint32_t Len);
+
+#else
+
+#define W25QXX_Cache_Read(pBuffer, ReadAddr, NumByteToRead) W25QXX_Read(pBuffer, ReadAddr, NumByteToRead)
+#define W25QXX_Cache_Flush()
+#define W25QXX_Cache_Program(pBuffer, Addr, Len)
+#define W25QXX_Cache_Erase(Addr, Len)
+
+#endif
+
+#endif
@@ -0,0 +1,113 @@
+#include "trace.h"
+#include "usart.h"
+#include "stdlib.h"
+#include "string.h"
+
+typedef struct _Trace_Rec
+{
+	volatile uint32_t seq; // reserved index + 1, 0 while being written
+	uint32_t start;		   // start cycle
+	uint32_t cycles;	   // duration
+	uint32_t bytes;
+	uint16_t xfers;
+	uint8_t id;
+} Trace_Rec;
+
+volatile uint32_t TRACE_XFERS = 0;
+
+static Trace_Rec Trace_Buf[TRACE_BUF_SIZE];
+static volatile uint32_t Trace_Head = 0; // records ever reserved
+
+static const char *const TRACE_NAME[TRACE_ID_NUM] = {
+	"W25QXX_Read",
+	"W25QXX_Write",
+	"OLED_Refresh_Gram",
+	"IIC_Write",
+	"IIC_Read",
+};
+
+/**
+ * @brief enable the DWT cycle counter and clear the records
+ *
+ */
+void Trace_Init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	memset(Trace_Buf, 0, sizeof(Trace_Buf));
+	Trace_Head = 0;
+}
+
+/**
+ * @brief store a record, called by TRACE_END
+ *
+ * @param
+ * id: traced function
+ * m: mark taken by TRACE_BEGIN
+ *
+ */
+void Trace_Record(uint8_t id, const Trace_Mark *m)
+{
+	uint32_t end = DWT->CYCCNT;
+	uint32_t idx;
+	Trace_Rec *rec;
+	do
+	{
+		idx = __LDREXW(&Trace_Head);
+	} while (__STREXW(idx + 1, &Trace_Head));
+	rec = &Trace_Buf[idx & (TRACE_BUF_SIZE - 1)];
+	rec->seq = 0;
+	rec->start = m->start;
+	rec->cycles = end - m->start;
+	rec->bytes = m->bytes;
+	rec->xfers = TRACE_XFERS - m->xfers;
+	rec->id = id;
+	__DMB();
+	rec->seq = idx + 1; // publish
+}
+
+static int Trace_Cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief print count, p50, p99 and max cycles, bytes and transactions of
+ * each traced function
+ *
+ */
+void Trace_Dump(void)
+{
+	static uint32_t cycles[TRACE_BUF_SIZE];
+	uint32_t head = Trace_Head;
+	uint32_t first = head > TRACE_BUF_SIZE ? head - TRACE_BUF_SIZE : 0;
+	uint32_t i, n, bytes, xfers;
+	uint8_t id;
+	Trace_Rec *rec;
+
+	printf("trace: %lu records, %lu MHz\r\n", (unsigned long)(head - first), (unsigned long)(SystemCoreClock / 1000000));
+	for (id = 0; id < TRACE_ID_NUM; id++)
+	{
+		n = bytes = xfers = 0;
+		for (i = first; i < head; i++)
+		{
+			rec = &Trace_Buf[i & (TRACE_BUF_SIZE - 1)];
+			if (rec->seq != i + 1 || rec->id != id)
+			{
+				continue; // being written or overwritten
+			}
+			cycles[n++] = rec->cycles;
+			bytes += rec->bytes;
+			xfers += rec->xfers;
+		}
+		if (n == 0)
+		{
+			continue;
+		}
+		qsort(cycles, n, sizeof(cycles[0]), Trace_Cmp);
+		printf("%-18s n=%lu p50=%lu p99=%lu max=%lu cycles, %lu bytes, %lu xfers\r\n",
+			   TRACE_NAME[id], (unsigned long)n, (unsigned long)cycles[(n - 1) * 50 / 100],
+			   (unsigned long)cycles[(n - 1) * 99 / 100], (unsigned long)cycles[n - 1], (unsigned long)bytes, (unsigned long)xfers);
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ * trace.h
+ *
+ */
+
+#ifndef __TRACE_H_
+#define __TRACE_H_
+#include "sys.h"
+
+/**
+ * Trace points for driver hot paths
+ *
+ * A traced call records its start cycle (DWT->CYCCNT), duration, bytes
+ * moved and the bus transactions issued meanwhile (SPI5 block transfers,
+ * OLED bus writes, I2C starts) into a lock-free ring buffer. Trace_Dump
+ * prints p50/p99/max cycles per function.
+ *
+ * With TRACE_ENABLE 0 the macros expand to nothing.
+ *
+ *  void Foo(uint8_t *buf, uint16_t len)
+ *  {
+ *      TRACE_BEGIN(trace, len);
+ *      ...
+ *      TRACE_XFER(); //for each bus transaction
+ *      ...
+ *      TRACE_END(TRACE_FOO, trace);
+ *  }
+ *
+ */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE    0
+#endif
+#define TRACE_BUF_SIZE  256 //records, power of 2
+
+//traced functions
+typedef enum _TRACE_ID
+{
+    TRACE_W25QXX_READ,
+    TRACE_W25QXX_WRITE,
+    TRACE_OLED_REFRESH,
+    TRACE_IIC_WRITE,
+    TRACE_IIC_READ,
+    TRACE_ID_NUM
+} TRACE_ID;
+
+typedef struct _Trace_Mark
+{
+    uint32_t start; //DWT->CYCCNT at TRACE_BEGIN
+    uint32_t xfers; //TRACE_XFERS at TRACE_BEGIN
+    uint32_t bytes; //bytes moved
+} Trace_Mark;
+
+#if TRACE_ENABLE
+
+extern volatile uint32_t TRACE_XFERS;
+
+#define TRACE_NOW()              (DWT->CYCCNT)
+#define TRACE_BEGIN(m, bytes)    Trace_Mark m = {TRACE_NOW(), TRACE_XFERS, (bytes)}
+#define TRACE_ADD(m, n)          ((m).bytes += (n))
+#define TRACE_XFER()             (TRACE_XFERS++)
+#define TRACE_END(id, m)         Trace_Record((id), &(m))
+
+#else
+
+#define TRACE_BEGIN(m, bytes)
+#define TRACE_ADD(m, n)
+#define TRACE_XFER()
+#define TRACE_END(id, m)
+
+#endif
+
+/**
+ * @brief enable the DWT cycle counter and clear the records
+ *
+ */
+void Trace_Init(void);
+
+/**
+ * @brief store a record, called by TRACE_END
+ * Safe from interrupts, a slot is reserved with LDREX/STREX and the oldest
+ * record is overwritten.
+ *
+ * @param
+ * id: traced function
+ * m: mark taken by TRACE_BEGIN
+ *
+ */
+void Trace_Record(uint8_t id, const Trace_Mark *m);
+
+/**
+ * @brief print count, p50, p99 and max cycles, bytes and transactions of
+ * each traced function over the records in the ring buffer
+ *
+ */
+void Trace_Dump(void);
+
+#endif